@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+
+
+namespace vkx {
+
+
+	struct BoneInfo;
+
+	// bone name to bone index (transparent, looked up by a node's char name)
+	typedef std::map<std::string, uint32_t, std::less<>> BoneMapping;
+
+
+
+	// evaluates an assimp animation over a flattened node hierarchy
+	//
+	// bind() walks the hierarchy once into an array where every parent comes before its children and looks up
+	// each node's channel and bone, evaluate() is then a single loop over that array
+	// keyframes are found from a cursor per channel (the last key used, time mostly moves forward a bit),
+	// falling back to a binary search
+	// the channels point into the scene, it has to stay loaded while the animation is used
+	class AnimationRuntime {
+
+		private:
+
+			struct Node {
+				// index of the parent node, -1 for the root
+				int32_t parent;
+				// into channels, -1 when the animation doesn't move the node
+				int32_t channel;
+				// into the bone transforms, -1 when no vertex is weighted to the node
+				int32_t bone;
+				// bind pose, used when there is no channel
+				aiMatrix4x4 transformation;
+				const aiNode *source;
+			};
+
+			struct Channel {
+				const aiNodeAnim *nodeAnim;
+				uint32_t positionCursor{ 0 };
+				uint32_t rotationCursor{ 0 };
+				uint32_t scalingCursor{ 0 };
+			};
+
+			std::vector<Node> nodes;
+			std::vector<Channel> channels;
+			std::vector<aiMatrix4x4> boneOffsets;
+
+			// node transforms of the last evaluate()
+			std::vector<aiMatrix4x4> globals;
+
+			const aiScene *scene{ nullptr };
+			const aiAnimation *animation{ nullptr };
+
+			void flatten(const aiNode *node, int32_t parent);
+
+			aiMatrix4x4 sample(Channel &channel, float time) const;
+
+		public:
+
+			// flattens the scene's hierarchy (the first time) and binds the animation's channels and the bones to the nodes
+			void bind(const aiScene *scene, const aiAnimation *animation, const BoneMapping &boneMapping, const std::vector<BoneInfo> &boneInfo);
+
+			// time in ticks, writes globalInverseTransform * node transform * bone offset of every bone
+			void evaluate(float time, const aiMatrix4x4 &globalInverseTransform, std::vector<aiMatrix4x4> &boneTransforms);
+
+			const aiAnimation *getAnimation() const { return this->animation; }
+
+			uint32_t nodeCount() const { return (uint32_t)this->nodes.size(); }
+			uint32_t channelCount() const { return (uint32_t)this->channels.size(); }
+	};
+
+}
@@ -63,6 +63,7 @@
 #include "vulkanInit.hpp"
 #include "vulkanTools.h"
 #include "vulkanDebug.h"
+#include "vulkanArena.h"
 
 #include "vulkanAssetManager.h"
 #include "vulkanContext.h"
@@ -70,9 +71,18 @@
 
 #include "vulkanTextureLoader.h"
 #include "vulkanMeshLoader.h"
+#include "vulkanVertexFormat.h"
 #include "vulkanMesh.h"
 #include "vulkanModel.h"
 #include "vulkanSkinnedMesh.h"
+#include "vulkanMaterialTable.h"
+#include "vulkanTextureStreamer.h"
+#include "vulkanMeshResidency.h"
+#include "vulkanUniformRing.h"
+#include "vulkanDrawList.h"
+#include "vulkanStaticBatch.h"
+#include "vulkanPipelineBatch.h"
+#include "vulkanTimeline.h"
 
 #include "vulkanTextOverlay.h"
 //#include "vulkanTextOverlay2.hpp"
@@ -162,6 +172,9 @@ namespace vkx
 
 			// initialize and set references to context
 			vkx::Context context;
+
+			// startup stage timings, printed when the first frame is ready
+			vkx::StartupTimeline startupTimeline;
 			//vk::Device &device = context.device;
 			//vk::PhysicalDevice &physicalDevice = context.physicalDevice;
 			//vk::Queue &queue = context.queue;
@@ -233,6 +246,10 @@ namespace vkx
 				bool SSAO = true;
 				// enable shadow mapping
 				bool shadows = true;
+				// cull g-buffer meshlets on the gpu
+				bool meshletCulling = true;
+				// merge static models into world space chunks per material after start()
+				bool staticBatching = true;
 
 				// shadow mapping:
 				float depthBiasConstant = 1.25f;
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+
+
+// size of an arena block, bigger allocations get a block of their own
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+// replaces the global operator new / delete to count heap allocations per frame
+#define ARENA_COUNT_HEAP_ALLOCATIONS 1
+
+
+
+namespace vkx {
+
+
+	// bump allocator for transient data, nothing is freed until reset()
+	//
+	// the blocks are kept across resets, after a few frames the arena stops allocating from the heap
+	class Arena {
+
+		private:
+
+			struct Block {
+				std::unique_ptr<uint8_t[]> data;
+				size_t size{ 0 };
+			};
+
+			std::vector<Block> blocks;
+			size_t blockSize;
+
+			// the block allocations come from and the bytes used in it
+			size_t current{ 0 };
+			size_t used{ 0 };
+
+			// bytes in the blocks before current
+			size_t usedBefore{ 0 };
+
+			size_t highWater{ 0 };
+
+		public:
+
+			// where the arena was, rewind() frees everything allocated after it
+			struct Marker {
+				size_t block;
+				size_t used;
+				size_t usedBefore;
+			};
+
+			explicit Arena(size_t blockSize = ARENA_BLOCK_SIZE);
+
+			Arena(const Arena&) = delete;
+			Arena &operator=(const Arena&) = delete;
+
+			void *allocate(size_t size, size_t alignment);
+
+			template <typename T>
+			T *allocate(size_t count) {
+				return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+			}
+
+			Marker mark() const;
+			void rewind(const Marker &marker);
+
+			// frees everything, keeps the blocks
+			void reset();
+
+			size_t bytesUsed() const { return this->usedBefore + this->used; }
+			size_t highWaterMark() const { return this->highWater; }
+			size_t capacity() const;
+	};
+
+
+
+	// std allocator over an arena, deallocate() does nothing
+	template <typename T>
+	class ArenaAllocator {
+
+		public:
+
+			typedef T value_type;
+
+			Arena *arena;
+
+			ArenaAllocator(Arena &arena) : arena(&arena) {}
+
+			template <typename U>
+			ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+			T *allocate(size_t count) {
+				return this->arena->allocate<T>(count);
+			}
+
+			void deallocate(T*, size_t) {}
+
+			template <typename U>
+			bool operator==(const ArenaAllocator<U> &other) const { return this->arena == other.arena; }
+
+			template <typename U>
+			bool operator!=(const ArenaAllocator<U> &other) const { return this->arena != other.arena; }
+	};
+
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+
+
+	// reset at the start of every frame, main thread only
+	// whatever is allocated from it must be gone by the end of the frame
+	Arena &frameArena();
+
+	// the calling thread's arena, for workers (and main thread code that can run outside a frame)
+	Arena &scratchArena();
+
+	// rewinds the thread's scratch arena to where it was when the scope started
+	class ScratchScope {
+		private:
+			Arena::Marker marker;
+		public:
+			ScratchScope();
+			~ScratchScope();
+			Arena &arena() { return scratchArena(); }
+	};
+
+	// a vector in the frame arena
+	template <typename T>
+	ArenaVector<T> frameVector() {
+		return ArenaVector<T>(ArenaAllocator<T>(frameArena()));
+	}
+
+
+
+	struct FrameAllocations {
+		// operator new calls during the frame (0 without ARENA_COUNT_HEAP_ALLOCATIONS)
+		uint64_t heapAllocations{ 0 };
+		// bytes the frame arena handed out
+		size_t frameArenaBytes{ 0 };
+		size_t frameArenaCapacity{ 0 };
+	};
+
+	// called at the start of every frame, resets the frame arena and keeps the counts of the frame before
+	void beginFrameAllocations();
+
+	// the frame before the current one
+	const FrameAllocations &lastFrameAllocations();
+
+	// operator new calls since the start
+	uint64_t heapAllocationCount();
+
+}
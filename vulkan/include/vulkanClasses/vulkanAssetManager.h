@@ -2,6 +2,7 @@
 
 
 #include <unordered_map>
+#include <atomic>
 
 #include <vulkan/vulkan.hpp>
 
@@ -21,6 +22,8 @@
 #include "vulkanContext.h"
 #include "vulkanTextureLoader.h"
 #include "vulkanMeshLoader.h"
+#include "vulkanGeometryPool.h"
+#include "vulkanArena.h"
 
 #include "Object3D.h"
 
@@ -120,6 +123,10 @@ namespace vkx {
 
 	struct MeshBuffer;// defined in vulkanMeshLoader.h
 
+	class TextureStreamer;// defined in vulkanTextureStreamer.h
+
+	class MeshResidency;// defined in vulkanMeshResidency.h
+
 
 
 
@@ -129,13 +136,13 @@ namespace vkx {
 	class ResourceList {
 		public:
 			std::unordered_map<std::string, T> resources;
-			const T get(std::string name) {
+			const T get(const std::string &name) {
 				return resources[name];
 			}
-			T *getPtr(std::string name) {
+			T *getPtr(const std::string &name) {
 				return &resources[name];
 			}
-			bool present(std::string name) {
+			bool present(const std::string &name) {
 				return resources.find(name) != resources.end();
 			}
 	};
@@ -144,13 +151,13 @@ namespace vkx {
 	class OrderedResourceList {
 		public:
 			std::map<std::string, T> resources;
-			const T get(std::string name) {
+			const T get(const std::string &name) {
 				return resources[name];
 			}
-			T *getPtr(std::string name) {
+			T *getPtr(const std::string &name) {
 				return &resources[name];
 			}
-			bool present(std::string name) {
+			bool present(const std::string &name) {
 				return resources.find(name) != resources.end();
 			}
 	};
@@ -162,19 +169,21 @@ namespace vkx {
 			vk::Device &device;
 			std::map<std::string, T> resources;
 			OrderedVulkanResourceList(vk::Device &dev) : device(dev) {};
-			const T get(std::string name) {
-				if (!present(name)) {
+			const T get(const std::string &name) {
+				auto it = resources.find(name);
+				if (it == resources.end()) {
 					throw;
 				}
-				return resources[name];
+				return it->second;
 			}
-			T *getPtr(std::string name) {
-				if (!present(name)) {
+			T *getPtr(const std::string &name) {
+				auto it = resources.find(name);
+				if (it == resources.end()) {
 					throw;
 				}
-				return &resources[name];
+				return &it->second;
 			}
-			bool present(std::string name) {
+			bool present(const std::string &name) {
 				return resources.find(name) != resources.end();
 			}
 	};
@@ -188,19 +197,21 @@ namespace vkx {
 			vk::Device &device;
 			std::unordered_map<std::string, T> resources;
 			VulkanResourceList(vk::Device &dev) : device(dev) {};
-			const T get(std::string name) {
-				if (!present(name)) {
+			const T get(const std::string &name) {
+				auto it = resources.find(name);
+				if (it == resources.end()) {
 					throw;
 				}
-				return resources[name];
+				return it->second;
 			}
-			T *getPtr(std::string name) {
-				if (!present(name)) {
+			T *getPtr(const std::string &name) {
+				auto it = resources.find(name);
+				if (it == resources.end()) {
 					throw;
 				}
-				return &resources[name];
+				return &it->second;
 			}
-			bool present(std::string name) {
+			bool present(const std::string &name) {
 				return resources.find(name) != resources.end();
 			}
 	};
@@ -393,6 +404,8 @@ namespace vkx {
 	};
 
 
+	// only the scenes a mesh loader retains (MESH_RETAIN_SCENE) or spawns from repeatedly (MESH_RETAIN_POSITIONS),
+	// the others are freed after parsing
 	class SceneList : public ResourceList</*const */aiScene*> {
 
 		public:
@@ -406,6 +419,14 @@ namespace vkx {
 			void add(std::string name, /*const */aiScene* scene) {
 				resources[name] = scene;
 			}
+
+			// orphaned scenes belong to the list
+			void destroy() {
+				for (auto &iterator : resources) {
+					delete iterator.second;
+				}
+				resources.clear();
+			}
 	};
 
 	
@@ -464,22 +485,23 @@ namespace vkx {
 				}
 			}
 
-			const vkx::Texture get(std::string name) {
+			const vkx::Texture get(const std::string &name) {
 				return resources[name];
 			}
 
-			std::shared_ptr<vkx::Texture> getSharedPtr(std::string name) {
+			// a copy that references the list's texture, the list destroys the image / view and the context's cache the sampler
+			std::shared_ptr<vkx::Texture> getSharedPtr(const std::string &name) {
 				auto texture = std::make_shared<vkx::Texture>(resources[name]);
 
 				return texture;
 			}
 
-			std::shared_ptr<vkx::Texture> getOrLoad(std::string name, vkx::TextureLoader *textureLoader) {
+			std::shared_ptr<vkx::Texture> getOrLoad(std::string name, vkx::TextureLoader *textureLoader, vkx::texture::Usage usage = vkx::texture::Usage::eColor) {
 				if (present(name)) {
 					auto texture = std::make_shared<vkx::Texture>(resources[name]);
 					return texture;
 				} else {
-					vkx::Texture tex = textureLoader->loadTexture(name, vk::Format::eBc2UnormBlock);
+					vkx::Texture tex = textureLoader->loadTexture(name, usage);
 					add(name, tex);
 					auto texture = std::make_shared<vkx::Texture>(resources[name]);
 					return texture;
@@ -508,7 +530,7 @@ namespace vkx {
 	//			}
 	//		}
 
-	//		const Material get(std::string name) {
+	//		const Material get(const std::string &name) {
 	//			return resources[name];
 	//		}
 
@@ -532,13 +554,16 @@ namespace vkx {
 
 		std::map<std::string, Material> resources;
 
+		// bumped by every change, the material table uploads its records again when it differs
+		uint32_t generation{ 0 };
+
 		void destroy() {
 			for (auto &material : resources) {
 				material.second.destroy();
 			}
 		}
 
-		const Material get(std::string name) {
+		const Material get(const std::string &name) {
 			return resources[name];
 		}
 
@@ -547,16 +572,27 @@ namespace vkx {
 			this->sync();
 		}
 
-		bool present(std::string name) {
+		void remove(const std::string &name) {
+			resources.erase(name);
+			this->sync();
+		}
+
+		bool present(const std::string &name) {
 			return resources.find(name) != resources.end();
 		}
 
+		// after a material in resources was edited in place
+		void changed() {
+			this->generation++;
+		}
+
 		void sync() {
 			uint32_t counter = 0;
 			for (auto &iterator : resources) {
 				iterator.second.index = counter;
 				counter++;
 			}
+			this->generation++;
 		}
 	};
 
@@ -586,6 +622,12 @@ namespace vkx {
 			vk::DescriptorSetLayout* materialDescriptorSetLayoutDeferred{ nullptr };
 			vk::DescriptorPool* materialDescriptorPoolDeferred{ nullptr };
 
+			// set to stream the material textures in (models then load with their small mips only)
+			vkx::TextureStreamer* textureStreamer{ nullptr };
+
+			// set to evict the mesh buffers no model uses when they don't fit the budget
+			vkx::MeshResidency* meshResidency{ nullptr };
+
 
 
 
@@ -600,10 +642,48 @@ namespace vkx {
 
 			MeshBuffersList meshBuffers;
 
+			// shared vertex / index buffers for mesh buffers
+			GeometryPoolList geometryPools;
+
+			// host memory the mesh loaders gave back after uploading (see MeshRetention)
+			std::atomic<uint64_t> releasedMeshBytes{ 0 };
+			std::atomic<uint64_t> releasedSceneBytes{ 0 };
+
+			// a texture was recreated (texture streaming), every copy of it now refers to replacement
+			// and the material descriptor sets are written again
+			// nothing may be using the old texture (wait for the device first)
+			void replaceTexture(vk::Device device, const vkx::Texture &old, const vkx::Texture &replacement) {
+
+				for (auto &iterator : textures.resources) {
+					if (iterator.second.image == old.image) {
+						iterator.second = replacement;
+					}
+				}
+
+				ArenaVector<vk::WriteDescriptorSet> writes = frameVector<vk::WriteDescriptorSet>();
+				for (auto &iterator : materials.resources) {
+					Material &material = iterator.second;
+					std::shared_ptr<vkx::Texture> channels[] = { material.diffuse, material.specular, material.bump };
+					for (uint32_t binding = 0; binding < 3; ++binding) {
+						if (!channels[binding] || channels[binding]->image != old.image) {
+							continue;
+						}
+						*channels[binding] = replacement;
+						if (material.descriptorSet) {
+							writes.push_back(vkx::writeDescriptorSet(material.descriptorSet, vk::DescriptorType::eCombinedImageSampler, binding, &channels[binding]->descriptor));
+						}
+					}
+				}
+				if (!writes.empty()) {
+					device.updateDescriptorSets(writes, nullptr);
+				}
+			}
+
 			void destroy() {
 				textures.destroy();
+				geometryPools.destroy();
 				//materials.destroy();
-				//scenes.~SceneList();
+				scenes.destroy();
 			}
 
 
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "common.h"
+
+#include <map>
+#include <unordered_map>
+
 #include "vulkanDebug.h"
 #include "vulkanTools.h"
 #include "vulkanShaders.h"
@@ -20,6 +24,10 @@ namespace vkx {
 
 
 
+	// hash of the settings of a sampler (pNext isn't followed, cached samplers don't use it)
+	struct SamplerCreateInfoHash {
+		size_t operator()(const vk::SamplerCreateInfo &info) const;
+	};
 
 
 
@@ -30,6 +38,8 @@ namespace vkx {
         bool enableValidation = false;
         // Set to true when the debug marker extension is detected
         bool enableDebugMarkers = false;
+        // Set to true when VK_EXT_memory_budget is enabled (needs VK_KHR_get_physical_device_properties2 on the instance)
+        bool enableMemoryBudget = false;
         // fps timer (one second interval)
         float fpsTimer = 0.0f;
         // Create application wide Vulkan instance
@@ -58,8 +68,28 @@ namespace vkx {
 
 		void destroyContext();
 
+		// pipelineCacheDirectory + a name made from the vendor / device ids and the driver version
+		std::string pipelineCacheFileName() const;
+
+		// creates pipelineCache, from the cache file if there is a valid one for this device
+		void loadPipelineCache();
+
+		// writes pipelineCache to the cache file (merge any other caches into it first)
+		void savePipelineCache() const;
+
 		uint32_t findQueue(const vk::QueueFlags& flags, const vk::SurfaceKHR& presentSurface = vk::SurfaceKHR()) const;
 
+		// budget and usage of the device local heaps, from VK_EXT_memory_budget (returns true)
+		// without the extension budget is the heap size, usage is 0 and it returns false
+		bool getMemoryBudget(vk::DeviceSize &budget, vk::DeviceSize &usage) const;
+
+		// live and peak bytes of the allocations made through the context, per category and memory type
+		// tag allocations with a vkx::memory::Scope, otherwise the category is guessed from the usage
+		MemoryStats getMemoryStats() const;
+
+		// the stats and every live allocation as json
+		bool dumpMemoryStats(const std::string &fileName) const;
+
         // Vulkan instance, stores all per-application states
         vk::Instance instance;
         std::vector<vk::PhysicalDevice> physicalDevices;
@@ -75,8 +105,28 @@ namespace vkx {
         vk::Device device;
         // vk::Pipeline cache object
         vk::PipelineCache pipelineCache;
+        // where the pipeline cache is kept between runs (one file per device / driver), empty for the working directory
+        std::string pipelineCacheDirectory;
+        // false to not load / save the pipeline cache
+        bool persistPipelineCache = true;
+        // true if the cache was loaded from a previous run (warm start)
+        bool pipelineCacheLoaded = false;
+        // time spent in loadShader, for the startup timeline
+        mutable double shaderLoadTimeMS = 0.0;
         // List of shader modules created (stored for cleanup)
         mutable std::vector<vk::ShaderModule> shaderModules;
+        // loadShader's modules by file name, so passes sharing a shader (fullscreen.vert etc.) share the module
+        // (only used from the main thread)
+        mutable std::map<std::string, vk::ShaderModule> shaderModuleCache;
+        // where compileShader keeps the compiled spir-v, empty for the working directory
+        std::string spirvCacheDirectory;
+        // where the texture loader keeps png / tga sources cooked to ktx, empty for the working directory
+        std::string textureCacheDirectory;
+        // where evicted meshes are kept for re-upload (see MeshResidency), empty for the working directory
+        std::string meshCacheDirectory;
+        // getSampler's samplers by their settings, destroyed with the context
+        // (only used from the main thread)
+        mutable std::unordered_map<vk::SamplerCreateInfo, vk::Sampler, SamplerCreateInfoHash> samplerCache;
 
         vk::Queue queue;
         // Find a queue that supports graphics operations
@@ -162,6 +212,10 @@ namespace vkx {
 
 		CreateImageResult createImage(const vk::ImageCreateInfo& imageCreateInfo, const vk::MemoryPropertyFlags& memoryPropertyFlags) const;
 
+		// the sampler with these settings, created on first use
+		// it's shared, whoever uses it only references it and must not destroy it
+		vk::Sampler getSampler(const vk::SamplerCreateInfo& samplerCreateInfo) const;
+
         using MipData = ::std::pair<vk::Extent3D, vk::DeviceSize>;
 
 		CreateImageResult stageToDeviceImage(vk::ImageCreateInfo imageCreateInfo, const vk::MemoryPropertyFlags& memoryPropertyFlags, vk::DeviceSize size, const void* data, const std::vector<MipData>& mipData = {}) const;
@@ -211,6 +265,9 @@ namespace vkx {
 
 		CreateBufferResult stageToDeviceBuffer(const vk::BufferUsageFlags& usage, size_t size, const void* data) const;
 
+		// fill writes straight into the mapped staging memory, saves building a temporary copy first
+		CreateBufferResult stageToDeviceBuffer(const vk::BufferUsageFlags& usage, size_t size, const std::function<void(void*)> &fill) const;
+
         template <typename T>
 		CreateBufferResult stageToDeviceBuffer(const vk::BufferUsageFlags& usage, const std::vector<T>& data) const;
 
@@ -226,21 +283,36 @@ namespace vkx {
 		// Load a SPIR-V shader
 		// actually inline
 		inline vk::PipelineShaderStageCreateInfo loadShader(const std::string& fileName, vk::ShaderStageFlagBits stage) const {
+			auto tStart = std::chrono::high_resolution_clock::now();
 			vk::PipelineShaderStageCreateInfo shaderStage;
 			shaderStage.stage = stage;
+			shaderStage.pName = "main"; // todo : make param
+
+			auto cached = shaderModuleCache.find(fileName);
+			if (cached != shaderModuleCache.end()) {
+				shaderStage.module = cached->second;
+				return shaderStage;
+			}
+
 			#if defined(__ANDROID__)
 			shaderStage.module = loadShader(androidApp->activity->assetManager, fileName.c_str(), device, stage);
 			#else
 			shaderStage.module = vkx::loadShader(fileName.c_str(), device, stage);
 			#endif
-			shaderStage.pName = "main"; // todo : make param
 			assert(shaderStage.module);
 			shaderModules.push_back(shaderStage.module);
+			shaderModuleCache[fileName] = shaderStage.module;
+			shaderLoadTimeMS += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 			return shaderStage;
 		}
 
 		inline vk::PipelineShaderStageCreateInfo loadGlslShader(const std::string& fileName, vk::ShaderStageFlagBits stage) const;
 
+		// compiles a glsl file with defines through the spir-v cache, modules are shared like loadShader's
+		// without the glsl source (android, or only .spv files shipped) precompiledFileName is loaded instead,
+		// fileName + ".spv" if it's empty
+		vk::PipelineShaderStageCreateInfo compileShader(const std::string& fileName, vk::ShaderStageFlagBits stage, const shader::Defines& defines = shader::Defines(), const std::string& precompiledFileName = "") const;
+
         void submit(
             const vk::ArrayProxy<const vk::CommandBuffer>& commandBuffers,
             const vk::ArrayProxy<const vk::Semaphore>& wait = {},
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanMeshLoader.h"
+#include "vulkanMeshlet.h"
+
+
+
+namespace vkx {
+
+
+	// per mesh vertex shader push constants for the g-buffer and shadow passes
+	struct MeshPushConstants {
+		glm::vec4 positionCenter;
+		glm::vec4 positionExtent;
+		// index into the matrix node buffer
+		uint32_t objectIndex;
+	};
+
+
+	// what a pass recorded, shown in the overlay
+	struct DrawStats {
+		uint32_t draws{ 0 };
+		uint32_t pipelines{ 0 };
+		// descriptor sets bound
+		uint32_t descriptorSets{ 0 };
+		// vertex + index buffers bound
+		uint32_t buffers{ 0 };
+
+		uint32_t binds() const { return descriptorSets + buffers; }
+	};
+
+
+	// one draw of a mesh buffer
+	struct DrawCommand {
+		vk::Pipeline pipeline;
+
+		// set 2, only bound when the pass doesn't use the material table
+		vk::DescriptorSet materialSet;
+		// MaterialList index (pushed to the fragment stage with the material table)
+		uint32_t materialIndex{ 0 };
+
+		const MeshBuffer *meshBuffer{ nullptr };
+		uint32_t firstBinding{ 0 };
+		// the position stream only for depth passes
+		uint32_t streamCount{ 2 };
+
+		// compacted indices from the meshlet cull pass, drawn indirectly
+		const MeshletDrawTarget *culled{ nullptr };
+
+		MeshPushConstants pushConstants;
+	};
+
+
+	// the draws of one pass, sorted by a 64 bit key so draws sharing a pipeline, material and
+	// geometry block end up next to each other and record() only emits the binds that change
+	//
+	// key, high to low:
+	//	8 bits pipeline (in order of first use)
+	//	16 bits material / 16 bits geometry block (geometry first with the material table, a material switch is only a push there)
+	//	16 bits view depth bucket (front to back inside a state group)
+	class DrawList {
+
+		private:
+
+			struct SortItem {
+				uint64_t key;
+				uint32_t command;
+			};
+
+			std::vector<DrawCommand> commands;
+			std::vector<float> depths;
+
+			std::vector<SortItem> items;
+			std::vector<SortItem> scratch;
+
+			// small ids for the key
+			std::map<vk::Pipeline, uint32_t> pipelineIds;
+			std::map<vk::Buffer, uint32_t> geometryIds;
+
+			vk::PipelineLayout layout;
+			vk::ShaderStageFlags pushStages;
+			bool pushMaterialIndex{ false };
+
+			uint32_t pipelineId(vk::Pipeline pipeline);
+			uint32_t geometryId(const MeshBuffer &meshBuffer);
+
+			void radixSort();
+
+		public:
+
+			// of the last record()
+			DrawStats stats;
+
+			// start a new pass
+			// pushStages: stages of the MeshPushConstants range
+			// pushMaterialIndex: push DrawCommand::materialIndex after the mesh constants instead of binding materialSet
+			void reset(vk::PipelineLayout layout, vk::ShaderStageFlags pushStages, bool pushMaterialIndex);
+
+			// depth: view space distance, only used to order draws with the same state
+			void add(const DrawCommand &command, float depth = 0.0f);
+
+			size_t size() const { return commands.size(); }
+
+			// binds descriptor sets for the whole pass (counted in the stats)
+			void bindDescriptorSets(const vk::CommandBuffer &cmdBuffer, uint32_t firstSet, vk::ArrayProxy<const vk::DescriptorSet> sets);
+
+			// sorts the draws and records them
+			void record(const vk::CommandBuffer &cmdBuffer);
+	};
+
+}
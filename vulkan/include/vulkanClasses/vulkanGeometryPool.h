@@ -0,0 +1,178 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanContext.h"
+
+
+
+// default block sizes, meshes that don't fit get a block of their own
+#define GEOMETRY_POOL_BLOCK_VERTICES (1 << 20)
+#define GEOMETRY_POOL_BLOCK_INDEX_SIZE (32 * 1024 * 1024)
+
+
+
+namespace vkx {
+
+	class GeometryPool;
+
+
+	// a mesh's share of a GeometryPool block
+	// the offsets change when the pool is defragmented, so read them while recording, don't cache them
+	struct GeometryRange {
+		GeometryPool *pool{ nullptr };
+		uint32_t block{ 0 };
+
+		// in vertices, the same for every stream (drawIndexed vertexOffset)
+		uint32_t vertexOffset{ 0 };
+		uint32_t vertexCount{ 0 };
+
+		// in indices (drawIndexed firstIndex)
+		uint32_t firstIndex{ 0 };
+		uint32_t indexCount{ 0 };
+		vk::IndexType indexType{ vk::IndexType::eUint32 };
+
+		// in bytes, indexSize is padded to a whole number of 32 bit words
+		vk::DeviceSize indexOffset{ 0 };
+		vk::DeviceSize indexSize{ 0 };
+
+		// gives the range back to the pool
+		~GeometryRange();
+	};
+
+
+
+	// first fit free list over [0, capacity)
+	class RangeAllocator {
+
+		private:
+
+			// offset -> size
+			std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+
+		public:
+
+			vk::DeviceSize capacity{ 0 };
+			vk::DeviceSize used{ 0 };
+
+			// everything below usedEnd is allocated, the rest is free
+			void reset(vk::DeviceSize capacity, vk::DeviceSize usedEnd = 0);
+
+			bool allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize &offset);
+
+			void free(vk::DeviceSize offset, vk::DeviceSize size);
+	};
+
+
+
+	// device local vertex / index buffers shared by every mesh with the same vertex streams
+	// so draws of different meshes only differ in firstIndex / vertexOffset and can go without rebinding
+	class GeometryPool {
+
+		friend struct GeometryRange;
+
+		public:
+
+			struct Block {
+				// one buffer per vertex stream, all indexed by the same vertex number
+				std::vector<vkx::CreateBufferResult> streams;
+				// 16 and 32 bit indices share the buffer
+				vkx::CreateBufferResult indices;
+
+				// in vertices
+				RangeAllocator vertexRanges;
+				// in bytes
+				RangeAllocator indexRanges;
+			};
+
+		private:
+
+			const vkx::Context *context{ nullptr };
+
+			// vertex size of each stream
+			std::vector<uint32_t> strides;
+
+			std::vector<std::unique_ptr<Block>> blocks;
+
+			// live ranges, updated in place by defragment()
+			std::set<GeometryRange*> ranges;
+
+			// meshes can be created from other threads
+			std::mutex mutex;
+
+			// storage buffer offset alignment, index ranges are bound as storage buffers by the meshlet cull pass
+			vk::DeviceSize indexAlignment{ 4 };
+
+			Block *createBlock(uint32_t vertexCount, vk::DeviceSize indexSize);
+
+			void release(GeometryRange *range);
+
+		public:
+
+			GeometryPool(const vkx::Context *context, const std::vector<uint32_t> &strides);
+
+			~GeometryPool();
+
+			const std::vector<uint32_t> &getStrides() const { return strides; }
+
+			uint32_t streamCount() const { return (uint32_t)strides.size(); }
+
+			// space for vertexCount vertices in every stream and indexCount indices
+			std::shared_ptr<GeometryRange> allocate(uint32_t vertexCount, uint32_t indexCount, vk::IndexType indexType);
+
+			// fill gets the staging memory for the vertices (every stream's part, one after another) and for the indices
+			void upload(const GeometryRange &range, const std::function<void(void *vertices, void *indices)> &fill);
+
+			vk::Buffer vertexBuffer(uint32_t block, uint32_t stream) const { return blocks[block]->streams[stream].buffer; }
+
+			vk::Buffer indexBuffer(uint32_t block) const { return blocks[block]->indices.buffer; }
+
+			// the range's indices, for binding as a storage buffer
+			vk::DescriptorBufferInfo indexDescriptor(const GeometryRange &range) const;
+
+			// move every live range to the front of its block so freed space can be reused by larger meshes
+			// waits for the device to be idle, command buffers recorded before this have to be recorded again
+			void defragment();
+
+			// hands over the buffers of blocks nothing is allocated in anymore (the first block is kept)
+			// the caller destroys them once the gpu is done with them, the slots are reused by new blocks
+			std::vector<vkx::CreateBufferResult> releaseEmptyBlocks();
+
+			// bytes allocated / reserved in device memory
+			vk::DeviceSize usedSize() const;
+			vk::DeviceSize capacity() const;
+
+			void destroy();
+	};
+
+
+
+	// one pool per set of stream strides
+	class GeometryPoolList {
+
+		private:
+
+			std::map<std::vector<uint32_t>, std::shared_ptr<GeometryPool>> pools;
+
+			std::mutex mutex;
+
+		public:
+
+			std::shared_ptr<GeometryPool> get(const vkx::Context *context, const std::vector<uint32_t> &strides);
+
+			void defragment();
+
+			std::vector<vkx::CreateBufferResult> releaseEmptyBlocks();
+
+			void destroy();
+	};
+
+}
@@ -75,8 +75,10 @@ class ImGUI {
 		indexBuffer.destroy();
 		context->device.destroyImage(fontImage, nullptr);
 		context->device.destroyImageView(fontView, nullptr);
-		context->device.freeMemory(fontMemory, nullptr);
+		vkx::memory::freeMemory(context->device, fontMemory);
 		context->device.destroySampler(sampler, nullptr);
+		// keep what was compiled here in the cache that's saved at shutdown
+		context->device.mergePipelineCaches(context->pipelineCache, pipelineCache);
 		context->device.destroyPipelineCache(pipelineCache, nullptr);
 		context->device.destroyPipeline(pipeline, nullptr);
 		context->device.destroyPipelineLayout(pipelineLayout, nullptr);
@@ -131,7 +133,7 @@ class ImGUI {
 		memAllocInfo.allocationSize = memReqs.size;
 		memAllocInfo.memoryTypeIndex = context->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-		fontMemory = context->device.allocateMemory(memAllocInfo, nullptr);
+		fontMemory = vkx::memory::allocateMemory(context->device, memAllocInfo, vkx::MEMORY_CATEGORY_UI);
 		context->device.bindImageMemory(fontImage, fontMemory, 0);
 
 		// Image view
@@ -407,6 +409,7 @@ class ImGUI {
 		vk::DeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
 		// Update buffers only if vertex or index count has been changed compared to current buffer size
+		vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_UI, "imgui");
 
 		// Vertex buffer		
 		if (((VkBuffer)vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
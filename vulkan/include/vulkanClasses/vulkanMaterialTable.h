@@ -0,0 +1,102 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanContext.h"
+#include "vulkanAssetManager.h"
+
+
+
+// size of the material texture array, must match MATERIAL_TABLE_TEXTURES in the mrt*.frag shaders
+#define MATERIAL_TABLE_TEXTURES 256
+
+// samplers used by the other sets of the pipelines the table is bound to (the deferred set)
+#define MATERIAL_TABLE_RESERVED_SAMPLERS 16
+
+// initial number of material records, the buffer grows as needed
+#define MATERIAL_TABLE_INITIAL_RECORDS 256
+
+
+
+namespace vkx {
+
+
+	// one material as seen by the g-buffer shaders
+	// std430 layout, must match MaterialRecord in the mrt*.frag shaders
+	struct MaterialRecord {
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+		float opacity;
+		// slots in the texture array
+		uint32_t diffuseTexture;
+		uint32_t specularTexture;
+		uint32_t bumpTexture;
+	};
+
+	// pushed per draw for the fragment stage, after the vertex push constants
+	struct MaterialPushConstants {
+		uint32_t materialIndex;
+	};
+
+
+	// every material texture in one sampler array plus a storage buffer of material records
+	// so a whole pass binds a single material descriptor set and draws only push their material index
+	// needs shaderSampledImageArrayDynamicIndexing (the index is uniform per draw), otherwise
+	// enabled stays false and the per material descriptor sets are used instead
+	class MaterialTable {
+
+		private:
+
+			const vkx::Context *context{ nullptr };
+
+			vk::DescriptorPool descriptorPool;
+
+			// material records, host visible and kept mapped
+			vkx::CreateBufferResult records;
+			uint32_t recordCapacity{ 0 };
+
+			// image view -> texture array slot
+			// (materials hold their own copies of the textures, the view is what they share)
+			std::map<vk::ImageView, uint32_t> textureSlots;
+
+			// materials.generation and materials.resources.size() at the last update
+			uint32_t materialGeneration{ 0 };
+			size_t materialCount{ 0 };
+
+			void createRecordBuffer(uint32_t capacity);
+
+			uint32_t textureSlot(const vk::DescriptorImageInfo &descriptor, std::vector<vk::DescriptorImageInfo> &newTextures);
+
+		public:
+
+			bool enabled{ false };
+
+			vk::DescriptorSetLayout setLayout;
+			vk::DescriptorSet descriptorSet;
+
+			// checks the device limits / features, leaves enabled false if the table can't be used
+			void prepare(const vkx::Context *context);
+
+			// writes the records again when the material list changed since the last call (materials added, removed or
+			// edited, see MaterialList::generation) and the descriptors of new textures
+			// returns true if anything changed (material indices shift when materials are added, so draws have to be recorded again)
+			// waits for the device to be idle before touching descriptors that could be in use
+			bool update(const vkx::MaterialList &materials);
+
+			// the texture with view old was recreated (texture streaming), its slot gets the new descriptor
+			// nothing may be using the table (wait for the device first)
+			void replaceTexture(vk::ImageView old, const vk::DescriptorImageInfo &descriptor);
+
+			uint32_t textureCount() const { return (uint32_t)textureSlots.size(); }
+
+			void destroy();
+	};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+
+
+
+namespace vkx {
+
+
+	// what a device memory allocation is used for
+	typedef enum MemoryCategory {
+		MEMORY_CATEGORY_OTHER = 0,
+		MEMORY_CATEGORY_MESH_VERTEX,
+		MEMORY_CATEGORY_MESH_INDEX,
+		MEMORY_CATEGORY_TEXTURE,
+		MEMORY_CATEGORY_GBUFFER,
+		MEMORY_CATEGORY_SHADOW_MAP,
+		MEMORY_CATEGORY_UNIFORM,
+		MEMORY_CATEGORY_STAGING,
+		MEMORY_CATEGORY_UI,
+		MEMORY_CATEGORY_COUNT,
+	} MemoryCategory;
+
+	const char *memoryCategoryName(MemoryCategory category);
+
+
+
+	struct MemoryUsage {
+		vk::DeviceSize liveBytes{ 0 };
+		vk::DeviceSize peakBytes{ 0 };
+		uint32_t allocations{ 0 };
+	};
+
+	// a snapshot of what's allocated (see Context::getMemoryStats)
+	struct MemoryStats {
+		MemoryUsage total;
+		std::array<MemoryUsage, MEMORY_CATEGORY_COUNT> categories;
+		std::array<MemoryUsage, VK_MAX_MEMORY_TYPES> memoryTypes;
+	};
+
+
+
+	// every vkAllocateMemory / vkFreeMemory of the engine goes through here
+	//
+	// the category and debug name of an allocation come from the innermost Scope on the calling thread,
+	// without one the caller's guess (from the buffer / image usage) is used and the name is the category's
+	namespace memory {
+
+		class Scope {
+			private:
+				MemoryCategory previousCategory;
+				const char *previousName;
+			public:
+				// name must outlive the scope
+				Scope(MemoryCategory category, const char *name = nullptr);
+				// only names the allocations (a file name), the category stays the enclosing scope's or the guess
+				explicit Scope(const char *name);
+				~Scope();
+		};
+
+		// the scope's category if there is one, otherwise the guess
+		MemoryCategory currentCategory(MemoryCategory guess);
+
+		// the scope's name if it has one, otherwise the category's
+		const char *currentName(MemoryCategory category);
+
+		// guesses from usage flags
+		MemoryCategory bufferCategory(vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryPropertyFlags);
+		MemoryCategory imageCategory(vk::ImageUsageFlags usage);
+
+		// allocates and records the memory, names it when debug markers are active
+		vk::DeviceMemory allocateMemory(vk::Device device, const vk::MemoryAllocateInfo &allocateInfo, MemoryCategory category);
+
+		// frees memory from allocateMemory()
+		void freeMemory(vk::Device device, vk::DeviceMemory memory);
+
+		MemoryStats stats();
+
+		// the stats and the live allocations as json, with the memory types' flags and heaps
+		std::string toJson(const vk::PhysicalDeviceMemoryProperties &memoryProperties);
+	}
+
+}
@@ -15,6 +15,8 @@
 #include <stdio.h>
 #include <vector>
 #include <map>
+#include <array>
+#include <memory>
 #include <algorithm>
 
 
@@ -41,8 +43,11 @@
 
 #include "vulkanTools.h"
 #include "vulkanContext.h"
+#include "vulkanAnimation.h"
 #include "vulkanTextureLoader.h"
 #include "vulkanAssetManager.h"
+#include "vulkanMeshlet.h"
+#include "vulkanGeometryPool.h"
 #include "Object3D.h"
 
 
@@ -90,8 +95,25 @@ namespace vkx {
 		VERTEX_COMPONENT_DUMMY_VEC4 = 0x7,
 		//VERTEX_COMPONENT_BONE_ID = 0x8,// added 1/20/17
 		//VERTEX_COMPONENT_BONE_WEIGHT = 0x9,// added 1/20/17
+		// quantized components (see vulkanVertexFormat.h)
+		VERTEX_COMPONENT_POSITION_SNORM16 = 0xA,// 16 bit normalized, relative to the mesh bounds
+		VERTEX_COMPONENT_NORMAL_OCT = 0xB,// octahedral, 16 bit normalized
+		VERTEX_COMPONENT_TANGENT_OCT = 0xC,// octahedral, 16 bit normalized
+		VERTEX_COMPONENT_UV_HALF = 0xD,
+		VERTEX_COMPONENT_COLOR_UNORM8 = 0xE,
 	} VertexComponent;
 
+	// what a mesh loader keeps on the cpu once its meshes are uploaded (flags, see MeshLoader::retention)
+	typedef enum MeshRetention {
+		MESH_RETAIN_NONE = 0x0,
+		// positions and indices of each entry (physics shapes), the scene stays cached for further spawns
+		MESH_RETAIN_POSITIONS = 0x1,
+		// the full vertices and indices of each entry (static batches)
+		MESH_RETAIN_VERTICES = 0x2,
+		// the aiScene, shared through the asset manager (skinned meshes animate from it)
+		MESH_RETAIN_SCENE = 0x4,
+	} MeshRetention;
+
 	//std::vector<vkx::VertexComponent> defaultLayout =
 	//{
 	//	vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
@@ -108,9 +130,14 @@ namespace vkx {
 	struct MeshBuffer {
 
 		// vulkan buffers
+		// only used by mesh buffers that aren't in a geometry pool
 		vkx::CreateBufferResult vertices;
 		vkx::CreateBufferResult indices;
 
+		// sub-allocation in a shared geometry pool (see vulkanGeometryPool.h)
+		std::shared_ptr<GeometryPool> pool;
+		std::shared_ptr<GeometryRange> geometry;
+
 		uint32_t vertexBufferBinding = 0;// 5/4/17
 
 		std::vector<VertexComponent> vertexLayout;// 4/26/17
@@ -118,24 +145,82 @@ namespace vkx {
 		// dimensions of the mesh?
 		glm::vec3 dim;
 
+		// dequantization for VERTEX_COMPONENT_POSITION_SNORM16: position = center + extent * stored
+		glm::vec4 positionCenter{ 0.0f };
+		glm::vec4 positionExtent{ 1.0f };
+		// byte offset of the attribute stream for layouts with a position stream, 0 if interleaved
+		vk::DeviceSize attributeOffset{ 0 };
+
 		uint32_t indexCount{ 0 };
+		// eUint16 when every index fits (see stageIndexBuffer)
+		vk::IndexType indexType{ vk::IndexType::eUint32 };
 		uint32_t materialIndex{ 0 };
 
 		std::string materialName;
 
+		// meshlets for gpu culling (see vulkanMeshlet.h)
+		std::vector<Meshlet> meshlets;
+		// device copy of meshlets, only created when there's more than one
+		vkx::CreateBufferResult meshletData;
+
+		// the geometry's bytes in the mesh cache, an evicted mesh is uploaded again from it (see MeshResidency)
+		std::string cookedFile;
+
+		// drawIndexed parameters
+		uint32_t firstIndex() const {
+			return geometry ? geometry->firstIndex : 0;
+		}
+
+		int32_t vertexOffset() const {
+			return geometry ? (int32_t)geometry->vertexOffset : 0;
+		}
+
+		// the index buffer (range) as a storage buffer
+		vk::DescriptorBufferInfo indexDescriptor() const {
+			return geometry ? pool->indexDescriptor(*geometry) : indices.descriptor;
+		}
+
 		void destroy() {
 			vertices.destroy();
 			indices.destroy();
+			meshletData.destroy();
+			geometry.reset();
 		}
 
 		~MeshBuffer() {
 			vertices.destroy();
 			indices.destroy();
+			meshletData.destroy();
 		}
 	};
 
 
 
+	// vertex / index buffers bound in a command buffer
+	// draws of meshes from the same geometry pool block skip rebinding
+	struct MeshBufferBinding {
+
+		std::array<vk::Buffer, 2> vertexBuffers;
+		std::array<vk::DeviceSize, 2> vertexOffsets{ { 0, 0 } };
+		uint32_t firstBinding{ 0 };
+		uint32_t streamCount{ 0 };
+
+		vk::Buffer indexBuffer;
+		vk::IndexType indexType{ vk::IndexType::eUint32 };
+
+		// vertex + index buffer binds actually recorded
+		uint32_t bindCount{ 0 };
+
+		// binds the first streamCount vertex streams of the mesh buffer (the position stream only for depth passes)
+		void bindVertices(const vk::CommandBuffer &cmdBuffer, const MeshBuffer &meshBuffer, uint32_t firstBinding, uint32_t streamCount);
+
+		void bindIndices(const vk::CommandBuffer &cmdBuffer, const MeshBuffer &meshBuffer);
+
+		void bindIndices(const vk::CommandBuffer &cmdBuffer, vk::Buffer buffer, vk::IndexType indexType);
+	};
+
+
+
 
 
 
@@ -179,6 +264,13 @@ namespace vkx {
 
 		std::vector<Vertex> Vertices;
 		std::vector<uint32_t> Indices;
+
+		// unscaled positions, only kept instead of Vertices with MESH_RETAIN_POSITIONS
+		std::vector<glm::vec3> Positions;
+
+		// unscaled bounds of Vertices
+		glm::vec3 boundsMin{ 0.0f };
+		glm::vec3 boundsMax{ 0.0f };
 	};
 
 
@@ -210,6 +302,15 @@ namespace vkx {
 				case VERTEX_COMPONENT_DUMMY_FLOAT:
 					vSize += 1 * sizeof(float);
 					break;
+				case VERTEX_COMPONENT_POSITION_SNORM16:
+					vSize += 4 * sizeof(int16_t);
+					break;
+				case VERTEX_COMPONENT_NORMAL_OCT:
+				case VERTEX_COMPONENT_TANGENT_OCT:
+				case VERTEX_COMPONENT_UV_HALF:
+				case VERTEX_COMPONENT_COLOR_UNORM8:
+					vSize += 4;
+					break;
 				default:
 					vSize += 3 * sizeof(float);
 					break;
@@ -228,6 +329,29 @@ namespace vkx {
 
 
 
+	// eUint16 when the largest index fits, eUint32 otherwise
+	vk::IndexType smallestIndexType(const std::vector<uint32_t> &indices);
+
+	// write indices as indexType, 16 bit indices are padded to a whole number of 32 bit words
+	void writeIndices(const std::vector<uint32_t> &indices, vk::IndexType indexType, void *dst);
+
+	// upload indices to meshBuffer.indices (and set indexCount / indexType)
+	// stored as 16 bit when the largest index fits, 32 bit otherwise
+	void stageIndexBuffer(const vkx::Context *context, const vk::BufferUsageFlags &usage, const std::vector<uint32_t> &indices, MeshBuffer &meshBuffer);
+
+	// mesh buffer in the geometry pool for layout, split into meshlets for gpu culling
+	// bounds are those of the unscaled vertices, scale is applied while converting them
+	// cook writes the uploaded bytes to the mesh cache when the asset manager has a MeshResidency
+	// name (the model file) names its device memory in the memory stats
+	std::shared_ptr<MeshBuffer> createPooledMeshBuffer(vkx::AssetManager *assetManager, const vkx::Context *context, const std::vector<VertexComponent> &layout,
+		const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float scale, bool cook = false, const char *name = nullptr);
+
+
+
+
+
+
+
 	// Simple mesh class for getting all the necessary stuff from models loaded via ASSIMP
 	class MeshLoader {
 		private:
@@ -241,14 +365,18 @@ namespace vkx {
 			#endif
 
 			// raw data
+			// released as far as retention allows once the mesh buffers are created
 			std::vector<MeshEntry> m_Entries;
 
+			// MeshRetention flags, set before load
+			uint32_t retention{ MESH_RETAIN_NONE };
+
 
 
 			struct {
 				// Bone related stuff
 				// Maps bone name with index
-				std::map<std::string, uint32_t> boneMapping;
+				BoneMapping boneMapping;
 				// Bone details
 				std::vector<BoneInfo> boneInfo;
 
@@ -261,7 +389,9 @@ namespace vkx {
 				// Bone transformations
 				std::vector<aiMatrix4x4> boneTransforms;
 				// Currently active animation
-				aiAnimation *pAnimation;
+				aiAnimation *pAnimation = nullptr;
+				// the hierarchy and pAnimation's channels bound to it (see setAnimation)
+				AnimationRuntime runtime;
 
 				// when the last update was
 				std::chrono::steady_clock::time_point tLastUpdate = std::chrono::high_resolution_clock::now();
@@ -346,6 +476,10 @@ namespace vkx {
 			// for groups of meshes (models) with multiple buffers and materials
 			void createMeshBuffers(const std::vector<VertexComponent> &layout, float scale);
 
+			// drops the cpu data retention doesn't keep, called by the create functions after the upload
+			// can be called again with fewer flags once the data isn't needed anymore (a static batch was built)
+			void release(uint32_t retention);
+
 			void destroy();
 
 			/* Skinned Meshes */
@@ -355,11 +489,6 @@ namespace vkx {
 			void setAnimation(uint32_t animationIndex);
 			void loadBones(uint32_t meshIndex, const aiMesh *pMesh, std::vector<VertexBoneData>& Bones);
 			void update(float time);
-			const aiNodeAnim* findNodeAnim(const aiAnimation *animation, const std::string nodeName);
-			aiMatrix4x4 interpolateTranslation(float time, const aiNodeAnim *pNodeAnim);
-			aiMatrix4x4 interpolateRotation(float time, const aiNodeAnim *pNodeAnim);
-			aiMatrix4x4 interpolateScale(float time, const aiNodeAnim *pNodeAnim);
-			void readNodeHierarchy(float AnimationTime, const aiNode *pNode, const aiMatrix4x4 &ParentTransform);
 	};
 
 }
\ No newline at end of file
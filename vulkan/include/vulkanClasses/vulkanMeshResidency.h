@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkanContext.h"
+#include "vulkanAssetManager.h"
+#include "vulkanMeshLoader.h"
+
+
+
+// without a budget the cached meshes may use this part of the device local heaps
+#define MESH_RESIDENCY_HEAP_FRACTION 0.25
+
+// bump to invalidate the cooked meshes
+#define MESH_COOK_VERSION 1
+
+
+
+namespace vkx {
+
+
+	// keeps the asset manager's mesh buffers in device memory as long as they fit a budget
+	//
+	// every mesh is cooked when it's uploaded (its vertex / index bytes as they went to the geometry pool, one file
+	// named by a hash of the bytes), once per frame update() marks the files whose meshes a model still holds as used
+	// and when the resident meshes don't fit the budget the ones no model holds are evicted, least recently used first
+	// their geometry goes through the context's dumpster so it's only freed once the frame in flight is done with it
+	// a loader that finds an evicted file in the asset manager calls use(), which uploads it again from the cooked file
+	// into the same MeshBuffer objects, so whoever kept them doesn't notice
+	class MeshResidency {
+
+		private:
+
+			// the meshes of one model file (AssetManager::meshBuffers)
+			struct Entry {
+				std::vector<std::shared_ptr<MeshBuffer>> meshBuffers;
+				uint64_t lastUsed{ 0 };
+				bool resident{ true };
+			};
+
+			vkx::Context *context{ nullptr };
+			vkx::AssetManager *assetManager{ nullptr };
+
+			std::map<std::string, Entry> entries;
+
+			// meshes can be created from other threads
+			std::mutex mutex;
+
+			uint64_t frame{ 0 };
+
+			// held by more than the asset manager and the entry
+			static bool referenced(const Entry &entry);
+
+			// pooled and cooked (meshes that aren't stay resident)
+			static bool evictable(const Entry &entry);
+
+			// device memory of a resident mesh
+			static vk::DeviceSize meshSize(const MeshBuffer &meshBuffer);
+
+			vk::DeviceSize currentLimit() const;
+
+			void evict(Entry &entry);
+
+			void restore(const std::string &fileName, Entry &entry);
+
+		public:
+
+			// bytes the cached meshes may use, 0 takes a part of the device local heap budget
+			vk::DeviceSize budget{ 0 };
+
+			// stats
+			vk::DeviceSize residentBytes{ 0 };
+			vk::DeviceSize limitBytes{ 0 };
+			uint32_t evictedFiles{ 0 };
+			uint32_t evictions{ 0 };
+			uint32_t restores{ 0 };
+
+			void prepare(vkx::Context *context, vkx::AssetManager *assetManager);
+
+			// called with the bytes a mesh buffer's geometry range was filled with, sets its cookedFile
+			void cook(MeshBuffer &meshBuffer, uint32_t vertexCount, const std::vector<uint8_t> &vertices, const std::vector<uint8_t> &indices);
+
+			// the meshes of a file were added to the asset manager
+			void add(const std::string &fileName, const std::vector<std::shared_ptr<MeshBuffer>> &meshBuffers);
+
+			// a loader takes the file's meshes from the asset manager, uploads them again if they were evicted
+			void use(const std::string &fileName);
+
+			uint32_t fileCount() const { return (uint32_t)entries.size(); }
+
+			// once per frame, evicts what doesn't fit
+			void update();
+
+			void destroy();
+	};
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanContext.h"
+
+
+
+// meshlet limits
+// same as the usual mesh shader limits so the data stays usable if we ever move to mesh shaders
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// workgroup size of meshletCull.comp
+#define MESHLET_CULL_GROUP_SIZE 64
+
+// number of cull targets per descriptor pool
+#define MESHLET_TARGETS_PER_POOL 256
+
+
+
+namespace vkx {
+
+	struct MeshBuffer;// defined in vulkanMeshLoader.h
+
+
+	// a cluster of triangles that is culled as a whole
+	// std430 layout, must match meshletCull.comp
+	struct Meshlet {
+		// xyz: bounding sphere center (mesh space), w: radius
+		glm::vec4 sphere;
+		// xyz: normal cone axis, w: cone cutoff (>= 1.0 means the cone can't be culled)
+		glm::vec4 cone;
+		// triangles are kept in order so a meshlet is a range of the mesh's index buffer
+		uint32_t firstIndex{ 0 };
+		uint32_t indexCount{ 0 };
+		uint32_t vertexCount{ 0 };
+		uint32_t padding{ 0 };
+	};
+
+	// split a triangle list into meshlets of at most MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES
+	// positions and normals are read with vertexStride so they can point straight into an interleaved vertex
+	std::vector<Meshlet> buildMeshlets(
+		const glm::vec3 *positions,
+		const glm::vec3 *normals,
+		size_t vertexCount,
+		size_t vertexStride,
+		const uint32_t *indices,
+		size_t indexCount,
+		float positionScale = 1.0f);
+
+
+
+	// output of the cull pass for one instance of a mesh buffer
+	// (mesh buffers are shared between models, so this can't live on the MeshBuffer)
+	struct MeshletDrawTarget {
+		// compacted index list written by the cull pass
+		vkx::CreateBufferResult indices;
+		// a single vk::DrawIndexedIndirectCommand
+		vkx::CreateBufferResult drawCommand;
+
+		vk::DescriptorSet descriptorSet;
+
+		// the mesh buffer this target was created for
+		const MeshBuffer *meshBuffer{ nullptr };
+		uint32_t indexCount{ 0 };
+		// where the source indices were when the descriptor set was written (geometry pools can move them)
+		vk::DescriptorBufferInfo sourceIndices;
+		// the meshlet buffer the descriptor set points at (a restored mesh buffer gets a new one)
+		vk::Buffer meshletData;
+		// the last record() this target was add()ed for
+		uint32_t lastRecord{ 0 };
+
+		void destroy() {
+			indices.destroy();
+			drawCommand.destroy();
+		}
+	};
+
+
+
+	// culls meshlets against the view frustum and their normal cones in a compute pass
+	// and writes a compacted index list + indirect draw per mesh buffer
+	// works on plain vulkan 1.0 (no mesh shaders, no multiDrawIndirect, no drawIndirectCount)
+	class MeshletCuller {
+
+		private:
+
+			const vkx::Context *context{ nullptr };
+
+			// cull data uniform, must match meshletCull.comp
+			struct CullData {
+				glm::vec4 frustumPlanes[6];
+				glm::vec4 cameraPos;
+			} uboCull;
+
+			vkx::CreateBufferResult cullData;
+
+			vk::DescriptorSetLayout sceneSetLayout;
+			vk::DescriptorSetLayout targetSetLayout;
+			vk::PipelineLayout pipelineLayout;
+			vk::Pipeline pipeline;
+
+			std::vector<vk::DescriptorPool> descriptorPools;
+			uint32_t setsInLastPool{ 0 };
+			// sets of pruned targets (the pools can't free single sets)
+			std::vector<vk::DescriptorSet> freeSets;
+
+			vk::DescriptorSet sceneSet;
+
+			// (owner, mesh buffer) -> cull output
+			// targets that weren't add()ed for a record() are pruned by it (removed models, reused owner addresses)
+			std::map<std::pair<const void*, const MeshBuffer*>, MeshletDrawTarget> targets;
+
+			// incremented by every record()
+			uint32_t recordIndex{ 0 };
+
+			// push constants, must match meshletCull.comp
+			struct CullPushConstants {
+				uint32_t meshletCount;
+				// source indices are 16 bit, packed two per uint
+				uint32_t shortIndices;
+				// matrix node of the mesh's owner
+				uint32_t objectIndex;
+			};
+
+			struct PendingCull {
+				MeshletDrawTarget *target;
+				CullPushConstants pushConstants;
+			};
+
+			// culls queued for the next record()
+			std::vector<PendingCull> pending;
+
+			vk::DescriptorSet allocateTargetSet();
+
+			MeshletDrawTarget *getOrCreateTarget(const void *owner, const std::shared_ptr<MeshBuffer> &meshBuffer);
+
+			// destroys the targets the current record() doesn't use
+			void prune();
+
+		public:
+
+			// false if the cull shader isn't available, everything falls back to regular draws
+			bool enabled{ false };
+
+			// number of meshlets tested by the last recorded pass
+			uint32_t meshletCount{ 0 };
+
+			// matrixDescriptor: storage buffer holding the per object matrix nodes (same one the g-buffer pass uses)
+			void prepare(const vkx::Context *context, const std::string &shaderPath, const vk::DescriptorBufferInfo &matrixDescriptor);
+
+			// update the frustum planes and camera position, once per frame
+			void updateFrustum(const glm::mat4 &projection, const glm::mat4 &view);
+
+			// queue a mesh buffer (as drawn by owner) for culling
+			// returns false if the mesh buffer isn't worth culling (single meshlet)
+			// objectIndex: the owner's matrix node
+			bool add(const void *owner, const std::shared_ptr<MeshBuffer> &meshBuffer, uint32_t objectIndex);
+
+			// records the queued cull dispatches, must be called outside of a render pass
+			// targets not queued since the last record() are destroyed, so only while the previous frame's fence was waited on
+			void record(const vk::CommandBuffer &cmdBuffer);
+
+			// the cull output for owner / mesh buffer, or nullptr if it wasn't culled
+			const MeshletDrawTarget *get(const void *owner, const MeshBuffer *meshBuffer) const;
+
+			void destroy();
+	};
+
+}
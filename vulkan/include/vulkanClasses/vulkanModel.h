@@ -45,6 +45,12 @@ namespace vkx {
 			uint32_t matrixIndex = -1;
 			uint32_t vertexBufferBinding = 0;
 
+			// scale the meshes were created with
+			float scale = 1.0f;
+
+			// never moves, can be merged into a static batch (see vulkanStaticBatch.h)
+			bool staticGeometry = false;
+
 
 			// pointer to meshLoader
 			vkx::MeshLoader *meshLoader = nullptr;
@@ -62,7 +68,9 @@ namespace vkx {
 			Model();
 			Model(vkx::Context *context, vkx::AssetManager *assetManager);
 
-			//~Model();
+			// frees the mesh loader (and its references to the shared mesh buffers), the buffers themselves stay
+			// with the asset manager
+			~Model();
 
 
 
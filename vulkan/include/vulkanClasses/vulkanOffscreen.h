@@ -215,8 +215,8 @@ namespace vkx {
 			samplerInfo.maxLod = 1.0f;
 			samplerInfo.borderColor = vk::BorderColor::eFloatOpaqueWhite;
 			//return vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler);
-			vk::Sampler sampler = context.device.createSampler(samplerInfo, nullptr);
-			return sampler;
+			// the attachments don't destroy their sampler, the context's cache does
+			return context.getSampler(samplerInfo);
 		}
 
 
@@ -231,6 +231,8 @@ namespace vkx {
 
 		void addDeferredFramebuffer2() {
 
+			vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_GBUFFER, "g-buffer");
+
 			vkx::Framebuffer deferredFramebuffer;
 			deferredFramebuffer.device = context.device;
 			deferredFramebuffer.context = &context;
@@ -375,6 +377,8 @@ namespace vkx {
 		// add SSAO frame buffer
 		void addSSAOGenerateFramebuffer() {
 
+			vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_GBUFFER, "ssao");
+
 			vkx::Framebuffer SSAOGenerateFramebuffer;
 			SSAOGenerateFramebuffer.device = context.device;
 			SSAOGenerateFramebuffer.context = &context;
@@ -390,6 +394,8 @@ namespace vkx {
 
 		void addSSAOBlurFramebuffer() {
 
+			vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_GBUFFER, "ssao blur");
+
 			vkx::Framebuffer SSAOBlurFramebuffer;
 			SSAOBlurFramebuffer.device = context.device;
 			SSAOBlurFramebuffer.context = &context;
@@ -408,6 +414,8 @@ namespace vkx {
 
 
 		void addShadowPassFramebuffer() {
+
+			vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_SHADOW_MAP, "shadow map");
 			//int SHADOW_MAP_DIM = 2048;
 
 			vkx::Framebuffer shadowFramebuffer;
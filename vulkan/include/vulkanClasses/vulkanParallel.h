@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+
+
+namespace vkx {
+
+	// number of threads parallelFor runs on (including the calling thread)
+	uint32_t workerCount();
+
+	// calls func(begin, end) for chunks of [0, count) of at most grainSize items
+	// threads keep claiming the next chunk from a shared counter until there are none left,
+	// so a few expensive chunks don't leave the other threads idle
+	// the calling thread takes part, and small ranges run inline without starting any threads
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)> &func);
+
+}
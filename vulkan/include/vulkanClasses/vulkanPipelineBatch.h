@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkanContext.h"
+#include "vulkanAssetManager.h"
+
+
+
+namespace vkx {
+
+
+	// graphics pipeline descriptions, created all at once on worker threads (build / prewarm)
+	// or only when something first asks for them (get / getAsync)
+	// add() copies everything the create info points to, so the caller can keep editing the
+	// same state structs between pipelines like it does when creating them one by one
+	// created pipelines go into the PipelineList, which owns them
+	class PipelineBatch {
+
+		private:
+
+			struct Specialization {
+				vk::SpecializationInfo info;
+				std::vector<vk::SpecializationMapEntry> mapEntries;
+				std::vector<uint8_t> data;
+			};
+
+			struct Entry {
+				std::string name;
+				vk::GraphicsPipelineCreateInfo createInfo;
+
+				std::vector<vk::PipelineShaderStageCreateInfo> stages;
+				std::vector<Specialization> specializations;
+
+				vk::PipelineVertexInputStateCreateInfo vertexInputState;
+				std::vector<vk::VertexInputBindingDescription> vertexBindings;
+				std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+
+				vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState;
+				vk::PipelineTessellationStateCreateInfo tessellationState;
+
+				vk::PipelineViewportStateCreateInfo viewportState;
+				std::vector<vk::Viewport> viewports;
+				std::vector<vk::Rect2D> scissors;
+
+				vk::PipelineRasterizationStateCreateInfo rasterizationState;
+
+				vk::PipelineMultisampleStateCreateInfo multisampleState;
+				std::vector<vk::SampleMask> sampleMask;
+
+				vk::PipelineDepthStencilStateCreateInfo depthStencilState;
+
+				vk::PipelineColorBlendStateCreateInfo colorBlendState;
+				std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments;
+
+				vk::PipelineDynamicStateCreateInfo dynamicState;
+				std::vector<vk::DynamicState> dynamicStates;
+
+				vk::Pipeline pipeline;
+
+				enum State { described, building, created };
+				State state{ described };
+
+				// getAsync's thread
+				std::thread worker;
+				std::atomic<bool> finished{ false };
+				std::exception_ptr error;
+			};
+
+			const vkx::Context *context{ nullptr };
+			vkx::PipelineList *pipelines{ nullptr };
+
+			// entries don't move once added, the create infos point into them
+			std::vector<std::unique_ptr<Entry>> entries;
+			std::map<std::string, Entry*> entryNames;
+
+			Entry *find(const std::string &name);
+
+			// creates the entries on threadCount threads, rethrows the first error
+			void create(const std::vector<Entry*> &list, uint32_t threadCount);
+
+			// joins a getAsync thread and hands its pipeline to the list
+			void finish(Entry &entry);
+
+		public:
+
+			~PipelineBatch();
+
+			// pipelines are created through context's pipeline cache and added to pipelines under their names
+			void prepare(const vkx::Context *context, vkx::PipelineList *pipelines);
+
+			// describes a pipeline, nothing is created yet
+			void add(const std::string &name, const vk::GraphicsPipelineCreateInfo &createInfo);
+
+			// creates every pipeline that isn't created yet
+			// threadCount: 0 for one thread per core
+			void build(uint32_t threadCount = 0);
+
+			// creates the named pipelines (what the first frame draws), in parallel
+			void prewarm(const std::vector<std::string> &names, uint32_t threadCount = 0);
+
+			// the pipeline, created here on first use
+			vk::Pipeline get(const std::string &name);
+
+			// the pipeline if it's ready, otherwise starts creating it on a thread and returns fallback (can be null)
+			vk::Pipeline getAsync(const std::string &name, vk::Pipeline fallback);
+
+			// picks up pipelines getAsync finished, true if there were any (command buffers using a fallback need re-recording)
+			bool update();
+
+			// waits for getAsync threads, call before the pipeline list is destroyed
+			void destroy();
+
+			// created / described
+			uint32_t createdCount() const;
+			size_t size() const { return entries.size(); }
+	};
+
+}
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <string>
+#include <utility>
 #include <vector>
 #include <algorithm>
 #include <vulkan/vulkan.hpp>
@@ -14,11 +16,20 @@
 namespace vkx {
     namespace shader {
         using SpvBuffer = std::vector<uint32_t>;
+        // name / value pairs, added as #defines after the #version line
+        using Defines = std::vector<std::pair<std::string, std::string>>;
+
         void initGlsl();
         void finalizeGlsl();
         void initDebugReport(const vk::Instance& instance);
 
         SpvBuffer glslToSpv(vk::ShaderStageFlagBits shaderType, const std::string& shaderSource);
+        // name is only used in error messages
+        SpvBuffer glslToSpv(vk::ShaderStageFlagBits shaderType, const std::string& shaderSource, const Defines& defines, const std::string& name);
         vk::ShaderModule glslToShaderModule(const vk::Device& device, const vk::ShaderStageFlagBits shaderType, const std::string& shaderSource);
+
+        // compiles a glsl file, or reuses the spir-v from an earlier compile of the same source and defines
+        // the spir-v is kept in cacheDirectory (empty for the working directory) as spirv_<hash>.spv
+        SpvBuffer compileCached(vk::ShaderStageFlagBits shaderType, const std::string& fileName, const Defines& defines, const std::string& cacheDirectory);
     }
 }
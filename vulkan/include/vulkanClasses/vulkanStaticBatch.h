@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "vulkanContext.h"
+#include "vulkanAssetManager.h"
+#include "vulkanMeshLoader.h"
+#include "vulkanModel.h"
+
+
+
+// vertices per chunk, keeps the chunks within 16 bit indices
+// (a single mesh larger than this gets a chunk of its own)
+#define STATIC_BATCH_CHUNK_VERTICES 65536
+
+
+
+namespace vkx {
+
+
+	// the model's meshes are loaded and its mesh loader still has the source vertices
+	bool canBatch(const Model &model);
+
+	// merges the meshes of static models into world space mesh buffers, split into chunks per material
+	// meshes go into the chunks in morton order of their centers so every chunk stays spatially compact,
+	// each chunk gets its own bounds (position quantization) and meshlets so it's still culled on the gpu
+	// returns a model with an identity transform holding the chunks, the source models aren't changed
+	std::shared_ptr<Model> buildStaticBatch(vkx::Context *context, vkx::AssetManager *assetManager, const std::vector<std::shared_ptr<Model>> &models);
+
+}
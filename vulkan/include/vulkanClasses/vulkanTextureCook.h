@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#pragma warning(disable: 4996 4244 4267)
+#include <gli/gli.hpp>
+
+
+
+// bump when the encoder changes, so cooked textures from an older build are redone
+#define TEXTURE_COOK_VERSION 1
+
+// block rows per parallelFor chunk when compressing
+#define TEXTURE_COOK_GRAIN_ROWS 4
+
+
+
+namespace vkx {
+	namespace texture {
+
+
+		// how a texture is sampled, picks the block format when cooking
+		enum class Usage {
+			// diffuse: BC1, BC3 if any texel isn't opaque
+			eColor,
+			// specular / masks: same as color
+			eSpecular,
+			// tangent space normals: BC5 (x, y), the shaders rebuild z
+			eNormal
+		};
+
+
+		// decoded image, 8 bit rgba
+		struct Image {
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			std::vector<uint8_t> rgba;
+		};
+
+
+		// the Vulkan format of a loaded texture (gli's format enum follows VkFormat)
+		// eUndefined when the header has none
+		vk::Format format(const gli::texture &texture);
+
+		// png / tga, the sources the cook stage encodes
+		bool isCookable(const std::string &fileName);
+
+		// decodes an 8 / 16 bit png (not interlaced) or an uncompressed / rle tga
+		// throws on anything else
+		Image decode(const std::string &fileName);
+
+		// compresses the image with a full box filtered mip chain, block rows are encoded on all worker threads
+		gli::texture2d encode(const Image &image, Usage usage);
+
+		// generateMips() handles the format: uncompressed (not depth) or BC1 to BC5
+		bool canGenerateMips(vk::Format format);
+
+		// a copy of the texture with a full mip chain made on the cpu from its first level
+		// uncompressed formats are filtered by gli, block formats are decoded, box filtered and encoded again
+		// (BC2 and BC1 with alpha come back as BC3, the format of the result is what has to be uploaded)
+		gli::texture2d generateMips(const gli::texture2d &texture, Usage usage);
+
+		// the cooked ktx for a png / tga source, encoded on the first load and kept in cacheDirectory
+		// (empty for the working directory) as texture_<hash>.ktx, the hash covers the path, size, modification
+		// time and usage so an edited source is cooked again
+		std::string cook(const std::string &fileName, Usage usage, const std::string &cacheDirectory);
+
+		// loads a ktx / dds as is, png / tga sources through cook()
+		// a png / tga that doesn't exist falls back to a .ktx next to it (older assets were converted by hand)
+		gli::texture2d load2D(const std::string &fileName, Usage usage, const std::string &cacheDirectory);
+
+	}
+}
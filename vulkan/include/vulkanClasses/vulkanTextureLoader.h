@@ -8,11 +8,16 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <vulkan/vulkan.hpp>
 #pragma warning(disable: 4996 4244 4267)
 #include <gli/gli.hpp>
 #include "vulkanTools.h"
 #include "vulkanContext.h"
+#include "vulkanTextureCook.h"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -25,29 +30,32 @@ namespace vkx {
 		vk::Device device = nullptr;
 		vk::Image image = nullptr;
 		vk::DeviceMemory memory = nullptr;
+		// from Context::getSampler, shared with the other textures using the same settings (not destroyed with the texture)
 		vk::Sampler sampler = nullptr;
 
 		vk::ImageLayout imageLayout{ vk::ImageLayout::eShaderReadOnlyOptimal };
 		vk::ImageView view;
 		vk::Extent3D extent{ 0, 0, 1 };
+		vk::Format format{ vk::Format::eUndefined };
 		vk::DescriptorImageInfo descriptor;
 
 		uint32_t mipLevels{ 1 };
 		uint32_t layerCount{ 1 };
 
+		// the file's mip the image starts at, streamed textures leave out their largest levels (see TextureStreamer)
+		uint32_t firstLevel{ 0 };
+
 		Texture &operator=(const vkx::CreateImageResult &created) {
 			device = created.device;
 			image = created.image;
 			memory = created.memory;
 			extent = created.extent;
+			format = created.format;
 			return *this;
 		}
 
 		void destroy() {
-			if (sampler) {
-				device.destroySampler(sampler);
-				sampler = vk::Sampler();
-			}
+			sampler = vk::Sampler();
 			if (view) {
 				device.destroyImageView(view);
 				view = vk::ImageView();
@@ -57,12 +65,18 @@ namespace vkx {
 				image = vk::Image();
 			}
 			if (memory) {
-				device.freeMemory(memory);
+				vkx::memory::freeMemory(device, memory);
 				memory = vk::DeviceMemory();
 			}
 		}
 	};
 
+	// trilinear + 8x anisotropic, from the context's sampler cache
+	// every mip mapped texture gets the same sampler, the view limits the levels
+	vk::Sampler createSampler2D(const Context &context, uint32_t mipLevels);
+
+	vk::ImageView createView2D(const Context &context, vk::Image image, vk::Format format, uint32_t mipLevels);
+
 	class TextureLoader {
 		private:
 			//Context context;
@@ -75,7 +89,10 @@ namespace vkx {
 			//vk::Queue queue;
 			vk::CommandPool cmdPool;
 
-		
+			// uploads the texture's mips to a new image
+			// a single level texture gets its mips made first (see generateMissingMips)
+			Texture createTexture2D(const gli::texture2d& tex2D, vk::Format format, texture::Usage usage, bool forceLinear, vk::ImageUsageFlags imageUsageFlags);
+
 
 		public:
 
@@ -89,7 +106,19 @@ namespace vkx {
 			AAssetManager* assetManager = nullptr;
 			#endif
 
-			// Load a 2D texture
+			// files that come with one level get a full mip chain at upload, blitted on the gpu where the format
+			// can be filtered, made on the cpu for block compressed ones (linear tiled textures stay single level)
+			bool generateMissingMips{ true };
+
+			// the file as a gli texture, png / tga sources are cooked first (not on android, the apk has ktx only)
+			// only reads files, so it can run on worker threads
+			gli::texture2d loadFile2D(const std::string& filename, texture::Usage usage);
+
+			// Load a 2D texture in the format its ktx / dds header names
+			// png / tga sources are cooked to BC1 / BC3 (color with alpha) / BC5 (normals) with mips first
+			Texture loadTexture(const std::string& filename, texture::Usage usage = texture::Usage::eColor, bool forceLinear = false, vk::ImageUsageFlags imageUsageFlags = vk::ImageUsageFlagBits::eSampled);
+
+			// Load a 2D texture, format is only used if the file doesn't name one
 			Texture loadTexture(const std::string& filename, vk::Format format, bool forceLinear = false, vk::ImageUsageFlags imageUsageFlags = vk::ImageUsageFlagBits::eSampled);
 
 			// Load a cubemap texture (single file)
@@ -98,8 +127,73 @@ namespace vkx {
 			// Load an array texture (single file)
 			Texture loadTextureArray(const std::string& filename, vk::Format format);
 
-			void createTexture(void * buffer, vk::DeviceSize bufferSize, vk::Format format, uint32_t width, uint32_t height, vkx::Texture * texture, vk::Filter filter = vk::Filter::eLinear, vk::ImageUsageFlags imageUsageFlags = vk::ImageUsageFlagBits::eSampled);
+			void createTexture(void * buffer, vk::DeviceSize bufferSize, vk::Format format, uint32_t width, uint32_t height, vkx::Texture * texture, vk::Filter filter = vk::Filter::eLinear, vk::ImageUsageFlags imageUsageFlags = vk::ImageUsageFlagBits::eSampled, bool generateMips = false);
 			
 			//void createTexture(void * buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t width, uint32_t height, vkx::Texture * texture, VkFilter filter, VkImageUsageFlags imageUsageFlags);
 		};
+
+
+
+	// uploads many 2D textures with one staging buffer, one command buffer and one fence
+	// instead of a queue wait per texture
+	//
+	// add() every texture, then submit() decodes / cooks them on all worker threads, creates the images,
+	// views and samplers and records every copy and layout change into one submit
+	// the handles can be used (descriptor writes etc.) right after submit(), the contents once ready() / wait()
+	// (later submits to the same queue see the uploads through the final barrier)
+	class TextureBatch {
+		private:
+
+			struct Request {
+				std::string filename;
+				texture::Usage usage;
+				std::shared_ptr<Texture> texture;
+				gli::texture2d data;
+				vk::Format format{ vk::Format::eUndefined };
+				vk::DeviceSize offset{ 0 };
+				// levels before this one aren't uploaded (maxSize)
+				uint32_t firstLevel{ 0 };
+			};
+
+			const Context &context;
+			TextureLoader &loader;
+
+			std::vector<Request> requests;
+
+			CreateBufferResult staging;
+			vk::CommandBuffer cmdBuffer;
+			vk::Fence fence;
+
+			bool submitted{ false };
+			bool finished{ false };
+
+			// bytes of the levels that are uploaded
+			static vk::DeviceSize stagedSize(const Request &request);
+
+			// frees the staging buffer and command buffer once the fence signalled
+			void release();
+
+		public:
+
+			// levels larger than this aren't uploaded, 0 uploads all of them
+			// the images can then be copied from, a TextureStreamer takes them over and streams the rest in
+			uint32_t maxSize{ 0 };
+
+			TextureBatch(const Context &context, TextureLoader &loader);
+
+			// waits for the upload
+			~TextureBatch();
+
+			// the texture is filled in by submit()
+			std::shared_ptr<Texture> add(const std::string& filename, texture::Usage usage = texture::Usage::eColor);
+
+			size_t size() const { return requests.size(); }
+
+			void submit();
+
+			// true once the upload finished (and the staging memory is freed)
+			bool ready();
+
+			void wait();
+	};
 }
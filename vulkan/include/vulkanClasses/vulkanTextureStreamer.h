@@ -0,0 +1,149 @@
+#pragma once
+
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkanContext.h"
+#include "vulkanTextureLoader.h"
+#include "vulkanAssetManager.h"
+#include "vulkanMaterialTable.h"
+
+
+
+// models load their textures with the mips up to this size, the larger ones are streamed in when they're seen up close
+#define TEXTURE_STREAM_START_SIZE 128
+
+// files read at the same time
+#define TEXTURE_STREAM_MAX_LOADS 4
+
+// textures that weren't requested for this many frames lose their large mips first when memory runs short
+#define TEXTURE_STREAM_IDLE_FRAMES 120
+
+// without VK_EXT_memory_budget the streamed textures may use this part of the device local heaps
+#define TEXTURE_STREAM_HEAP_FRACTION 0.5
+
+// with it, this part of the heap budget is left to everything else
+#define TEXTURE_STREAM_BUDGET_RESERVE 0.1
+
+
+
+namespace vkx {
+
+
+	// keeps the material textures' mips resident as far as they're seen and fit in a memory budget
+	//
+	// every frame the app requests the materials it draws with their size on screen, update() reads the files of
+	// textures that need larger mips on worker threads and uploads them, and when the wanted mips don't fit the budget
+	// the textures requested least recently give up their largest mips (copied down on the gpu, no file access)
+	// a texture with other mips is a new image, it replaces the old one everywhere (asset manager, material
+	// descriptor sets, material table) once its upload finished, update() then returns true
+	class TextureStreamer {
+
+		private:
+
+			struct Entry {
+				std::string fileName;
+				texture::Usage usage;
+				// of the file
+				uint32_t width{ 0 };
+				uint32_t height{ 0 };
+				uint32_t mipLevels{ 0 };
+				// the mips it was added with are never dropped
+				uint32_t minLevel{ 0 };
+				// resident levels [texture.firstLevel, mipLevels)
+				Texture texture;
+
+				// first level this frame's requests need
+				uint32_t wantedLevel{ 0 };
+				uint64_t lastRequested{ 0 };
+				// where update() wants it to be
+				uint32_t targetLevel{ 0 };
+
+				// the file, read on a worker thread
+				std::future<gli::texture2d> load;
+				bool loading{ false };
+				bool uploading{ false };
+				// the file couldn't be read, keeps what it has
+				bool failed{ false };
+			};
+
+			// a new image for an entry, swapped in once the submit finished
+			struct Upload {
+				size_t entry;
+				Texture texture;
+			};
+
+			const Context *context{ nullptr };
+			TextureLoader *loader{ nullptr };
+			AssetManager *assetManager{ nullptr };
+			MaterialTable *materialTable{ nullptr };
+
+			std::vector<Entry> entries;
+			// resident image -> entry
+			std::unordered_map<VkImage, size_t> entryByImage;
+
+			uint64_t frame{ 1 };
+
+			std::vector<Upload> uploads;
+			CreateBufferResult staging;
+			vk::CommandBuffer cmdBuffer;
+			vk::Fence fence;
+
+			// bytes of the levels [firstLevel, mipLevels)
+			vk::DeviceSize levelsSize(const Entry &entry, uint32_t firstLevel) const;
+
+			// the memory the streamed textures may use now
+			vk::DeviceSize currentLimit() const;
+
+			// swaps the finished uploads in, returns true if there were any
+			bool finishUploads();
+
+			// target levels from the requests, least recently requested textures are lowered until they fit
+			void chooseLevels();
+
+			void startLoads();
+
+			// new images for the loaded files and the textures that drop mips, one submit
+			void recordUploads();
+
+		public:
+
+			// bytes the streamed textures may use, 0 takes it from VK_EXT_memory_budget (or a part of the heaps)
+			vk::DeviceSize budget{ 0 };
+			// added to the mip the screen size asks for, > 0 streams in less
+			float lodBias{ 0.0f };
+
+			// stats
+			vk::DeviceSize residentBytes{ 0 };
+			vk::DeviceSize limitBytes{ 0 };
+			uint32_t streamedIn{ 0 };
+			uint32_t evicted{ 0 };
+
+			void prepare(const Context *context, TextureLoader *loader, AssetManager *assetManager, MaterialTable *materialTable = nullptr);
+
+			// a texture loaded with TextureBatch::maxSize (it has to be a transfer source), the rest of the file's mips are streamed
+			void add(const std::string &fileName, texture::Usage usage, const Texture &texture);
+
+			uint32_t textureCount() const { return (uint32_t)entries.size(); }
+
+			// starts a frame's requests
+			void beginFrame();
+
+			// the texture is drawn about pixels across on screen (textures that aren't streamed are ignored)
+			void request(const Texture &texture, float pixels);
+
+			void request(const Material &material, float pixels);
+
+			// once per frame after the requests, doesn't wait on the gpu except to swap textures (device idle)
+			// returns true if textures were replaced, descriptor sets changed and command buffers have to be recorded again
+			bool update();
+
+			// waits for the loads and uploads in flight, the textures stay with the asset manager
+			void destroy();
+	};
+
+}
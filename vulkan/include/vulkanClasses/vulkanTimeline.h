@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+
+namespace vkx {
+
+
+	// time spent in each startup stage, printed once everything is ready
+	// compare the pipelines stage between a cold start (no pipeline cache file) and a warm one
+	class StartupTimeline {
+
+		private:
+
+			struct Stage {
+				std::string name;
+				double ms;
+			};
+
+			std::vector<Stage> stages;
+
+			std::chrono::high_resolution_clock::time_point tStart;
+			std::chrono::high_resolution_clock::time_point tLastMark;
+
+			// add()ed since the last mark, not counted again by the next mark
+			double excludedMS{ 0.0 };
+
+			bool finished{ false };
+
+			Stage &stage(const std::string &name);
+
+		public:
+
+			// times a block and add()s it to a stage, for work spread over other stages
+			class Scope {
+				private:
+					StartupTimeline &timeline;
+					std::string name;
+					std::chrono::high_resolution_clock::time_point tStart;
+				public:
+					Scope(StartupTimeline &timeline, const std::string &name);
+					~Scope();
+			};
+
+			StartupTimeline();
+
+			// adds ms to a stage, and takes it out of the next mark
+			void add(const std::string &name, double ms);
+
+			// the time since the last mark goes to this stage
+			void mark(const std::string &name);
+
+			// prints the stages and the total, after that add / mark do nothing
+			// warm: whether a pipeline cache from an earlier run was used
+			void print(bool warm);
+	};
+
+}
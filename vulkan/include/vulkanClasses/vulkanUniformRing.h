@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanContext.h"
+
+
+
+// frames a ring region waits before it's written again
+// the main loop waits for the offscreen submit of a frame, which also waits for every earlier submit,
+// so two frames back is always done with its region
+#define UNIFORM_RING_FRAMES 3
+
+// compared and uploaded in blocks of this many bytes when the caller doesn't pick a size
+#define DIRTY_UPLOAD_BLOCK_SIZE 64
+
+
+
+namespace vkx {
+
+
+	// a persistently mapped uniform buffer split in one region per frame
+	//
+	// uniforms that change every frame are pushed into the current region and bound as dynamic uniform buffers
+	// at the offset push() returned, so a frame never writes what an earlier one may still be reading
+	class UniformRing {
+
+		private:
+
+			vkx::CreateBufferResult buffer;
+
+			vk::DeviceSize alignment{ 0 };
+			vk::DeviceSize frameSize{ 0 };
+			uint32_t frameCount{ 0 };
+
+			uint32_t frameIndex{ 0 };
+			// into the current region
+			vk::DeviceSize offset{ 0 };
+
+			vk::DeviceSize aligned(vk::DeviceSize size) const;
+
+		public:
+
+			// stats
+			vk::DeviceSize usedBytes{ 0 };
+			vk::DeviceSize peakBytes{ 0 };
+
+			// frameSize: what may be pushed during one frame
+			void prepare(const vkx::Context *context, vk::DeviceSize frameSize, uint32_t frameCount = UNIFORM_RING_FRAMES);
+
+			// moves on to the next region, once per frame before anything is pushed
+			void beginFrame();
+
+			// copies the data into the current region, returns its dynamic offset
+			uint32_t push(const void *data, vk::DeviceSize size);
+
+			template <typename T>
+			uint32_t push(const T &data) {
+				return push(&data, sizeof(T));
+			}
+
+			// for a dynamic uniform buffer binding reading range bytes at the pushed offset
+			vk::DescriptorBufferInfo descriptor(vk::DeviceSize range) const;
+
+			vk::DeviceSize size() const { return this->frameSize * this->frameCount; }
+
+			void destroy();
+	};
+
+
+
+	// writes data to a mapped buffer, but only the blocks that changed since the last write
+	//
+	// keeps a copy of what was written (comparing against the mapped memory would read back from the device)
+	// a write with a different size than the last one writes everything
+	class DirtyUpload {
+
+		private:
+
+			std::vector<uint8_t> shadow;
+
+		public:
+
+			// bytes written since resetStats()
+			vk::DeviceSize writtenBytes{ 0 };
+
+			// returns the bytes that were written
+			vk::DeviceSize write(const vkx::CreateBufferResult &buffer, const void *data, size_t size, size_t blockSize = DIRTY_UPLOAD_BLOCK_SIZE);
+
+			template <typename T>
+			vk::DeviceSize write(const vkx::CreateBufferResult &buffer, const T &data, size_t blockSize = DIRTY_UPLOAD_BLOCK_SIZE) {
+				return write(buffer, &data, sizeof(T), blockSize);
+			}
+
+			template <typename T>
+			vk::DeviceSize write(const vkx::CreateBufferResult &buffer, const std::vector<T> &data, size_t blockSize = sizeof(T)) {
+				return write(buffer, data.data(), data.size() * sizeof(T), blockSize);
+			}
+
+			// the buffer was recreated, the next write writes everything
+			void invalidate() { this->shadow.clear(); }
+
+			void resetStats() { this->writtenBytes = 0; }
+	};
+
+}
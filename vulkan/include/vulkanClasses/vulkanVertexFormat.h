@@ -0,0 +1,312 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/packing.hpp>
+
+#include "vulkanTools.h"
+#include "vulkanMeshLoader.h"
+
+
+
+// compile time vertex layouts
+// a VertexFormat is a list of components, each component knows its size, its vk::Format and how to write itself from a vkx::Vertex
+// so converting a mesh becomes one unrolled loop with constant offsets instead of a per component switch / push_back
+
+namespace vkx {
+
+
+	// per mesh parameters for the vertex writers
+	struct VertexWriteParams {
+		// positions are multiplied by scale
+		float scale{ 1.0f };
+		// quantized positions are stored as (position * scale - center) * invExtent
+		glm::vec3 center{ 0.0f };
+		glm::vec3 extent{ 1.0f };
+		glm::vec3 invExtent{ 1.0f };
+	};
+
+	// write params for a mesh with the given (unscaled) bounds
+	VertexWriteParams vertexWriteParams(float scale, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+
+	namespace vertex {
+
+		// octahedral encoding of a unit vector, both components in [-1, 1]
+		inline glm::vec2 octEncode(const glm::vec3 &v) {
+			float l1 = fabs(v.x) + fabs(v.y) + fabs(v.z);
+			if (l1 == 0.0f) {
+				return glm::vec2(0.0f);
+			}
+			glm::vec2 e = glm::vec2(v.x, v.y) / l1;
+			if (v.z < 0.0f) {
+				glm::vec2 s(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+				e = (glm::vec2(1.0f) - glm::abs(glm::vec2(e.y, e.x))) * s;
+			}
+			return e;
+		}
+
+
+
+		// float components
+
+		struct Position {
+			static const VertexComponent component = VERTEX_COMPONENT_POSITION;
+			static const uint32_t size = 3 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_pos.x * params.scale;
+				d[1] = v.m_pos.y * params.scale;
+				d[2] = v.m_pos.z * params.scale;
+			}
+		};
+
+		struct Normal {
+			static const VertexComponent component = VERTEX_COMPONENT_NORMAL;
+			static const uint32_t size = 3 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_normal.x;
+				d[1] = v.m_normal.y;
+				d[2] = v.m_normal.z;
+			}
+		};
+
+		struct Color {
+			static const VertexComponent component = VERTEX_COMPONENT_COLOR;
+			static const uint32_t size = 3 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_color.r;
+				d[1] = v.m_color.g;
+				d[2] = v.m_color.b;
+			}
+		};
+
+		struct UV {
+			static const VertexComponent component = VERTEX_COMPONENT_UV;
+			static const uint32_t size = 2 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_tex.s;
+				d[1] = v.m_tex.t;
+			}
+		};
+
+		struct Tangent {
+			static const VertexComponent component = VERTEX_COMPONENT_TANGENT;
+			static const uint32_t size = 3 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_tangent.x;
+				d[1] = v.m_tangent.y;
+				d[2] = v.m_tangent.z;
+			}
+		};
+
+		struct Bitangent {
+			static const VertexComponent component = VERTEX_COMPONENT_BITANGENT;
+			static const uint32_t size = 3 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = v.m_binormal.x;
+				d[1] = v.m_binormal.y;
+				d[2] = v.m_binormal.z;
+			}
+		};
+
+		// padding components
+		struct PadFloat {
+			static const VertexComponent component = VERTEX_COMPONENT_DUMMY_FLOAT;
+			static const uint32_t size = sizeof(float);
+			static vk::Format format() { return vk::Format::eR32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = 0.0f;
+			}
+		};
+
+		struct Pad4 {
+			static const VertexComponent component = VERTEX_COMPONENT_DUMMY_VEC4;
+			static const uint32_t size = 4 * sizeof(float);
+			static vk::Format format() { return vk::Format::eR32G32B32A32Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				float *d = reinterpret_cast<float*>(dst);
+				d[0] = 0.0f;
+				d[1] = 0.0f;
+				d[2] = 0.0f;
+				d[3] = 0.0f;
+			}
+		};
+
+
+
+		// quantized components
+
+		// 16 bit normalized, relative to the mesh bounds (w is unused)
+		struct PositionSnorm16 {
+			static const VertexComponent component = VERTEX_COMPONENT_POSITION_SNORM16;
+			static const uint32_t size = 4 * sizeof(int16_t);
+			static vk::Format format() { return vk::Format::eR16G16B16A16Snorm; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				glm::vec3 p = (v.m_pos * params.scale - params.center) * params.invExtent;
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst);
+				d[0] = glm::packSnorm2x16(glm::vec2(p.x, p.y));
+				d[1] = glm::packSnorm2x16(glm::vec2(p.z, 0.0f));
+			}
+		};
+
+		// octahedral, 16 bit normalized
+		struct NormalOct {
+			static const VertexComponent component = VERTEX_COMPONENT_NORMAL_OCT;
+			static const uint32_t size = 2 * sizeof(int16_t);
+			static vk::Format format() { return vk::Format::eR16G16Snorm; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst);
+				d[0] = glm::packSnorm2x16(octEncode(v.m_normal));
+			}
+		};
+
+		struct TangentOct {
+			static const VertexComponent component = VERTEX_COMPONENT_TANGENT_OCT;
+			static const uint32_t size = 2 * sizeof(int16_t);
+			static vk::Format format() { return vk::Format::eR16G16Snorm; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst);
+				d[0] = glm::packSnorm2x16(octEncode(v.m_tangent));
+			}
+		};
+
+		struct UVHalf {
+			static const VertexComponent component = VERTEX_COMPONENT_UV_HALF;
+			static const uint32_t size = 2 * sizeof(uint16_t);
+			static vk::Format format() { return vk::Format::eR16G16Sfloat; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst);
+				d[0] = glm::packHalf2x16(v.m_tex);
+			}
+		};
+
+		struct ColorUnorm8 {
+			static const VertexComponent component = VERTEX_COMPONENT_COLOR_UNORM8;
+			static const uint32_t size = 4 * sizeof(uint8_t);
+			static vk::Format format() { return vk::Format::eR8G8B8A8Unorm; }
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				uint32_t *d = reinterpret_cast<uint32_t*>(dst);
+				d[0] = glm::packUnorm4x8(glm::vec4(v.m_color, 1.0f));
+			}
+		};
+
+
+
+		// recursion over the component list
+		template <typename... Components>
+		struct ComponentList;
+
+		template <>
+		struct ComponentList<> {
+			static const uint32_t size = 0;
+
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {}
+
+			static bool matches(const VertexComponent *layout, size_t count) {
+				return count == 0;
+			}
+
+			static void describe(std::vector<vk::VertexInputAttributeDescription> &attributes, uint32_t binding, uint32_t location, uint32_t offset) {}
+		};
+
+		template <typename Component, typename... Rest>
+		struct ComponentList<Component, Rest...> {
+			static const uint32_t size = Component::size + ComponentList<Rest...>::size;
+
+			// the offsets are constant so this inlines into straight stores
+			static void write(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+				Component::write(dst, v, params);
+				ComponentList<Rest...>::write(dst + Component::size, v, params);
+			}
+
+			static bool matches(const VertexComponent *layout, size_t count) {
+				return count > 0 && layout[0] == Component::component && ComponentList<Rest...>::matches(layout + 1, count - 1);
+			}
+
+			static void describe(std::vector<vk::VertexInputAttributeDescription> &attributes, uint32_t binding, uint32_t location, uint32_t offset) {
+				attributes.push_back(vkx::vertexInputAttributeDescription(binding, location, Component::format(), offset));
+				ComponentList<Rest...>::describe(attributes, binding, location + 1, offset + Component::size);
+			}
+		};
+
+	}
+
+
+
+	template <typename... Components>
+	struct VertexFormat {
+
+		typedef vertex::ComponentList<Components...> List;
+
+		// stride in bytes
+		static const uint32_t size = List::size;
+
+		// the runtime layout this format corresponds to
+		static std::vector<VertexComponent> layout() {
+			return std::vector<VertexComponent>{ Components::component... };
+		}
+
+		static bool matches(const std::vector<VertexComponent> &layout) {
+			return List::matches(layout.data(), layout.size());
+		}
+
+		// dst must have room for count * size bytes
+		static void write(const Vertex *src, size_t count, const VertexWriteParams &params, uint8_t *dst) {
+			for (size_t i = 0; i < count; ++i) {
+				List::write(dst + i * size, src[i], params);
+			}
+		}
+
+		// one attribute per component, locations in order starting at firstLocation
+		static std::vector<vk::VertexInputAttributeDescription> attributeDescriptions(uint32_t binding, uint32_t firstLocation = 0) {
+			std::vector<vk::VertexInputAttributeDescription> attributes;
+			attributes.reserve(sizeof...(Components));
+			List::describe(attributes, binding, firstLocation, 0);
+			return attributes;
+		}
+	};
+
+
+
+	// pre-instantiated formats, runtime layouts that match one of these use its writer
+	typedef VertexFormat<vertex::Position, vertex::UV, vertex::Color, vertex::Normal, vertex::Tangent, vertex::Pad4, vertex::Pad4> DefaultVertexFormat;
+	typedef VertexFormat<vertex::Position, vertex::UV, vertex::Color, vertex::Normal, vertex::Pad4, vertex::Pad4> MeshVertexFormat;
+	typedef VertexFormat<vertex::Position, vertex::UV, vertex::Color, vertex::Normal> DeferredVertexFormat;
+
+	// quantized layout, 24 bytes per vertex (same locations as the float layouts: position, uv, color, normal, tangent)
+	// meshes store the position in a stream of its own (see MeshBuffer::attributeOffset) so depth only passes fetch 8 bytes per vertex
+	typedef VertexFormat<vertex::PositionSnorm16> PackedPositionFormat;
+	typedef VertexFormat<vertex::UVHalf, vertex::ColorUnorm8, vertex::NormalOct, vertex::TangentOct> PackedAttributeFormat;
+	// both of the above interleaved
+	typedef VertexFormat<vertex::PositionSnorm16, vertex::UVHalf, vertex::ColorUnorm8, vertex::NormalOct, vertex::TangentOct> PackedVertexFormat;
+
+
+	// true for layouts with a quantized position, these are written as a position stream followed by the rest of the layout
+	bool hasPositionStream(const std::vector<VertexComponent> &layout);
+
+
+	// convert vertices to a runtime layout
+	// dispatches to a pre-instantiated format when the layout matches one, otherwise falls back to a per component loop
+	void writeVertices(const std::vector<VertexComponent> &layout, const std::vector<Vertex> &vertices, const VertexWriteParams &params, std::vector<uint8_t> &vertexBuffer);
+
+	// same as above but writes into dst (e.g. mapped staging memory), which must hold vertices.size() * vertexSize(layout) bytes
+	// large meshes are converted in parallel
+	void writeVertices(const std::vector<VertexComponent> &layout, const std::vector<Vertex> &vertices, const VertexWriteParams &params, void *dst);
+
+}
@@ -35,6 +35,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include "common.h"
+#include "vulkanMemoryStats.h"
 
 // Custom define for better code readability
 #define VK_FLAGS_NONE 0
@@ -227,7 +228,7 @@ namespace vkx {
 				unmap();
 			}
 			if (memory) {
-				device.freeMemory(memory);
+				vkx::memory::freeMemory(device, memory);
 				memory = vk::DeviceMemory();
 			}
 		}
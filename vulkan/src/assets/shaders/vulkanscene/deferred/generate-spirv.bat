@@ -4,7 +4,9 @@ glslangvalidator -V composition.vert -o composition.vert.spv
 glslangvalidator -V composition.frag -o composition.frag.spv
 glslangvalidator -V mrtMesh.vert -o mrtMesh.vert.spv
 glslangvalidator -V mrtMesh.frag -o mrtMesh.frag.spv
+glslangvalidator -V -DMATERIAL_TABLE mrtMesh.frag -o mrtMesh.table.frag.spv
 glslangvalidator -V mrtSkinnedMesh.vert -o mrtSkinnedMesh.vert.spv
 glslangvalidator -V mrtSkinnedMesh.frag -o mrtSkinnedMesh.frag.spv
+glslangvalidator -V -DMATERIAL_TABLE mrtSkinnedMesh.frag -o mrtSkinnedMesh.table.frag.spv
 
 pause
\ No newline at end of file
@@ -21,10 +21,44 @@ layout (location = 2) out uvec4 outAlbedo;// this is a uvec
 
 
 // diffuse texture (from material)
+#ifdef MATERIAL_TABLE
+
+// every material's textures in one array (must match MATERIAL_TABLE_TEXTURES)
+#define MATERIAL_TABLE_TEXTURES 256
+layout (set = 2, binding = 0) uniform sampler2D materialTextures[MATERIAL_TABLE_TEXTURES];
+
+struct MaterialRecord {
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float opacity;
+	uint diffuseTexture;
+	uint specularTexture;
+	uint bumpTexture;
+};
+
+layout (std430, set = 2, binding = 1) readonly buffer MaterialRecords {
+	MaterialRecord materials[];
+};
+
+// after the vertex stage's mesh constants
+layout (push_constant) uniform MaterialPushConstants {
+	layout (offset = 36) uint materialIndex;
+} material;
+
+// the same for every fragment of a draw, so the array can be indexed without nonuniformEXT
+#define samplerColor materialTextures[materials[material.materialIndex].diffuseTexture]
+#define samplerSpecular materialTextures[materials[material.materialIndex].specularTexture]
+#define samplerNormal materialTextures[materials[material.materialIndex].bumpTexture]
+
+#else
+
 layout (set = 2, binding = 0) uniform sampler2D samplerColor;
 layout (set = 2, binding = 1) uniform sampler2D samplerSpecular;
 layout (set = 2, binding = 2) uniform sampler2D samplerNormal;
 
+#endif
+
 
 
 float linearDepth(float depth) {
@@ -49,7 +83,9 @@ void main() {
 		vec3 T = normalize(inTangent);
 		vec3 B = cross(N, T);
 		mat3 TBN = mat3(T, B, N);
-		vec3 nm = texture(samplerNormal, inUV).xyz * 2.0 - vec3(1.0);
+		// z from x and y, cooked normal maps are BC5 (two channels)
+		vec2 nmXY = texture(samplerNormal, inUV).xy * 2.0 - vec2(1.0);
+		vec3 nm = vec3(nmXY, sqrt(max(1.0 - dot(nmXY, nmXY), 0.0)));
 		nm = TBN * normalize(nm);
 		outNormal = vec4(nm * 0.5 + 0.5, 0.0);
 		
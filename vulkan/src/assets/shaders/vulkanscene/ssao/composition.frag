@@ -85,13 +85,15 @@ struct DirectionalLight {
 #define NEAR_PLANE 0.1
 #define FAR_PLANE 256.0
 
-// #define SSAO_ENABLED 1;
-// #define USE_SHADOWS 1;
-// #define USE_PCF 1;
-
-const int SSAO_ENABLED = 1;
-const int USE_SHADOWS = 1;
-const int USE_PCF = 1;
+// set per pipeline, disabled features are folded away when the pipeline is compiled
+layout (constant_id = 0) const int SSAO_ENABLED = 1;
+layout (constant_id = 1) const int USE_SHADOWS = 1;
+layout (constant_id = 2) const int USE_PCF = 1;
+
+// lights actually used, up to the NUM_*_LIGHTS the uniform buffer holds
+layout (constant_id = 3) const int POINT_LIGHT_COUNT = NUM_POINT_LIGHTS;
+layout (constant_id = 4) const int SPOT_LIGHT_COUNT = NUM_SPOT_LIGHTS;
+layout (constant_id = 5) const int DIR_LIGHT_COUNT = NUM_DIR_LIGHTS;
 const float PI = 3.14159265359;
 
 
@@ -489,7 +491,7 @@ void main() {
 
 
         // world space point lights:
-        for(int i = 0; i < NUM_POINT_LIGHTS; ++i) {
+        for(int i = 0; i < POINT_LIGHT_COUNT; ++i) {
 
             PointLight light = ubo.pointlights[i];
 
@@ -564,7 +566,7 @@ void main() {
 
 
         // world space spot lights:
-        for(int i = 0; i < NUM_SPOT_LIGHTS; ++i) {
+        for(int i = 0; i < SPOT_LIGHT_COUNT; ++i) {
 
             SpotLight light = ubo.spotlights[i];
 
@@ -640,7 +642,7 @@ void main() {
 
 
         // directional lights:
-        for(int i = 0; i < NUM_DIR_LIGHTS; ++i) {
+        for(int i = 0; i < DIR_LIGHT_COUNT; ++i) {
 
         	DirectionalLight light = ubo.directionalLights[i];
 
@@ -676,7 +678,7 @@ void main() {
         if (USE_SHADOWS > 0) {
 
 
-            for(int i = 0; i < NUM_SPOT_LIGHTS; ++i) {
+            for(int i = 0; i < SPOT_LIGHT_COUNT; ++i) {
                 vec4 shadowClip = ubo.spotlights[i].viewMatrix * vec4(worldPos, 1.0);
 
                 float shadowFactor;
@@ -720,7 +722,7 @@ void main() {
             //     fragcolor *= shadowFactor;
             // }
 
-            for(int i = 0; i < NUM_DIR_LIGHTS; ++i) {
+            for(int i = 0; i < DIR_LIGHT_COUNT; ++i) {
 
 
                 vec4 shadowClip = ubo.directionalLights[i].viewMatrix * vec4(worldPos, 1.0);
@@ -5,8 +5,10 @@ glslangvalidator -V deferred.vert -o deferred.vert.spv
 glslangvalidator -V deferred.frag -o deferred.frag.spv
 glslangvalidator -V mrtMesh.vert -o mrtMesh.vert.spv
 glslangvalidator -V mrtMesh.frag -o mrtMesh.frag.spv
+glslangvalidator -V -DMATERIAL_TABLE mrtMesh.frag -o mrtMesh.table.frag.spv
 glslangvalidator -V mrtSkinnedMesh.vert -o mrtSkinnedMesh.vert.spv
 glslangvalidator -V mrtSkinnedMesh.frag -o mrtSkinnedMesh.frag.spv
+glslangvalidator -V -DMATERIAL_TABLE mrtSkinnedMesh.frag -o mrtSkinnedMesh.table.frag.spv
 
 glslangvalidator -V fullscreen.vert -o fullscreen.vert.spv
 glslangvalidator -V ssao.frag -o ssao.frag.spv
@@ -20,4 +22,6 @@ glslangvalidator -V shadow.vert -o shadow.vert.spv
 glslangvalidator -V shadow.frag -o shadow.frag.spv
 glslangvalidator -V shadow.geom -o shadow.geom.spv
 
+glslangvalidator -V meshletCull.comp -o meshletCull.comp.spv
+
 pause
\ No newline at end of file
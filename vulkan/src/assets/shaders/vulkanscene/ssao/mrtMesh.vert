@@ -3,11 +3,12 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-layout (location = 0) in vec4 inPos;
+// quantized vertex (see vulkanVertexFormat.h)
+layout (location = 0) in vec4 inPackedPos;// snorm16, relative to the mesh bounds
 layout (location = 1) in vec2 inUV;
-layout (location = 2) in vec3 inColor;
-layout (location = 3) in vec3 inNormal;
-layout (location = 4) in vec3 inTangent;
+layout (location = 2) in vec4 inColor;
+layout (location = 3) in vec2 inPackedNormal;// octahedral
+layout (location = 4) in vec2 inPackedTangent;// octahedral
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec2 outUV;
@@ -23,21 +24,45 @@ layout (set = 0, binding = 0) uniform sceneBuffer
 	mat4 projection;
 } scene;
 
-// matrix data
-layout (set = 1, binding = 0) uniform matrixBuffer
-{
+// per object data (see MatrixNode in main.cpp)
+struct MatrixNode {
 	mat4 model;
 	int boneIndex;
-	vec3 padding;
-	vec4 padding2[3];
-	//mat4 boneIndex;
-	mat4 g1;// more paddding
-	mat4 g2;
-} instance;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer matrixBuffer
+{
+	MatrixNode nodes[];
+} matrices;
+
+
+// per mesh position dequantization
+layout (push_constant) uniform meshConstants
+{
+	vec4 positionCenter;
+	vec4 positionExtent;
+	// index into matrices.nodes
+	uint objectIndex;
+} mesh;
+
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
 
 
 void main() {
-	
+
+	MatrixNode instance = matrices.nodes[mesh.objectIndex];
+
+	vec4 inPos = vec4(mesh.positionCenter.xyz + mesh.positionExtent.xyz * inPackedPos.xyz, 1.0);
+	vec3 inNormal = octDecode(inPackedNormal);
+	vec3 inTangent = octDecode(inPackedTangent);
+
 	gl_Position = scene.projection * scene.view * instance.model * inPos;
 	
 	outUV = inUV;
@@ -66,5 +91,5 @@ void main() {
 
 	
 	// Currently just vertex color
-	outColor = inColor;
+	outColor = inColor.rgb;
 }
\ No newline at end of file
@@ -3,7 +3,8 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-layout (location = 0) in vec4 inPos;
+// position stream of the quantized vertex (see vulkanVertexFormat.h)
+layout (location = 0) in vec4 inPackedPos;
 layout (location = 0) out int outInstanceIndex;
 
 out gl_PerVertex
@@ -12,7 +13,16 @@ out gl_PerVertex
 };
 
 
+// per mesh position dequantization
+layout (push_constant) uniform meshConstants
+{
+	vec4 positionCenter;
+	vec4 positionExtent;
+	// objectIndex follows, read by shadow.geom
+} mesh;
+
+
 void main() {
 	outInstanceIndex = gl_InstanceIndex;
-	gl_Position = inPos;
+	gl_Position = vec4(mesh.positionCenter.xyz + mesh.positionExtent.xyz * inPackedPos.xyz, 1.0);
 }
@@ -39,48 +39,28 @@
 
 
 
-std::vector<vkx::VertexComponent> meshVertexLayout =
-{
-	vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
-	vkx::VertexComponent::VERTEX_COMPONENT_UV,
-	vkx::VertexComponent::VERTEX_COMPONENT_COLOR,
-	vkx::VertexComponent::VERTEX_COMPONENT_NORMAL,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4
-};
+// vertex formats (see vulkanVertexFormat.h)
+typedef vkx::MeshVertexFormat MeshVertexFormat;
+typedef vkx::MeshVertexFormat SkinnedMeshVertexFormat;
+typedef vkx::DeferredVertexFormat DeferredVertexFormat;
+typedef vkx::DefaultVertexFormat SSAOVertexFormat;
+// quantized, used for all deferred meshes (positions are dequantized with MeshPushConstants)
+typedef vkx::PackedVertexFormat PackedVertexFormat;
 
 
-std::vector<vkx::VertexComponent> skinnedMeshVertexLayout =
-{
-	vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
-	vkx::VertexComponent::VERTEX_COMPONENT_UV,
-	vkx::VertexComponent::VERTEX_COMPONENT_COLOR,
-	vkx::VertexComponent::VERTEX_COMPONENT_NORMAL,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4
-};
+std::vector<vkx::VertexComponent> meshVertexLayout = MeshVertexFormat::layout();
 
+std::vector<vkx::VertexComponent> skinnedMeshVertexLayout = SkinnedMeshVertexFormat::layout();
 
-std::vector<vkx::VertexComponent> deferredVertexLayout =
-{
-	vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
-	vkx::VertexComponent::VERTEX_COMPONENT_UV,
-	vkx::VertexComponent::VERTEX_COMPONENT_COLOR,
-	vkx::VertexComponent::VERTEX_COMPONENT_NORMAL
-};
+std::vector<vkx::VertexComponent> deferredVertexLayout = DeferredVertexFormat::layout();
 
+std::vector<vkx::VertexComponent> SSAOVertexLayout = SSAOVertexFormat::layout();
 
+std::vector<vkx::VertexComponent> packedVertexLayout = PackedVertexFormat::layout();
 
-std::vector<vkx::VertexComponent> SSAOVertexLayout =
-{
-	vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
-	vkx::VertexComponent::VERTEX_COMPONENT_UV,
-	vkx::VertexComponent::VERTEX_COMPONENT_COLOR,
-	vkx::VertexComponent::VERTEX_COMPONENT_NORMAL,
-	vkx::VertexComponent::VERTEX_COMPONENT_TANGENT,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4,
-	vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4
-};
+
+// per mesh vertex shader push constants for the g-buffer and shadow passes (see vulkanDrawList.h)
+typedef vkx::MeshPushConstants MeshPushConstants;
 
 
 
@@ -120,10 +100,12 @@ float rnd(float min, float max) {
 // todo: move this somewhere else
 btConvexHullShape* createConvexHullFromMesh(vkx::MeshLoader *meshLoader, float scale = 1.0f) {
 	btConvexHullShape *convexHullShape = new btConvexHullShape();
+	// the loader has to retain positions (MESH_RETAIN_POSITIONS) or vertices
 	for (int i = 0; i < meshLoader->m_Entries.size(); ++i) {
-		for (int j = 0; j < meshLoader->m_Entries[i].Indices.size(); ++j) {
-			uint32_t index = meshLoader->m_Entries[i].Indices[j];
-			glm::vec3 point = meshLoader->m_Entries[i].Vertices[index].m_pos*scale;
+		const vkx::MeshEntry &entry = meshLoader->m_Entries[i];
+		for (int j = 0; j < entry.Indices.size(); ++j) {
+			uint32_t index = entry.Indices[j];
+			glm::vec3 point = (entry.Vertices.empty() ? entry.Positions[index] : entry.Vertices[index].m_pos)*scale;
 			btVector3 p = btVector3(point.x, point.y, point.z);
 			convexHullShape->addPoint(p);
 		}
@@ -210,14 +192,12 @@ class VulkanExample : public vkx::vulkanApp {
 		//glm::mat4 g2;
 	} uboScene;
 
-	// todo: fix this
+	// per object data, read from a storage buffer indexed by MeshPushConstants::objectIndex
+	// std430 layout, must match MatrixNode in the mrt*.vert / shadow.geom / meshletCull.comp shaders
 	struct MatrixNode {
 		glm::mat4 model;
 		uint32_t boneIndex;
-		glm::vec3 padding;
-		glm::vec4 padding2[3];
-		glm::mat4 g1;
-		glm::mat4 g2;
+		uint32_t padding[3];
 	};
 
 	std::vector<MatrixNode> matrixNodes;
@@ -237,7 +217,6 @@ class VulkanExample : public vkx::vulkanApp {
 	} temporary;
 
 
-	unsigned int alignedMatrixSize;
 	unsigned int alignedMaterialSize;
 
 	size_t dynamicAlignment;
@@ -261,11 +240,26 @@ class VulkanExample : public vkx::vulkanApp {
 	} textures;
 
 
-	struct {
+	struct VertexInput {
 		vk::PipelineVertexInputStateCreateInfo inputState;
 		std::vector<vk::VertexInputBindingDescription> bindingDescriptions;
 		std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
-	} vertices;
+
+		void update() {
+			inputState.vertexBindingDescriptionCount = bindingDescriptions.size();
+			inputState.pVertexBindingDescriptions = bindingDescriptions.data();
+			inputState.vertexAttributeDescriptionCount = attributeDescriptions.size();
+			inputState.pVertexAttributeDescriptions = attributeDescriptions.data();
+		}
+	};
+
+	// float layout (quads)
+	VertexInput vertices;
+	// quantized layouts (see vulkanVertexFormat.h)
+	VertexInput meshVertices;
+	VertexInput skinnedMeshVertices;
+	// position stream only
+	VertexInput shadowVertices;
 
 
 
@@ -376,12 +370,7 @@ class VulkanExample : public vkx::vulkanApp {
 	} uboShadowGS;
 
 	struct {
-		vkx::UniformData vsFullScreen;
 		vkx::UniformData vsOffscreen;
-		vkx::UniformData fsLights;
-
-		vkx::UniformData matrixVS;
-
 
 		vkx::UniformData ssaoKernel;
 		vkx::UniformData ssaoParams;
@@ -414,6 +403,8 @@ class VulkanExample : public vkx::vulkanApp {
 
 	bool updateDraw = true;
 	bool updateOffscreen = true;
+	// the view the offscreen draw list was sorted for (front to back)
+	glm::mat4 offscreenView;
 
 
 
@@ -421,9 +412,44 @@ class VulkanExample : public vkx::vulkanApp {
 
 	vk::CommandBuffer offscreenCmdBuffer;
 
+	// gpu meshlet culling for the g-buffer pass
+	vkx::MeshletCuller meshletCuller;
+	bool lastMeshletCulling = true;
+
+	// all material textures in one descriptor set (per material sets are used when it isn't supported)
+	vkx::MaterialTable materialTable;
+
+	// material texture mips by screen size, within a memory budget
+	vkx::TextureStreamer textureStreamer;
+
+	// meshes no model uses are evicted when they don't fit, uploaded again when loaded again
+	vkx::MeshResidency meshResidency;
+
+	// the composition pass' per frame uniforms (uboVS, uboFSLights), bound at deferredOffsets
+	vkx::UniformRing uniformRing;
+	std::array<uint32_t, 2> deferredOffsets;
+
+	// the other uniform buffers are read by the offscreen pass, which the frame waits for,
+	// they're written in place but only where they changed
+	struct {
+		vkx::DirtyUpload scene;
+		vkx::DirtyUpload matrix;
+		vkx::DirtyUpload material;
+		vkx::DirtyUpload bones;
+		vkx::DirtyUpload offscreen;
+		vkx::DirtyUpload ssaoParams;
+		vkx::DirtyUpload shadow;
+	} uniformUploads;
+
+	// per pass draw lists, sorted to cut down on state changes
+	vkx::DrawList shadowDrawList;
+	vkx::DrawList offscreenDrawList;
+
+	// every pipeline is described in preparePipelines, only the ones the first frame draws are created there
+	vkx::PipelineBatch pipelineBatch;
+
 
 	uint32_t lastMaterialIndex = -1;
-	std::string lastMaterialName;
 
 	// todo: move this:
 	bool rayPicking = false;
@@ -476,7 +502,6 @@ class VulkanExample : public vkx::vulkanApp {
 		// todo: move this somewhere else
 		unsigned int alignment = (uint32_t)context.deviceProperties.limits.minUniformBufferOffsetAlignment;
 
-		alignedMatrixSize = (unsigned int)(alignedSize(alignment, sizeof(MatrixNode)));
 		alignedMaterialSize = (unsigned int)(alignedSize(alignment, sizeof(vkx::MaterialProperties)));
 
 
@@ -516,10 +541,8 @@ class VulkanExample : public vkx::vulkanApp {
 
 		// destroy offscreen uniform buffers
 		uniformDataDeferred.vsOffscreen.destroy();
-		uniformDataDeferred.vsFullScreen.destroy();
-		uniformDataDeferred.fsLights.destroy();
+		uniformRing.destroy();
 
-		uniformDataDeferred.matrixVS.destroy();
 		uniformDataDeferred.ssaoKernel.destroy();
 		uniformDataDeferred.ssaoParams.destroy();
 
@@ -532,6 +555,9 @@ class VulkanExample : public vkx::vulkanApp {
 		// destroy offscreen command buffer
 		context.device.freeCommandBuffers(cmdPool, offscreenCmdBuffer);
 
+		meshletCuller.destroy();
+		materialTable.destroy();
+
 		context.device.destroyFence(renderFence, nullptr);// temp
 
 
@@ -577,9 +603,12 @@ class VulkanExample : public vkx::vulkanApp {
 		// Destroy and free resources
 
 
+		textureStreamer.destroy();
+		meshResidency.destroy();
 		assetManager.destroy();
 
 
+		pipelineBatch.destroy();
 		rscs.pipelines->destroy();
 
 		rscs.pipelineLayouts->destroy();
@@ -650,27 +679,54 @@ class VulkanExample : public vkx::vulkanApp {
 
 		// Binding description
 		vertices.bindingDescriptions = std::vector<vk::VertexInputBindingDescription>{
-			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vkx::vertexSize(SSAOVertexLayout), vk::VertexInputRate::eVertex),
+			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, SSAOVertexFormat::size, vk::VertexInputRate::eVertex),
 		};
 
 		// Attribute descriptions
 		// Describes memory layout and shader positions
-		vertices.attributeDescriptions = std::vector<vk::VertexInputAttributeDescription>{
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, vk::Format::eR32G32B32Sfloat, 0),						// Location 0 : Position
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, vk::Format::eR32G32Sfloat,		sizeof(float) * 3),		// Location 1 : (UV) Texture coordinates
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, vk::Format::eR32G32B32Sfloat,	sizeof(float) * 5),		// Location 2 : Color
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 3, vk::Format::eR32G32B32Sfloat,	sizeof(float) * 8),		// Location 3 : Normal
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 4, vk::Format::eR32G32B32Sfloat,	sizeof(float) * 11),	// Location 4 : Tangent
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 5, vk::Format::eR32G32B32A32Sfloat, sizeof(float) * 14),	// Location 5 : Bone weights
-			vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 6, vk::Format::eR32G32B32A32Sint,	sizeof(float) * 18),	// Location 6 : Bone IDs
+		// Location 0 : Position
+		// Location 1 : (UV) Texture coordinates
+		// Location 2 : Color
+		// Location 3 : Normal
+		// Location 4 : Tangent
+		// Location 5 : Bone weights
+		// Location 6 : Bone IDs
+		vertices.attributeDescriptions = SSAOVertexFormat::attributeDescriptions(VERTEX_BUFFER_BIND_ID);
+		// skinned meshes store the bone ids as ints in the second padding slot
+		vertices.attributeDescriptions[6].format = vk::Format::eR32G32B32A32Sint;
+
+
+		vertices.update();
+
+
+
+		// meshes: position stream on VERTEX_BUFFER_BIND_ID, everything else on the next binding (same buffer, MeshBuffer::attributeOffset)
+		meshVertices.bindingDescriptions = std::vector<vk::VertexInputBindingDescription>{
+			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vkx::PackedPositionFormat::size, vk::VertexInputRate::eVertex),
+			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID + 1, vkx::PackedAttributeFormat::size, vk::VertexInputRate::eVertex),
 		};
+		meshVertices.attributeDescriptions = vkx::PackedPositionFormat::attributeDescriptions(VERTEX_BUFFER_BIND_ID);
+		std::vector<vk::VertexInputAttributeDescription> packedAttributes = vkx::PackedAttributeFormat::attributeDescriptions(VERTEX_BUFFER_BIND_ID + 1, 1);
+		meshVertices.attributeDescriptions.insert(meshVertices.attributeDescriptions.end(), packedAttributes.begin(), packedAttributes.end());
+		meshVertices.update();
+
 
+		// skinned meshes: interleaved, bone weights (unorm8) and bone IDs (uint8) after the packed vertex
+		skinnedMeshVertices.bindingDescriptions = std::vector<vk::VertexInputBindingDescription>{
+			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, PackedVertexFormat::size + 2 * sizeof(uint32_t), vk::VertexInputRate::eVertex),
+		};
+		skinnedMeshVertices.attributeDescriptions = PackedVertexFormat::attributeDescriptions(VERTEX_BUFFER_BIND_ID);
+		skinnedMeshVertices.attributeDescriptions.push_back(vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 5, vk::Format::eR8G8B8A8Unorm, PackedVertexFormat::size));
+		skinnedMeshVertices.attributeDescriptions.push_back(vkx::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 6, vk::Format::eR8G8B8A8Uint, PackedVertexFormat::size + sizeof(uint32_t)));
+		skinnedMeshVertices.update();
 
-		vertices.inputState.vertexBindingDescriptionCount = vertices.bindingDescriptions.size();
-		vertices.inputState.pVertexBindingDescriptions = vertices.bindingDescriptions.data();
 
-		vertices.inputState.vertexAttributeDescriptionCount = vertices.attributeDescriptions.size();
-		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
+		// shadows only need the position
+		shadowVertices.bindingDescriptions = std::vector<vk::VertexInputBindingDescription>{
+			vkx::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vkx::PackedPositionFormat::size, vk::VertexInputRate::eVertex),
+		};
+		shadowVertices.attributeDescriptions = vkx::PackedPositionFormat::attributeDescriptions(VERTEX_BUFFER_BIND_ID);
+		shadowVertices.update();
 	}
 
 
@@ -713,7 +769,10 @@ class VulkanExample : public vkx::vulkanApp {
 		};
 		rscs.descriptorPools->add("forward.textures", descriptorPoolSizes4, 100);
 
-		this->assetManager.materialDescriptorPool = rscs.descriptorPools->getPtr("forward.textures");
+		// per material descriptor sets aren't needed with the material table
+		if (!materialTable.enabled) {
+			this->assetManager.materialDescriptorPool = rscs.descriptorPools->getPtr("forward.textures");
+		}
 
 
 
@@ -736,7 +795,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 		// matrix data
 		std::vector<vk::DescriptorPoolSize> descriptorPoolSizes6 = {
-			vkx::descriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 2),// non-static data
+			vkx::descriptorPoolSize(vk::DescriptorType::eStorageBuffer, 2),// non-static data
 		};
 		rscs.descriptorPools->add("offscreen.matrix", descriptorPoolSizes6, 2);
 
@@ -752,6 +811,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 		std::vector<vk::DescriptorPoolSize> descriptorPoolSizesDeferred = {
 			vkx::descriptorPoolSize(vk::DescriptorType::eUniformBuffer, 16),
+			vkx::descriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 2),
 			vkx::descriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 16)
 		};
 		rscs.descriptorPools->add("deferred", descriptorPoolSizesDeferred, 4);
@@ -832,7 +892,9 @@ class VulkanExample : public vkx::vulkanApp {
 				2),
 		};
 		rscs.descriptorSetLayouts->add("forward.textures", descriptorSetLayoutBindings3);
-		this->assetManager.materialDescriptorSetLayout = rscs.descriptorSetLayouts->getPtr("forward.textures");
+		if (!materialTable.enabled) {
+			this->assetManager.materialDescriptorSetLayout = rscs.descriptorSetLayouts->getPtr("forward.textures");
+		}
 
 
 
@@ -928,9 +990,9 @@ class VulkanExample : public vkx::vulkanApp {
 		// descriptor set layout 1
 		// matrix data
 		std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings6 = {
-			// Set 1: Binding 0 : Vertex shader dynamic uniform buffer
+			// Set 1: Binding 0 : Vertex shader matrix node storage buffer
 			vkx::descriptorSetLayoutBinding(
-				vk::DescriptorType::eUniformBufferDynamic,
+				vk::DescriptorType::eStorageBuffer,
 				vk::ShaderStageFlagBits::eVertex,
 				0),
 		};
@@ -991,9 +1053,9 @@ class VulkanExample : public vkx::vulkanApp {
 		// Deferred shading layout
 		std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindingsDeferred = {
 
-			// Set 3: Binding 0: Vertex shader uniform buffer
+			// Set 3: Binding 0: Vertex shader uniform buffer (uniform ring)
 			vkx::descriptorSetLayoutBinding(
-				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eUniformBufferDynamic,
 				//vk::ShaderStageFlagBits::eVertex,
 				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry,// added geometry 4/12/17
 				0),
@@ -1025,9 +1087,9 @@ class VulkanExample : public vkx::vulkanApp {
 				vk::ShaderStageFlagBits::eFragment,
 				5),
 
-			// Set 3: Binding 6: Fragment shader uniform buffer
+			// Set 3: Binding 6: Fragment shader uniform buffer (uniform ring)
 			vkx::descriptorSetLayoutBinding(
-				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eUniformBufferDynamic,
 				vk::ShaderStageFlagBits::eFragment,
 				6),
 		};
@@ -1055,7 +1117,28 @@ class VulkanExample : public vkx::vulkanApp {
 
 		
 		// Offscreen (scene) rendering pipeline layout
-		rscs.pipelineLayouts->add("offscreen", pPipelineLayoutCreateInfoDeferred);
+		// same sets plus the per mesh dequantization constants
+		vk::PushConstantRange meshPushConstantRange = vkx::pushConstantRange(vk::ShaderStageFlagBits::eVertex, sizeof(MeshPushConstants), 0);
+		vk::PipelineLayoutCreateInfo pPipelineLayoutCreateInfoOffscreen = pPipelineLayoutCreateInfoDeferred;
+		pPipelineLayoutCreateInfoOffscreen.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfoOffscreen.pPushConstantRanges = &meshPushConstantRange;
+		rscs.pipelineLayouts->add("offscreen", pPipelineLayoutCreateInfoOffscreen);
+
+		// material table version: the texture array replaces the per material set and the fragment stage gets the material index
+		if (materialTable.enabled) {
+			std::vector<vk::DescriptorSetLayout> descriptorSetLayoutsMaterialTable = descriptorSetLayoutsDeferred;
+			descriptorSetLayoutsMaterialTable[2] = materialTable.setLayout;
+
+			std::array<vk::PushConstantRange, 2> materialTablePushConstantRanges = {
+				meshPushConstantRange,
+				vkx::pushConstantRange(vk::ShaderStageFlagBits::eFragment, sizeof(vkx::MaterialPushConstants), sizeof(MeshPushConstants)),
+			};
+
+			vk::PipelineLayoutCreateInfo pPipelineLayoutCreateInfoMaterialTable = vkx::pipelineLayoutCreateInfo(descriptorSetLayoutsMaterialTable.data(), descriptorSetLayoutsMaterialTable.size());
+			pPipelineLayoutCreateInfoMaterialTable.pushConstantRangeCount = materialTablePushConstantRanges.size();
+			pPipelineLayoutCreateInfoMaterialTable.pPushConstantRanges = materialTablePushConstantRanges.data();
+			rscs.pipelineLayouts->add("offscreen.materialTable", pPipelineLayoutCreateInfoMaterialTable);
+		}
 
 		rscs.pipelineLayouts->add("deferred", pPipelineLayoutCreateInfoDeferred);
 
@@ -1194,9 +1277,9 @@ class VulkanExample : public vkx::vulkanApp {
 
 		// Geometry shader descriptor set layout binding
 		std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindingsShadowMatrix = {
-			// Set 0: Binding 0: Vertex shader uniform buffer
+			// Set 1: Binding 0: matrix node storage buffer
 			vkx::descriptorSetLayoutBinding(
-				vk::DescriptorType::eUniformBufferDynamic,
+				vk::DescriptorType::eStorageBuffer,
 				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry,// geometry shader
 				0),
 		};
@@ -1210,6 +1293,10 @@ class VulkanExample : public vkx::vulkanApp {
 
 		// create pipelineLayout from descriptorSetLayouts
 		vk::PipelineLayoutCreateInfo pPipelineLayoutCreateInfoShadow = vkx::pipelineLayoutCreateInfo(descriptorSetLayoutsShadow.data(), descriptorSetLayoutsShadow.size());
+		// the geometry shader reads the object index
+		vk::PushConstantRange shadowPushConstantRange = vkx::pushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, sizeof(MeshPushConstants), 0);
+		pPipelineLayoutCreateInfoShadow.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfoShadow.pPushConstantRanges = &shadowPushConstantRange;
 		rscs.pipelineLayouts->add("offscreen.shadow", pPipelineLayoutCreateInfoShadow);
 
 
@@ -1280,6 +1367,10 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 
+		// the offsets are given when the set is bound
+		vk::DescriptorBufferInfo screenDescriptor = uniformRing.descriptor(sizeof(uboVS));
+		vk::DescriptorBufferInfo lightsDescriptor = uniformRing.descriptor(sizeof(uboFSLights));
+
 		// Offscreen texture targets:
 		std::vector<vk::WriteDescriptorSet> writeDescriptorSets2 = {
 
@@ -1287,9 +1378,9 @@ class VulkanExample : public vkx::vulkanApp {
 			// set 3: Binding 0: Vertex shader uniform buffer
 			vkx::writeDescriptorSet(
 				rscs.descriptorSets->get("deferred"),
-				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eUniformBufferDynamic,
 				0,
-				&uniformDataDeferred.vsFullScreen.descriptor),
+				&screenDescriptor),
 			// set 3: Binding 1: Position texture target
 			// replaced with depth
 			vkx::writeDescriptorSet(
@@ -1328,9 +1419,9 @@ class VulkanExample : public vkx::vulkanApp {
 			// set 3: Binding 6: Fragment shader uniform buffer// lights
 			vkx::writeDescriptorSet(
 				rscs.descriptorSets->get("deferred"),
-				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eUniformBufferDynamic,
 				6,
-				&uniformDataDeferred.fsLights.descriptor),
+				&lightsDescriptor),
 
 
 
@@ -1367,10 +1458,10 @@ class VulkanExample : public vkx::vulkanApp {
 				&uniformData.bonesVS.descriptor),// bind to forward descriptor since it's the same
 
 
-			// Set 1: Binding 0: Vertex shader uniform buffer
+			// Set 1: Binding 0: matrix node storage buffer
 			vkx::writeDescriptorSet(
 				rscs.descriptorSets->get("offscreen.matrix"),
-				vk::DescriptorType::eUniformBufferDynamic,
+				vk::DescriptorType::eStorageBuffer,
 				0,
 				&uniformData.matrixVS.descriptor),// bind to forward descriptor since it's the same
 
@@ -1502,10 +1593,10 @@ class VulkanExample : public vkx::vulkanApp {
 				0,
 				&uniformDataDeferred.gsShadow.descriptor),
 
-			// Set 1: Binding 0: Vertex shader uniform buffer
+			// Set 1: Binding 0: matrix node storage buffer
 			vkx::writeDescriptorSet(
 				rscs.descriptorSets->get("shadow.matrix"),
-				vk::DescriptorType::eUniformBufferDynamic,
+				vk::DescriptorType::eStorageBuffer,
 				0,
 				&uniformData.matrixVS.descriptor),// bind to forward descriptor since it's the same
 		};
@@ -1567,6 +1658,9 @@ class VulkanExample : public vkx::vulkanApp {
 		// Load shaders
 		std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages;
 
+		// everything is described here, what the first frame needs is created together on worker threads at the end
+		pipelineBatch.prepare(&context, rscs.pipelines);
+
 
 		vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
 		// set pipeline layout
@@ -1620,31 +1714,64 @@ class VulkanExample : public vkx::vulkanApp {
 		// deferred quad that is blitted to:
 		// not offscreen
 		// fullscreen quad
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/composition.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/composition.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("deferred.composition", deferredPipeline);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/composition.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/composition.frag", vk::ShaderStageFlagBits::eFragment);
+		pipelineBatch.add("deferred.composition", pipelineCreateInfo);
 
 
 		// fullscreen quad
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/composition.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/composition.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredSSAOQuadPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("deferred.composition.ssao", deferredSSAOQuadPipeline);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/composition.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/composition.frag", vk::ShaderStageFlagBits::eFragment);
+		{
+			// feature switches and light counts are specialization constants, a variant is just another pipeline
+			// from the same module and the disabled paths are folded away when it's compiled
+			struct CompositionConstants {
+				int32_t ssao = 1;
+				int32_t shadows = 1;
+				int32_t pcf = 1;
+				int32_t pointLights = NUM_POINT_LIGHTS;
+				int32_t spotLights = NUM_SPOT_LIGHTS;
+				int32_t dirLights = NUM_DIR_LIGHTS;
+			} compositionConstants;
+
+			std::array<vk::SpecializationMapEntry, 6> compositionEntries = { {
+				{ 0, offsetof(CompositionConstants, ssao), sizeof(int32_t) },
+				{ 1, offsetof(CompositionConstants, shadows), sizeof(int32_t) },
+				{ 2, offsetof(CompositionConstants, pcf), sizeof(int32_t) },
+				{ 3, offsetof(CompositionConstants, pointLights), sizeof(int32_t) },
+				{ 4, offsetof(CompositionConstants, spotLights), sizeof(int32_t) },
+				{ 5, offsetof(CompositionConstants, dirLights), sizeof(int32_t) },
+			} };
+
+			vk::SpecializationInfo compositionSpecialization;
+			compositionSpecialization.mapEntryCount = compositionEntries.size();
+			compositionSpecialization.pMapEntries = compositionEntries.data();
+			compositionSpecialization.dataSize = sizeof(compositionConstants);
+			compositionSpecialization.pData = &compositionConstants;
+			shaderStages[1].pSpecializationInfo = &compositionSpecialization;
+
+			pipelineBatch.add("deferred.composition.ssao", pipelineCreateInfo);
+
+			// with shadows off the shadow pass isn't recorded, so don't sample the shadow maps
+			compositionConstants.shadows = 0;
+			compositionConstants.pcf = 0;
+			pipelineBatch.add("deferred.composition.ssao.noShadows", pipelineCreateInfo);
+
+			// the batch copied it
+			shaderStages[1].pSpecializationInfo = nullptr;
+		}
 
 
 		// Debug display pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/debug.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/debug.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline debugPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("deferred.debug", debugPipeline);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/debug.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/debug.frag", vk::ShaderStageFlagBits::eFragment);
+		pipelineBatch.add("deferred.debug", pipelineCreateInfo);
 
 
 		// Debug display pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/debug.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/debug.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline debugPipelineSSAO = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("deferred.debug.ssao", debugPipelineSSAO);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/debug.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/debug.frag", vk::ShaderStageFlagBits::eFragment);
+		pipelineBatch.add("deferred.debug.ssao", pipelineCreateInfo);
 
 
 
@@ -1664,7 +1791,15 @@ class VulkanExample : public vkx::vulkanApp {
 		pipelineCreateInfo.renderPass = offscreen.framebuffers[0].renderPass;
 
 		// Separate layout
-		pipelineCreateInfo.layout = rscs.pipelineLayouts->get("offscreen");
+		pipelineCreateInfo.layout = rscs.pipelineLayouts->get(materialTable.enabled ? "offscreen.materialTable" : "offscreen");
+
+		// the material table shaders are the same sources compiled with MATERIAL_TABLE defined
+		vkx::shader::Defines mrtDefines;
+		if (materialTable.enabled) {
+			mrtDefines.push_back({ "MATERIAL_TABLE", "1" });
+		}
+		// precompiled variants, for when the sources aren't there
+		std::string mrtFragmentSuffix = materialTable.enabled ? ".table.frag.spv" : ".frag.spv";
 
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
@@ -1681,30 +1816,32 @@ class VulkanExample : public vkx::vulkanApp {
 		rasterizationState.cullMode = vk::CullModeFlagBits::eBack;// added
 
 		// Offscreen pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtMesh.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtMesh.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredMeshPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("offscreen.meshes", deferredMeshPipeline);
+		pipelineCreateInfo.pVertexInputState = &meshVertices.inputState;
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtMesh.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtMesh.frag", vk::ShaderStageFlagBits::eFragment, mrtDefines, getAssetPath() + "shaders/vulkanscene/deferred/mrtMesh" + mrtFragmentSuffix);
+		pipelineBatch.add("offscreen.meshes", pipelineCreateInfo);
 
 		// Offscreen pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtSkinnedMesh.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtSkinnedMesh.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredSkinnedMeshPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("offscreen.skinnedMeshes", deferredSkinnedMeshPipeline);
+		pipelineCreateInfo.pVertexInputState = &skinnedMeshVertices.inputState;
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtSkinnedMesh.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/deferred/mrtSkinnedMesh.frag", vk::ShaderStageFlagBits::eFragment, mrtDefines, getAssetPath() + "shaders/vulkanscene/deferred/mrtSkinnedMesh" + mrtFragmentSuffix);
+		pipelineBatch.add("offscreen.skinnedMeshes", pipelineCreateInfo);
 
 		// ssao:
 
 		// Offscreen pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtMesh.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtMesh.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredMeshSSAOPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("offscreen.meshes.ssao", deferredMeshSSAOPipeline);
+		pipelineCreateInfo.pVertexInputState = &meshVertices.inputState;
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtMesh.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtMesh.frag", vk::ShaderStageFlagBits::eFragment, mrtDefines, getAssetPath() + "shaders/vulkanscene/ssao/mrtMesh" + mrtFragmentSuffix);
+		pipelineBatch.add("offscreen.meshes.ssao", pipelineCreateInfo);
 
 		// Offscreen pipeline
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtSkinnedMesh.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtSkinnedMesh.frag.spv", vk::ShaderStageFlagBits::eFragment);
-		vk::Pipeline deferredSkinnedMeshSSAOPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("offscreen.skinnedMeshes.ssao", deferredSkinnedMeshSSAOPipeline);
+		pipelineCreateInfo.pVertexInputState = &skinnedMeshVertices.inputState;
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtSkinnedMesh.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/mrtSkinnedMesh.frag", vk::ShaderStageFlagBits::eFragment, mrtDefines, getAssetPath() + "shaders/vulkanscene/ssao/mrtSkinnedMesh" + mrtFragmentSuffix);
+		pipelineBatch.add("offscreen.skinnedMeshes.ssao", pipelineCreateInfo);
+
+		pipelineCreateInfo.pVertexInputState = &vertices.inputState;
 
 
 
@@ -1722,50 +1859,53 @@ class VulkanExample : public vkx::vulkanApp {
 		pipelineCreateInfo.pVertexInputState = &emptyInputState;
 
 		// SSAO Generate pass
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/fullscreen.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/ssao.frag.spv", vk::ShaderStageFlagBits::eFragment);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/fullscreen.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/ssao.frag", vk::ShaderStageFlagBits::eFragment);
 		{
-			//// Set constant parameters via specialization constants
-			//struct SpecializationData {
-			//	uint32_t kernelSize = SSAO_KERNEL_SIZE;
-			//	float radius = SSAO_RADIUS;
-			//	float power = 1.5f;
-			//} specializationData;
-
-			//std::vector<VkSpecializationMapEntry> specializationMapEntries;
-			//specializationMapEntries = {
-			//	vkTools::initializers::specializationMapEntry(0, offsetof(SpecializationData, kernelSize), sizeof(uint32_t)),	// SSAO Kernel size
-			//	vkTools::initializers::specializationMapEntry(1, offsetof(SpecializationData, radius), sizeof(float)),			// SSAO radius
-			//	vkTools::initializers::specializationMapEntry(2, offsetof(SpecializationData, power), sizeof(float)),			// SSAO power
-			//};
-
-			//VkSpecializationInfo specializationInfo = vkTools::initializers::specializationInfo(specializationMapEntries.size(), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
-			//shaderStages[1].pSpecializationInfo = &specializationInfo;
+			// Set constant parameters via specialization constants
+			// (the kernel buffer holds SSAO_KERNEL_SIZE samples, the shader uses the first kernelSize)
+			struct SpecializationData {
+				int32_t kernelSize = 32;
+				float radius = 1.2f;
+				float power = 1.5f;
+			} specializationData;
+
+			std::array<vk::SpecializationMapEntry, 3> specializationMapEntries = { {
+				{ 0, offsetof(SpecializationData, kernelSize), sizeof(int32_t) },// SSAO Kernel size
+				{ 1, offsetof(SpecializationData, radius), sizeof(float) },// SSAO radius
+				{ 2, offsetof(SpecializationData, power), sizeof(float) },// SSAO power
+			} };
+
+			vk::SpecializationInfo specializationInfo;
+			specializationInfo.mapEntryCount = specializationMapEntries.size();
+			specializationInfo.pMapEntries = specializationMapEntries.data();
+			specializationInfo.dataSize = sizeof(specializationData);
+			specializationInfo.pData = &specializationData;
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
 
 			pipelineCreateInfo.renderPass = offscreen.framebuffers[1].renderPass;// SSAO Generate render pass
 			pipelineCreateInfo.layout = rscs.pipelineLayouts->get("offscreen.ssaoGenerate");
 
-			vk::Pipeline ssaoGenerate = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-			rscs.pipelines->add("ssao.generate", ssaoGenerate);
+			pipelineBatch.add("ssao.generate", pipelineCreateInfo);
+			shaderStages[1].pSpecializationInfo = nullptr;
 		}
 
 		// SSAO blur pass
-		shaderStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/fullscreen.vert.spv", vk::ShaderStageFlagBits::eVertex);
-		shaderStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/blur.frag.spv", vk::ShaderStageFlagBits::eFragment);
+		shaderStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/fullscreen.vert", vk::ShaderStageFlagBits::eVertex);
+		shaderStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/blur.frag", vk::ShaderStageFlagBits::eFragment);
 
 		pipelineCreateInfo.renderPass = offscreen.framebuffers[2].renderPass;// SSAO Blur render pass
 		pipelineCreateInfo.layout = rscs.pipelineLayouts->get("offscreen.ssaoBlur");
 
-		vk::Pipeline ssaoBlur = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-		rscs.pipelines->add("ssao.blur", ssaoBlur);
+		pipelineBatch.add("ssao.blur", pipelineCreateInfo);
 
 
 
 
 
 
-		// change vertex input state back to what it was:
-		pipelineCreateInfo.pVertexInputState = &vertices.inputState;// important
+		// shadows only read the position stream:
+		pipelineCreateInfo.pVertexInputState = &shadowVertices.inputState;// important
 
 		// seperate pipeline layout:
 		pipelineCreateInfo.layout = rscs.pipelineLayouts->get("offscreen.shadow");
@@ -1777,9 +1917,9 @@ class VulkanExample : public vkx::vulkanApp {
 			// The shadow mapping pipeline uses geometry shader instancing (invocations layout modifier) to output 
 			// shadow maps for multiple lights sources into the different shadow map layers in one single render pass
 			std::array<vk::PipelineShaderStageCreateInfo, 3> shadowStages;
-			shadowStages[0] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.vert.spv", vk::ShaderStageFlagBits::eVertex);
-			shadowStages[1] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.frag.spv", vk::ShaderStageFlagBits::eFragment);
-			shadowStages[2] = context.loadShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.geom.spv", vk::ShaderStageFlagBits::eGeometry);
+			shadowStages[0] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.vert", vk::ShaderStageFlagBits::eVertex);
+			shadowStages[1] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.frag", vk::ShaderStageFlagBits::eFragment);
+			shadowStages[2] = context.compileShader(getAssetPath() + "shaders/vulkanscene/ssao/shadow.geom", vk::ShaderStageFlagBits::eGeometry);
 
 			pipelineCreateInfo.pStages = shadowStages.data();
 			pipelineCreateInfo.stageCount = static_cast<uint32_t>(shadowStages.size());
@@ -1804,12 +1944,23 @@ class VulkanExample : public vkx::vulkanApp {
 			// Reset blend attachment state
 			pipelineCreateInfo.renderPass = offscreen.framebuffers[3].renderPass;
 
-			vk::Pipeline shadowPipeline = context.device.createGraphicsPipeline(context.pipelineCache, pipelineCreateInfo, nullptr);
-			rscs.pipelines->add("shadow", shadowPipeline);
+			pipelineBatch.add("shadow", pipelineCreateInfo);
 
 		}
 
 
+		// the rest (debug views, the other g-buffer path, the shadows off composition) is created when first used
+		std::vector<std::string> prewarm;
+		if (settings.SSAO) {
+			prewarm = { "offscreen.meshes.ssao", "offscreen.skinnedMeshes.ssao", "ssao.generate", "ssao.blur" };
+			prewarm.push_back(settings.shadows ? "deferred.composition.ssao" : "deferred.composition.ssao.noShadows");
+		} else {
+			prewarm = { "offscreen.meshes", "offscreen.skinnedMeshes", "deferred.composition" };
+		}
+		if (settings.shadows) {
+			prewarm.push_back("shadow");
+		}
+		pipelineBatch.prewarm(prewarm);
 
 	}
 
@@ -1824,9 +1975,14 @@ class VulkanExample : public vkx::vulkanApp {
 
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers() {
+
+		vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_UNIFORM);
+
 		// Vertex shader uniform buffer block
 		uniformData.sceneVS = context.createUniformBuffer(uboScene);
-		uniformData.matrixVS = context.createDynamicUniformBuffer(matrixNodes);
+		// one storage buffer for every object, draws push their index instead of rebinding at a dynamic offset
+		uniformData.matrixVS = context.createBuffer(vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, matrixNodes);
+		uniformData.matrixVS.map();
 		uniformData.materialVS = context.createDynamicUniformBuffer(materialNodes);
 		uniformData.bonesVS = context.createUniformBuffer(uboBoneData);
 
@@ -1853,12 +2009,12 @@ class VulkanExample : public vkx::vulkanApp {
 		uboScene.view = camera.matrices.view;
 		uboScene.projection = camera.matrices.projection;
 		//uboScene.cameraPos = glm::vec4(camera.transform.translation, 0.0f);
-		uniformData.sceneVS.copy(uboScene);
+		uniformUploads.scene.write(uniformData.sceneVS, uboScene);
 	}
 
 	void updateMatrixBuffer() {
-		// todo:
-		uniformData.matrixVS.copy(matrixNodes);
+		// only the nodes that moved
+		uniformUploads.matrix.write(uniformData.matrixVS, matrixNodes);
 		//uniformData.matrixVS.copy(modelMatrices);
 
 		//memcpy(uniformData.matrixVS.mapped, modelMatrices, uniformData.matrixVS.size);
@@ -1894,34 +2050,77 @@ class VulkanExample : public vkx::vulkanApp {
 		}
 
 
-		// todo: don't update the whole buffer each time
-		// use map memory range and flush
-		// uniform data must not set local host coherent bit?
-		// makes changes visible to host
-		uniformData.materialVS.copy(materialNodes);
+		// only the materials that changed
+		uniformUploads.material.write(uniformData.materialVS, materialNodes);
+
+		// new materials shift the material indices recorded in the offscreen command buffer
+		if (materialTable.update(this->assetManager.materials)) {
+			updateOffscreen = true;
+		}
 	}
 
 
+	// requests the materials of everything drawn by its size on screen (bounding sphere of each mesh)
+	// textures that were swapped change the descriptors the recorded command buffers use
+	void updateTextureStreaming() {
+
+		textureStreamer.beginFrame();
+
+		float pixelsPerUnit = camera.matrices.projection[1][1] * 0.5f * (float)settings.windowSize.height;
+
+		auto requestMesh = [&](const vkx::MeshBuffer &meshBuffer, const glm::mat4 &transform) {
+			auto material = assetManager.materials.resources.find(meshBuffer.materialName);
+			if (material == assetManager.materials.resources.end()) {
+				return;
+			}
+			glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(meshBuffer.positionCenter), 1.0f));
+			glm::vec3 axisScale(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+			float radius = glm::length(glm::vec3(meshBuffer.positionExtent) * axisScale);
+			float distance = glm::max(glm::length(glm::vec3(camera.matrices.view * glm::vec4(center, 1.0f))) - radius, 0.1f);
+			textureStreamer.request(material->second, 2.0f * radius * pixelsPerUnit / distance);
+		};
+
+		for (auto &model : models) {
+			for (auto &meshBuffer : model->meshBuffers) {
+				requestMesh(*meshBuffer, model->transfMatrix);
+			}
+		}
+		for (auto &model : modelsDeferred) {
+			for (auto &meshBuffer : model->meshBuffers) {
+				requestMesh(*meshBuffer, model->transfMatrix);
+			}
+		}
+		for (auto &skinnedMesh : skinnedMeshes) {
+			if (skinnedMesh->meshBuffer) {
+				requestMesh(*skinnedMesh->meshBuffer, skinnedMesh->transfMatrix);
+			}
+		}
+		for (auto &skinnedMesh : skinnedMeshesDeferred) {
+			if (skinnedMesh->meshBuffer) {
+				requestMesh(*skinnedMesh->meshBuffer, skinnedMesh->transfMatrix);
+			}
+		}
+
+		if (textureStreamer.update()) {
+			updateDraw = true;
+			updateOffscreen = true;
+		}
+	}
+
 	void updateBoneBuffer() {
-		uniformData.bonesVS.copy(uboBoneData);
+		// a bone at a time, the bones of meshes that aren't animated stay as they are
+		uniformUploads.bones.write(uniformData.bonesVS, uboBoneData, sizeof(glm::mat4));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffersDeferred() {
-		// Fullscreen quad vertex shader
-		uniformDataDeferred.vsFullScreen = context.createUniformBuffer(uboVS);
+		// Fullscreen quad vertex shader and deferred fragment shader, pushed every frame
+		vk::DeviceSize ringAlignment = context.deviceProperties.limits.minUniformBufferOffsetAlignment;
+		uniformRing.prepare(&context, sizeof(uboVS) + ringAlignment + sizeof(uboFSLights));
 
 		// Offscreen vertex shader
 		uniformDataDeferred.vsOffscreen = context.createUniformBuffer(uboOffscreenVS);
 
-		// Deferred fragment shader
-		uniformDataDeferred.fsLights = context.createUniformBuffer(uboFSLights);
-
-		uniformDataDeferred.matrixVS = context.createDynamicUniformBuffer(matrixNodes);
-
-
-
-
 		// ssao
 		uniformDataDeferred.ssaoParams = context.createUniformBuffer(uboSSAOParams);
 		uniformDataDeferred.ssaoKernel = context.createUniformBuffer(uboSSAOKernel);
@@ -1939,7 +2138,6 @@ class VulkanExample : public vkx::vulkanApp {
 		// offscreen:
 		updateUniformBuffersScreen();
 		updateSceneBufferDeferred();
-		updateMatrixBufferDeferred();
 
 		initLights();
 		updateUniformBufferDeferredLights();
@@ -1951,6 +2149,7 @@ class VulkanExample : public vkx::vulkanApp {
 		// shadow mapping:
 		updateUniformBufferShadow();
 
+		updateDeferredUniforms();
 	}
 
 	void updateUniformBuffersScreen() {
@@ -1961,22 +2160,17 @@ class VulkanExample : public vkx::vulkanApp {
 		}
 		uboVS.model = glm::mat4();
 		//uboVS.camPos = glm::vec4(camera.transform.translation, 1.0);// added
-
-		uniformDataDeferred.vsFullScreen.copy(uboVS);
 	}
 
 	void updateSceneBufferDeferred() {
 		//camera.updateViewMatrix();
 		uboOffscreenVS.projection = camera.matrices.projection;
 		uboOffscreenVS.view = camera.matrices.view;
-		uniformDataDeferred.vsOffscreen.copy(uboOffscreenVS);
-	}
+		uniformUploads.offscreen.write(uniformDataDeferred.vsOffscreen, uboOffscreenVS);
 
-	void updateMatrixBufferDeferred() {
-		uniformDataDeferred.matrixVS.copy(matrixNodes);
+		meshletCuller.updateFrustum(camera.matrices.projection, camera.matrices.view);
 	}
 
-
 	SpotLight initLight(glm::vec3 pos, glm::vec3 target, glm::vec3 color) {
 		SpotLight light;
 		light.position = glm::vec4(pos, 1.0f);
@@ -2300,15 +2494,19 @@ class VulkanExample : public vkx::vulkanApp {
 		uboFSLights.projection = camera.matrices.projection;// new
 
 		uboFSLights.invViewProj = glm::inverse(camera.matrices.projection * camera.matrices.view);// new
+	}
 
-
-		uniformDataDeferred.fsLights.copy(uboFSLights);
+	// pushes the composition pass' uniforms into the ring, once per frame before the draw command buffers are recorded
+	void updateDeferredUniforms() {
+		uniformRing.beginFrame();
+		deferredOffsets[0] = uniformRing.push(uboVS);
+		deferredOffsets[1] = uniformRing.push(uboFSLights);
 	}
 
 	void updateUniformBufferSSAOParams() {
 		uboSSAOParams.projection = camera.matrices.projection;
 		uboSSAOParams.view = camera.matrices.view;
-		uniformDataDeferred.ssaoParams.copy(uboSSAOParams);
+		uniformUploads.ssaoParams.write(uniformDataDeferred.ssaoParams, uboSSAOParams);
 	}
 
 	inline float lerp(float a, float b, float f) {
@@ -2323,8 +2521,11 @@ class VulkanExample : public vkx::vulkanApp {
 		std::random_device rndDev;
 		std::default_random_engine rndGen;
 
+		// the temporaries live in the scratch arena, this also runs when the window is resized
+		vkx::ScratchScope scratch;
+
 		// Sample kernel
-		std::vector<glm::vec4> ssaoKernel(SSAO_KERNEL_SIZE);
+		vkx::ArenaVector<glm::vec4> ssaoKernel(SSAO_KERNEL_SIZE, glm::vec4(), scratch.arena());
 		//std::vector<glm::vec4> ssaoKernel;
 
 		for (uint32_t i = 0; i < SSAO_KERNEL_SIZE; ++i) {
@@ -2355,7 +2556,7 @@ class VulkanExample : public vkx::vulkanApp {
 		// todo: fix
 
 		// Random noise
-		std::vector<glm::vec4> ssaoNoise(SSAO_NOISE_DIM * SSAO_NOISE_DIM);
+		vkx::ArenaVector<glm::vec4> ssaoNoise(SSAO_NOISE_DIM * SSAO_NOISE_DIM, glm::vec4(), scratch.arena());
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(ssaoNoise.size()); i++) {
 
@@ -2375,7 +2576,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 	void updateUniformBufferShadow() {
-		uniformDataDeferred.gsShadow.copy(uboShadowGS);
+		uniformUploads.shadow.write(uniformDataDeferred.gsShadow, uboShadowGS);
 	}
 
 
@@ -2398,11 +2599,13 @@ class VulkanExample : public vkx::vulkanApp {
 	void createDomino(glm::vec3 pos, float angle) {
 		auto dominoModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		dominoModel->load(getAssetPath() + "models/domino3.fbx");
-		dominoModel->createMeshes(SSAOVertexLayout, 0.125f, VERTEX_BUFFER_BIND_ID);
+		dominoModel->createMeshes(packedVertexLayout, 0.125f, VERTEX_BUFFER_BIND_ID);
 
 		modelsDeferred.push_back(dominoModel);
 
 
+		vkx::StartupTimeline::Scope physicsScope(startupTimeline, "physics");
+
 		auto physicsDomino = std::make_shared<vkx::PhysicsObject>(&physicsManager, dominoModel);
 
 		btCollisionShape* dominoShape = new btBoxShape(btVector3(1.0/8, 0.3/8, 1.9/8));
@@ -2439,17 +2642,20 @@ class VulkanExample : public vkx::vulkanApp {
 		// add plane model
 		auto planeModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		planeModel->load(getAssetPath() + "models/plane.fbx");
-		planeModel->createMeshes(SSAOVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
+		planeModel->createMeshes(packedVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
 		models.push_back(planeModel);
 
-		auto physicsPlane = std::make_shared<vkx::PhysicsObject>(&physicsManager, planeModel);
-		//btCollisionShape* boxShape = new btBoxShape(btVector3(btScalar(200.), btScalar(200.), btScalar(0.01)));
-		btCollisionShape* planeShape = new btStaticPlaneShape(btVector3(0.0, 0.0, 1.0), 0.0);
-		physicsPlane->createRigidBody(planeShape, 0.0f);
-		//btTransform t;
-		//t.setOrigin(btVector3(0., 0., 0.));
-		//physicsPlane->rigidBody->setWorldTransform(t);
-		physicsObjects.push_back(physicsPlane);
+		{
+			vkx::StartupTimeline::Scope physicsScope(startupTimeline, "physics");
+			auto physicsPlane = std::make_shared<vkx::PhysicsObject>(&physicsManager, planeModel);
+			//btCollisionShape* boxShape = new btBoxShape(btVector3(btScalar(200.), btScalar(200.), btScalar(0.01)));
+			btCollisionShape* planeShape = new btStaticPlaneShape(btVector3(0.0, 0.0, 1.0), 0.0);
+			physicsPlane->createRigidBody(planeShape, 0.0f);
+			//btTransform t;
+			//t.setOrigin(btVector3(0., 0., 0.));
+			//physicsPlane->rigidBody->setWorldTransform(t);
+			physicsObjects.push_back(physicsPlane);
+		}
 
 
 
@@ -2457,7 +2663,7 @@ class VulkanExample : public vkx::vulkanApp {
 		//for (int i = 0; i < 2; ++i) {
 		//	auto testModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		//	testModel->load(getAssetPath() + "models/cube.fbx");
-		//	testModel->createMeshes(SSAOVertexLayout, 0.5f, VERTEX_BUFFER_BIND_ID);
+		//	testModel->createMeshes(packedVertexLayout, 0.5f, VERTEX_BUFFER_BIND_ID);
 
 		//	models.push_back(testModel);
 		//}
@@ -2467,7 +2673,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 		//	auto testSkinnedMesh = std::make_shared<vkx::SkinnedMesh>(&context, &assetManager);
 		//	testSkinnedMesh->load(getAssetPath() + "models/goblin.dae");
-		//	testSkinnedMesh->createSkinnedMeshBuffer(SSAOVertexLayout, 0.0005f);
+		//	testSkinnedMesh->createSkinnedMeshBuffer(packedVertexLayout, 0.0005f);
 
 		//	skinnedMeshes.push_back(testSkinnedMesh);
 		//}
@@ -2492,18 +2698,21 @@ class VulkanExample : public vkx::vulkanApp {
 
 		if (!false) {
 			auto sponzaModel = std::make_shared<vkx::Model>(&context, &assetManager);
+			// kept until batchStaticModels merged it
+			sponzaModel->meshLoader->retention = vkx::MESH_RETAIN_VERTICES;
 			sponzaModel->load(getAssetPath() + "models/sponza.dae");
-			sponzaModel->createMeshes(SSAOVertexLayout, 0.08f, VERTEX_BUFFER_BIND_ID);//0.3
+			sponzaModel->createMeshes(packedVertexLayout, 0.08f, VERTEX_BUFFER_BIND_ID);//0.3
 			sponzaModel->rotateWorldX(PI / 2.0);
 			sponzaModel->rotateWorldZ(PI / 2.0);
 			//sponzaModel->rotateWorldX(glm::radians(90.0f));
+			sponzaModel->staticGeometry = true;
 			modelsDeferred.push_back(sponzaModel);
 		}
 
 		if (false) {
 			auto sibModel = std::make_shared<vkx::Model>(&context, &assetManager);
 			sibModel->load(getAssetPath() + "models/sibenik/sibenik.dae");
-			sibModel->createMeshes(SSAOVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
+			sibModel->createMeshes(packedVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
 			sibModel->rotateWorldX(PI / 2.0);
 			modelsDeferred.push_back(sibModel);
 		}
@@ -2538,7 +2747,7 @@ class VulkanExample : public vkx::vulkanApp {
 		for (int i = 0; i < 2; ++i) {
 			auto testModel = std::make_shared<vkx::Model>(&context, &assetManager);
 			testModel->load(getAssetPath() + "models/monkey.fbx");
-			testModel->createMeshes(SSAOVertexLayout, 0.0f, VERTEX_BUFFER_BIND_ID);
+			testModel->createMeshes(packedVertexLayout, 0.0f, VERTEX_BUFFER_BIND_ID);
 
 			modelsDeferred.push_back(testModel);
 		}
@@ -2548,7 +2757,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 			auto testSkinnedMesh = std::make_shared<vkx::SkinnedMesh>(&context, &assetManager);
 			testSkinnedMesh->load(getAssetPath() + "models/goblin.dae");// breaks size?
-			testSkinnedMesh->createSkinnedMeshBuffer(SSAOVertexLayout, 0.000005f);
+			testSkinnedMesh->createSkinnedMeshBuffer(packedVertexLayout, 0.000005f);
 			//todo: figure out why there must be atleast one deferred skinned mesh here
 			//inorder to not cause problems
 			//fixed?
@@ -2559,7 +2768,7 @@ class VulkanExample : public vkx::vulkanApp {
 		//for (int i = 0; i < 10; ++i) {
 		//	auto boxModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		//	boxModel->load(getAssetPath() + "models/myCube.dae");
-		//	boxModel->createMeshes(SSAOVertexLayout, 0.1f, VERTEX_BUFFER_BIND_ID);
+		//	boxModel->createMeshes(packedVertexLayout, 0.1f, VERTEX_BUFFER_BIND_ID);
 		//	//boxModel->rotateWorldX(PI / 2.0);
 		//	modelsDeferred.push_back(boxModel);
 		//	temporary.modelsDeferred.push_back(boxModel);
@@ -2570,14 +2779,14 @@ class VulkanExample : public vkx::vulkanApp {
 
 		//auto floorModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		//floorModel->load(getAssetPath() + "models/plane.fbx");
-		//floorModel->createMeshes(SSAOVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
+		//floorModel->createMeshes(packedVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
 		//modelsDeferred.push_back(floorModel);
 
 
 
 		//auto skyboxModel = std::make_shared<vkx::Model>(&context, &assetManager);
 		//skyboxModel->load(getAssetPath() + "models/myCube.dae");
-		//skyboxModel->createMeshes(SSAOVertexLayout, 10.0f, VERTEX_BUFFER_BIND_ID);
+		//skyboxModel->createMeshes(packedVertexLayout, 10.0f, VERTEX_BUFFER_BIND_ID);
 		//modelsDeferred.push_back(skyboxModel);
 
 
@@ -2607,7 +2816,9 @@ class VulkanExample : public vkx::vulkanApp {
 		}
 
 
-
+		if (settings.staticBatching) {
+			batchStaticModels();
+		}
 
 
 
@@ -2620,6 +2831,49 @@ class VulkanExample : public vkx::vulkanApp {
 	}
 
 
+	// replaces the static deferred models with world space chunks merged per material
+	// models driven by a physics object stay separate
+	void batchStaticModels() {
+
+		std::vector<std::shared_ptr<vkx::Model>> staticModels;
+		for (auto &model : modelsDeferred) {
+			if (!model->staticGeometry || !vkx::canBatch(*model)) {
+				continue;
+			}
+			bool dynamic = false;
+			for (auto &physicsObject : physicsObjects) {
+				if (physicsObject->object3D == model) {
+					dynamic = true;
+					break;
+				}
+			}
+			if (!dynamic) {
+				staticModels.push_back(model);
+			}
+		}
+
+		if (staticModels.empty()) {
+			return;
+		}
+
+		auto batch = vkx::buildStaticBatch(&context, &assetManager, staticModels);
+
+		// the batch takes the place of the first static model so the order of the others doesn't change
+		auto first = std::find(modelsDeferred.begin(), modelsDeferred.end(), staticModels[0]);
+		*first = batch;
+		for (size_t i = 1; i < staticModels.size(); ++i) {
+			modelsDeferred.erase(std::find(modelsDeferred.begin(), modelsDeferred.end(), staticModels[i]));
+		}
+
+		// the batch has its own copy
+		for (auto &model : staticModels) {
+			model->meshLoader->release(vkx::MESH_RETAIN_NONE);
+		}
+
+		updateOffscreen = true;
+	}
+
+
 
 
 
@@ -2764,8 +3018,9 @@ class VulkanExample : public vkx::vulkanApp {
 			float scale = 0.1f;
 
 			auto testModel = std::make_shared<vkx::Model>(&context, &assetManager);
+			testModel->meshLoader->retention = vkx::MESH_RETAIN_POSITIONS;
 			testModel->load(getAssetPath() + "models/monkey.fbx");
-			testModel->createMeshes(SSAOVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
+			testModel->createMeshes(packedVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
 			//testModel->loadAndCreateMeshes(getAssetPath() + "models/monkey.fbx", SSAOVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
 			modelsDeferred.push_back(testModel);
 
@@ -2782,7 +3037,7 @@ class VulkanExample : public vkx::vulkanApp {
 		if (keyStates.i) {
 			//auto dominoModel = std::make_shared<vkx::Model>(&context, &assetManager);
 			//dominoModel->load(getAssetPath() + "models/myCube.dae");
-			//dominoModel->createMeshes(SSAOVertexLayout, 0.45f, VERTEX_BUFFER_BIND_ID);
+			//dominoModel->createMeshes(packedVertexLayout, 0.45f, VERTEX_BUFFER_BIND_ID);
 
 			//modelsDeferred.push_back(dominoModel);
 
@@ -2808,8 +3063,9 @@ class VulkanExample : public vkx::vulkanApp {
 			float scale = 0.1f;
 
 			auto testModel = std::make_shared<vkx::Model>(&context, &assetManager);
+			testModel->meshLoader->retention = vkx::MESH_RETAIN_POSITIONS;
 			testModel->load(getAssetPath() + "models/myCube.dae");
-			testModel->createMeshes(SSAOVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
+			testModel->createMeshes(packedVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
 
 			//testModel->loadAndCreateMeshes(getAssetPath() + "models/myCube.dae", SSAOVertexLayout, 1.0f, VERTEX_BUFFER_BIND_ID);
 
@@ -2834,8 +3090,9 @@ class VulkanExample : public vkx::vulkanApp {
 			float scale = 0.1f;
 
 			auto testModel = std::make_shared<vkx::Model>(&context, &assetManager);
+			testModel->meshLoader->retention = vkx::MESH_RETAIN_POSITIONS;
 			testModel->load(getAssetPath() + "models/sphere.dae");
-			testModel->createMeshes(SSAOVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
+			testModel->createMeshes(packedVertexLayout, scale, VERTEX_BUFFER_BIND_ID);
 			modelsDeferred.push_back(testModel);
 
 
@@ -2879,6 +3136,12 @@ class VulkanExample : public vkx::vulkanApp {
 			updateDraw = true;
 		}
 
+		// toggled from the gui
+		if (settings.meshletCulling != lastMeshletCulling) {
+			lastMeshletCulling = settings.meshletCulling;
+			updateOffscreen = true;
+		}
+
 
 		if (!camera.isFirstPerson) {
 			camera.followOpts.point = models[1]->transform.translation;
@@ -3136,6 +3399,14 @@ class VulkanExample : public vkx::vulkanApp {
 		}
 
 
+		updateTextureStreaming();
+		meshResidency.update();
+
+		for (vkx::DirtyUpload *upload : { &uniformUploads.scene, &uniformUploads.matrix, &uniformUploads.material, &uniformUploads.bones,
+			&uniformUploads.offscreen, &uniformUploads.ssaoParams, &uniformUploads.shadow }) {
+			upload->resetStats();
+		}
+
 		updateSceneBuffer();
 		updateMatrixBuffer();
 		updateMaterialBuffer();
@@ -3145,8 +3416,8 @@ class VulkanExample : public vkx::vulkanApp {
 
 		updateUniformBuffersScreen();
 		updateSceneBufferDeferred();
-		updateMatrixBufferDeferred();
 		updateUniformBufferDeferredLights();
+		updateUniformBufferSSAOParams();
 
 
 		// change to whenever camera moves
@@ -3220,6 +3491,11 @@ class VulkanExample : public vkx::vulkanApp {
 
 	void updateCommandBuffers() {
 
+		// a pipeline that was being created in the background replaces its fallback
+		if (pipelineBatch.update()) {
+			updateDraw = true;
+		}
+
 		if (updateDraw) {
 			// record / update draw command buffers
 			if (TEST_DEFINE) {
@@ -3229,6 +3505,11 @@ class VulkanExample : public vkx::vulkanApp {
 			}
 		}
 
+		// the g-buffer draws are ordered front to back, a moved camera sorts them again
+		if (camera.matrices.view != offscreenView) {
+			updateOffscreen = true;
+		}
+
 		if (updateOffscreen) {
 			buildOffscreenCommandBuffer();
 		}
@@ -3277,7 +3558,41 @@ class VulkanExample : public vkx::vulkanApp {
 		ImGui::Checkbox("Update Draw Command Buffers", &updateDraw);
 		ImGui::Checkbox("Update Offscreen Command Buffers", &updateOffscreen);
 		ImGui::Checkbox("SSAO", &settings.SSAO);
-		ImGui::Checkbox("Shadows", &settings.shadows);
+		if (ImGui::Checkbox("Shadows", &settings.shadows)) {
+			// the composition pipeline depends on it
+			updateDraw = true;
+		}
+		if (meshletCuller.enabled) {
+			ImGui::Checkbox("Meshlet Culling", &settings.meshletCulling);
+			ImGui::Text("Meshlets: %d", meshletCuller.meshletCount);
+		}
+		if (materialTable.enabled) {
+			ImGui::Text("Material textures: %d", materialTable.textureCount());
+		}
+		if (textureStreamer.textureCount()) {
+			ImGui::Text("Streamed textures: %d, %d / %d MB", textureStreamer.textureCount(), (int)(textureStreamer.residentBytes >> 20), (int)(textureStreamer.limitBytes >> 20));
+			ImGui::Text("Mips streamed in: %d, evicted: %d", textureStreamer.streamedIn, textureStreamer.evicted);
+		}
+		if (meshResidency.fileCount()) {
+			ImGui::Text("Meshes: %d / %d MB, %d files evicted", (int)(meshResidency.residentBytes >> 20), (int)(meshResidency.limitBytes >> 20), meshResidency.evictedFiles);
+		}
+		if (assetManager.releasedMeshBytes || assetManager.releasedSceneBytes) {
+			ImGui::Text("Mesh data released: %d MB vertices, %d MB scenes", (int)(assetManager.releasedMeshBytes >> 20), (int)(assetManager.releasedSceneBytes >> 20));
+		}
+		{
+			// a growing count means something in the frame loop went back to the heap
+			const vkx::FrameAllocations &allocations = vkx::lastFrameAllocations();
+			ImGui::Text("Heap allocations: %d / frame, frame arena: %d / %d KB", (int)allocations.heapAllocations, (int)(allocations.frameArenaBytes >> 10), (int)(allocations.frameArenaCapacity >> 10));
+		}
+		{
+			vk::DeviceSize written = uniformUploads.scene.writtenBytes + uniformUploads.matrix.writtenBytes + uniformUploads.material.writtenBytes +
+				uniformUploads.bones.writtenBytes + uniformUploads.offscreen.writtenBytes + uniformUploads.ssaoParams.writtenBytes + uniformUploads.shadow.writtenBytes;
+			ImGui::Text("Uniforms: %d KB written, ring %d / %d KB", (int)(written >> 10), (int)(uniformRing.usedBytes >> 10), (int)(uniformRing.size() >> 10));
+		}
+		if (settings.shadows) {
+			ImGui::Text("Shadow: %d draws, %d binds, %d pipelines", shadowDrawList.stats.draws, shadowDrawList.stats.binds(), shadowDrawList.stats.pipelines);
+		}
+		ImGui::Text("G-buffer: %d draws, %d binds, %d pipelines", offscreenDrawList.stats.draws, offscreenDrawList.stats.binds(), offscreenDrawList.stats.pipelines);
 		ImGui::Checkbox("Add Boxes", &keyStates.b);
 		ImGui::SliderFloat("FPS Cap", &settings.fpsCap, 5.0f, 500.0f);
 
@@ -3324,6 +3639,26 @@ class VulkanExample : public vkx::vulkanApp {
 
 		ImGui::End();
 
+		ImGui::Begin("Memory");
+		vkx::MemoryStats memoryStats = context.getMemoryStats();
+		ImGui::Text("Total: %.1f MB (peak %.1f MB), %d allocations", memoryStats.total.liveBytes / 1048576.0, memoryStats.total.peakBytes / 1048576.0, memoryStats.total.allocations);
+		for (uint32_t i = 0; i < vkx::MEMORY_CATEGORY_COUNT; ++i) {
+			const vkx::MemoryUsage &usage = memoryStats.categories[i];
+			if (usage.peakBytes) {
+				ImGui::Text("%s: %.1f MB (peak %.1f MB), %d", vkx::memoryCategoryName((vkx::MemoryCategory)i), usage.liveBytes / 1048576.0, usage.peakBytes / 1048576.0, usage.allocations);
+			}
+		}
+		for (uint32_t i = 0; i < context.deviceMemoryProperties.memoryTypeCount; ++i) {
+			const vkx::MemoryUsage &usage = memoryStats.memoryTypes[i];
+			if (usage.peakBytes) {
+				ImGui::Text("type %d (heap %d): %.1f MB (peak %.1f MB)", i, context.deviceMemoryProperties.memoryTypes[i].heapIndex, usage.liveBytes / 1048576.0, usage.peakBytes / 1048576.0);
+			}
+		}
+		if (ImGui::Button("Dump to memory.json")) {
+			context.dumpMemoryStats("memory.json");
+		}
+		ImGui::End();
+
 		ImGui::SetNextWindowPos(ImVec2(650, 20), ImGuiSetCond_FirstUseEver);
 		ImGui::ShowTestWindow();
 
@@ -3339,9 +3674,13 @@ class VulkanExample : public vkx::vulkanApp {
 
 	void updateDrawCommandBuffer(const vk::CommandBuffer &cmdBuffer) {
 
-		// todo: definitely remove thise:
-		updateUniformBufferDeferredLights();
-		updateUniformBufferSSAOParams();
+		// looked up for every command buffer, literals would make a heap string each time
+		static const std::string debugName = "deferred.debug";
+		static const std::string debugSSAOName = "deferred.debug.ssao";
+		static const std::string compositionName = "deferred.composition";
+		static const std::string compositionSSAOName = "deferred.composition.ssao";
+		static const std::string compositionSSAONoShadowsName = "deferred.composition.ssao.noShadows";
+		static const std::string deferredName = "deferred";
 
 		{
 			/* DEFERRED QUAD */
@@ -3356,16 +3695,16 @@ class VulkanExample : public vkx::vulkanApp {
 			// renders quad
 			uint32_t setNum = 3;// important!
 			//uint32_t setNum = 0;// important!
-			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("deferred"), setNum, rscs.descriptorSets->get("deferred"), nullptr);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get(deferredName), setNum, rscs.descriptorSets->get(deferredName), deferredOffsets);
 			if (debugDisplay) {
-				if (settings.SSAO) {
-					cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("deferred.debug.ssao"));
-				} else {
-					cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("deferred.debug"));
+				// created in the background the first time, the debug quads are left out until then
+				vk::Pipeline debugPipeline = pipelineBatch.getAsync(settings.SSAO ? debugSSAOName : debugName, vk::Pipeline());
+				if (debugPipeline) {
+					cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, debugPipeline);
+					cmdBuffer.bindVertexBuffers(VERTEX_BUFFER_BIND_ID, meshBuffers.quad.vertices.buffer, { 0 });
+					cmdBuffer.bindIndexBuffer(meshBuffers.quad.indices.buffer, 0, meshBuffers.quad.indexType);
+					cmdBuffer.drawIndexed(meshBuffers.quad.indexCount, 1, 0, 0, 1);
 				}
-				cmdBuffer.bindVertexBuffers(VERTEX_BUFFER_BIND_ID, meshBuffers.quad.vertices.buffer, { 0 });
-				cmdBuffer.bindIndexBuffer(meshBuffers.quad.indices.buffer, 0, vk::IndexType::eUint32);
-				cmdBuffer.drawIndexed(meshBuffers.quad.indexCount, 1, 0, 0, 1);
 				// Move viewport to display final composition in lower right corner
 				viewport.x = viewport.width * 0.5f;
 				viewport.y = viewport.height * 0.5f;
@@ -3381,12 +3720,22 @@ class VulkanExample : public vkx::vulkanApp {
 			cmdBuffer.setViewport(0, viewport);
 			// Final composition as full screen quad
 			if (settings.SSAO) {
-				cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("deferred.composition.ssao"));
+				if (settings.shadows) {
+					cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineBatch.get(compositionSSAOName));
+				} else {
+					vk::Pipeline composition = pipelineBatch.getAsync(compositionSSAONoShadowsName, vk::Pipeline());
+					if (!composition) {
+						// the shadowed one reads stale shadow maps for the few frames until this one is ready
+						composition = pipelineBatch.get(compositionSSAOName);
+					}
+					cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, composition);
+				}
 			} else {
-				cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("deferred.composition"));
+				// the other g-buffer path, created right away (its g-buffer pipelines are too)
+				cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineBatch.get(compositionName));
 			}
 			cmdBuffer.bindVertexBuffers(VERTEX_BUFFER_BIND_ID, meshBuffers.quad.vertices.buffer, { 0 });
-			cmdBuffer.bindIndexBuffer(meshBuffers.quad.indices.buffer, 0, vk::IndexType::eUint32);
+			cmdBuffer.bindIndexBuffer(meshBuffers.quad.indices.buffer, 0, meshBuffers.quad.indexType);
 			cmdBuffer.drawIndexed(6, 1, 0, 0, 1);
 		}
 	}
@@ -3397,9 +3746,6 @@ class VulkanExample : public vkx::vulkanApp {
 
 	void buildDrawCommandBuffers() {
 
-		// todo: remove this:
-		updateUniformBufferDeferredLights();
-
 		{
 
 
@@ -3477,6 +3823,23 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 
+		// meshlet culling:
+		// compute pass, has to be recorded outside of the render passes
+		// the shadow pass still draws everything (the camera frustum doesn't apply there)
+		if (settings.meshletCulling) {
+			for (auto &model : modelsDeferred) {
+				if (!model->buffersReady) {
+					continue;
+				}
+				for (auto &meshBuffer : model->meshBuffers) {
+					meshletCuller.add(model.get(), meshBuffer, model->matrixIndex);
+				}
+			}
+			meshletCuller.record(offscreenCmdBuffer);
+		}
+
+
+
 
 
 
@@ -3526,7 +3889,14 @@ class VulkanExample : public vkx::vulkanApp {
 				//	offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("offscreen.meshes"));
 				//}
 
-				offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("shadow"));
+				// sorted by pipeline / geometry block / depth, only the binds that change are recorded
+				shadowDrawList.reset(rscs.pipelineLayouts->get("offscreen.shadow"), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, false);
+
+				// the scene and matrix sets are the same for every draw, objects are picked by the pushed index
+				std::array<vk::DescriptorSet, 2> shadowSets = { rscs.descriptorSets->get("shadow.scene"), rscs.descriptorSets->get("shadow.matrix") };
+				shadowDrawList.bindDescriptorSets(offscreenCmdBuffer, 0, shadowSets);
+
+				vk::Pipeline shadowPipeline = pipelineBatch.get("shadow");
 
 				// for each model
 				// model = group of meshes
@@ -3541,40 +3911,21 @@ class VulkanExample : public vkx::vulkanApp {
 
 					// for each of the model's meshBuffers
 					for (auto &meshBuffer : model->meshBuffers) {
-
-
-						// bind vertex & index buffers
-						offscreenCmdBuffer.bindVertexBuffers(meshBuffer->vertexBufferBinding, meshBuffer->vertices.buffer, vk::DeviceSize());
-						offscreenCmdBuffer.bindIndexBuffer(meshBuffer->indices.buffer, 0, vk::IndexType::eUint32);
-
-						// descriptor set #
-						uint32_t setNum;
-
-						// bind scene descriptor set
-						//setIndex = 0;
-						//offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setIndex, rscs.descriptorSets->get("offscreen.scene"), nullptr);
-
-						// bind shadow descriptor set?
-						// for vs uniform buffer?
-						// bind deferred descriptor set
-						// layout: offscreen, set index = 0
-						setNum = 0;
-						offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen.shadow"), setNum, rscs.descriptorSets->get("shadow.scene"), nullptr);
-
-
-						// dynamic uniform buffer to position objects
-						uint32_t offset1 = model->matrixIndex * static_cast<uint32_t>(alignedMatrixSize);
-						setNum = 1;
-						offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen.shadow"), setNum, 1, &rscs.descriptorSets->get("shadow.matrix"), 1, &offset1);
-
-
-
-						// draw:
-						offscreenCmdBuffer.drawIndexed(meshBuffer->indexCount, 1, 0, 0, 0);
+						vkx::DrawCommand command;
+						command.pipeline = shadowPipeline;
+						command.meshBuffer = meshBuffer.get();
+						command.firstBinding = meshBuffer->vertexBufferBinding;
+						// only the position stream, the rest of the vertex isn't needed here
+						command.streamCount = 1;
+						// dequantization constants + the model's matrix node (read by the geometry shader)
+						command.pushConstants = { meshBuffer->positionCenter, meshBuffer->positionExtent, model->matrixIndex };
+						shadowDrawList.add(command);
 					}
 
 				}
 
+				shadowDrawList.record(offscreenCmdBuffer);
+
 
 
 				offscreenCmdBuffer.endRenderPass();
@@ -3635,21 +3986,38 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 
-			// MODELS:
+			// the material table version of the layout has its own set 2 and a fragment push constant range
+			// (the skinned mesh pipelines use the same layout)
+			vk::PipelineLayout offscreenLayout = rscs.pipelineLayouts->get(materialTable.enabled ? "offscreen.materialTable" : "offscreen");
 
-			// bind mesh pipeline
-			// don't have to do this for every mesh
-			// todo: create pipelinesDeferred.mesh
-			if (settings.SSAO) {
-				offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("offscreen.meshes.ssao"));
-			} else {
-				offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("offscreen.meshes"));
+			// sorted by pipeline / material / geometry block / depth, only the binds that change are recorded
+			offscreenDrawList.reset(offscreenLayout, vk::ShaderStageFlagBits::eVertex, materialTable.enabled);
+
+			// scene and matrix sets, every object's matrix node is in the same storage buffer, draws push their index
+			std::array<vk::DescriptorSet, 2> offscreenSets = { rscs.descriptorSets->get("offscreen.scene"), rscs.descriptorSets->get("offscreen.matrix") };
+			offscreenDrawList.bindDescriptorSets(offscreenCmdBuffer, 0, offscreenSets);
+
+			// with the material table one set holds every material's textures, bind it once for the whole pass
+			if (materialTable.enabled) {
+				offscreenDrawList.bindDescriptorSets(offscreenCmdBuffer, 2, materialTable.descriptorSet);
 			}
 
+			// todo: create pipelinesDeferred.mesh
+			vk::Pipeline meshPipeline = pipelineBatch.get(settings.SSAO ? "offscreen.meshes.ssao" : "offscreen.meshes");
+			vk::Pipeline skinnedMeshPipeline = pipelineBatch.get(settings.SSAO ? "offscreen.skinnedMeshes.ssao" : "offscreen.skinnedMeshes");
+
+			// view space depth, orders draws with the same state front to back
+			glm::mat4 view = camera.matrices.view;
+			offscreenView = view;
+			auto viewDepth = [&view](const glm::mat4 &transform) {
+				return -(view * transform[3]).z;
+			};
+
+
+			// MODELS:
 
 			// for each model
 			// model = group of meshes
-			// todo: add skinned / animated model support
 			for (auto &model : modelsDeferred) {
 
 				// todo: fix
@@ -3658,117 +4026,52 @@ class VulkanExample : public vkx::vulkanApp {
 					continue;
 				}
 
+				float depth = viewDepth(model->transfMatrix);
+
 				// for each of the model's meshes
 				for (auto &meshBuffer : model->meshBuffers) {
 
-
-					// bind vertex & index buffers
-					offscreenCmdBuffer.bindVertexBuffers(meshBuffer->vertexBufferBinding, meshBuffer->vertices.buffer, vk::DeviceSize());
-					offscreenCmdBuffer.bindIndexBuffer(meshBuffer->indices.buffer, 0, vk::IndexType::eUint32);
-
-					// descriptor set #
-					uint32_t setNum;
-
-					// bind scene descriptor set
-					setNum = 0;
-					offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, rscs.descriptorSets->get("offscreen.scene"), nullptr);
-
-
-					//uint32_t offset1 = model->matrixIndex * alignedMatrixSize;
-					uint32_t offset1 = model->matrixIndex * static_cast<uint32_t>(alignedMatrixSize);
-					setNum = 1;
-					offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, 1, &rscs.descriptorSets->get("offscreen.matrix"), 1, &offset1);
-
-
-					// if we just bound this texture don't bind it again (this could be further optimized by ordering by textures used)
-					if (lastMaterialName != meshBuffer->materialName) {
-
-						lastMaterialName = meshBuffer->materialName;
-
-						vkx::Material m = this->assetManager.materials.get(meshBuffer->materialName);
-						//uint32_t materialIndex = this->assetManager.materials.get(mesh.meshBuffer.materialName).index;
-
-
-						//uint32_t offset2 = m.index * static_cast<uint32_t>(alignedMaterialSize);
-						// the third param is the set number!
-						//setNum = 2;
-						//offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayouts.offscreen, setNum, 1, &descriptorSets[setNum], 1, &offset2);
-
-
-						// bind material descriptor set containing texture:
-						// todo: implement a better way to bind textures
-
-						setNum = 2;
-						offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, m.descriptorSet, nullptr);
-					}
-
-
-					// draw:
-					offscreenCmdBuffer.drawIndexed(meshBuffer->indexCount, 1, 0, 0, 0);
+					// looked up by reference, materials hold shared_ptrs to their textures
+					const vkx::Material &m = this->assetManager.materials.resources[meshBuffer->materialName];
+
+					vkx::DrawCommand command;
+					command.pipeline = meshPipeline;
+					command.materialSet = m.descriptorSet;
+					command.materialIndex = m.index;
+					command.meshBuffer = meshBuffer.get();
+					// position and attribute streams
+					command.firstBinding = meshBuffer->vertexBufferBinding;
+					command.streamCount = 2;
+					// compacted indices from the meshlet cull pass (if this mesh was culled)
+					command.culled = settings.meshletCulling ? meshletCuller.get(model.get(), meshBuffer.get()) : nullptr;
+					command.pushConstants = { meshBuffer->positionCenter, meshBuffer->positionExtent, model->matrixIndex };
+					offscreenDrawList.add(command, depth);
 				}
 
 			}
 
 
 
-
-
-
-
-
-
-
-
-
-
-
 			// SKINNED MESHES:
 
-			// bind skinned mesh pipeline
-			if (settings.SSAO) {
-				offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("offscreen.skinnedMeshes.ssao"));
-			} else {
-				offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("offscreen.skinnedMeshes"));
-			}
 			for (auto &skinnedMesh : skinnedMeshesDeferred) {
-				// bind vertex & index buffers
-				offscreenCmdBuffer.bindVertexBuffers(skinnedMesh->vertexBufferBinding, skinnedMesh->meshBuffer->vertices.buffer, vk::DeviceSize());
-				offscreenCmdBuffer.bindIndexBuffer(skinnedMesh->meshBuffer->indices.buffer, 0, vk::IndexType::eUint32);
-
-				// descriptor set #
-				uint32_t setNum;
-
-				// bind scene descriptor set
-				// Set 0: Binding 0:
-				setNum = 0;
-				offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, rscs.descriptorSets->get("offscreen.scene"), nullptr);
-
-				// there is a bone uniform, set: 0, binding: 1
-
-
-				// Set 1: Binding 0:
-				uint32_t offset1 = skinnedMesh->matrixIndex * static_cast<uint32_t>(alignedMatrixSize);
-				setNum = 1;
-				offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, 1, &rscs.descriptorSets->get("offscreen.matrix"), 1, &offset1);
-
-
-				// if we just bound this texture don't bind it again (this could be further optimized by ordering by textures used)
-				if (lastMaterialName != skinnedMesh->meshBuffer->materialName) {
-					lastMaterialName = skinnedMesh->meshBuffer->materialName;
-					vkx::Material m = this->assetManager.materials.get(skinnedMesh->meshBuffer->materialName);
 
-
-					// bind texture:
-					// Set 2: Binding 0:
-					setNum = 2;
-					offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen"), setNum, m.descriptorSet, nullptr);
-				}
-
-
-				// draw:
-				offscreenCmdBuffer.drawIndexed(skinnedMesh->meshBuffer->indexCount, 1, 0, 0, 0);
+				const vkx::MeshBuffer *meshBuffer = skinnedMesh->meshBuffer.get();
+				const vkx::Material &m = this->assetManager.materials.resources[meshBuffer->materialName];
+
+				vkx::DrawCommand command;
+				command.pipeline = skinnedMeshPipeline;
+				command.materialSet = m.descriptorSet;
+				command.materialIndex = m.index;
+				command.meshBuffer = meshBuffer;
+				command.firstBinding = skinnedMesh->vertexBufferBinding;
+				command.streamCount = 1;
+				command.pushConstants = { meshBuffer->positionCenter, meshBuffer->positionExtent, skinnedMesh->matrixIndex };
+				offscreenDrawList.add(command, viewDepth(skinnedMesh->transfMatrix));
 			}
 
+			offscreenDrawList.record(offscreenCmdBuffer);
+
 
 
 
@@ -3819,7 +4122,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 			offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen.ssaoGenerate"), 0, 1, rscs.descriptorSets->getPtr("offscreen.ssao.generate"), 0, nullptr);
-			offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("ssao.generate"));
+			offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineBatch.get("ssao.generate"));
 			offscreenCmdBuffer.draw(3, 1, 0, 0);
 
 
@@ -3855,7 +4158,7 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 			offscreenCmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rscs.pipelineLayouts->get("offscreen.ssaoBlur"), 0, 1, rscs.descriptorSets->getPtr("offscreen.ssao.blur"), 0, nullptr);
-			offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rscs.pipelines->get("ssao.blur"));
+			offscreenCmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineBatch.get("ssao.blur"));
 			offscreenCmdBuffer.draw(3, 1, 0, 0);
 
 			offscreenCmdBuffer.endRenderPass();
@@ -3969,8 +4272,7 @@ class VulkanExample : public vkx::vulkanApp {
 				indexBuffer.push_back(i * 4 + index);
 			}
 		}
-		meshBuffers.quad.indexCount = indexBuffer.size();
-		meshBuffers.quad.indices = context.stageToDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer);
+		vkx::stageIndexBuffer(&context, vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer, meshBuffers.quad);
 	}
 
 
@@ -3992,12 +4294,14 @@ class VulkanExample : public vkx::vulkanApp {
 
 		vulkanApp::prepare();
 		offscreen.prepare();
+		startupTimeline.mark("swapchain/targets");
 
 		//offscreen.depthFinalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
 		//OffscreenExampleBase::prepare();
 
 		loadTextures();
+		startupTimeline.mark("textures");
 		generateQuads();
 
 
@@ -4005,24 +4309,46 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 
+		// before the descriptor set / pipeline layouts, they depend on whether the table is supported
+		materialTable.prepare(&context);
+
+		// models loaded from here on stream their textures
+		textureStreamer.prepare(&context, textureLoader, &assetManager, &materialTable);
+		assetManager.textureStreamer = &textureStreamer;
+
+		meshResidency.prepare(&context, &assetManager);
+		assetManager.meshResidency = &meshResidency;
+
 		prepareUniformBuffers();
 		prepareUniformBuffersDeferred();
 
 		prepareDescriptorSetLayouts();
 		prepareDescriptorPools();
 		prepareDescriptorSets();
+		startupTimeline.mark("buffers/descriptors");
+
+		// shader module loading is counted apart from pipeline creation
+		double shaderLoadTimeMS = context.shaderLoadTimeMS;
 
 		preparePipelines();
 		prepareDeferredPipelines();
 
+		// g-buffer meshlet culling, uses the same matrix buffer as the offscreen pass
+		meshletCuller.prepare(&context, getAssetPath() + "shaders/vulkanscene/ssao/meshletCull.comp.spv", uniformData.matrixVS.descriptor);
+
+		startupTimeline.add("shaders", context.shaderLoadTimeMS - shaderLoadTimeMS);
+		startupTimeline.mark("pipelines");
+
 
 		{
 			imGui = new ImGUI(&context);
 			imGui->init((float)settings.windowSize.width, (float)settings.windowSize.height);
 			imGui->initResources(renderPass, context.queue);
 		}
+		startupTimeline.mark("gui");
 
 		start();
+		startupTimeline.mark("models");
 
 		updateWorld();
 		if (TEST_DEFINE) {
@@ -4032,8 +4358,9 @@ class VulkanExample : public vkx::vulkanApp {
 		}
 
 		buildOffscreenCommandBuffer();
+		startupTimeline.mark("command buffers");
 
-
+		startupTimeline.print(context.pipelineCacheLoaded);
 
 		prepared = true;
 	}
@@ -4045,6 +4372,7 @@ class VulkanExample : public vkx::vulkanApp {
 			}
 		}
 
+		updateDeferredUniforms();
 		buildDrawCommandBuffers();
 
 		prepareFrame();
@@ -4097,9 +4425,16 @@ class VulkanExample : public vkx::vulkanApp {
 			//submitInfo.pCommandBuffers = &primaryCmdBuffers[currentBuffer];
 			submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
+			// what was trashed since the last frame (evicted meshes) is destroyed once this frame is done
+			vk::Fence dumpsterFence;
+			if (!context.dumpster.empty()) {
+				dumpsterFence = context.device.createFence(vk::FenceCreateInfo());
+				context.emptyDumpster(dumpsterFence);
+			}
+
 			// Submit
 			//queue.submit(submitInfo, deferredFence);
-			context.queue.submit(submitInfo, nullptr);
+			context.queue.submit(submitInfo, dumpsterFence);
 		}
 
 
@@ -4124,6 +4459,8 @@ class VulkanExample : public vkx::vulkanApp {
 
 
 		submitFrame();
+
+		context.recycle();
 	}
 
 
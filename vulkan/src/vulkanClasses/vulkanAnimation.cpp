@@ -0,0 +1,161 @@
+#include "vulkanAnimation.h"
+#include "vulkanAssetManager.h"
+
+#include <algorithm>
+
+namespace vkx {
+
+
+	// the key to interpolate from: keys[index].mTime <= time < keys[index + 1].mTime, clamped to the first and the last pair
+	template <typename Key>
+	static uint32_t findKey(const Key *keys, uint32_t count, float time, uint32_t &cursor) {
+
+		if (count < 2) {
+			return 0;
+		}
+
+		// the same pair as last time or the next one
+		if (cursor + 1 < count && (float)keys[cursor].mTime <= time) {
+			if (time < (float)keys[cursor + 1].mTime) {
+				return cursor;
+			}
+			if (cursor + 2 < count && time < (float)keys[cursor + 2].mTime) {
+				return ++cursor;
+			}
+		}
+
+		const Key *next = std::upper_bound(keys, keys + count, time, [](float t, const Key &key) {
+			return t < (float)key.mTime;
+		});
+		uint32_t index = (uint32_t)(next - keys);
+		index = index ? index - 1 : 0;
+		cursor = std::min(index, count - 2);
+		return cursor;
+	}
+
+	template <typename Key>
+	static float keyDelta(const Key &current, const Key &next, float time) {
+		float span = (float)(next.mTime - current.mTime);
+		if (span <= 0.0f) {
+			return 0.0f;
+		}
+		return std::min(std::max((time - (float)current.mTime) / span, 0.0f), 1.0f);
+	}
+
+
+
+	void AnimationRuntime::flatten(const aiNode *node, int32_t parent) {
+
+		Node flat;
+		flat.parent = parent;
+		flat.channel = -1;
+		flat.bone = -1;
+		flat.transformation = node->mTransformation;
+		flat.source = node;
+
+		int32_t index = (int32_t)this->nodes.size();
+		this->nodes.push_back(flat);
+
+		for (uint32_t i = 0; i < node->mNumChildren; ++i) {
+			flatten(node->mChildren[i], index);
+		}
+	}
+
+
+
+	void AnimationRuntime::bind(const aiScene *scene, const aiAnimation *animation, const BoneMapping &boneMapping, const std::vector<BoneInfo> &boneInfo) {
+
+		if (this->scene != scene) {
+			this->scene = scene;
+			this->nodes.clear();
+			flatten(scene->mRootNode, -1);
+			this->globals.resize(this->nodes.size());
+		}
+
+		this->animation = animation;
+
+		this->channels.clear();
+		this->channels.reserve(animation->mNumChannels);
+
+		this->boneOffsets.resize(boneInfo.size());
+		for (size_t i = 0; i < boneInfo.size(); ++i) {
+			this->boneOffsets[i] = boneInfo[i].offset;
+		}
+
+		for (auto &node : this->nodes) {
+			const aiString &name = node.source->mName;
+
+			node.channel = -1;
+			for (uint32_t i = 0; i < animation->mNumChannels; ++i) {
+				if (animation->mChannels[i]->mNodeName == name) {
+					Channel channel;
+					channel.nodeAnim = animation->mChannels[i];
+					node.channel = (int32_t)this->channels.size();
+					this->channels.push_back(channel);
+					break;
+				}
+			}
+
+			auto bone = boneMapping.find(name.data);
+			node.bone = bone != boneMapping.end() ? (int32_t)bone->second : -1;
+		}
+	}
+
+
+
+	aiMatrix4x4 AnimationRuntime::sample(Channel &channel, float time) const {
+
+		const aiNodeAnim *nodeAnim = channel.nodeAnim;
+
+		aiVector3D position = nodeAnim->mPositionKeys[0].mValue;
+		if (nodeAnim->mNumPositionKeys > 1) {
+			uint32_t i = findKey(nodeAnim->mPositionKeys, nodeAnim->mNumPositionKeys, time, channel.positionCursor);
+			const aiVectorKey &current = nodeAnim->mPositionKeys[i];
+			const aiVectorKey &next = nodeAnim->mPositionKeys[i + 1];
+			position = current.mValue + keyDelta(current, next, time) * (next.mValue - current.mValue);
+		}
+
+		aiQuaternion rotation = nodeAnim->mRotationKeys[0].mValue;
+		if (nodeAnim->mNumRotationKeys > 1) {
+			uint32_t i = findKey(nodeAnim->mRotationKeys, nodeAnim->mNumRotationKeys, time, channel.rotationCursor);
+			const aiQuatKey &current = nodeAnim->mRotationKeys[i];
+			const aiQuatKey &next = nodeAnim->mRotationKeys[i + 1];
+			aiQuaternion::Interpolate(rotation, current.mValue, next.mValue, keyDelta(current, next, time));
+			rotation.Normalize();
+		}
+
+		aiVector3D scaling = nodeAnim->mScalingKeys[0].mValue;
+		if (nodeAnim->mNumScalingKeys > 1) {
+			uint32_t i = findKey(nodeAnim->mScalingKeys, nodeAnim->mNumScalingKeys, time, channel.scalingCursor);
+			const aiVectorKey &current = nodeAnim->mScalingKeys[i];
+			const aiVectorKey &next = nodeAnim->mScalingKeys[i + 1];
+			scaling = current.mValue + keyDelta(current, next, time) * (next.mValue - current.mValue);
+		}
+
+		// translation * rotation * scale, as separate matrices
+		// (assimp's scaling / rotation / position constructor scales the rotation rows, which skews non-uniform scales)
+		aiMatrix4x4 translationMatrix;
+		aiMatrix4x4::Translation(position, translationMatrix);
+		aiMatrix4x4 scalingMatrix;
+		aiMatrix4x4::Scaling(scaling, scalingMatrix);
+		return translationMatrix * aiMatrix4x4(rotation.GetMatrix()) * scalingMatrix;
+	}
+
+
+
+	void AnimationRuntime::evaluate(float time, const aiMatrix4x4 &globalInverseTransform, std::vector<aiMatrix4x4> &boneTransforms) {
+
+		// parents come first, their transforms are ready when the children get to them
+		for (size_t i = 0; i < this->nodes.size(); ++i) {
+			const Node &node = this->nodes[i];
+
+			aiMatrix4x4 local = node.channel >= 0 ? sample(this->channels[node.channel], time) : node.transformation;
+			this->globals[i] = node.parent >= 0 ? this->globals[node.parent] * local : local;
+
+			if (node.bone >= 0 && (size_t)node.bone < boneTransforms.size()) {
+				boneTransforms[node.bone] = globalInverseTransform * this->globals[i] * this->boneOffsets[node.bone];
+			}
+		}
+	}
+
+}
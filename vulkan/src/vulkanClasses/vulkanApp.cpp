@@ -37,6 +37,7 @@ vulkanApp::vulkanApp(bool enableValidation) : swapChain(this->context) {
 	#if !defined(__ANDROID__)
 		// Android Vulkan initialization is handled in APP_CMD_INIT_WINDOW event
 		initVulkan(enableValidation);
+		startupTimeline.mark("instance/device");
 	#endif
 }
 
@@ -1066,6 +1067,8 @@ void vulkanApp::renderLoop() {
 
 		// start of frame
 		tFrameStart = std::chrono::high_resolution_clock::now();
+		// nothing from the last frame's arena is alive anymore
+		vkx::beginFrameAllocations();
 
 
 		// poll keyboard / mouse
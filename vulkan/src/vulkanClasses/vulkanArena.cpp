@@ -0,0 +1,176 @@
+#include "vulkanArena.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace vkx {
+
+
+	Arena::Arena(size_t blockSize) : blockSize(blockSize) {}
+
+
+
+	void *Arena::allocate(size_t size, size_t alignment) {
+
+		if (size == 0) {
+			size = 1;
+		}
+
+		for (;;) {
+			if (this->current < this->blocks.size()) {
+				Block &block = this->blocks[this->current];
+				uintptr_t base = (uintptr_t)block.data.get();
+				uintptr_t aligned = (base + this->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+				size_t offset = (size_t)(aligned - base);
+				if (offset + size <= block.size) {
+					this->used = offset + size;
+					this->highWater = std::max(this->highWater, bytesUsed());
+					return (void*)aligned;
+				}
+				// doesn't fit, the rest of this block is skipped
+				this->usedBefore += this->used;
+				this->current++;
+				this->used = 0;
+				continue;
+			}
+
+			Block block;
+			block.size = std::max(this->blockSize, size + alignment);
+			block.data.reset(new uint8_t[block.size]);
+			this->blocks.push_back(std::move(block));
+		}
+	}
+
+
+
+	Arena::Marker Arena::mark() const {
+		Marker marker;
+		marker.block = this->current;
+		marker.used = this->used;
+		marker.usedBefore = this->usedBefore;
+		return marker;
+	}
+
+	void Arena::rewind(const Marker &marker) {
+		this->current = marker.block;
+		this->used = marker.used;
+		this->usedBefore = marker.usedBefore;
+	}
+
+	void Arena::reset() {
+		this->current = 0;
+		this->used = 0;
+		this->usedBefore = 0;
+	}
+
+	size_t Arena::capacity() const {
+		size_t size = 0;
+		for (auto &block : this->blocks) {
+			size += block.size;
+		}
+		return size;
+	}
+
+
+
+	Arena &frameArena() {
+		static Arena arena;
+		return arena;
+	}
+
+	Arena &scratchArena() {
+		static thread_local Arena arena;
+		return arena;
+	}
+
+	ScratchScope::ScratchScope() {
+		this->marker = scratchArena().mark();
+	}
+
+	ScratchScope::~ScratchScope() {
+		scratchArena().rewind(this->marker);
+	}
+
+
+
+	static std::atomic<uint64_t> heapAllocations{ 0 };
+	static uint64_t frameStartHeapAllocations = 0;
+	static FrameAllocations lastFrame;
+
+	void beginFrameAllocations() {
+		Arena &arena = frameArena();
+		uint64_t count = heapAllocations.load(std::memory_order_relaxed);
+
+		lastFrame.heapAllocations = count - frameStartHeapAllocations;
+		lastFrame.frameArenaBytes = arena.bytesUsed();
+		lastFrame.frameArenaCapacity = arena.capacity();
+
+		frameStartHeapAllocations = count;
+		arena.reset();
+	}
+
+	const FrameAllocations &lastFrameAllocations() {
+		return lastFrame;
+	}
+
+	uint64_t heapAllocationCount() {
+		return heapAllocations.load(std::memory_order_relaxed);
+	}
+
+}
+
+
+
+#if ARENA_COUNT_HEAP_ALLOCATIONS
+
+// counts every allocation of the process that goes through operator new (all threads, not only the frame loop's)
+
+void *operator new(size_t size) {
+	vkx::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void *pointer = malloc(size ? size : 1);
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+	vkx::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept {
+	free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t&) noexcept {
+	free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t&) noexcept {
+	free(pointer);
+}
+
+#endif
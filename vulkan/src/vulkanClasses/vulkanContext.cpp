@@ -10,6 +10,20 @@ thread_local vk::CommandPool Context::s_cmdPool;
 
 std::list<std::string> Context::requestedLayers{ { "VK_LAYER_LUNARG_standard_validation" } };
 
+// the bundled headers predate VK_EXT_memory_budget
+#ifndef VK_EXT_memory_budget
+#define VK_EXT_MEMORY_BUDGET_EXTENSION_NAME "VK_EXT_memory_budget"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT ((VkStructureType)1000237000)
+typedef struct VkPhysicalDeviceMemoryBudgetPropertiesEXT {
+	VkStructureType sType;
+	void* pNext;
+	VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryBudgetPropertiesEXT;
+#endif
+
+static PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+
 std::set<std::string> vkx::Context::getAvailableLayers() {
 	std::set<std::string> result;
 	auto layers = vk::enumerateInstanceLayerProperties();
@@ -29,6 +43,8 @@ void vkx::Context::createContext(bool enableValidation) {
 		requireExtension(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 	}
 
+	bool physicalDeviceProperties2 = false;
+
 	{
 		// Vulkan instance
 		vk::ApplicationInfo appInfo;
@@ -42,6 +58,16 @@ void vkx::Context::createContext(bool enableValidation) {
 			enabledExtensions.push_back(extension.c_str());
 		}
 
+		// needed to query VK_EXT_memory_budget
+		for (const auto& extension : vk::enumerateInstanceExtensionProperties()) {
+			if (!strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+				if (!requiredExtensions.count(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+					enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				}
+				physicalDeviceProperties2 = true;
+			}
+		}
+
 		// Enable surface extensions depending on os
 		#if defined(_WIN32)
 		enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
@@ -113,6 +139,14 @@ void vkx::Context::createContext(bool enableValidation) {
 			enabledExtensions.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
 			enableDebugMarkers = true;
 		}
+		// heap budget / usage for the texture streamer
+		if (physicalDeviceProperties2 && vkx::checkDeviceExtensionPresent(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+			getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)instance.getProcAddr("vkGetPhysicalDeviceMemoryProperties2KHR");
+			if (getPhysicalDeviceMemoryProperties2) {
+				enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				enableMemoryBudget = true;
+			}
+		}
 		if (enabledExtensions.size() > 0) {
 			deviceCreateInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
 			deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
@@ -131,7 +165,7 @@ void vkx::Context::createContext(bool enableValidation) {
 	if (enableDebugMarkers) {
 		debug::marker::setup(device);
 	}
-	pipelineCache = device.createPipelineCache(vk::PipelineCacheCreateInfo());
+	loadPipelineCache();
 	// Find a queue that supports graphics operations
 	graphicsQueueIndex = findQueue(vk::QueueFlagBits::eGraphics);
 	// Get the graphics queue
@@ -139,6 +173,50 @@ void vkx::Context::createContext(bool enableValidation) {
 
 }
 
+bool vkx::Context::getMemoryBudget(vk::DeviceSize & budget, vk::DeviceSize & usage) const {
+	budget = 0;
+	usage = 0;
+
+	if (!enableMemoryBudget) {
+		for (uint32_t i = 0; i < deviceMemoryProperties.memoryHeapCount; i++) {
+			if (deviceMemoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+				budget += deviceMemoryProperties.memoryHeaps[i].size;
+			}
+		}
+		return false;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget = {};
+	memoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2KHR memoryProperties = {};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memoryProperties.pNext = &memoryBudget;
+	getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++) {
+		if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			budget += memoryBudget.heapBudget[i];
+			usage += memoryBudget.heapUsage[i];
+		}
+	}
+	return true;
+}
+
+MemoryStats vkx::Context::getMemoryStats() const {
+	return memory::stats();
+}
+
+bool vkx::Context::dumpMemoryStats(const std::string & fileName) const {
+	std::ofstream file(fileName);
+	file << memory::toJson(deviceMemoryProperties);
+	if (!file.good()) {
+		printf("Warning: couldn't write %s\n", fileName.c_str());
+		return false;
+	}
+	printf("Memory stats written to %s\n", fileName.c_str());
+	return true;
+}
+
 void vkx::Context::destroyContext() {
 	queue.waitIdle();
 	device.waitIdle();
@@ -151,8 +229,15 @@ void vkx::Context::destroyContext() {
 		recycle();
 	}
 
+	for (auto &sampler : samplerCache) {
+		device.destroySampler(sampler.second);
+	}
+	samplerCache.clear();
+
 	destroyCommandPool();
+	savePipelineCache();
 	device.destroyPipelineCache(pipelineCache);
+	shader::finalizeGlsl();
 	device.destroy();
 
 	if (enableValidation) {
@@ -162,6 +247,148 @@ void vkx::Context::destroyContext() {
 	instance.destroy();
 }
 
+// header of the pipeline cache file, followed by dataSize bytes of vkGetPipelineCacheData output
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+};
+
+// "VKPC"
+#define PIPELINE_CACHE_FILE_MAGIC 0x43504B56
+#define PIPELINE_CACHE_FILE_VERSION 1
+
+// the header vulkan puts at the start of the cache data
+struct PipelineCacheDataHeader {
+	uint32_t length;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+
+
+std::string vkx::Context::pipelineCacheFileName() const {
+	char name[64];
+	snprintf(name, sizeof(name), "pipelinecache_%04x_%04x_%08x.bin", deviceProperties.vendorID, deviceProperties.deviceID, deviceProperties.driverVersion);
+	if (pipelineCacheDirectory.empty()) {
+		return name;
+	}
+	return pipelineCacheDirectory + "/" + name;
+}
+
+
+
+void vkx::Context::loadPipelineCache() {
+
+	pipelineCacheLoaded = false;
+
+	std::vector<uint8_t> data;
+	std::string fileName = pipelineCacheFileName();
+
+	std::ifstream file(fileName, std::ios::binary);
+	if (persistPipelineCache && file.good()) {
+
+		// the file name already has the ids in it, the headers catch stale / copied / truncated files
+		PipelineCacheFileHeader header;
+		const char *error = nullptr;
+
+		// the data size in the header is checked against this before anything is allocated for it
+		file.seekg(0, std::ios::end);
+		uint64_t fileSize = (uint64_t)file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+			error = "truncated header";
+		} else if (header.magic != PIPELINE_CACHE_FILE_MAGIC || header.version != PIPELINE_CACHE_FILE_VERSION) {
+			error = "unknown format";
+		} else if (header.vendorID != deviceProperties.vendorID || header.deviceID != deviceProperties.deviceID || header.driverVersion != deviceProperties.driverVersion) {
+			error = "different device or driver";
+		} else if (memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			error = "different pipeline cache uuid";
+		} else if (header.dataSize < sizeof(PipelineCacheDataHeader)) {
+			error = "no data";
+		} else if (header.dataSize > fileSize - sizeof(header)) {
+			error = "truncated data";
+		} else {
+			data.resize((size_t)header.dataSize);
+			if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+				error = "truncated data";
+			} else {
+				PipelineCacheDataHeader dataHeader;
+				memcpy(&dataHeader, data.data(), sizeof(dataHeader));
+				if (dataHeader.version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || dataHeader.length < sizeof(dataHeader) ||
+					dataHeader.vendorID != deviceProperties.vendorID || dataHeader.deviceID != deviceProperties.deviceID ||
+					memcmp(dataHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+					error = "invalid cache data";
+				}
+			}
+		}
+
+		if (error) {
+			printf("Ignoring pipeline cache %s: %s\n", fileName.c_str(), error);
+			data.clear();
+		}
+	}
+
+	vk::PipelineCacheCreateInfo pipelineCacheCreateInfo;
+	pipelineCacheCreateInfo.initialDataSize = data.size();
+	pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+	pipelineCache = device.createPipelineCache(pipelineCacheCreateInfo);
+
+	pipelineCacheLoaded = !data.empty();
+	if (pipelineCacheLoaded) {
+		printf("Loaded pipeline cache %s (%d bytes)\n", fileName.c_str(), (int)data.size());
+	}
+}
+
+
+
+void vkx::Context::savePipelineCache() const {
+
+	if (!persistPipelineCache || !pipelineCache) {
+		return;
+	}
+
+	std::vector<uint8_t> data = device.getPipelineCacheData(pipelineCache);
+	if (data.empty()) {
+		return;
+	}
+
+	PipelineCacheFileHeader header;
+	header.magic = PIPELINE_CACHE_FILE_MAGIC;
+	header.version = PIPELINE_CACHE_FILE_VERSION;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+
+	// written next to the old file and swapped in, so a crash while saving doesn't leave a broken cache behind
+	std::string fileName = pipelineCacheFileName();
+	std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.good()) {
+			printf("Error: couldn't write pipeline cache %s\n", tempFileName.c_str());
+			return;
+		}
+	}
+	std::remove(fileName.c_str());
+	if (std::rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+		printf("Error: couldn't replace pipeline cache %s\n", fileName.c_str());
+	}
+}
+
+
+
 uint32_t vkx::Context::findQueue(const vk::QueueFlags & flags, const vk::SurfaceKHR & presentSurface) const {
 	std::vector<vk::QueueFamilyProperties> queueProps = physicalDevice.getQueueFamilyProperties();
 	size_t queueCount = queueProps.size();
@@ -309,17 +536,62 @@ CreateImageResult vkx::Context::createImage(const vk::ImageCreateInfo & imageCre
 	result.device = device;
 	result.image = device.createImage(imageCreateInfo);
 	result.format = imageCreateInfo.format;
+	result.extent = imageCreateInfo.extent;
 	vk::MemoryRequirements memReqs = device.getImageMemoryRequirements(result.image);
 	vk::MemoryAllocateInfo memAllocInfo;
 	memAllocInfo.allocationSize = result.allocSize = memReqs.size;
 	memAllocInfo.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-	result.memory = device.allocateMemory(memAllocInfo);
+	MemoryCategory category = memory::currentCategory(memory::imageCategory(imageCreateInfo.usage));
+	result.memory = memory::allocateMemory(device, memAllocInfo, category);
+	if (debug::marker::active) {
+		debug::marker::setImageName(device, result.image, memory::currentName(category));
+	}
 	device.bindImageMemory(result.image, result.memory, 0);
 	return result;
 }
 
+static inline void hashCombine(size_t &seed, size_t value) {
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t vkx::SamplerCreateInfoHash::operator()(const vk::SamplerCreateInfo &info) const {
+	std::hash<uint32_t> hashInt;
+	std::hash<float> hashFloat;
+	size_t seed = hashInt((uint32_t)(VkSamplerCreateFlags)info.flags);
+	hashCombine(seed, hashInt((uint32_t)info.magFilter));
+	hashCombine(seed, hashInt((uint32_t)info.minFilter));
+	hashCombine(seed, hashInt((uint32_t)info.mipmapMode));
+	hashCombine(seed, hashInt((uint32_t)info.addressModeU));
+	hashCombine(seed, hashInt((uint32_t)info.addressModeV));
+	hashCombine(seed, hashInt((uint32_t)info.addressModeW));
+	hashCombine(seed, hashFloat(info.mipLodBias));
+	hashCombine(seed, hashInt(info.anisotropyEnable));
+	hashCombine(seed, hashFloat(info.maxAnisotropy));
+	hashCombine(seed, hashInt(info.compareEnable));
+	hashCombine(seed, hashInt((uint32_t)info.compareOp));
+	hashCombine(seed, hashFloat(info.minLod));
+	hashCombine(seed, hashFloat(info.maxLod));
+	hashCombine(seed, hashInt((uint32_t)info.borderColor));
+	hashCombine(seed, hashInt(info.unnormalizedCoordinates));
+	return seed;
+}
+
+vk::Sampler vkx::Context::getSampler(const vk::SamplerCreateInfo & samplerCreateInfo) const {
+	auto cached = samplerCache.find(samplerCreateInfo);
+	if (cached != samplerCache.end()) {
+		return cached->second;
+	}
+	vk::Sampler sampler = device.createSampler(samplerCreateInfo);
+	samplerCache[samplerCreateInfo] = sampler;
+	return sampler;
+}
+
 CreateImageResult vkx::Context::stageToDeviceImage(vk::ImageCreateInfo imageCreateInfo, const vk::MemoryPropertyFlags & memoryPropertyFlags, vk::DeviceSize size, const void * data, const std::vector<MipData>& mipData) const {
-	CreateBufferResult staging = createBuffer(vk::BufferUsageFlagBits::eTransferSrc, size, data);
+	CreateBufferResult staging;
+	{
+		memory::Scope scope(MEMORY_CATEGORY_STAGING);
+		staging = createBuffer(vk::BufferUsageFlagBits::eTransferSrc, size, data);
+	}
 	imageCreateInfo.usage = imageCreateInfo.usage | vk::ImageUsageFlagBits::eTransferDst;
 	CreateImageResult result = createImage(imageCreateInfo, memoryPropertyFlags);
 
@@ -381,7 +653,11 @@ CreateBufferResult vkx::Context::createBuffer(const vk::BufferUsageFlags & usage
 	vk::MemoryAllocateInfo memAlloc;
 	result.allocSize = memAlloc.allocationSize = memReqs.size;
 	memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-	result.memory = device.allocateMemory(memAlloc);
+	MemoryCategory category = memory::currentCategory(memory::bufferCategory(usageFlags, memoryPropertyFlags));
+	result.memory = memory::allocateMemory(device, memAlloc, category);
+	if (debug::marker::active) {
+		debug::marker::setBufferName(device, result.buffer, memory::currentName(category));
+	}
 	if (data != nullptr) {
 		copyToMemory(result.memory, data, size);
 	}
@@ -396,12 +672,34 @@ void vkx::Context::copyToMemory(const vk::DeviceMemory & memory, const void * da
 }
 
 CreateBufferResult vkx::Context::stageToDeviceBuffer(const vk::BufferUsageFlags & usage, size_t size, const void * data) const {
-	CreateBufferResult staging = createBuffer(vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible, size, data);
+	CreateBufferResult staging;
+	{
+		memory::Scope scope(MEMORY_CATEGORY_STAGING);
+		staging = createBuffer(vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible, size, data);
+	}
+	CreateBufferResult result = createBuffer(usage | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, size);
+	withPrimaryCommandBuffer([&](vk::CommandBuffer copyCmd) {
+		copyCmd.copyBuffer(staging.buffer, result.buffer, vk::BufferCopy(0, 0, size));
+	});
+	memory::freeMemory(device, staging.memory);
+	device.destroyBuffer(staging.buffer);
+	return result;
+}
+
+CreateBufferResult vkx::Context::stageToDeviceBuffer(const vk::BufferUsageFlags & usage, size_t size, const std::function<void(void*)> &fill) const {
+	CreateBufferResult staging;
+	{
+		memory::Scope scope(MEMORY_CATEGORY_STAGING);
+		staging = createBuffer(vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, size);
+	}
+	void *mapped = device.mapMemory(staging.memory, 0, size, vk::MemoryMapFlags());
+	fill(mapped);
+	device.unmapMemory(staging.memory);
 	CreateBufferResult result = createBuffer(usage | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, size);
 	withPrimaryCommandBuffer([&](vk::CommandBuffer copyCmd) {
 		copyCmd.copyBuffer(staging.buffer, result.buffer, vk::BufferCopy(0, 0, size));
 	});
-	device.freeMemory(staging.memory);
+	memory::freeMemory(device, staging.memory);
 	device.destroyBuffer(staging.buffer);
 	return result;
 }
@@ -440,6 +738,56 @@ inline vk::PipelineShaderStageCreateInfo vkx::Context::loadGlslShader(const std:
 	return shaderStage;
 }
 
+vk::PipelineShaderStageCreateInfo vkx::Context::compileShader(const std::string& fileName, vk::ShaderStageFlagBits stage, const shader::Defines& defines, const std::string& precompiledFileName) const {
+
+	std::string precompiled = precompiledFileName.empty() ? fileName + ".spv" : precompiledFileName;
+
+	std::string key = fileName;
+	for (auto &define : defines) {
+		key += "|" + define.first + "=" + define.second;
+	}
+
+	vk::PipelineShaderStageCreateInfo shaderStage;
+	shaderStage.stage = stage;
+	shaderStage.pName = "main";
+
+	auto cached = shaderModuleCache.find(key);
+	if (cached != shaderModuleCache.end()) {
+		shaderStage.module = cached->second;
+		return shaderStage;
+	}
+
+	#if defined(__ANDROID__)
+	return loadShader(precompiled, stage);
+	#else
+
+	if (!std::ifstream(fileName).good()) {
+		return loadShader(precompiled, stage);
+	}
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	shader::SpvBuffer spirv;
+	try {
+		spirv = shader::compileCached(stage, fileName, defines, spirvCacheDirectory);
+	} catch (std::runtime_error &error) {
+		// an edited shader that doesn't compile shouldn't stop the app if there's a .spv to fall back to
+		printf("%s\nUsing %s instead\n", error.what(), precompiled.c_str());
+		return loadShader(precompiled, stage);
+	}
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo;
+	moduleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+	moduleCreateInfo.pCode = spirv.data();
+	shaderStage.module = device.createShaderModule(moduleCreateInfo);
+
+	shaderModules.push_back(shaderStage.module);
+	shaderModuleCache[key] = shaderStage.module;
+	shaderLoadTimeMS += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	return shaderStage;
+	#endif
+}
+
 void vkx::Context::submit(const vk::ArrayProxy<const vk::CommandBuffer>& commandBuffers, const vk::ArrayProxy<const vk::Semaphore>& wait, const vk::ArrayProxy<const vk::PipelineStageFlags>& waitStages, const vk::ArrayProxy<const vk::Semaphore>& signals, const vk::Fence & fence) {
 	vk::SubmitInfo info;
 	info.commandBufferCount = commandBuffers.size();
@@ -508,7 +856,7 @@ void vkx::Context::createBuffer(vk::BufferUsageFlags usageFlags, vk::MemoryPrope
 	memAlloc.allocationSize = memReqs.size;
 	// Find a memory type index that fits the properties of the buffer
 	memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-	device.allocateMemory(&memAlloc, nullptr, memory);
+	*memory = memory::allocateMemory(device, memAlloc, memory::bufferCategory(usageFlags, memoryPropertyFlags));
 
 	// If a pointer to the buffer data has been passed, map the buffer and copy over the data
 	if (data != nullptr) {
@@ -566,7 +914,11 @@ void vkx::Context::createBuffer(vk::BufferUsageFlags usageFlags, vk::MemoryPrope
 	memAlloc.allocationSize = memReqs.size;
 	// Find a memory type index that fits the properties of the buffer
 	memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-	buffer->memory = device.allocateMemory(memAlloc, nullptr);
+	MemoryCategory category = memory::currentCategory(memory::bufferCategory(usageFlags, memoryPropertyFlags));
+	buffer->memory = memory::allocateMemory(device, memAlloc, category);
+	if (debug::marker::active) {
+		debug::marker::setBufferName(device, buffer->buffer, memory::currentName(category));
+	}
 
 	buffer->alignment = memReqs.alignment;
 	buffer->size = memAlloc.allocationSize;
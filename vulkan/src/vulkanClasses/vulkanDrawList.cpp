@@ -0,0 +1,172 @@
+#include "vulkanDrawList.h"
+
+#include <algorithm>
+
+namespace vkx {
+
+
+	void DrawList::reset(vk::PipelineLayout layout, vk::ShaderStageFlags pushStages, bool pushMaterialIndex) {
+		this->layout = layout;
+		this->pushStages = pushStages;
+		this->pushMaterialIndex = pushMaterialIndex;
+
+		this->commands.clear();
+		this->depths.clear();
+		this->pipelineIds.clear();
+		this->geometryIds.clear();
+
+		this->stats = DrawStats();
+	}
+
+
+
+	uint32_t DrawList::pipelineId(vk::Pipeline pipeline) {
+		auto it = this->pipelineIds.find(pipeline);
+		if (it != this->pipelineIds.end()) {
+			return it->second;
+		}
+		uint32_t id = std::min<uint32_t>((uint32_t)this->pipelineIds.size(), 0xFF);
+		this->pipelineIds[pipeline] = id;
+		return id;
+	}
+
+	uint32_t DrawList::geometryId(const MeshBuffer &meshBuffer) {
+		// meshes in the same pool block share their vertex buffers
+		vk::Buffer buffer = meshBuffer.geometry ? meshBuffer.pool->vertexBuffer(meshBuffer.geometry->block, 0) : meshBuffer.vertices.buffer;
+
+		auto it = this->geometryIds.find(buffer);
+		if (it != this->geometryIds.end()) {
+			return it->second;
+		}
+		uint32_t id = std::min<uint32_t>((uint32_t)this->geometryIds.size(), 0xFFFF);
+		this->geometryIds[buffer] = id;
+		return id;
+	}
+
+
+
+	void DrawList::add(const DrawCommand &command, float depth) {
+		this->commands.push_back(command);
+		this->depths.push_back(depth);
+	}
+
+
+
+	void DrawList::bindDescriptorSets(const vk::CommandBuffer &cmdBuffer, uint32_t firstSet, vk::ArrayProxy<const vk::DescriptorSet> sets) {
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->layout, firstSet, sets, nullptr);
+		this->stats.descriptorSets += sets.size();
+	}
+
+
+
+	// lsd radix sort on the keys, 8 bits per pass
+	// passes where every key has the same digit are skipped (most of them, the ids are small)
+	void DrawList::radixSort() {
+
+		size_t count = this->items.size();
+		this->scratch.resize(count);
+
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+
+			std::array<size_t, 256> offsets;
+			offsets.fill(0);
+			for (auto &item : this->items) {
+				offsets[(item.key >> shift) & 0xFF]++;
+			}
+			if (offsets[(this->items[0].key >> shift) & 0xFF] == count) {
+				continue;
+			}
+
+			size_t sum = 0;
+			for (auto &offset : offsets) {
+				size_t digitCount = offset;
+				offset = sum;
+				sum += digitCount;
+			}
+
+			for (auto &item : this->items) {
+				this->scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+			}
+			this->items.swap(this->scratch);
+		}
+	}
+
+
+
+	void DrawList::record(const vk::CommandBuffer &cmdBuffer) {
+
+		if (this->commands.empty()) {
+			return;
+		}
+
+
+		// depth buckets relative to the furthest draw
+		float maxDepth = *std::max_element(this->depths.begin(), this->depths.end());
+		float depthScale = maxDepth > 0.0f ? 65535.0f / maxDepth : 0.0f;
+
+		this->items.resize(this->commands.size());
+
+		for (uint32_t i = 0; i < this->commands.size(); ++i) {
+			const DrawCommand &command = this->commands[i];
+
+			uint64_t pipeline = pipelineId(command.pipeline);
+			uint64_t material = std::min<uint32_t>(command.materialIndex, 0xFFFF);
+			uint64_t geometry = geometryId(*command.meshBuffer);
+			uint64_t depth = (uint64_t)std::min(std::max(this->depths[i] * depthScale, 0.0f), 65535.0f);
+
+			// with the material table a material switch is just a push, so keep geometry blocks together instead
+			uint64_t stateA = this->pushMaterialIndex ? geometry : material;
+			uint64_t stateB = this->pushMaterialIndex ? material : geometry;
+
+			this->items[i].key = (pipeline << 56) | (stateA << 40) | (stateB << 24) | (depth << 8);
+			this->items[i].command = i;
+		}
+
+		radixSort();
+
+
+		vk::Pipeline boundPipeline;
+		vk::DescriptorSet boundMaterialSet;
+		MeshBufferBinding binding;
+
+		for (auto &item : this->items) {
+			const DrawCommand &command = this->commands[item.command];
+
+			if (command.pipeline != boundPipeline) {
+				cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, command.pipeline);
+				boundPipeline = command.pipeline;
+				this->stats.pipelines++;
+			}
+
+			if (!this->pushMaterialIndex && command.materialSet && command.materialSet != boundMaterialSet) {
+				cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->layout, 2, command.materialSet, nullptr);
+				boundMaterialSet = command.materialSet;
+				this->stats.descriptorSets++;
+			}
+
+			binding.bindVertices(cmdBuffer, *command.meshBuffer, command.firstBinding, command.streamCount);
+			if (command.culled) {
+				// the cull pass always writes 32 bit indices
+				binding.bindIndices(cmdBuffer, command.culled->indices.buffer, vk::IndexType::eUint32);
+			} else {
+				binding.bindIndices(cmdBuffer, *command.meshBuffer);
+			}
+
+			cmdBuffer.pushConstants(this->layout, this->pushStages, 0, sizeof(MeshPushConstants), &command.pushConstants);
+			if (this->pushMaterialIndex) {
+				cmdBuffer.pushConstants(this->layout, vk::ShaderStageFlagBits::eFragment, sizeof(MeshPushConstants), sizeof(uint32_t), &command.materialIndex);
+			}
+
+			if (command.culled) {
+				// the draw command carries the mesh's vertexOffset
+				cmdBuffer.drawIndexedIndirect(command.culled->drawCommand.buffer, 0, 1, sizeof(vk::DrawIndexedIndirectCommand));
+			} else {
+				cmdBuffer.drawIndexed(command.meshBuffer->indexCount, 1, command.meshBuffer->firstIndex(), command.meshBuffer->vertexOffset(), 0);
+			}
+			this->stats.draws++;
+		}
+
+		this->stats.buffers += binding.bindCount;
+	}
+
+}
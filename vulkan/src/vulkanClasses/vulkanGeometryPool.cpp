@@ -0,0 +1,453 @@
+#include "vulkanGeometryPool.h"
+
+#include <algorithm>
+
+namespace vkx {
+
+
+	static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static const vk::BufferUsageFlags vertexUsage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+	// the meshlet cull pass reads indices as a storage buffer
+	static const vk::BufferUsageFlags indexUsage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+
+	static uint32_t indexStride(vk::IndexType indexType) {
+		return indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+
+
+	GeometryRange::~GeometryRange() {
+		if (this->pool) {
+			this->pool->release(this);
+		}
+	}
+
+
+
+	void RangeAllocator::reset(vk::DeviceSize capacity, vk::DeviceSize usedEnd) {
+		this->capacity = capacity;
+		this->used = usedEnd;
+		this->freeRanges.clear();
+		if (usedEnd < capacity) {
+			this->freeRanges[usedEnd] = capacity - usedEnd;
+		}
+	}
+
+	bool RangeAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize &offset) {
+
+		for (auto it = this->freeRanges.begin(); it != this->freeRanges.end(); ++it) {
+			vk::DeviceSize start = alignUp(it->first, alignment);
+			vk::DeviceSize end = it->first + it->second;
+			if (start + size > end) {
+				continue;
+			}
+
+			vk::DeviceSize rangeStart = it->first;
+			this->freeRanges.erase(it);
+
+			// keep what's left on either side
+			if (start > rangeStart) {
+				this->freeRanges[rangeStart] = start - rangeStart;
+			}
+			if (start + size < end) {
+				this->freeRanges[start + size] = end - (start + size);
+			}
+
+			this->used += size;
+			offset = start;
+			return true;
+		}
+
+		return false;
+	}
+
+	void RangeAllocator::free(vk::DeviceSize offset, vk::DeviceSize size) {
+
+		if (size == 0) {
+			return;
+		}
+
+		this->used -= size;
+
+		auto it = this->freeRanges.emplace(offset, size).first;
+
+		// merge with the next range
+		auto next = std::next(it);
+		if (next != this->freeRanges.end() && it->first + it->second == next->first) {
+			it->second += next->second;
+			this->freeRanges.erase(next);
+		}
+
+		// and the previous one
+		if (it != this->freeRanges.begin()) {
+			auto prev = std::prev(it);
+			if (prev->first + prev->second == it->first) {
+				prev->second += it->second;
+				this->freeRanges.erase(it);
+			}
+		}
+	}
+
+
+
+	GeometryPool::GeometryPool(const vkx::Context *context, const std::vector<uint32_t> &strides) {
+		this->context = context;
+		this->strides = strides;
+		this->indexAlignment = std::max<vk::DeviceSize>(4, context->deviceProperties.limits.minStorageBufferOffsetAlignment);
+	}
+
+	GeometryPool::~GeometryPool() {
+		destroy();
+	}
+
+
+	GeometryPool::Block *GeometryPool::createBlock(uint32_t vertexCount, vk::DeviceSize indexSize) {
+
+		// a released block's slot, so the block numbers of the live ranges stay valid
+		Block *block = nullptr;
+		for (auto &released : this->blocks) {
+			if (released->streams.empty()) {
+				block = released.get();
+				break;
+			}
+		}
+		if (!block) {
+			this->blocks.push_back(std::unique_ptr<Block>(new Block()));
+			block = this->blocks.back().get();
+		}
+
+		for (auto stride : this->strides) {
+			block->streams.push_back(this->context->createBuffer(vertexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, (vk::DeviceSize)vertexCount * stride));
+		}
+
+		block->indices = this->context->createBuffer(indexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, indexSize);
+
+		block->vertexRanges.reset(vertexCount);
+		block->indexRanges.reset(indexSize);
+
+		return block;
+	}
+
+
+	std::shared_ptr<GeometryRange> GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, vk::IndexType indexType) {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		auto range = std::make_shared<GeometryRange>();
+		range->vertexCount = vertexCount;
+		range->indexCount = indexCount;
+		range->indexType = indexType;
+		range->indexSize = alignUp((vk::DeviceSize)indexCount * indexStride(indexType), 4);
+
+		bool found = false;
+
+		// first block with room for both
+		for (uint32_t b = 0; b < this->blocks.size() && !found; ++b) {
+			Block &block = *this->blocks[b];
+
+			vk::DeviceSize vertexOffset;
+			if (!block.vertexRanges.allocate(vertexCount, 1, vertexOffset)) {
+				continue;
+			}
+			vk::DeviceSize indexOffset;
+			if (!block.indexRanges.allocate(range->indexSize, this->indexAlignment, indexOffset)) {
+				block.vertexRanges.free(vertexOffset, vertexCount);
+				continue;
+			}
+
+			range->block = b;
+			range->vertexOffset = (uint32_t)vertexOffset;
+			range->indexOffset = indexOffset;
+			found = true;
+		}
+
+		// none of the blocks have room, start a new one (large enough for this mesh)
+		if (!found) {
+			Block *block = createBlock(
+				std::max<uint32_t>(vertexCount, GEOMETRY_POOL_BLOCK_VERTICES),
+				std::max<vk::DeviceSize>(range->indexSize, GEOMETRY_POOL_BLOCK_INDEX_SIZE));
+
+			vk::DeviceSize vertexOffset;
+			vk::DeviceSize indexOffset;
+			block->vertexRanges.allocate(vertexCount, 1, vertexOffset);
+			block->indexRanges.allocate(range->indexSize, this->indexAlignment, indexOffset);
+
+			for (uint32_t b = 0; b < this->blocks.size(); ++b) {
+				if (this->blocks[b].get() == block) {
+					range->block = b;
+				}
+			}
+			range->vertexOffset = (uint32_t)vertexOffset;
+			range->indexOffset = indexOffset;
+		}
+
+		range->firstIndex = (uint32_t)(range->indexOffset / indexStride(indexType));
+
+		range->pool = this;
+		this->ranges.insert(range.get());
+		return range;
+	}
+
+
+	void GeometryPool::release(GeometryRange *range) {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (this->ranges.erase(range) == 0) {
+			return;
+		}
+
+		Block &block = *this->blocks[range->block];
+		block.vertexRanges.free(range->vertexOffset, range->vertexCount);
+		block.indexRanges.free(range->indexOffset, range->indexSize);
+	}
+
+
+
+	void GeometryPool::upload(const GeometryRange &range, const std::function<void(void *vertices, void *indices)> &fill) {
+
+		vk::DeviceSize vertexSize = 0;
+		for (auto stride : this->strides) {
+			vertexSize += (vk::DeviceSize)range.vertexCount * stride;
+		}
+
+		vk::DeviceSize stagingSize = vertexSize + range.indexSize;
+		if (stagingSize == 0) {
+			return;
+		}
+
+		CreateBufferResult staging = this->context->createBuffer(
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			stagingSize);
+
+		uint8_t *mapped = (uint8_t*)this->context->device.mapMemory(staging.memory, 0, stagingSize, vk::MemoryMapFlags());
+		fill(mapped, mapped + vertexSize);
+		this->context->device.unmapMemory(staging.memory);
+
+		// the block can't change while we copy into it
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		const Block &block = *this->blocks[range.block];
+
+		this->context->withPrimaryCommandBuffer([&](vk::CommandBuffer copyCmd) {
+			vk::DeviceSize srcOffset = 0;
+			for (uint32_t s = 0; s < this->strides.size(); ++s) {
+				vk::DeviceSize size = (vk::DeviceSize)range.vertexCount * this->strides[s];
+				if (size > 0) {
+					copyCmd.copyBuffer(staging.buffer, block.streams[s].buffer, vk::BufferCopy(srcOffset, (vk::DeviceSize)range.vertexOffset * this->strides[s], size));
+				}
+				srcOffset += size;
+			}
+			if (range.indexSize > 0) {
+				copyCmd.copyBuffer(staging.buffer, block.indices.buffer, vk::BufferCopy(vertexSize, range.indexOffset, range.indexSize));
+			}
+		});
+
+		staging.destroy();
+	}
+
+
+
+	vk::DescriptorBufferInfo GeometryPool::indexDescriptor(const GeometryRange &range) const {
+		return vk::DescriptorBufferInfo(this->blocks[range.block]->indices.buffer, range.indexOffset, range.indexSize);
+	}
+
+
+
+	void GeometryPool::defragment() {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		// the blocks are read by command buffers that could still be in flight
+		this->context->device.waitIdle();
+
+		for (uint32_t b = 0; b < this->blocks.size(); ++b) {
+			Block &block = *this->blocks[b];
+
+			std::vector<GeometryRange*> blockRanges;
+			for (auto range : this->ranges) {
+				if (range->block == b) {
+					blockRanges.push_back(range);
+				}
+			}
+
+			// ranges are packed in vertex order
+			std::sort(blockRanges.begin(), blockRanges.end(), [](const GeometryRange *a, const GeometryRange *b) {
+				return a->vertexOffset < b->vertexOffset;
+			});
+
+			// nothing to do if every range is already where packing would put it
+			bool packed = true;
+			vk::DeviceSize vertexEnd = 0;
+			vk::DeviceSize indexEnd = 0;
+			for (auto range : blockRanges) {
+				indexEnd = alignUp(indexEnd, this->indexAlignment);
+				packed = packed && range->vertexOffset == vertexEnd && range->indexOffset == indexEnd;
+				vertexEnd += range->vertexCount;
+				indexEnd += range->indexSize;
+			}
+			if (packed) {
+				continue;
+			}
+
+			// copy into fresh buffers, vkCmdCopyBuffer regions in the same buffer can't overlap
+			std::vector<CreateBufferResult> streams;
+			for (auto &stream : block.streams) {
+				streams.push_back(this->context->createBuffer(vertexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, stream.size));
+			}
+			CreateBufferResult indices = this->context->createBuffer(indexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal, block.indices.size);
+
+			vk::DeviceSize nextVertex = 0;
+			vk::DeviceSize nextIndex = 0;
+			vk::DeviceSize indexUsed = 0;
+
+			this->context->withPrimaryCommandBuffer([&](vk::CommandBuffer copyCmd) {
+				for (auto range : blockRanges) {
+					nextIndex = alignUp(nextIndex, this->indexAlignment);
+
+					for (uint32_t s = 0; s < this->strides.size(); ++s) {
+						vk::DeviceSize size = (vk::DeviceSize)range->vertexCount * this->strides[s];
+						if (size > 0) {
+							copyCmd.copyBuffer(block.streams[s].buffer, streams[s].buffer, vk::BufferCopy((vk::DeviceSize)range->vertexOffset * this->strides[s], nextVertex * this->strides[s], size));
+						}
+					}
+					if (range->indexSize > 0) {
+						copyCmd.copyBuffer(block.indices.buffer, indices.buffer, vk::BufferCopy(range->indexOffset, nextIndex, range->indexSize));
+					}
+
+					range->vertexOffset = (uint32_t)nextVertex;
+					range->indexOffset = nextIndex;
+					range->firstIndex = (uint32_t)(nextIndex / indexStride(range->indexType));
+
+					nextVertex += range->vertexCount;
+					nextIndex += range->indexSize;
+					indexUsed += range->indexSize;
+				}
+			});
+
+			for (auto &stream : block.streams) {
+				stream.destroy();
+			}
+			block.indices.destroy();
+
+			block.streams = streams;
+			block.indices = indices;
+
+			block.vertexRanges.reset(block.vertexRanges.capacity, nextVertex);
+			block.indexRanges.reset(block.indexRanges.capacity, nextIndex);
+			// alignment padding doesn't count as used
+			block.indexRanges.used = indexUsed;
+		}
+	}
+
+
+
+	std::vector<vkx::CreateBufferResult> GeometryPool::releaseEmptyBlocks() {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		std::vector<vkx::CreateBufferResult> buffers;
+		for (size_t b = 1; b < this->blocks.size(); ++b) {
+			Block &block = *this->blocks[b];
+			if (block.streams.empty() || block.vertexRanges.used != 0 || block.indexRanges.used != 0) {
+				continue;
+			}
+			buffers.insert(buffers.end(), block.streams.begin(), block.streams.end());
+			buffers.push_back(block.indices);
+			block.streams.clear();
+			block.indices = vkx::CreateBufferResult();
+			// no room, allocate() passes it by
+			block.vertexRanges.reset(0);
+			block.indexRanges.reset(0);
+		}
+		return buffers;
+	}
+
+	vk::DeviceSize GeometryPool::usedSize() const {
+		vk::DeviceSize size = 0;
+		for (auto &block : this->blocks) {
+			for (auto stride : this->strides) {
+				size += block->vertexRanges.used * stride;
+			}
+			size += block->indexRanges.used;
+		}
+		return size;
+	}
+
+	vk::DeviceSize GeometryPool::capacity() const {
+		vk::DeviceSize size = 0;
+		for (auto &block : this->blocks) {
+			for (auto &stream : block->streams) {
+				size += stream.size;
+			}
+			size += block->indices.size;
+		}
+		return size;
+	}
+
+
+	void GeometryPool::destroy() {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		// ranges that outlive the pool just stop pointing at it
+		for (auto range : this->ranges) {
+			range->pool = nullptr;
+		}
+		this->ranges.clear();
+
+		for (auto &block : this->blocks) {
+			for (auto &stream : block->streams) {
+				stream.destroy();
+			}
+			block->indices.destroy();
+		}
+		this->blocks.clear();
+	}
+
+
+
+	std::shared_ptr<GeometryPool> GeometryPoolList::get(const vkx::Context *context, const std::vector<uint32_t> &strides) {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		auto it = this->pools.find(strides);
+		if (it != this->pools.end()) {
+			return it->second;
+		}
+
+		auto pool = std::make_shared<GeometryPool>(context, strides);
+		this->pools[strides] = pool;
+		return pool;
+	}
+
+	void GeometryPoolList::defragment() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (auto &pool : this->pools) {
+			pool.second->defragment();
+		}
+	}
+
+	std::vector<vkx::CreateBufferResult> GeometryPoolList::releaseEmptyBlocks() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::vector<vkx::CreateBufferResult> buffers;
+		for (auto &pool : this->pools) {
+			std::vector<vkx::CreateBufferResult> released = pool.second->releaseEmptyBlocks();
+			buffers.insert(buffers.end(), released.begin(), released.end());
+		}
+		return buffers;
+	}
+
+	void GeometryPoolList::destroy() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (auto &pool : this->pools) {
+			pool.second->destroy();
+		}
+		this->pools.clear();
+	}
+
+}
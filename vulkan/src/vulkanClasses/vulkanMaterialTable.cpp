@@ -0,0 +1,222 @@
+#include "vulkanMaterialTable.h"
+#include "vulkanArena.h"
+
+namespace vkx {
+
+
+	void MaterialTable::prepare(const vkx::Context *context) {
+
+		this->context = context;
+
+		if (!context->deviceFeatures.shaderSampledImageArrayDynamicIndexing) {
+			printf("material table disabled: shaderSampledImageArrayDynamicIndexing not supported\n");
+			this->enabled = false;
+			return;
+		}
+
+		const vk::PhysicalDeviceLimits &limits = context->deviceProperties.limits;
+		uint32_t samplersNeeded = MATERIAL_TABLE_TEXTURES + MATERIAL_TABLE_RESERVED_SAMPLERS;
+		if (limits.maxPerStageDescriptorSamplers < samplersNeeded || limits.maxPerStageDescriptorSampledImages < samplersNeeded ||
+			limits.maxDescriptorSetSamplers < samplersNeeded || limits.maxDescriptorSetSampledImages < samplersNeeded) {
+			printf("material table disabled: the device allows %d samplers per stage, %d are needed\n", limits.maxPerStageDescriptorSamplers, samplersNeeded);
+			this->enabled = false;
+			return;
+		}
+
+
+		// binding 0: texture array, binding 1: material records
+		vk::DescriptorSetLayoutBinding textureBinding = vkx::descriptorSetLayoutBinding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 0);
+		textureBinding.descriptorCount = MATERIAL_TABLE_TEXTURES;
+
+		std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+			textureBinding,
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment, 1),
+		};
+		this->setLayout = context->device.createDescriptorSetLayout(vkx::descriptorSetLayoutCreateInfo(bindings));
+
+		std::vector<vk::DescriptorPoolSize> poolSizes = {
+			vkx::descriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MATERIAL_TABLE_TEXTURES),
+			vkx::descriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1),
+		};
+		this->descriptorPool = context->device.createDescriptorPool(vkx::descriptorPoolCreateInfo(poolSizes, 1));
+		this->descriptorSet = context->device.allocateDescriptorSets(vkx::descriptorSetAllocateInfo(this->descriptorPool, &this->setLayout, 1))[0];
+
+		createRecordBuffer(MATERIAL_TABLE_INITIAL_RECORDS);
+
+		this->enabled = true;
+	}
+
+
+
+	void MaterialTable::createRecordBuffer(uint32_t capacity) {
+
+		if (this->records.buffer) {
+			this->records.destroy();
+		}
+
+		this->records = this->context->createBuffer(
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			capacity * sizeof(MaterialRecord));
+		this->records.map();
+		this->recordCapacity = capacity;
+
+		vk::WriteDescriptorSet write = vkx::writeDescriptorSet(this->descriptorSet, vk::DescriptorType::eStorageBuffer, 1, &this->records.descriptor);
+		this->context->device.updateDescriptorSets(write, nullptr);
+	}
+
+
+
+	uint32_t MaterialTable::textureSlot(const vk::DescriptorImageInfo &descriptor, std::vector<vk::DescriptorImageInfo> &newTextures) {
+
+		auto it = this->textureSlots.find(descriptor.imageView);
+		if (it != this->textureSlots.end()) {
+			return it->second;
+		}
+
+		if (this->textureSlots.size() >= MATERIAL_TABLE_TEXTURES) {
+			printf("Error: material table is full (%d textures), using the first texture instead!\n", MATERIAL_TABLE_TEXTURES);
+			return 0;
+		}
+
+		uint32_t slot = (uint32_t)this->textureSlots.size();
+		this->textureSlots[descriptor.imageView] = slot;
+		newTextures.push_back(descriptor);
+		return slot;
+	}
+
+
+
+	bool MaterialTable::update(const vkx::MaterialList &materials) {
+
+		// (the size too, a lookup with resources[] can add a material without a sync())
+		if (!this->enabled || (materials.generation == this->materialGeneration && materials.resources.size() == this->materialCount)) {
+			return false;
+		}
+
+		uint32_t firstNewSlot = (uint32_t)this->textureSlots.size();
+		std::vector<vk::DescriptorImageInfo> newTextures;
+
+		// MaterialList::sync() numbers the materials in name order, so every record can move
+		std::vector<MaterialRecord> recordData(materials.resources.size());
+
+		for (auto &iterator : materials.resources) {
+			const Material &material = iterator.second;
+			MaterialRecord &record = recordData[material.index];
+
+			record.ambient = material.properties.ambient;
+			record.diffuse = material.properties.diffuse;
+			record.specular = material.properties.specular;
+			record.opacity = material.properties.opacity;
+
+			record.diffuseTexture = material.diffuse ? textureSlot(material.diffuse->descriptor, newTextures) : 0;
+			record.specularTexture = material.specular ? textureSlot(material.specular->descriptor, newTextures) : 0;
+			record.bumpTexture = material.bump ? textureSlot(material.bump->descriptor, newTextures) : 0;
+		}
+
+
+		// earlier frames could still be reading the records and the texture array
+		this->context->device.waitIdle();
+
+		if (recordData.size() > this->recordCapacity) {
+			uint32_t capacity = this->recordCapacity;
+			while (capacity < recordData.size()) {
+				capacity *= 2;
+			}
+			createRecordBuffer(capacity);
+		}
+		this->records.copy(recordData);
+
+
+		if (!newTextures.empty()) {
+
+			std::vector<vk::WriteDescriptorSet> writes;
+
+			// without partially bound descriptors every element has to be valid,
+			// so the first texture fills the slots that haven't been used yet
+			std::vector<vk::DescriptorImageInfo> unused;
+			if (firstNewSlot == 0 && newTextures.size() < MATERIAL_TABLE_TEXTURES) {
+				unused.resize(MATERIAL_TABLE_TEXTURES - newTextures.size(), newTextures[0]);
+
+				vk::WriteDescriptorSet write = vkx::writeDescriptorSet(this->descriptorSet, vk::DescriptorType::eCombinedImageSampler, 0, unused.data());
+				write.dstArrayElement = (uint32_t)newTextures.size();
+				write.descriptorCount = (uint32_t)unused.size();
+				writes.push_back(write);
+			}
+
+			vk::WriteDescriptorSet write = vkx::writeDescriptorSet(this->descriptorSet, vk::DescriptorType::eCombinedImageSampler, 0, newTextures.data());
+			write.dstArrayElement = firstNewSlot;
+			write.descriptorCount = (uint32_t)newTextures.size();
+			writes.push_back(write);
+
+			this->context->device.updateDescriptorSets(writes, nullptr);
+		}
+
+		this->materialGeneration = materials.generation;
+		this->materialCount = materials.resources.size();
+		return true;
+	}
+
+
+
+	void MaterialTable::replaceTexture(vk::ImageView old, const vk::DescriptorImageInfo &descriptor) {
+
+		auto it = this->textureSlots.find(old);
+		if (!this->enabled || it == this->textureSlots.end()) {
+			return;
+		}
+
+		uint32_t slot = it->second;
+		this->textureSlots.erase(it);
+		this->textureSlots[descriptor.imageView] = slot;
+
+		// called by the texture streamer during the frame
+		ArenaVector<vk::WriteDescriptorSet> writes = frameVector<vk::WriteDescriptorSet>();
+
+		// writeDescriptorSet takes a non-const pointer
+		vk::DescriptorImageInfo imageInfo = descriptor;
+		vk::WriteDescriptorSet write = vkx::writeDescriptorSet(this->descriptorSet, vk::DescriptorType::eCombinedImageSampler, 0, &imageInfo);
+		write.dstArrayElement = slot;
+		writes.push_back(write);
+
+		// the slots that haven't been used yet hold the first texture
+		ArenaVector<vk::DescriptorImageInfo> unused = frameVector<vk::DescriptorImageInfo>();
+		if (slot == 0 && this->textureSlots.size() < MATERIAL_TABLE_TEXTURES) {
+			unused.resize(MATERIAL_TABLE_TEXTURES - this->textureSlots.size(), descriptor);
+
+			vk::WriteDescriptorSet unusedWrite = vkx::writeDescriptorSet(this->descriptorSet, vk::DescriptorType::eCombinedImageSampler, 0, unused.data());
+			unusedWrite.dstArrayElement = (uint32_t)this->textureSlots.size();
+			unusedWrite.descriptorCount = (uint32_t)unused.size();
+			writes.push_back(unusedWrite);
+		}
+
+		this->context->device.updateDescriptorSets(writes, nullptr);
+	}
+
+
+
+	void MaterialTable::destroy() {
+
+		this->textureSlots.clear();
+		this->materialGeneration = 0;
+		this->materialCount = 0;
+		this->enabled = false;
+
+		if (!this->context) {
+			return;
+		}
+
+		if (this->records.buffer) {
+			this->records.destroy();
+		}
+		if (this->descriptorPool) {
+			this->context->device.destroyDescriptorPool(this->descriptorPool);
+			this->descriptorPool = vk::DescriptorPool();
+		}
+		if (this->setLayout) {
+			this->context->device.destroyDescriptorSetLayout(this->setLayout);
+			this->setLayout = vk::DescriptorSetLayout();
+		}
+	}
+
+}
@@ -0,0 +1,233 @@
+#include "vulkanMemoryStats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#include "vulkanDebug.h"
+
+namespace vkx {
+
+
+	const char *memoryCategoryName(MemoryCategory category) {
+		switch (category) {
+			case MEMORY_CATEGORY_MESH_VERTEX:
+				return "mesh vertex";
+			case MEMORY_CATEGORY_MESH_INDEX:
+				return "mesh index";
+			case MEMORY_CATEGORY_TEXTURE:
+				return "texture";
+			case MEMORY_CATEGORY_GBUFFER:
+				return "g-buffer";
+			case MEMORY_CATEGORY_SHADOW_MAP:
+				return "shadow map";
+			case MEMORY_CATEGORY_UNIFORM:
+				return "uniform";
+			case MEMORY_CATEGORY_STAGING:
+				return "staging";
+			case MEMORY_CATEGORY_UI:
+				return "ui";
+			default:
+				return "other";
+		}
+	}
+
+
+
+	namespace memory {
+
+		struct Allocation {
+			MemoryCategory category;
+			uint32_t memoryTypeIndex;
+			vk::DeviceSize size;
+			std::string name;
+		};
+
+		// allocations come from worker threads too (texture streaming, mesh loading)
+		static std::mutex mutex;
+		static std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		static MemoryStats current;
+
+		static thread_local MemoryCategory scopeCategory = MEMORY_CATEGORY_COUNT;
+		static thread_local const char *scopeName = nullptr;
+
+
+
+		static void add(MemoryUsage &usage, vk::DeviceSize size) {
+			usage.liveBytes += size;
+			usage.peakBytes = std::max(usage.peakBytes, usage.liveBytes);
+			usage.allocations++;
+		}
+
+		static void remove(MemoryUsage &usage, vk::DeviceSize size) {
+			usage.liveBytes -= size;
+			usage.allocations--;
+		}
+
+
+
+		Scope::Scope(MemoryCategory category, const char *name) {
+			this->previousCategory = scopeCategory;
+			this->previousName = scopeName;
+			scopeCategory = category;
+			scopeName = name;
+		}
+
+		Scope::Scope(const char *name) {
+			this->previousCategory = scopeCategory;
+			this->previousName = scopeName;
+			scopeName = name;
+		}
+
+		Scope::~Scope() {
+			scopeCategory = this->previousCategory;
+			scopeName = this->previousName;
+		}
+
+		MemoryCategory currentCategory(MemoryCategory guess) {
+			return scopeCategory == MEMORY_CATEGORY_COUNT ? guess : scopeCategory;
+		}
+
+		const char *currentName(MemoryCategory category) {
+			return scopeName ? scopeName : memoryCategoryName(category);
+		}
+
+
+
+		MemoryCategory bufferCategory(vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryPropertyFlags) {
+			if (usage == vk::BufferUsageFlagBits::eTransferSrc && (memoryPropertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)) {
+				return MEMORY_CATEGORY_STAGING;
+			}
+			if (usage & vk::BufferUsageFlagBits::eVertexBuffer) {
+				return MEMORY_CATEGORY_MESH_VERTEX;
+			}
+			if (usage & vk::BufferUsageFlagBits::eIndexBuffer) {
+				return MEMORY_CATEGORY_MESH_INDEX;
+			}
+			if (usage & vk::BufferUsageFlagBits::eUniformBuffer) {
+				return MEMORY_CATEGORY_UNIFORM;
+			}
+			return MEMORY_CATEGORY_OTHER;
+		}
+
+		MemoryCategory imageCategory(vk::ImageUsageFlags usage) {
+			// the shadow maps are tagged by their scope, every other render target is part of the g-buffer passes
+			if (usage & (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment)) {
+				return MEMORY_CATEGORY_GBUFFER;
+			}
+			if (usage & vk::ImageUsageFlagBits::eSampled) {
+				return MEMORY_CATEGORY_TEXTURE;
+			}
+			return MEMORY_CATEGORY_OTHER;
+		}
+
+
+
+		vk::DeviceMemory allocateMemory(vk::Device device, const vk::MemoryAllocateInfo &allocateInfo, MemoryCategory category) {
+
+			category = currentCategory(category);
+			const char *name = currentName(category);
+
+			vk::DeviceMemory memory = device.allocateMemory(allocateInfo);
+			if (debug::marker::active) {
+				debug::marker::setDeviceMemoryName(device, memory, name);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Allocation allocation;
+			allocation.category = category;
+			allocation.memoryTypeIndex = allocateInfo.memoryTypeIndex;
+			allocation.size = allocateInfo.allocationSize;
+			allocation.name = name;
+			allocations[(VkDeviceMemory)memory] = allocation;
+
+			add(current.total, allocation.size);
+			add(current.categories[category], allocation.size);
+			add(current.memoryTypes[allocation.memoryTypeIndex], allocation.size);
+
+			return memory;
+		}
+
+		void freeMemory(vk::Device device, vk::DeviceMemory memory) {
+			if (!memory) {
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = allocations.find((VkDeviceMemory)memory);
+				// memory allocated elsewhere (swapchain, external code) isn't counted
+				if (it != allocations.end()) {
+					const Allocation &allocation = it->second;
+					remove(current.total, allocation.size);
+					remove(current.categories[allocation.category], allocation.size);
+					remove(current.memoryTypes[allocation.memoryTypeIndex], allocation.size);
+					allocations.erase(it);
+				}
+			}
+
+			device.freeMemory(memory);
+		}
+
+
+
+		MemoryStats stats() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return current;
+		}
+
+
+
+		static void appendUsage(std::string &json, const MemoryUsage &usage) {
+			char text[128];
+			snprintf(text, sizeof(text), "{ \"live\": %llu, \"peak\": %llu, \"allocations\": %u }",
+				(unsigned long long)usage.liveBytes, (unsigned long long)usage.peakBytes, usage.allocations);
+			json += text;
+		}
+
+		std::string toJson(const vk::PhysicalDeviceMemoryProperties &memoryProperties) {
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			char text[256];
+			std::string json = "{\n\t\"total\": ";
+			appendUsage(json, current.total);
+
+			json += ",\n\t\"categories\": {";
+			for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+				json += i ? ",\n\t\t\"" : "\n\t\t\"";
+				json += memoryCategoryName((MemoryCategory)i);
+				json += "\": ";
+				appendUsage(json, current.categories[i]);
+			}
+
+			json += "\n\t},\n\t\"memoryTypes\": [";
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+				const vk::MemoryType &memoryType = memoryProperties.memoryTypes[i];
+				snprintf(text, sizeof(text), "%s\n\t\t{ \"index\": %u, \"heap\": %u, \"heapSize\": %llu, \"flags\": \"%s\", \"usage\": ",
+					i ? "," : "", i, memoryType.heapIndex, (unsigned long long)memoryProperties.memoryHeaps[memoryType.heapIndex].size,
+					vk::to_string(memoryType.propertyFlags).c_str());
+				json += text;
+				appendUsage(json, current.memoryTypes[i]);
+				json += " }";
+			}
+
+			json += "\n\t],\n\t\"allocations\": [";
+			bool first = true;
+			for (auto &iterator : allocations) {
+				const Allocation &allocation = iterator.second;
+				json += first ? "\n\t\t{ \"name\": \"" : ",\n\t\t{ \"name\": \"";
+				json += allocation.name;
+				snprintf(text, sizeof(text), "\", \"category\": \"%s\", \"memoryType\": %u, \"bytes\": %llu }",
+					memoryCategoryName(allocation.category), allocation.memoryTypeIndex, (unsigned long long)allocation.size);
+				json += text;
+				first = false;
+			}
+			json += "\n\t]\n}\n";
+
+			return json;
+		}
+	}
+
+}
@@ -1,4 +1,18 @@
 #include "vulkanMeshLoader.h"
+#include "vulkanVertexFormat.h"
+#include "vulkanParallel.h"
+#include "vulkanTextureStreamer.h"
+#include "vulkanMeshResidency.h"
+
+#include <set>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define VKX_MESH_SSE
+#endif
+
+// vertices per parallel chunk when converting assimp meshes
+#define MESH_LOAD_GRAIN_SIZE 16384
 
 namespace vkx {
 
@@ -16,6 +30,32 @@ namespace vkx {
 
 
 
+	// host memory of a scene's meshes, about what freeing it gives back
+	static uint64_t sceneSize(const aiScene *pScene) {
+		uint64_t size = 0;
+		for (unsigned int i = 0; i < pScene->mNumMeshes; ++i) {
+			const aiMesh *pMesh = pScene->mMeshes[i];
+			uint32_t vectors = 1 + (pMesh->HasNormals() ? 1 : 0) + (pMesh->HasTangentsAndBitangents() ? 2 : 0);
+			for (uint32_t t = 0; t < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++t) {
+				vectors += pMesh->HasTextureCoords(t) ? 1 : 0;
+			}
+			size += (uint64_t)pMesh->mNumVertices * vectors * sizeof(aiVector3D);
+			for (uint32_t c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c) {
+				size += pMesh->HasVertexColors(c) ? (uint64_t)pMesh->mNumVertices * sizeof(aiColor4D) : 0;
+			}
+			size += (uint64_t)pMesh->mNumFaces * sizeof(aiFace);
+			for (unsigned int f = 0; f < pMesh->mNumFaces; ++f) {
+				size += pMesh->mFaces[f].mNumIndices * sizeof(unsigned int);
+			}
+			for (unsigned int b = 0; b < pMesh->mNumBones; ++b) {
+				size += sizeof(aiBone) + pMesh->mBones[b]->mNumWeights * sizeof(aiVertexWeight);
+			}
+		}
+		return size;
+	}
+
+
+
 	// Loads the mesh with some default flags
 	bool vkx::MeshLoader::load(const std::string &filename) {
 		int flags = aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
@@ -49,13 +89,21 @@ namespace vkx {
 
 
 		// use asset manager
+		// a scene some loader retains is shared, one only this loader needs is freed once it's parsed
+		// loaders retaining positions keep it cached too: physics objects are spawned from the same file over and over,
+		// each spawn would read and post-process it again
+		bool ownScene = false;
 		if (this->assetManager->scenes.present(filename)) {
 			pScene = this->assetManager->scenes.get(filename);
 		} else {
 			//pScene = Importer.ReadFile(filename.c_str(), flags);
 			Importer.ReadFile(filename.c_str(), flags);
 			pScene = Importer.GetOrphanedScene();
-			this->assetManager->scenes.add(filename, pScene);
+			if (pScene && (this->retention & (MESH_RETAIN_SCENE | MESH_RETAIN_POSITIONS))) {
+				this->assetManager->scenes.add(filename, pScene);
+			} else {
+				ownScene = true;
+			}
 		}
 
 
@@ -67,7 +115,18 @@ namespace vkx {
 		if (!pScene) {
 			throw std::runtime_error("Unable to parse " + filename);
 		}
-		return parse(pScene, filename);
+		bool parsed = parse(pScene, filename);
+
+		#if !defined(__ANDROID__)
+		// the materials and meshes were copied out
+		if (ownScene) {
+			this->assetManager->releasedSceneBytes += sceneSize(pScene);
+			delete pScene;
+			pScene = nullptr;
+		}
+		#endif
+
+		return parsed;
 	}
 
 
@@ -82,6 +141,76 @@ namespace vkx {
 
 
 
+		// every texture the new materials use goes up in one batch (decoded on all threads, one fence),
+		// the material loop below then finds them in the asset manager
+		// the upload runs while the materials and their descriptor sets are set up
+		vkx::TextureBatch textureBatch(*context, *textureLoader);
+		{
+			struct TextureSlot {
+				aiTextureType type;
+				vkx::texture::Usage usage;
+				const char *dummy;
+			};
+			const TextureSlot slots[] = {
+				{ aiTextureType_DIFFUSE, vkx::texture::Usage::eColor, "dummy/dummy.dds" },
+				{ aiTextureType_SPECULAR, vkx::texture::Usage::eSpecular, "dummy/dummy_specular.dds" },
+				{ aiTextureType_NORMALS, vkx::texture::Usage::eNormal, "dummy/dummy_ddn.dds" },
+			};
+
+			std::string assetPath = getAssetPath() + "models/";
+			struct Batched {
+				std::string textureName;
+				std::string fileName;
+				vkx::texture::Usage usage;
+				std::shared_ptr<vkx::Texture> texture;
+			};
+			std::vector<Batched> batched;
+			// a file used with several usages is still one texture by its name, the first usage wins
+			// (like the loop below, which loads it once and then finds it)
+			std::set<std::string> batchedNames;
+
+			// with streaming only the small mips are loaded now
+			vkx::TextureStreamer *textureStreamer = this->assetManager->textureStreamer;
+			if (textureStreamer) {
+				textureBatch.maxSize = TEXTURE_STREAM_START_SIZE;
+			}
+
+			for (size_t i = 0; i < pScene->mNumMaterials; i++) {
+				aiString name;
+				pScene->mMaterials[i]->Get(AI_MATKEY_NAME, name);
+				if (this->assetManager->materials.present(name.C_Str())) {
+					continue;
+				}
+
+				for (auto &slot : slots) {
+					// same names as the loop below (dummies by their full path, like getOrLoad)
+					std::string textureName = assetPath + slot.dummy;
+					std::string fileName = textureName;
+					if (pScene->mMaterials[i]->GetTextureCount(slot.type) > 0) {
+						aiString texturefile;
+						pScene->mMaterials[i]->GetTexture(slot.type, 0, &texturefile);
+						textureName = std::string(texturefile.C_Str());
+						std::replace(textureName.begin(), textureName.end(), '\\', '/');
+						fileName = assetPath + textureName;
+					}
+					if (!this->assetManager->textures.present(textureName) && batchedNames.insert(textureName).second) {
+						batched.push_back({ textureName, fileName, slot.usage, textureBatch.add(fileName, slot.usage) });
+					}
+				}
+			}
+
+			textureBatch.submit();
+
+			for (auto &texture : batched) {
+				this->assetManager->textures.add(texture.textureName, *texture.texture);
+				if (textureStreamer) {
+					textureStreamer->add(texture.fileName, texture.usage, *texture.texture);
+				}
+			}
+		}
+
+
+
 		for (size_t i = 0; i < pScene->mNumMaterials; i++) {
 
 			Material material;
@@ -142,7 +271,7 @@ namespace vkx {
 				// if the texture hasn't been loaded already, load it
 				if (!this->assetManager->textures.present(fileName)) {
 					// load from file
-					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vk::Format::eBc2UnormBlock);
+					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vkx::texture::Usage::eColor);
 					this->assetManager->textures.add(fileName, tex);
 				}
 				material.diffuse = assetManager->textures.getSharedPtr(fileName);
@@ -171,7 +300,7 @@ namespace vkx {
 				// if the texture hasn't been loaded already, load it
 				if (!this->assetManager->textures.present(fileName)) {
 					// load from file
-					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vk::Format::eBc2UnormBlock);
+					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vkx::texture::Usage::eSpecular);
 					this->assetManager->textures.add(fileName, tex);
 				}
 				material.specular = assetManager->textures.getSharedPtr(fileName);
@@ -180,7 +309,7 @@ namespace vkx {
 				printf("Error: Material has no specular, using dummy texture!\n");
 
 				//material.specular = textureLoader->loadTexture(assetPath + "dummy/dummy_specular.dds", vk::Format::eBc2UnormBlock);
-				material.specular = assetManager->textures.getOrLoad(assetPath + "dummy/dummy_specular.dds", textureLoader);
+				material.specular = assetManager->textures.getOrLoad(assetPath + "dummy/dummy_specular.dds", textureLoader, vkx::texture::Usage::eSpecular);
 			}
 
 
@@ -200,7 +329,7 @@ namespace vkx {
 				// if the texture hasn't been loaded already, load it
 				if (!this->assetManager->textures.present(fileName)) {
 					// load from file
-					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vk::Format::eBc2UnormBlock);
+					vkx::Texture tex = textureLoader->loadTexture(assetPath + fileName, vkx::texture::Usage::eNormal);
 					this->assetManager->textures.add(fileName, tex);
 				}
 				material.bump = assetManager->textures.getSharedPtr(fileName);
@@ -209,7 +338,7 @@ namespace vkx {
 				printf("Error: Material has no bump, using dummy texture!\n");
 
 				//material.bump = textureLoader->loadTexture(assetPath + "dummy/dummy_ddn.dds", vk::Format::eBc2UnormBlock);
-				material.bump = assetManager->textures.getOrLoad(assetPath + "dummy/dummy_ddn.dds", textureLoader);
+				material.bump = assetManager->textures.getOrLoad(assetPath + "dummy/dummy_ddn.dds", textureLoader, vkx::texture::Usage::eNormal);
 			}
 
 			// Mask
@@ -219,75 +348,127 @@ namespace vkx {
 			}
 
 
-			if (this->assetManager->materialDescriptorPool == nullptr) {
-				return;
+			// per material descriptor set, only when the material table isn't used (no pool / layout is set then)
+			if (this->assetManager->materialDescriptorPool != nullptr && this->assetManager->materialDescriptorSetLayout != nullptr) {
+
+				vk::DescriptorSetAllocateInfo allocInfo =
+					vkx::descriptorSetAllocateInfo(
+						*this->assetManager->materialDescriptorPool,
+						this->assetManager->materialDescriptorSetLayout,
+						1);
+
+				material.descriptorSet = context->device.allocateDescriptorSets(allocInfo)[0];
+
+
+				std::vector<vk::WriteDescriptorSet> writeDescriptorSets =
+				{
+					// image bindings
+					// binding 0: diffuse
+					vkx::writeDescriptorSet(
+						material.descriptorSet,
+						vk::DescriptorType::eCombinedImageSampler,
+						0,
+						&material.diffuse->descriptor),
+					// binding 1: specular
+					vkx::writeDescriptorSet(
+						material.descriptorSet,
+						vk::DescriptorType::eCombinedImageSampler,
+						1,
+						&material.specular->descriptor),
+					// binding 2: normal
+					vkx::writeDescriptorSet(
+						material.descriptorSet,
+						vk::DescriptorType::eCombinedImageSampler,
+						2,
+						&material.bump->descriptor)
+				};
+
+				context->device.updateDescriptorSets(writeDescriptorSets, {});
 			}
 
-			if (this->assetManager->materialDescriptorSetLayout == nullptr) {
-				return;
-			}
+			this->assetManager->materials.add(material.name, material);
 
+		}
 
-			vk::DescriptorSetAllocateInfo allocInfo =
-				vkx::descriptorSetAllocateInfo(
-					*this->assetManager->materialDescriptorPool,
-					this->assetManager->materialDescriptorSetLayout,
-					1);
-
-			material.descriptorSet = context->device.allocateDescriptorSets(allocInfo)[0];
-
-
-			std::vector<vk::WriteDescriptorSet> writeDescriptorSets =
-			{
-				// image bindings
-				// binding 0: diffuse
-				vkx::writeDescriptorSet(
-					material.descriptorSet,
-					vk::DescriptorType::eCombinedImageSampler,
-					0,
-					&material.diffuse->descriptor),
-				// binding 1: specular
-				vkx::writeDescriptorSet(
-					material.descriptorSet,
-					vk::DescriptorType::eCombinedImageSampler,
-					1,
-					&material.specular->descriptor),
-				// binding 2: normal
-				vkx::writeDescriptorSet(
-					material.descriptorSet,
-					vk::DescriptorType::eCombinedImageSampler,
-					2,
-					&material.bump->descriptor)
-			};
+		textureBatch.wait();
 
-			context->device.updateDescriptorSets(writeDescriptorSets, {});
+	}
 
-			this->assetManager->materials.add(material.name, material);
 
+
+
+
+	// bounds of a position stream
+	static void positionBounds(const aiVector3D *positions, size_t count, glm::vec3 &outMin, glm::vec3 &outMax) {
+
+		size_t i = 0;
+
+		#if defined(VKX_MESH_SSE)
+		// 4 positions (12 floats) per iteration, the xyz lanes rotate through the 3 registers:
+		// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+		if (count >= 4) {
+			const float *p = &positions[0].x;
+			__m128 minA = _mm_set1_ps(FLT_MAX), minB = minA, minC = minA;
+			__m128 maxA = _mm_set1_ps(-FLT_MAX), maxB = maxA, maxC = maxA;
+
+			for (; i + 4 <= count; i += 4) {
+				__m128 a = _mm_loadu_ps(p + i * 3);
+				__m128 b = _mm_loadu_ps(p + i * 3 + 4);
+				__m128 c = _mm_loadu_ps(p + i * 3 + 8);
+				minA = _mm_min_ps(minA, a);
+				minB = _mm_min_ps(minB, b);
+				minC = _mm_min_ps(minC, c);
+				maxA = _mm_max_ps(maxA, a);
+				maxB = _mm_max_ps(maxB, b);
+				maxC = _mm_max_ps(maxC, c);
+			}
+
+			float mn[12], mx[12];
+			_mm_storeu_ps(mn, minA);
+			_mm_storeu_ps(mn + 4, minB);
+			_mm_storeu_ps(mn + 8, minC);
+			_mm_storeu_ps(mx, maxA);
+			_mm_storeu_ps(mx + 4, maxB);
+			_mm_storeu_ps(mx + 8, maxC);
+
+			for (int j = 0; j < 12; ++j) {
+				outMin[j % 3] = fmin(outMin[j % 3], mn[j]);
+				outMax[j % 3] = fmax(outMax[j % 3], mx[j]);
+			}
 		}
+		#endif
 
+		for (; i < count; ++i) {
+			glm::vec3 pos(positions[i].x, positions[i].y, positions[i].z);
+			outMin = glm::min(outMin, pos);
+			outMax = glm::max(outMax, pos);
+		}
 	}
 
 
 
+	void vkx::MeshLoader::loadMeshes(const aiScene *pScene) {
 
+		// vertex ranges are converted in parallel, large meshes are split so they don't end up on a single thread
+		struct VertexRange {
+			uint32_t meshIndex;
+			uint32_t begin;
+			uint32_t end;
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+		std::vector<VertexRange> ranges;
 
-	void vkx::MeshLoader::loadMeshes(const aiScene *pScene) {
+		// material colors, looked up once per mesh
+		std::vector<glm::vec3> colors(m_Entries.size());
 
 		// init each entry with mesh data
 		for (unsigned int index = 0; index < m_Entries.size(); ++index) {
 
-
-			// reference to corresponding mesh entry
-			MeshEntry &meshEntry = m_Entries[index];
-
 			// pointer to corresponding mesh
 			const aiMesh *pMesh = pScene->mMeshes[index];
 
 			// set material name for this mesh
-			//int materialIndex = this->assetManager->loadedMaterials.size() - pScene->mNumMaterials + pMesh->mMaterialIndex;
-			//m_Entries[index].MaterialIndex = materialIndex;
-
 			aiString name;
 			pScene->mMaterials[pMesh->mMaterialIndex]->Get(AI_MATKEY_NAME, name);
 
@@ -297,57 +478,116 @@ namespace vkx {
 			// get the color of this mesh's material
 			aiColor3D pColor(0.f, 0.f, 0.f);
 			pScene->mMaterials[pMesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, pColor);
+			colors[index] = glm::vec3(pColor.r, pColor.g, pColor.b);
+
+			// sized up front, every range writes its own part
+			m_Entries[index].Vertices.resize(pMesh->mNumVertices);
+
+			for (uint32_t begin = 0; begin < pMesh->mNumVertices; begin += MESH_LOAD_GRAIN_SIZE) {
+				VertexRange range;
+				range.meshIndex = index;
+				range.begin = begin;
+				range.end = std::min<uint32_t>(begin + MESH_LOAD_GRAIN_SIZE, pMesh->mNumVertices);
+				range.min = glm::vec3(FLT_MAX);
+				range.max = glm::vec3(-FLT_MAX);
+				ranges.push_back(range);
+			}
+		}
+
+
+		// get vertices
+		vkx::parallelFor(ranges.size(), 1, [&](size_t first, size_t last) {
+			for (size_t r = first; r < last; ++r) {
+				VertexRange &range = ranges[r];
 
-			aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+				const aiMesh *pMesh = pScene->mMeshes[range.meshIndex];
+				Vertex *vertices = m_Entries[range.meshIndex].Vertices.data();
+				const glm::vec3 color = colors[range.meshIndex];
 
-			// get vertices
+				const bool hasNormals = pMesh->HasNormals();
+				const bool hasTexCoords = pMesh->HasTextureCoords(0);
+				const bool hasTangents = pMesh->HasTangentsAndBitangents();
 
-			for (unsigned int i = 0; i < pMesh->mNumVertices; i++) {
-				aiVector3D* pPos = &(pMesh->mVertices[i]);
-				aiVector3D* pNormal = &(pMesh->mNormals[i]);
+				for (uint32_t i = range.begin; i < range.end; ++i) {
+					Vertex &v = vertices[i];
 
-				aiVector3D *pTexCoord = (pMesh->HasTextureCoords(0)) ? &(pMesh->mTextureCoords[0][i]) : &Zero3D;
+					const aiVector3D &pos = pMesh->mVertices[i];
+					v.m_pos = glm::vec3(pos.x, pos.y, pos.z);
 
-				aiVector3D* pTangent = (pMesh->HasTangentsAndBitangents()) ? &(pMesh->mTangents[i]) : &Zero3D;
-				aiVector3D* pBiTangent = (pMesh->HasTangentsAndBitangents()) ? &(pMesh->mBitangents[i]) : &Zero3D;
+					if (hasNormals) {
+						const aiVector3D &normal = pMesh->mNormals[i];
+						v.m_normal = glm::vec3(normal.x, normal.y, normal.z);
+					} else {
+						v.m_normal = glm::vec3(0.0f);
+					}
 
-				Vertex v(
-					glm::vec3(pPos->x, pPos->y, pPos->z),
-					glm::vec2(pTexCoord->x, pTexCoord->y),
-					glm::vec3(pNormal->x, pNormal->y, pNormal->z),
-					glm::vec3(pTangent->x, pTangent->y, pTangent->z),
-					glm::vec3(pBiTangent->x, pBiTangent->y, pBiTangent->z),
-					glm::vec3(pColor.r, pColor.g, pColor.b)
-				);
+					if (hasTexCoords) {
+						const aiVector3D &texCoord = pMesh->mTextureCoords[0][i];
+						v.m_tex = glm::vec2(texCoord.x, texCoord.y);
+					} else {
+						v.m_tex = glm::vec2(0.0f);
+					}
 
-				dim.max.x = fmax(pPos->x, dim.max.x);
-				dim.max.y = fmax(pPos->y, dim.max.y);
-				dim.max.z = fmax(pPos->z, dim.max.z);
+					if (hasTangents) {
+						const aiVector3D &tangent = pMesh->mTangents[i];
+						const aiVector3D &bitangent = pMesh->mBitangents[i];
+						v.m_tangent = glm::vec3(tangent.x, tangent.y, tangent.z);
+						v.m_binormal = glm::vec3(bitangent.x, bitangent.y, bitangent.z);
+					} else {
+						v.m_tangent = glm::vec3(0.0f);
+						v.m_binormal = glm::vec3(0.0f);
+					}
 
-				dim.min.x = fmin(pPos->x, dim.min.x);
-				dim.min.y = fmin(pPos->y, dim.min.y);
-				dim.min.z = fmin(pPos->z, dim.min.z);
+					v.m_color = color;
+				}
 
-				m_Entries[index].Vertices.push_back(v);
+				positionBounds(&pMesh->mVertices[range.begin], range.end - range.begin, range.min, range.max);
 			}
+		});
 
-			dim.size = dim.max - dim.min;
 
-			// get indices
+		// get indices
+		vkx::parallelFor(m_Entries.size(), 1, [&](size_t first, size_t last) {
+			for (size_t index = first; index < last; ++index) {
+				const aiMesh *pMesh = pScene->mMeshes[index];
+				std::vector<uint32_t> &indices = m_Entries[index].Indices;
 
-			for (unsigned int i = 0; i < pMesh->mNumFaces; i++) {
-				const aiFace &Face = pMesh->mFaces[i];
-				if (Face.mNumIndices != 3) {
-					continue;
+				indices.reserve(pMesh->mNumFaces * 3);
+
+				for (unsigned int i = 0; i < pMesh->mNumFaces; i++) {
+					const aiFace &Face = pMesh->mFaces[i];
+					if (Face.mNumIndices != 3) {
+						continue;
+					}
+					indices.push_back(Face.mIndices[0]);
+					indices.push_back(Face.mIndices[1]);
+					indices.push_back(Face.mIndices[2]);
 				}
-				m_Entries[index].Indices.push_back(Face.mIndices[0]);
-				m_Entries[index].Indices.push_back(Face.mIndices[1]);
-				m_Entries[index].Indices.push_back(Face.mIndices[2]);
 			}
+		});
 
 
+		// merge the bounds of every range, per mesh (for quantized positions) and for the whole model
+		for (auto &entry : m_Entries) {
+			entry.boundsMin = glm::vec3(FLT_MAX);
+			entry.boundsMax = glm::vec3(-FLT_MAX);
+		}
+		for (auto &range : ranges) {
+			MeshEntry &entry = m_Entries[range.meshIndex];
+			entry.boundsMin = glm::min(entry.boundsMin, range.min);
+			entry.boundsMax = glm::max(entry.boundsMax, range.max);
+			dim.min = glm::min(dim.min, range.min);
+			dim.max = glm::max(dim.max, range.max);
+		}
+		for (auto &entry : m_Entries) {
+			if (entry.Vertices.empty()) {
+				entry.boundsMin = glm::vec3(0.0f);
+				entry.boundsMax = glm::vec3(0.0f);
+			}
 		}
 
+		dim.size = dim.max - dim.min;
+
 	}
 
 
@@ -372,67 +612,225 @@ namespace vkx {
 	}
 
 
+	vk::IndexType smallestIndexType(const std::vector<uint32_t> &indices) {
+		uint32_t maxIndex = 0;
+		for (auto index : indices) {
+			maxIndex = std::max(maxIndex, index);
+		}
+		return maxIndex > 0xFFFF ? vk::IndexType::eUint32 : vk::IndexType::eUint16;
+	}
+
+	void writeIndices(const std::vector<uint32_t> &indices, vk::IndexType indexType, void *dst) {
+
+		if (indexType == vk::IndexType::eUint32) {
+			memcpy(dst, indices.data(), indices.size() * sizeof(uint32_t));
+			return;
+		}
+
+		uint16_t *shortIndices = static_cast<uint16_t*>(dst);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			shortIndices[i] = (uint16_t)indices[i];
+		}
+		// padded to a whole number of 32 bit words, the meshlet cull pass reads them as uints
+		if (indices.size() & 1) {
+			shortIndices[indices.size()] = 0;
+		}
+	}
+
+	void stageIndexBuffer(const vkx::Context *context, const vk::BufferUsageFlags &usage, const std::vector<uint32_t> &indices, MeshBuffer &meshBuffer) {
+
+		meshBuffer.indexCount = (uint32_t)indices.size();
+		meshBuffer.indexType = smallestIndexType(indices);
+
+		size_t size = meshBuffer.indexType == vk::IndexType::eUint16 ? ((indices.size() + 1) & ~(size_t)1) * sizeof(uint16_t) : indices.size() * sizeof(uint32_t);
+
+		meshBuffer.indices = context->stageToDeviceBuffer(usage, size, [&](void *mapped) {
+			writeIndices(indices, meshBuffer.indexType, mapped);
+		});
+	}
+
+
+
+	void MeshBufferBinding::bindVertices(const vk::CommandBuffer &cmdBuffer, const MeshBuffer &meshBuffer, uint32_t firstBinding, uint32_t streamCount) {
+
+		std::array<vk::Buffer, 2> buffers;
+		std::array<vk::DeviceSize, 2> offsets{ { 0, 0 } };
+
+		if (meshBuffer.geometry) {
+			// the whole block, the mesh is selected with vertexOffset
+			streamCount = std::min(streamCount, meshBuffer.pool->streamCount());
+			for (uint32_t s = 0; s < streamCount; ++s) {
+				buffers[s] = meshBuffer.pool->vertexBuffer(meshBuffer.geometry->block, s);
+			}
+		} else {
+			// own buffer, the streams follow each other
+			streamCount = std::min<uint32_t>(streamCount, meshBuffer.attributeOffset ? 2 : 1);
+			buffers[0] = buffers[1] = meshBuffer.vertices.buffer;
+			offsets[1] = meshBuffer.attributeOffset;
+		}
+
+		if (this->firstBinding == firstBinding && this->streamCount == streamCount && this->vertexBuffers == buffers && this->vertexOffsets == offsets) {
+			return;
+		}
+
+		cmdBuffer.bindVertexBuffers(firstBinding, streamCount, buffers.data(), offsets.data());
+		this->bindCount++;
+
+		this->firstBinding = firstBinding;
+		this->streamCount = streamCount;
+		this->vertexBuffers = buffers;
+		this->vertexOffsets = offsets;
+	}
+
+	void MeshBufferBinding::bindIndices(const vk::CommandBuffer &cmdBuffer, const MeshBuffer &meshBuffer) {
+		if (meshBuffer.geometry) {
+			bindIndices(cmdBuffer, meshBuffer.pool->indexBuffer(meshBuffer.geometry->block), meshBuffer.indexType);
+		} else {
+			bindIndices(cmdBuffer, meshBuffer.indices.buffer, meshBuffer.indexType);
+		}
+	}
+
+	void MeshBufferBinding::bindIndices(const vk::CommandBuffer &cmdBuffer, vk::Buffer buffer, vk::IndexType indexType) {
+		if (this->indexBuffer == buffer && this->indexType == indexType) {
+			return;
+		}
+		cmdBuffer.bindIndexBuffer(buffer, 0, indexType);
+		this->bindCount++;
+		this->indexBuffer = buffer;
+		this->indexType = indexType;
+	}
+
+
+
+	// vertex streams of a layout, layouts with a quantized position store it in a stream of its own
+	static std::vector<uint32_t> streamStrides(const std::vector<vkx::VertexComponent> &layout) {
+		uint32_t size = vkx::vertexSize(layout);
+		if (vkx::hasPositionStream(layout)) {
+			return { vkx::PackedPositionFormat::size, size - vkx::PackedPositionFormat::size };
+		}
+		return { size };
+	}
+
+	// allocate and upload a mesh buffer's vertices and indices in the matching geometry pool
+	// writeVertices fills the vertices of every stream, one stream after another
+	// name: of the model file, for the memory stats (a new pool block is named after the mesh that needed it)
+	static void uploadToGeometryPool(vkx::AssetManager *assetManager, const vkx::Context *context, vkx::MeshBuffer &meshBuffer, const std::vector<uint32_t> &strides, uint32_t vertexCount, const std::vector<uint32_t> &indices, const std::function<void(void*)> &writeVertices, bool cook = false, const char *name = nullptr) {
+
+		vkx::memory::Scope memoryScope(name);
+
+		meshBuffer.indexCount = (uint32_t)indices.size();
+		meshBuffer.indexType = vkx::smallestIndexType(indices);
+
+		meshBuffer.pool = assetManager->geometryPools.get(context, strides);
+		meshBuffer.geometry = meshBuffer.pool->allocate(vertexCount, meshBuffer.indexCount, meshBuffer.indexType);
+
+		// the residency manager keeps a copy of the bytes to upload them again after an eviction
+		if (cook && assetManager->meshResidency && vertexCount > 0) {
+			uint32_t vertexSize = 0;
+			for (auto stride : strides) {
+				vertexSize += stride;
+			}
+			std::vector<uint8_t> vertexBytes((size_t)vertexCount * vertexSize);
+			std::vector<uint8_t> indexBytes((size_t)meshBuffer.geometry->indexSize);
+			writeVertices(vertexBytes.data());
+			vkx::writeIndices(indices, meshBuffer.indexType, indexBytes.data());
+
+			meshBuffer.pool->upload(*meshBuffer.geometry, [&](void *vertices, void *indexData) {
+				memcpy(vertices, vertexBytes.data(), vertexBytes.size());
+				memcpy(indexData, indexBytes.data(), indexBytes.size());
+			});
+
+			assetManager->meshResidency->cook(meshBuffer, vertexCount, vertexBytes, indexBytes);
+			return;
+		}
+
+		meshBuffer.pool->upload(*meshBuffer.geometry, [&](void *vertices, void *indexData) {
+			writeVertices(vertices);
+			vkx::writeIndices(indices, meshBuffer.indexType, indexData);
+		});
+	}
+
+
+
+	// dequantization constants and stream offsets for a mesh buffer written with params
+	static void setPositionQuantization(vkx::MeshBuffer &meshBuffer, const std::vector<vkx::VertexComponent> &layout, const vkx::VertexWriteParams &params, size_t vertexCount) {
+		meshBuffer.positionCenter = glm::vec4(params.center, 0.0f);
+		meshBuffer.positionExtent = glm::vec4(params.extent, 0.0f);
+		meshBuffer.attributeOffset = 0;
+		if (vkx::hasPositionStream(layout)) {
+			meshBuffer.attributeOffset = vertexCount * vkx::PackedPositionFormat::size;
+		}
+	}
+
+
+	std::shared_ptr<MeshBuffer> createPooledMeshBuffer(vkx::AssetManager *assetManager, const vkx::Context *context, const std::vector<VertexComponent> &layout,
+		const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float scale, bool cook, const char *name) {
+
+		auto meshBuffer = std::make_shared<MeshBuffer>();
+		meshBuffer->vertexLayout = layout;
+
+		VertexWriteParams params = vkx::vertexWriteParams(scale, boundsMin, boundsMax);
+		setPositionQuantization(*meshBuffer, layout, params, vertices.size());
+
+
+		// split into meshlets for gpu culling
+		if (!vertices.empty()) {
+			meshBuffer->meshlets = vkx::buildMeshlets(
+				&vertices[0].m_pos,
+				&vertices[0].m_normal,
+				vertices.size(),
+				sizeof(Vertex),
+				indices.data(),
+				indices.size(),
+				scale);
+		}
+		// single meshlet meshes are drawn whole, no need for the gpu copy
+		if (meshBuffer->meshlets.size() > 1) {
+			vkx::memory::Scope memoryScope(name);
+			meshBuffer->meshletData = context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eStorageBuffer, meshBuffer->meshlets);
+		}
+
+		// vertices and indices go into the shared geometry pool for this layout
+		// the vertices are converted straight into the staging buffer
+		uploadToGeometryPool(assetManager, context, *meshBuffer, streamStrides(layout), (uint32_t)vertices.size(), indices, [&](void *mapped) {
+			vkx::writeVertices(layout, vertices, params, mapped);
+		}, cook, name);
+
+		return meshBuffer;
+	}
+
+
+
 	void vkx::MeshLoader::createMeshBuffer(const std::vector<VertexComponent> &layout, float scale) {
 
 		// combined mesh buffer
 
-		std::vector<float> vertexBuffer;
+		// converted in one go so layouts with a position stream get a single stream for the whole buffer
+		std::vector<Vertex> vertices;
+		vertices.reserve(numVertices);
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
 		for (int m = 0; m < m_Entries.size(); m++) {
-			for (int i = 0; i < m_Entries[m].Vertices.size(); i++) {
-				// Push vertex data depending on layout
-				for (auto& layoutDetail : layout) {
-					// Position
-					if (layoutDetail == VERTEX_COMPONENT_POSITION) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.x * scale);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.y * scale);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.z * scale);
-					}
-					// Normal
-					if (layoutDetail == VERTEX_COMPONENT_NORMAL) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_normal.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_normal.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_normal.z);
-					}
-					// Texture coordinates
-					if (layoutDetail == VERTEX_COMPONENT_UV) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tex.s);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tex.t);
-					}
-					// Color
-					if (layoutDetail == VERTEX_COMPONENT_COLOR) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.r);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.g);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.b);
-					}
-					// Tangent
-					if (layoutDetail == VERTEX_COMPONENT_TANGENT) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.z);
-					}
-					// Bitangent
-					if (layoutDetail == VERTEX_COMPONENT_BITANGENT) {
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.z);
-					}
-					// Dummy layout components for padding
-					if (layoutDetail == VERTEX_COMPONENT_DUMMY_FLOAT) {
-						vertexBuffer.push_back(0.0f);
-					}
-					if (layoutDetail == VERTEX_COMPONENT_DUMMY_VEC4) {
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-					}
-				}
+			vertices.insert(vertices.end(), m_Entries[m].Vertices.begin(), m_Entries[m].Vertices.end());
+			if (!m_Entries[m].Vertices.empty()) {
+				boundsMin = glm::min(boundsMin, m_Entries[m].boundsMin);
+				boundsMax = glm::max(boundsMax, m_Entries[m].boundsMax);
 			}
 		}
+		if (vertices.empty()) {
+			boundsMin = boundsMax = glm::vec3(0.0f);
+		}
+
+		VertexWriteParams params = vkx::vertexWriteParams(scale, boundsMin, boundsMax);
+
+		std::vector<uint8_t> vertexBuffer;
+		vkx::writeVertices(layout, vertices, params, vertexBuffer);
 
 		//MeshBuffer meshBuffer;
-		std::shared_ptr<MeshBuffer> meshBuffer;
-		meshBuffer->vertices.size = vertexBuffer.size() * sizeof(float);
+		auto meshBuffer = std::make_shared<MeshBuffer>();
+		meshBuffer->vertices.size = vertexBuffer.size();
+		meshBuffer->vertexLayout = layout;
+		setPositionQuantization(*meshBuffer, layout, params, vertices.size());
 
 		dim.min *= scale;
 		dim.max *= scale;
@@ -446,49 +844,18 @@ namespace vkx {
 			}
 		}
 
-		meshBuffer->indexCount = (uint32_t)indexBuffer.size();
 		// Use staging buffer to move vertex and index buffer to device local memory
 		// Vertex buffer
 		meshBuffer->vertices = context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eVertexBuffer, vertexBuffer);
 		// Index buffer
-		meshBuffer->indices = context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer);
+		vkx::stageIndexBuffer(context, vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer, *meshBuffer);
 		meshBuffer->dim = dim.size;
 
 		this->combinedBuffer = meshBuffer;
-	}
-
 
+		release(this->retention);
+	}
 
-	struct ComponentInfo {
-		int offset;
-		int length;
-		glm::vec2 Vertex::* vec2p;
-		glm::vec3 Vertex::* vec3p;
-		glm::vec4 Vertex::* vec4p;
-		VertexComponent vertexComponent;
-	};
-
-	std::vector<vkx::VertexComponent> defaultLayout =
-	{
-		vkx::VertexComponent::VERTEX_COMPONENT_POSITION,
-		vkx::VertexComponent::VERTEX_COMPONENT_UV,
-		vkx::VertexComponent::VERTEX_COMPONENT_COLOR,
-		vkx::VertexComponent::VERTEX_COMPONENT_NORMAL,
-		vkx::VertexComponent::VERTEX_COMPONENT_TANGENT,
-		vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4,
-		vkx::VertexComponent::VERTEX_COMPONENT_DUMMY_VEC4
-	};
-
-	// this needs to be fixed:
-	struct defaultVert {
-		glm::vec3 pos;
-		glm::vec2 uv;
-		glm::vec3 color;
-		glm::vec3 normal;
-		glm::vec3 tangent;
-		glm::vec4 dummy1;
-		glm::vec4 dummy2;
-	};
 
 
 	//void vkx::MeshLoader::createMeshBuffers(const std::vector<VertexComponent> &layout, float scale) {
@@ -823,8 +1190,13 @@ namespace vkx {
 
 		// todo: fix:
 		if (this->assetManager->meshBuffers.present(filename)) {
+			// evicted meshes come back from the mesh cache
+			if (this->assetManager->meshResidency) {
+				this->assetManager->meshResidency->use(filename);
+			}
 			// assumes correct vertex layout
 			this->meshBuffers = this->assetManager->meshBuffers.get(filename);
+			release(this->retention);
 			return;
 		}
 
@@ -833,189 +1205,12 @@ namespace vkx {
 
 
 
-			std::vector<defaultVert> verticesTest;
-			verticesTest.resize(m_Entries[m].Vertices.size());
-			std::vector<float> vertexBuffer;
-			int numOfFloats = m_Entries[m].Vertices.size() * (vkx::vertexSize(layout) / sizeof(float));
-			vertexBuffer.reserve(numOfFloats);
-
-
-			if (layout == defaultLayout) {
-
-				for (int i = 0; i < m_Entries[m].Vertices.size(); i++) {
-					// pos
-					verticesTest[i].pos = glm::make_vec3(&m_Entries[m].Vertices[i].m_pos.x) * scale;
-					// uv
-					verticesTest[i].uv = glm::make_vec2(&m_Entries[m].Vertices[i].m_tex.x);
-					// color
-					verticesTest[i].color = glm::make_vec3(&m_Entries[m].Vertices[i].m_color.x);
-					// normal
-					verticesTest[i].normal = glm::make_vec3(&m_Entries[m].Vertices[i].m_normal.x);
-					// tangent
-					verticesTest[i].tangent = glm::make_vec3(&m_Entries[m].Vertices[i].m_tangent.x);
-
-				}
-
-			} else {
-				//std::vector<int Vertex::*> componentMap;
-				//std::vector<int> componentMap;
-				std::vector<ComponentInfo> componentMap;
-
-
-				//auto a = offsetof(Vertex, m_pos);
-				//int Foo::* pm = &Foo::b;
-
-				for (auto &layoutDetail : layout) {
-					ComponentInfo c;
-					switch (layoutDetail) {
-						// Position
-						case VERTEX_COMPONENT_POSITION:
-							//int Vertex::* pm = &Vertex::m_pos;
-							//componentMap.push_back(offsetof(Vertex, m_pos));
-							c.offset = offsetof(Vertex, m_pos);
-							c.length = 3;
-							c.vec3p = &Vertex::m_pos;
-							componentMap.push_back(c);
-							break;
-							// Normal
-						case VERTEX_COMPONENT_NORMAL:
-							//componentMap.push_back(offsetof(Vertex, m_normal));
-							c.offset = offsetof(Vertex, m_normal);
-							c.length = 3;
-							c.vec3p = &Vertex::m_normal;
-							componentMap.push_back(c);
-							break;
-							// Texture Coordinates
-						case VERTEX_COMPONENT_UV:
-							//componentMap.push_back(offsetof(Vertex, m_tex));
-							c.offset = offsetof(Vertex, m_tex);
-							c.length = 2;
-							c.vec2p = &Vertex::m_tex;
-							componentMap.push_back(c);
-							break;
-							// Color
-						case VERTEX_COMPONENT_COLOR:
-							//componentMap.push_back(offsetof(Vertex, m_color));
-							c.offset = offsetof(Vertex, m_color);
-							c.length = 3;
-							c.vec3p = &Vertex::m_color;
-							componentMap.push_back(c);
-							break;
-							// Tangent
-						case VERTEX_COMPONENT_TANGENT:
-							//componentMap.push_back(offsetof(Vertex, m_tangent));
-							c.offset = offsetof(Vertex, m_tangent);
-							c.length = 3;
-							c.vec3p = &Vertex::m_tangent;
-							componentMap.push_back(c);
-							break;
-							// Bitangent
-						case VERTEX_COMPONENT_BITANGENT:
-							//componentMap.push_back(offsetof(Vertex, m_binormal));
-							c.offset = offsetof(Vertex, m_binormal);
-							c.length = 3;
-							c.vec3p = &Vertex::m_binormal;
-							componentMap.push_back(c);
-							break;
-							// Dummy layout components for padding
-						case VERTEX_COMPONENT_DUMMY_FLOAT:
-							//componentMap.push_back(-1);
-							c.offset = -1;
-							c.length = 1;
-							c.vertexComponent = VERTEX_COMPONENT_DUMMY_FLOAT;
-							componentMap.push_back(c);
-							break;
-						case VERTEX_COMPONENT_DUMMY_VEC4:
-							//componentMap.push_back(-4);
-							c.offset = -4;
-							c.length = 4;
-							c.vertexComponent = VERTEX_COMPONENT_DUMMY_VEC4;
-							componentMap.push_back(c);
-							break;
-					}
-				}
-
-				// for each vertex
-				for (int i = 0; i < m_Entries[m].Vertices.size(); i++) {
-					// Push vertex data depending on layout
-
-
-
-					for (auto &info : componentMap) {
-
-						if (info.vertexComponent == VERTEX_COMPONENT_DUMMY_VEC4) {
-							vertexBuffer.push_back(0.0f);
-							vertexBuffer.push_back(0.0f);
-							vertexBuffer.push_back(0.0f);
-							vertexBuffer.push_back(0.0f);
-						} else if (info.vertexComponent == VERTEX_COMPONENT_DUMMY_FLOAT) {
-							vertexBuffer.push_back(0.0f);
-						} else {
-
-							Vertex *vert = &m_Entries[m].Vertices[i];
-
-							if (info.length == 2) {
-								glm::vec2 comp = *reinterpret_cast<glm::vec2 *>(reinterpret_cast<char *>(vert) + info.offset);
-								vertexBuffer.push_back(comp.x);
-								vertexBuffer.push_back(comp.y);
-							} else if (info.length == 3) {
-								glm::vec3 comp = *reinterpret_cast<glm::vec3 *>(reinterpret_cast<char *>(vert) + info.offset);
-								vertexBuffer.push_back(comp.x);
-								vertexBuffer.push_back(comp.y);
-								vertexBuffer.push_back(comp.z);
-							} else if (info.length == 4) {
-								glm::vec4 comp = *reinterpret_cast<glm::vec4 *>(reinterpret_cast<char *>(vert) + info.offset);
-								vertexBuffer.push_back(comp.x);
-								vertexBuffer.push_back(comp.y);
-								vertexBuffer.push_back(comp.z);
-								vertexBuffer.push_back(comp.w);
-							}
-
-						}
-
-					}
-				}
-
-			}
-
-
-
-
-			//std::shared_ptr<MeshBuffer> meshesDeferred;
-			auto meshBuffer = std::make_shared<MeshBuffer>();
-
-
-
-			//MeshBuffer meshBuffer;
-			meshBuffer->vertexLayout = layout;
-
-			if (layout == defaultLayout) {
-				meshBuffer->vertices.size = verticesTest.size() * sizeof(defaultVert);
-			} else {
-				meshBuffer->vertices.size = vertexBuffer.size() * sizeof(float);
-			}
-
 			dim.min *= scale;
 			dim.max *= scale;
 			dim.size *= scale;
 
-			std::vector<uint32_t> indexBuffer;
-			uint32_t indexBase = (uint32_t)indexBuffer.size();
-			for (uint32_t i = 0; i < m_Entries[m].Indices.size(); i++) {
-				indexBuffer.push_back(m_Entries[m].Indices[i] + indexBase);
-			}
-
-			meshBuffer->indexCount = (uint32_t)indexBuffer.size();
-			// Use staging buffer to move vertex and index buffer to device local memory
-			// Vertex buffer
-			if (layout == defaultLayout) {
-				meshBuffer->vertices = this->context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eVertexBuffer, verticesTest);
-			} else {
-				meshBuffer->vertices = this->context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eVertexBuffer, vertexBuffer);
-			}
-			
-			// Index buffer
-			meshBuffer->indices = this->context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer);
+			//std::shared_ptr<MeshBuffer> meshesDeferred;
+			auto meshBuffer = vkx::createPooledMeshBuffer(this->assetManager, this->context, layout, m_Entries[m].Vertices, m_Entries[m].Indices, m_Entries[m].boundsMin, m_Entries[m].boundsMax, scale, true, this->filename.c_str());
 			meshBuffer->dim = dim.size;
 
 			meshBuffer->materialIndex = m_Entries[m].materialIndex;
@@ -1036,6 +1231,9 @@ namespace vkx {
 		// if these mesh buffers haven't been stored, store them
 		if (!this->assetManager->meshBuffers.present(this->filename)) {
 			this->assetManager->meshBuffers.add(filename, meshBuffers);
+			if (this->assetManager->meshResidency) {
+				this->assetManager->meshResidency->add(filename, meshBuffers);
+			}
 		}
 
 
@@ -1046,8 +1244,47 @@ namespace vkx {
 		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
 		printf("Load Time: %d\n", duration);
 
+		release(this->retention);
+	}
+
+
+
+	void MeshLoader::release(uint32_t retention) {
+
+		uint64_t released = 0;
+
+		for (auto &entry : m_Entries) {
+			if (retention & MESH_RETAIN_VERTICES) {
+				continue;
+			}
+
+			if (retention & MESH_RETAIN_POSITIONS) {
+				// 12 of a vertex's 68 bytes
+				if (!entry.Vertices.empty()) {
+					entry.Positions.resize(entry.Vertices.size());
+					for (size_t i = 0; i < entry.Vertices.size(); ++i) {
+						entry.Positions[i] = entry.Vertices[i].m_pos;
+					}
+					released += entry.Vertices.capacity() * sizeof(Vertex) - entry.Positions.capacity() * sizeof(glm::vec3);
+				}
+			} else {
+				released += entry.Vertices.capacity() * sizeof(Vertex) + entry.Positions.capacity() * sizeof(glm::vec3) + entry.Indices.capacity() * sizeof(uint32_t);
+				std::vector<glm::vec3>().swap(entry.Positions);
+				std::vector<uint32_t>().swap(entry.Indices);
+			}
+			std::vector<Vertex>().swap(entry.Vertices);
+		}
+
+		// only read while the skinned mesh buffer is created
+		released += this->boneData.bones.capacity() * sizeof(VertexBoneData);
+		std::vector<VertexBoneData>().swap(this->boneData.bones);
+
+		this->retention = retention;
+		this->assetManager->releasedMeshBytes += released;
 	}
 
+
+
 	void MeshLoader::destroy() {
 
 		//for (int i = 0; i < meshBuffers.size(); ++i) {
@@ -1103,8 +1340,6 @@ namespace vkx {
 
 		this->combinedBuffer = std::make_shared<MeshBuffer>();
 
-		this->setAnimation(0);
-
 
 		// Setup bones
 		// One vertex bone info structure per vertex
@@ -1128,6 +1363,68 @@ namespace vkx {
 			}
 		}
 
+		// after the bones, the animation runtime binds them to the nodes
+		this->setAnimation(0);
+
+		// Generate index buffer from loaded mesh file
+		std::vector<uint32_t> indexBuffer;
+		for (uint32_t m = 0; m < m_Entries.size(); m++) {
+			uint32_t indexBase = indexBuffer.size();
+			for (uint32_t i = 0; i < m_Entries[m].Indices.size(); i++) {
+				indexBuffer.push_back(m_Entries[m].Indices[i] + indexBase);
+			}
+		}
+		this->combinedBuffer->vertexLayout = layout;
+
+
+		// quantized layouts: PackedVertexFormat followed by the bone weights (unorm8) and IDs (uint8), 32 bytes per vertex
+		// positions are left unscaled here, the scale is part of globalInverseTransform
+		if (!layout.empty() && layout[0] == VERTEX_COMPONENT_POSITION_SNORM16) {
+
+			glm::vec3 boundsMin(FLT_MAX);
+			glm::vec3 boundsMax(-FLT_MAX);
+			for (auto &entry : m_Entries) {
+				if (!entry.Vertices.empty()) {
+					boundsMin = glm::min(boundsMin, entry.boundsMin);
+					boundsMax = glm::max(boundsMax, entry.boundsMax);
+				}
+			}
+			if (numVertices == 0) {
+				boundsMin = boundsMax = glm::vec3(0.0f);
+			}
+
+			VertexWriteParams params = vkx::vertexWriteParams(1.0f, boundsMin, boundsMax);
+			setPositionQuantization(*this->combinedBuffer, std::vector<VertexComponent>(), params, numVertices);
+
+			const uint32_t stride = PackedVertexFormat::size + 2 * sizeof(uint32_t);
+
+			uploadToGeometryPool(this->assetManager, this->context, *this->combinedBuffer, { stride }, numVertices, indexBuffer, [&](void *mapped) {
+				uint8_t *vertexBuffer = static_cast<uint8_t*>(mapped);
+				for (uint32_t m = 0; m < m_Entries.size(); m++) {
+					for (uint32_t i = 0; i < m_Entries[m].Vertices.size(); i++) {
+						uint32_t index = m_Entries[m].vertexBase + i;
+						uint8_t *dst = vertexBuffer + index * stride;
+
+						PackedVertexFormat::List::write(dst, m_Entries[m].Vertices[i], params);
+
+						const VertexBoneData &bone = this->boneData.bones[index];
+						uint8_t *weights = dst + PackedVertexFormat::size;
+						uint8_t *IDs = weights + sizeof(uint32_t);
+						for (uint32_t j = 0; j < MAX_BONES_PER_VERTEX; j++) {
+							weights[j] = (uint8_t)glm::round(glm::clamp(bone.weights[j], 0.0f, 1.0f) * 255.0f);
+							IDs[j] = (uint8_t)bone.IDs[j];
+						}
+					}
+				}
+			}, false, this->filename.c_str());
+
+			this->combinedBuffer->materialIndex = m_Entries[0].materialIndex;
+			this->combinedBuffer->materialName = m_Entries[0].materialName;
+			release(this->retention);
+			return;
+		}
+
+
 		// Generate vertex buffer
 		std::vector<skinnedMeshVertex> vertexBuffer;
 		// Iterate through all meshes in the file
@@ -1152,23 +1449,14 @@ namespace vkx {
 				vertexBuffer.push_back(vertex);
 			}
 		}
-		uint32_t vertexBufferSize = vertexBuffer.size() * vkx::vertexSize(layout);
-
-		// Generate index buffer from loaded mesh file
-		std::vector<uint32_t> indexBuffer;
-		for (uint32_t m = 0; m < m_Entries.size(); m++) {
-			uint32_t indexBase = indexBuffer.size();
-			for (uint32_t i = 0; i < m_Entries[m].Indices.size(); i++) {
-				indexBuffer.push_back(m_Entries[m].Indices[i] + indexBase);
-			}
-		}
-		uint32_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-		this->combinedBuffer->indexCount = indexBuffer.size();
-		this->combinedBuffer->vertices = context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eVertexBuffer, vertexBuffer);
-		this->combinedBuffer->indices = context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer);
+		uploadToGeometryPool(this->assetManager, this->context, *this->combinedBuffer, { sizeof(skinnedMeshVertex) }, (uint32_t)vertexBuffer.size(), indexBuffer, [&](void *mapped) {
+			memcpy(mapped, vertexBuffer.data(), vertexBuffer.size() * sizeof(skinnedMeshVertex));
+		}, false, this->filename.c_str());
 
 		this->combinedBuffer->materialIndex = m_Entries[0].materialIndex;
 		this->combinedBuffer->materialName = m_Entries[0].materialName;
+
+		release(this->retention);
 	}
 
 
@@ -1195,6 +1483,7 @@ namespace vkx {
 	void vkx::MeshLoader::setAnimation(uint32_t animationIndex) {
 		assert(animationIndex < pScene->mNumAnimations);
 		boneData.pAnimation = pScene->mAnimations[animationIndex];
+		boneData.runtime.bind(pScene, boneData.pAnimation, boneData.boneMapping, boneData.boneInfo);
 	}
 
 	// Load bone information from ASSIMP mesh
@@ -1229,7 +1518,7 @@ namespace vkx {
 		boneData.boneTransforms.resize(boneData.numBones);
 	}
 
-	// Recursive bone transformation for given animation time
+	// Bone transformations for given animation time
 	void vkx::MeshLoader::update(float time) {
 
 		// get the current time:
@@ -1240,16 +1529,12 @@ namespace vkx {
 			return;
 		}
 
-		float TicksPerSecond = (float)(pScene->mAnimations[0]->mTicksPerSecond != 0 ? pScene->mAnimations[0]->mTicksPerSecond : 25.0f);
+		const aiAnimation *animation = boneData.pAnimation;
+		float TicksPerSecond = (float)(animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f);
 		float TimeInTicks = time * TicksPerSecond;
-		float AnimationTime = fmod(TimeInTicks, (float)pScene->mAnimations[0]->mDuration);
-
-		aiMatrix4x4 identity = aiMatrix4x4();
-		readNodeHierarchy(AnimationTime, pScene->mRootNode, identity);
+		float AnimationTime = fmod(TimeInTicks, (float)animation->mDuration);
 
-		for (uint32_t i = 0; i < boneData.boneTransforms.size(); i++) {
-			boneData.boneTransforms[i] = boneData.boneInfo[i].finalTransformation;
-		}
+		boneData.runtime.evaluate(AnimationTime, boneData.globalInverseTransform, boneData.boneTransforms);
 
 		// update the time since last update to now:
 		boneData.tLastUpdate = std::chrono::high_resolution_clock::now();
@@ -1258,144 +1543,6 @@ namespace vkx {
 
 
 
-	// Find animation for a given node
-	const aiNodeAnim* vkx::MeshLoader::findNodeAnim(const aiAnimation* animation, const std::string nodeName) {
-		for (uint32_t i = 0; i < animation->mNumChannels; i++) {
-			const aiNodeAnim* nodeAnim = animation->mChannels[i];
-			if (std::string(nodeAnim->mNodeName.data) == nodeName) {
-				return nodeAnim;
-			}
-		}
-		return nullptr;
-	}
-
-	// Returns a 4x4 matrix with interpolated translation between current and next frame
-	aiMatrix4x4 vkx::MeshLoader::interpolateTranslation(float time, const aiNodeAnim* pNodeAnim) {
-		aiVector3D translation;
-
-		if (pNodeAnim->mNumPositionKeys == 1) {
-			translation = pNodeAnim->mPositionKeys[0].mValue;
-		} else {
-			uint32_t frameIndex = 0;
-			for (uint32_t i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++) {
-				if (time < (float)pNodeAnim->mPositionKeys[i + 1].mTime) {
-					frameIndex = i;
-					break;
-				}
-			}
-
-			aiVectorKey currentFrame = pNodeAnim->mPositionKeys[frameIndex];
-			aiVectorKey nextFrame = pNodeAnim->mPositionKeys[(frameIndex + 1) % pNodeAnim->mNumPositionKeys];
-
-			float delta = (time - (float)currentFrame.mTime) / (float)(nextFrame.mTime - currentFrame.mTime);
-
-			const aiVector3D& start = currentFrame.mValue;
-			const aiVector3D& end = nextFrame.mValue;
-
-			translation = (start + delta * (end - start));
-		}
-
-		aiMatrix4x4 mat;
-		aiMatrix4x4::Translation(translation, mat);
-		return mat;
-	}
-
-	// Returns a 4x4 matrix with interpolated rotation between current and next frame
-	aiMatrix4x4 vkx::MeshLoader::interpolateRotation(float time, const aiNodeAnim* pNodeAnim) {
-		aiQuaternion rotation;
-
-		if (pNodeAnim->mNumRotationKeys == 1) {
-			rotation = pNodeAnim->mRotationKeys[0].mValue;
-		} else {
-			uint32_t frameIndex = 0;
-			for (uint32_t i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++) {
-				if (time < (float)pNodeAnim->mRotationKeys[i + 1].mTime) {
-					frameIndex = i;
-					break;
-				}
-			}
-
-			aiQuatKey currentFrame = pNodeAnim->mRotationKeys[frameIndex];
-			aiQuatKey nextFrame = pNodeAnim->mRotationKeys[(frameIndex + 1) % pNodeAnim->mNumRotationKeys];
-
-			float delta = (time - (float)currentFrame.mTime) / (float)(nextFrame.mTime - currentFrame.mTime);
-
-			const aiQuaternion& start = currentFrame.mValue;
-			const aiQuaternion& end = nextFrame.mValue;
-
-			aiQuaternion::Interpolate(rotation, start, end, delta);
-			rotation.Normalize();
-		}
-
-		aiMatrix4x4 mat(rotation.GetMatrix());
-		return mat;
-	}
-
-
-	// Returns a 4x4 matrix with interpolated scaling between current and next frame
-	aiMatrix4x4 vkx::MeshLoader::interpolateScale(float time, const aiNodeAnim* pNodeAnim) {
-		aiVector3D scale;
-
-		if (pNodeAnim->mNumScalingKeys == 1) {
-			scale = pNodeAnim->mScalingKeys[0].mValue;
-		} else {
-			uint32_t frameIndex = 0;
-			for (uint32_t i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++) {
-				if (time < (float)pNodeAnim->mScalingKeys[i + 1].mTime) {
-					frameIndex = i;
-					break;
-				}
-			}
-
-			aiVectorKey currentFrame = pNodeAnim->mScalingKeys[frameIndex];
-			aiVectorKey nextFrame = pNodeAnim->mScalingKeys[(frameIndex + 1) % pNodeAnim->mNumScalingKeys];
-
-			float delta = (time - (float)currentFrame.mTime) / (float)(nextFrame.mTime - currentFrame.mTime);
-
-			const aiVector3D& start = currentFrame.mValue;
-			const aiVector3D& end = nextFrame.mValue;
-
-			scale = (start + delta * (end - start));
-		}
-
-		aiMatrix4x4 mat;
-		aiMatrix4x4::Scaling(scale, mat);
-		return mat;
-	}
-
-
-
-
-
-
-	// Get node hierarchy for current animation time
-	void vkx::MeshLoader::readNodeHierarchy(float AnimationTime, const aiNode* pNode, const aiMatrix4x4& ParentTransform) {
-		std::string NodeName(pNode->mName.data);
-
-		aiMatrix4x4 NodeTransformation(pNode->mTransformation);
-
-		const aiNodeAnim* pNodeAnim = findNodeAnim(boneData.pAnimation, NodeName);
-
-		if (pNodeAnim) {
-			// Get interpolated matrices between current and next frame
-			aiMatrix4x4 matScale = interpolateScale(AnimationTime, pNodeAnim);
-			aiMatrix4x4 matRotation = interpolateRotation(AnimationTime, pNodeAnim);
-			aiMatrix4x4 matTranslation = interpolateTranslation(AnimationTime, pNodeAnim);
-
-			NodeTransformation = matTranslation * matRotation * matScale;
-		}
-
-		aiMatrix4x4 GlobalTransformation = ParentTransform * NodeTransformation;
-
-		if (boneData.boneMapping.find(NodeName) != boneData.boneMapping.end()) {
-			uint32_t BoneIndex = boneData.boneMapping[NodeName];
-			boneData.boneInfo[BoneIndex].finalTransformation = boneData.globalInverseTransform * GlobalTransformation * boneData.boneInfo[BoneIndex].offset;
-		}
-
-		for (uint32_t i = 0; i < pNode->mNumChildren; i++) {
-			readNodeHierarchy(AnimationTime, pNode->mChildren[i], GlobalTransformation);
-		}
-	}
 
 
 
@@ -0,0 +1,308 @@
+#include "vulkanMeshResidency.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "vulkanGeometryPool.h"
+#include "vulkanArena.h"
+
+// "VKMH"
+#define MESH_COOK_MAGIC 0x484D4B56
+
+namespace vkx {
+
+
+	// header of a cooked mesh file, followed by vertexSize bytes of vertices and indexSize bytes of indices
+	struct CookedMeshHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;
+		uint32_t reserved;
+		uint64_t vertexSize;
+		uint64_t indexSize;
+	};
+
+
+
+	// fnv-1a, a word at a time
+	static uint64_t hashBytes(uint64_t hash, const std::vector<uint8_t> &bytes) {
+		size_t words = bytes.size() / sizeof(uint64_t);
+		const uint8_t *data = bytes.data();
+		for (size_t i = 0; i < words; ++i) {
+			uint64_t word;
+			memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+			hash ^= word;
+			hash *= 0x100000001b3ull;
+		}
+		for (size_t i = words * sizeof(uint64_t); i < bytes.size(); ++i) {
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+		hash ^= bytes.size();
+		hash *= 0x100000001b3ull;
+		return hash;
+	}
+
+
+
+	void MeshResidency::prepare(vkx::Context *context, vkx::AssetManager *assetManager) {
+		this->context = context;
+		this->assetManager = assetManager;
+		this->limitBytes = currentLimit();
+	}
+
+
+
+	void MeshResidency::cook(MeshBuffer &meshBuffer, uint32_t vertexCount, const std::vector<uint8_t> &vertices, const std::vector<uint8_t> &indices) {
+
+		CookedMeshHeader header;
+		header.magic = MESH_COOK_MAGIC;
+		header.version = MESH_COOK_VERSION;
+		header.vertexCount = vertexCount;
+		header.indexCount = meshBuffer.indexCount;
+		header.indexType = (uint32_t)meshBuffer.indexType;
+		header.reserved = 0;
+		header.vertexSize = vertices.size();
+		header.indexSize = indices.size();
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		hash = hashBytes(hash, vertices);
+		hash = hashBytes(hash, indices);
+		hash ^= ((uint64_t)MESH_COOK_VERSION << 32) | header.indexType;
+		hash *= 0x100000001b3ull;
+
+		char name[64];
+		snprintf(name, sizeof(name), "mesh_%016llx.bin", (unsigned long long)hash);
+		const std::string &cacheDirectory = this->context->meshCacheDirectory;
+		std::string cacheFileName = cacheDirectory.empty() ? std::string(name) : cacheDirectory + "/" + name;
+
+		// the same bytes were cooked before (this run or an earlier one)
+		if (!std::ifstream(cacheFileName, std::ios::binary).good()) {
+
+			// written next to the cache file first, a half written mesh is never picked up
+			std::string tempFileName = cacheFileName + ".tmp";
+			{
+				std::ofstream file(tempFileName, std::ios::binary);
+				file.write((const char*)&header, sizeof(header));
+				file.write((const char*)vertices.data(), vertices.size());
+				file.write((const char*)indices.data(), indices.size());
+				if (!file.good()) {
+					// the mesh just stays resident
+					printf("Warning: couldn't write %s\n", tempFileName.c_str());
+					return;
+				}
+			}
+			std::remove(cacheFileName.c_str());
+			if (std::rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+				std::remove(tempFileName.c_str());
+				printf("Warning: couldn't write %s\n", cacheFileName.c_str());
+				return;
+			}
+		}
+
+		meshBuffer.cookedFile = cacheFileName;
+	}
+
+
+
+	void MeshResidency::add(const std::string &fileName, const std::vector<std::shared_ptr<MeshBuffer>> &meshBuffers) {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		Entry &entry = this->entries[fileName];
+		entry.meshBuffers = meshBuffers;
+		entry.lastUsed = this->frame;
+		entry.resident = true;
+	}
+
+
+
+	void MeshResidency::use(const std::string &fileName) {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		auto it = this->entries.find(fileName);
+		if (it == this->entries.end()) {
+			return;
+		}
+		if (!it->second.resident) {
+			restore(it->first, it->second);
+		}
+		it->second.lastUsed = this->frame;
+	}
+
+
+
+	bool MeshResidency::referenced(const Entry &entry) {
+		for (auto &meshBuffer : entry.meshBuffers) {
+			if (meshBuffer.use_count() > 2) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool MeshResidency::evictable(const Entry &entry) {
+		for (auto &meshBuffer : entry.meshBuffers) {
+			// nothing to give back or nothing to come back from
+			if (!meshBuffer->geometry || meshBuffer->cookedFile.empty()) {
+				return false;
+			}
+		}
+		return !entry.meshBuffers.empty();
+	}
+
+	vk::DeviceSize MeshResidency::meshSize(const MeshBuffer &meshBuffer) {
+		vk::DeviceSize size = meshBuffer.meshletData.size;
+		if (meshBuffer.geometry && meshBuffer.pool) {
+			for (auto stride : meshBuffer.pool->getStrides()) {
+				size += (vk::DeviceSize)meshBuffer.geometry->vertexCount * stride;
+			}
+			size += meshBuffer.geometry->indexSize;
+		}
+		return size;
+	}
+
+
+
+	vk::DeviceSize MeshResidency::currentLimit() const {
+
+		if (this->budget) {
+			return this->budget;
+		}
+
+		vk::DeviceSize heapBudget, heapUsage;
+		this->context->getMemoryBudget(heapBudget, heapUsage);
+		return (vk::DeviceSize)(heapBudget * MESH_RESIDENCY_HEAP_FRACTION);
+	}
+
+
+
+	void MeshResidency::evict(Entry &entry) {
+
+		for (auto &meshBuffer : entry.meshBuffers) {
+			// the range goes back to the pool and the meshlets are destroyed once the gpu is done with the last frame
+			std::shared_ptr<GeometryRange> geometry = meshBuffer->geometry;
+			vkx::CreateBufferResult meshletData = meshBuffer->meshletData;
+			this->context->dumpster.push_back([geometry, meshletData]() mutable {
+				meshletData.destroy();
+			});
+			meshBuffer->geometry.reset();
+			meshBuffer->meshletData = vkx::CreateBufferResult();
+		}
+
+		entry.resident = false;
+		this->evictedFiles++;
+		this->evictions++;
+	}
+
+
+
+	void MeshResidency::restore(const std::string &fileName, Entry &entry) {
+
+		vkx::memory::Scope memoryScope(fileName.c_str());
+
+		for (auto &meshBufferPtr : entry.meshBuffers) {
+			MeshBuffer &meshBuffer = *meshBufferPtr;
+
+			std::ifstream file(meshBuffer.cookedFile, std::ios::binary);
+			CookedMeshHeader header;
+			if (!file.read((char*)&header, sizeof(header)) || header.magic != MESH_COOK_MAGIC || header.version != MESH_COOK_VERSION ||
+				header.indexCount != meshBuffer.indexCount || header.indexType != (uint32_t)meshBuffer.indexType) {
+				throw std::runtime_error("Couldn't restore " + fileName + " from " + meshBuffer.cookedFile);
+			}
+
+			std::vector<uint8_t> vertices((size_t)header.vertexSize);
+			std::vector<uint8_t> indices((size_t)header.indexSize);
+			file.read((char*)vertices.data(), vertices.size());
+			file.read((char*)indices.data(), indices.size());
+			if (!file) {
+				throw std::runtime_error("Couldn't restore " + fileName + " from " + meshBuffer.cookedFile);
+			}
+
+			meshBuffer.geometry = meshBuffer.pool->allocate(header.vertexCount, header.indexCount, meshBuffer.indexType);
+			meshBuffer.pool->upload(*meshBuffer.geometry, [&](void *vertexData, void *indexData) {
+				memcpy(vertexData, vertices.data(), vertices.size());
+				memcpy(indexData, indices.data(), indices.size());
+			});
+
+			if (meshBuffer.meshlets.size() > 1) {
+				meshBuffer.meshletData = this->context->stageToDeviceBuffer(vk::BufferUsageFlagBits::eStorageBuffer, meshBuffer.meshlets);
+			}
+		}
+
+		entry.resident = true;
+		this->evictedFiles--;
+		this->restores++;
+		printf("Restored %s from the mesh cache\n", fileName.c_str());
+	}
+
+
+
+	void MeshResidency::update() {
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->frame++;
+		this->limitBytes = currentLimit();
+
+		vk::DeviceSize resident = 0;
+		ArenaVector<std::map<std::string, Entry>::iterator> candidates = frameVector<std::map<std::string, Entry>::iterator>();
+		for (auto it = this->entries.begin(); it != this->entries.end(); ++it) {
+			Entry &entry = it->second;
+			if (!entry.resident) {
+				continue;
+			}
+			for (auto &meshBuffer : entry.meshBuffers) {
+				resident += meshSize(*meshBuffer);
+			}
+			if (referenced(entry)) {
+				entry.lastUsed = this->frame;
+			} else if (evictable(entry)) {
+				candidates.push_back(it);
+			}
+		}
+		this->residentBytes = resident;
+
+		// blocks left empty give their memory back, every update: evict() only hands its ranges to the dumpster,
+		// the blocks they were in are empty once it has dropped them, a later frame
+		std::vector<vkx::CreateBufferResult> blocks = this->assetManager->geometryPools.releaseEmptyBlocks();
+		for (auto &block : blocks) {
+			this->context->dumpster.push_back([block]() mutable {
+				block.destroy();
+			});
+		}
+
+		if (resident <= this->limitBytes || candidates.empty()) {
+			return;
+		}
+
+		// least recently used first
+		std::sort(candidates.begin(), candidates.end(), [](const std::map<std::string, Entry>::iterator &a, const std::map<std::string, Entry>::iterator &b) {
+			return a->second.lastUsed < b->second.lastUsed;
+		});
+
+		for (auto &it : candidates) {
+			vk::DeviceSize size = 0;
+			for (auto &meshBuffer : it->second.meshBuffers) {
+				size += meshSize(*meshBuffer);
+			}
+			evict(it->second);
+			this->residentBytes -= size;
+			printf("Evicted %s (%d KB)\n", it->first.c_str(), (int)(size >> 10));
+			if (this->residentBytes <= this->limitBytes) {
+				break;
+			}
+		}
+	}
+
+
+
+	void MeshResidency::destroy() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->entries.clear();
+	}
+
+}
@@ -0,0 +1,480 @@
+#include "vulkanMeshlet.h"
+#include "vulkanMeshLoader.h"
+#include "vulkanArena.h"
+
+namespace vkx {
+
+
+	static inline const glm::vec3 &stridedVec3(const glm::vec3 *base, size_t stride, size_t index) {
+		return *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const char *>(base) + index * stride);
+	}
+
+	// compute bounding sphere and normal cone of a finished meshlet
+	static void computeMeshletBounds(Meshlet &meshlet, const uint32_t *meshletVertices, const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexStride, const uint32_t *indices, float positionScale) {
+
+		// bounding sphere around the center of the aabb
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			glm::vec3 p = stridedVec3(positions, vertexStride, meshletVertices[i]) * positionScale;
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			glm::vec3 p = stridedVec3(positions, vertexStride, meshletVertices[i]) * positionScale;
+			radius = std::max(radius, glm::length(p - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+
+		// normal cone
+		// face normals are oriented by the vertex normals so it doesn't matter which winding the importer produced
+		// once per meshlet, the loader threads take them from their scratch arena
+		ScratchScope scratch;
+		ArenaVector<glm::vec3> faceNormals(scratch.arena());
+		faceNormals.reserve(meshlet.indexCount / 3);
+		glm::vec3 axis = glm::vec3(0.0f);
+
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+			glm::vec3 a = stridedVec3(positions, vertexStride, indices[i + 0]);
+			glm::vec3 b = stridedVec3(positions, vertexStride, indices[i + 1]);
+			glm::vec3 c = stridedVec3(positions, vertexStride, indices[i + 2]);
+
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float len = glm::length(n);
+			// skip degenerate triangles
+			if (len < 1e-12f) {
+				continue;
+			}
+			n /= len;
+
+			glm::vec3 vertexNormal = stridedVec3(normals, vertexStride, indices[i + 0])
+				+ stridedVec3(normals, vertexStride, indices[i + 1])
+				+ stridedVec3(normals, vertexStride, indices[i + 2]);
+			if (glm::dot(n, vertexNormal) < 0.0f) {
+				n = -n;
+			}
+
+			faceNormals.push_back(n);
+			axis += n;
+		}
+
+		float axisLength = glm::length(axis);
+
+		// can't be cone culled
+		if (faceNormals.empty() || axisLength < 1e-6f) {
+			meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			return;
+		}
+
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (auto &n : faceNormals) {
+			minDot = std::min(minDot, glm::dot(n, axis));
+		}
+
+		// the normals spread over more than a hemisphere (~84 degrees), culling would almost never succeed
+		if (minDot <= 0.1f) {
+			meshlet.cone = glm::vec4(axis, 1.0f);
+			return;
+		}
+
+		// sin of the cone's half angle
+		float cutoff = sqrtf(1.0f - minDot * minDot);
+		meshlet.cone = glm::vec4(axis, cutoff);
+	}
+
+
+	std::vector<Meshlet> buildMeshlets(const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexCount, size_t vertexStride, const uint32_t *indices, size_t indexCount, float positionScale) {
+
+		std::vector<Meshlet> meshlets;
+
+		if (vertexCount == 0 || indexCount < 3) {
+			return meshlets;
+		}
+
+		meshlets.reserve(indexCount / (MESHLET_MAX_TRIANGLES * 3) + 1);
+
+		// the meshlet each vertex was last added to
+		// avoids a set / map lookup per vertex
+		ScratchScope scratch;
+		ArenaVector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX, scratch.arena());
+
+		// vertices used by the current meshlet (for the bounds)
+		uint32_t meshletVertices[MESHLET_MAX_VERTICES];
+
+		Meshlet current;
+		uint32_t currentIndex = 0;
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+
+			const uint32_t tri[3] = { indices[i + 0], indices[i + 1], indices[i + 2] };
+
+			// count the vertices this triangle would add
+			uint32_t newVertices = 0;
+			for (int j = 0; j < 3; ++j) {
+				bool duplicate = (j > 0 && tri[j] == tri[0]) || (j > 1 && tri[j] == tri[1]);
+				if (vertexMeshlet[tri[j]] != currentIndex && !duplicate) {
+					newVertices++;
+				}
+			}
+
+			// start a new meshlet if this one is full
+			if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+				computeMeshletBounds(current, meshletVertices, positions, normals, vertexStride, indices, positionScale);
+				meshlets.push_back(current);
+
+				current = Meshlet();
+				current.firstIndex = (uint32_t)i;
+				currentIndex++;
+			}
+
+			for (int j = 0; j < 3; ++j) {
+				if (vertexMeshlet[tri[j]] != currentIndex) {
+					vertexMeshlet[tri[j]] = currentIndex;
+					meshletVertices[current.vertexCount++] = tri[j];
+				}
+			}
+
+			current.indexCount += 3;
+		}
+
+		if (current.indexCount > 0) {
+			computeMeshletBounds(current, meshletVertices, positions, normals, vertexStride, indices, positionScale);
+			meshlets.push_back(current);
+		}
+
+		return meshlets;
+	}
+
+
+
+
+
+
+
+
+
+	void MeshletCuller::prepare(const vkx::Context *context, const std::string &shaderPath, const vk::DescriptorBufferInfo &matrixDescriptor) {
+
+		this->context = context;
+
+		// older asset folders don't have the cull shader, just draw everything
+		if (!std::ifstream(shaderPath).good()) {
+			printf("meshlet culling disabled: %s not found\n", shaderPath.c_str());
+			this->enabled = false;
+			return;
+		}
+
+		this->cullData = context->createUniformBuffer(uboCull, 1);
+		this->cullData.descriptor.range = sizeof(uboCull);
+
+
+		// set 0: cull data + per object matrix nodes
+		std::vector<vk::DescriptorSetLayoutBinding> sceneBindings = {
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eCompute, 0),
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1),
+		};
+		this->sceneSetLayout = context->device.createDescriptorSetLayout(vkx::descriptorSetLayoutCreateInfo(sceneBindings));
+
+		// set 1: per target buffers
+		std::vector<vk::DescriptorSetLayoutBinding> targetBindings = {
+			// meshlets
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 0),
+			// source indices
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1),
+			// compacted indices
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 2),
+			// indirect draw command
+			vkx::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 3),
+		};
+		this->targetSetLayout = context->device.createDescriptorSetLayout(vkx::descriptorSetLayoutCreateInfo(targetBindings));
+
+
+		std::array<vk::DescriptorSetLayout, 2> setLayouts = { this->sceneSetLayout, this->targetSetLayout };
+		vk::PushConstantRange pushConstantRange = vkx::pushConstantRange(vk::ShaderStageFlagBits::eCompute, sizeof(CullPushConstants), 0);
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vkx::pipelineLayoutCreateInfo(setLayouts.data(), setLayouts.size());
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		this->pipelineLayout = context->device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+
+		vk::ComputePipelineCreateInfo computePipelineCreateInfo = vkx::computePipelineCreateInfo(this->pipelineLayout);
+		computePipelineCreateInfo.stage = context->loadShader(shaderPath, vk::ShaderStageFlagBits::eCompute);
+		this->pipeline = context->device.createComputePipeline(context->pipelineCache, computePipelineCreateInfo);
+
+
+		// scene set
+		std::vector<vk::DescriptorPoolSize> poolSizes = {
+			vkx::descriptorPoolSize(vk::DescriptorType::eUniformBuffer, 1),
+			vkx::descriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1),
+		};
+		this->descriptorPools.push_back(context->device.createDescriptorPool(vkx::descriptorPoolCreateInfo(poolSizes, 1)));
+		this->sceneSet = context->device.allocateDescriptorSets(vkx::descriptorSetAllocateInfo(this->descriptorPools[0], &this->sceneSetLayout, 1))[0];
+		// force a new pool for the first target
+		this->setsInLastPool = MESHLET_TARGETS_PER_POOL;
+
+		vk::DescriptorBufferInfo matrixInfo = matrixDescriptor;
+		std::vector<vk::WriteDescriptorSet> writes = {
+			vkx::writeDescriptorSet(this->sceneSet, vk::DescriptorType::eUniformBuffer, 0, &this->cullData.descriptor),
+			vkx::writeDescriptorSet(this->sceneSet, vk::DescriptorType::eStorageBuffer, 1, &matrixInfo),
+		};
+		context->device.updateDescriptorSets(writes, nullptr);
+
+		this->enabled = true;
+	}
+
+
+	void MeshletCuller::updateFrustum(const glm::mat4 &projection, const glm::mat4 &view) {
+
+		if (!this->enabled) {
+			return;
+		}
+
+		glm::mat4 viewProj = projection * view;
+
+		// Gribb / Hartmann plane extraction (glm is column major)
+		glm::vec4 row0 = glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+		uboCull.frustumPlanes[0] = row3 + row0;// left
+		uboCull.frustumPlanes[1] = row3 - row0;// right
+		uboCull.frustumPlanes[2] = row3 + row1;// bottom
+		uboCull.frustumPlanes[3] = row3 - row1;// top
+		uboCull.frustumPlanes[4] = row3 + row2;// near (conservative for 0..1 depth)
+		uboCull.frustumPlanes[5] = row3 - row2;// far
+
+		for (auto &plane : uboCull.frustumPlanes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		uboCull.cameraPos = glm::inverse(view)[3];
+
+		this->cullData.copy(uboCull);
+	}
+
+
+	vk::DescriptorSet MeshletCuller::allocateTargetSet() {
+
+		if (!this->freeSets.empty()) {
+			vk::DescriptorSet set = this->freeSets.back();
+			this->freeSets.pop_back();
+			return set;
+		}
+
+		if (this->setsInLastPool >= MESHLET_TARGETS_PER_POOL) {
+			std::vector<vk::DescriptorPoolSize> poolSizes = {
+				vkx::descriptorPoolSize(vk::DescriptorType::eStorageBuffer, 4 * MESHLET_TARGETS_PER_POOL),
+			};
+			this->descriptorPools.push_back(context->device.createDescriptorPool(vkx::descriptorPoolCreateInfo(poolSizes, MESHLET_TARGETS_PER_POOL)));
+			this->setsInLastPool = 0;
+		}
+
+		this->setsInLastPool++;
+		return context->device.allocateDescriptorSets(vkx::descriptorSetAllocateInfo(this->descriptorPools.back(), &this->targetSetLayout, 1))[0];
+	}
+
+
+	MeshletDrawTarget *MeshletCuller::getOrCreateTarget(const void *owner, const std::shared_ptr<MeshBuffer> &meshBuffer) {
+
+		auto key = std::make_pair(owner, (const MeshBuffer*)meshBuffer.get());
+		auto it = this->targets.find(key);
+
+		// the address could have been reused by a different mesh buffer,
+		// or the mesh buffer was evicted and restored (same range, new meshlet buffer)
+		vk::DescriptorBufferInfo sourceIndices = meshBuffer->indexDescriptor();
+		if (it != this->targets.end() && it->second.indexCount == meshBuffer->indexCount && it->second.sourceIndices == sourceIndices &&
+			it->second.meshletData == meshBuffer->meshletData.buffer) {
+			return &it->second;
+		}
+
+		MeshletDrawTarget target;
+		if (it != this->targets.end()) {
+			// keep the descriptor set, only the buffers change
+			// targets are only recreated while recording, after the frame fence was waited on
+			target.descriptorSet = it->second.descriptorSet;
+			it->second.destroy();
+		} else {
+			target.descriptorSet = allocateTargetSet();
+		}
+
+		target.meshBuffer = meshBuffer.get();
+		target.indexCount = meshBuffer->indexCount;
+		target.sourceIndices = sourceIndices;
+		target.meshletData = meshBuffer->meshletData.buffer;
+
+		target.indices = context->createBuffer(
+			vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			meshBuffer->indexCount * sizeof(uint32_t));
+
+		target.drawCommand = context->createBuffer(
+			vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			sizeof(vk::DrawIndexedIndirectCommand));
+
+		std::vector<vk::WriteDescriptorSet> writes = {
+			vkx::writeDescriptorSet(target.descriptorSet, vk::DescriptorType::eStorageBuffer, 0, &meshBuffer->meshletData.descriptor),
+			vkx::writeDescriptorSet(target.descriptorSet, vk::DescriptorType::eStorageBuffer, 1, &target.sourceIndices),
+			vkx::writeDescriptorSet(target.descriptorSet, vk::DescriptorType::eStorageBuffer, 2, &target.indices.descriptor),
+			vkx::writeDescriptorSet(target.descriptorSet, vk::DescriptorType::eStorageBuffer, 3, &target.drawCommand.descriptor),
+		};
+		context->device.updateDescriptorSets(writes, nullptr);
+
+		this->targets[key] = target;
+		return &this->targets[key];
+	}
+
+
+	bool MeshletCuller::add(const void *owner, const std::shared_ptr<MeshBuffer> &meshBuffer, uint32_t objectIndex) {
+
+		if (!this->enabled || meshBuffer->meshlets.size() < 2 || !meshBuffer->meshletData.buffer) {
+			return false;
+		}
+
+		PendingCull cull;
+		cull.target = getOrCreateTarget(owner, meshBuffer);
+		cull.target->lastRecord = this->recordIndex;
+		cull.pushConstants.meshletCount = (uint32_t)meshBuffer->meshlets.size();
+		cull.pushConstants.shortIndices = meshBuffer->indexType == vk::IndexType::eUint16 ? 1 : 0;
+		cull.pushConstants.objectIndex = objectIndex;
+		this->pending.push_back(cull);
+
+		return true;
+	}
+
+
+	void MeshletCuller::prune() {
+
+		for (auto it = this->targets.begin(); it != this->targets.end();) {
+			if (it->second.lastRecord == this->recordIndex) {
+				++it;
+				continue;
+			}
+			it->second.destroy();
+			this->freeSets.push_back(it->second.descriptorSet);
+			it = this->targets.erase(it);
+		}
+	}
+
+
+	void MeshletCuller::record(const vk::CommandBuffer &cmdBuffer) {
+
+		this->meshletCount = 0;
+
+		prune();
+		this->recordIndex++;
+
+		if (!this->enabled || this->pending.empty()) {
+			this->pending.clear();
+			return;
+		}
+
+		// the previous frame's draws must be done reading the draw commands / indices before we reset them
+		vk::MemoryBarrier readBarrier;
+		readBarrier.srcAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead;
+		readBarrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite;
+		cmdBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+			vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+			vk::DependencyFlags(), readBarrier, nullptr, nullptr);
+
+		// reset the draw commands, the cull pass appends to indexCount
+		vk::DrawIndexedIndirectCommand resetCommand;
+		resetCommand.indexCount = 0;
+		resetCommand.instanceCount = 1;
+		resetCommand.firstIndex = 0;
+		resetCommand.firstInstance = 0;
+		for (auto &cull : this->pending) {
+			// the culled indices are relative to the mesh, which can sit anywhere in its geometry pool block
+			resetCommand.vertexOffset = cull.target->meshBuffer->vertexOffset();
+			cmdBuffer.updateBuffer(cull.target->drawCommand.buffer, 0, sizeof(resetCommand), &resetCommand);
+		}
+
+		vk::MemoryBarrier resetBarrier;
+		resetBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		resetBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), resetBarrier, nullptr, nullptr);
+
+
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->pipelineLayout, 0, this->sceneSet, nullptr);
+
+		for (auto &cull : this->pending) {
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->pipelineLayout, 1, cull.target->descriptorSet, nullptr);
+			cmdBuffer.pushConstants(this->pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants), &cull.pushConstants);
+			// one workgroup per meshlet
+			cmdBuffer.dispatch(cull.pushConstants.meshletCount, 1, 1);
+
+			this->meshletCount += cull.pushConstants.meshletCount;
+		}
+
+		// make the compacted indices and draw commands visible to the draws
+		vk::MemoryBarrier cullBarrier;
+		cullBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		cullBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead;
+		cmdBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+			vk::DependencyFlags(), cullBarrier, nullptr, nullptr);
+
+		this->pending.clear();
+	}
+
+
+	const MeshletDrawTarget *MeshletCuller::get(const void *owner, const MeshBuffer *meshBuffer) const {
+		if (!this->enabled) {
+			return nullptr;
+		}
+		auto it = this->targets.find(std::make_pair(owner, meshBuffer));
+		if (it == this->targets.end() || it->second.indexCount != meshBuffer->indexCount) {
+			return nullptr;
+		}
+		return &it->second;
+	}
+
+
+	void MeshletCuller::destroy() {
+
+		for (auto &target : this->targets) {
+			target.second.destroy();
+		}
+		this->targets.clear();
+		this->pending.clear();
+		this->freeSets.clear();
+
+		if (!this->context) {
+			return;
+		}
+
+		const vk::Device &device = this->context->device;
+
+		for (auto &pool : this->descriptorPools) {
+			device.destroyDescriptorPool(pool);
+		}
+		this->descriptorPools.clear();
+
+		if (this->pipeline) {
+			device.destroyPipeline(this->pipeline);
+		}
+		if (this->pipelineLayout) {
+			device.destroyPipelineLayout(this->pipelineLayout);
+		}
+		if (this->sceneSetLayout) {
+			device.destroyDescriptorSetLayout(this->sceneSetLayout);
+		}
+		if (this->targetSetLayout) {
+			device.destroyDescriptorSetLayout(this->targetSetLayout);
+		}
+
+		this->cullData.destroy();
+		this->enabled = false;
+	}
+
+}
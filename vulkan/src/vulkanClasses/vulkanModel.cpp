@@ -12,6 +12,10 @@ namespace vkx {
 		this->meshLoader = new vkx::MeshLoader(context, assetManager);
 	}
 
+	Model::~Model() {
+		delete this->meshLoader;
+	}
+
 
 	void Model::load(const std::string &filename) {
 		this->meshLoader->load(filename);
@@ -37,6 +41,7 @@ namespace vkx {
 
 
 		this->vertexBufferBinding = binding;
+		this->scale = scale;
 
 		this->buffersReady = true;
 	}
@@ -97,6 +102,7 @@ namespace vkx {
 		// more to delete:
 		this->meshLoader->destroy();// todo: implement
 		delete this->meshLoader;
+		this->meshLoader = nullptr;
 	}
 
 
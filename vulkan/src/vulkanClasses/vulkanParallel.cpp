@@ -0,0 +1,64 @@
+#include "vulkanParallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace vkx {
+
+
+	uint32_t workerCount() {
+		static uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+		return count;
+	}
+
+
+
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)> &func) {
+
+		if (count == 0) {
+			return;
+		}
+
+		grainSize = std::max<size_t>(grainSize, 1);
+
+		size_t chunkCount = (count + grainSize - 1) / grainSize;
+		size_t threadCount = std::min<size_t>(workerCount(), chunkCount);
+
+		// not worth starting threads for
+		if (threadCount <= 1) {
+			func(0, count);
+			return;
+		}
+
+		std::atomic<size_t> nextChunk(0);
+
+		auto work = [&]() {
+			for (;;) {
+				size_t chunk = nextChunk.fetch_add(1);
+				if (chunk >= chunkCount) {
+					break;
+				}
+				size_t begin = chunk * grainSize;
+				size_t end = std::min(begin + grainSize, count);
+				func(begin, end);
+			}
+		};
+
+		std::vector<std::future<void>> workers;
+		workers.reserve(threadCount - 1);
+		for (size_t i = 0; i < threadCount - 1; ++i) {
+			workers.push_back(std::async(std::launch::async, work));
+		}
+
+		work();
+
+		// get() rethrows anything a worker threw
+		for (auto &worker : workers) {
+			worker.get();
+		}
+	}
+
+}
@@ -0,0 +1,314 @@
+#include "vulkanPipelineBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace vkx {
+
+
+	// copies count elements into storage, returns the copy (nullptr for none)
+	template <typename T>
+	static const T *copyArray(const T *source, uint32_t count, std::vector<T> &storage) {
+		if (!source || count == 0) {
+			storage.clear();
+			return nullptr;
+		}
+		storage.assign(source, source + count);
+		return storage.data();
+	}
+
+
+
+	void PipelineBatch::add(const std::string &name, const vk::GraphicsPipelineCreateInfo &createInfo) {
+
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->name = name;
+		entry->createInfo = createInfo;
+
+		vk::GraphicsPipelineCreateInfo &info = entry->createInfo;
+
+
+		info.pStages = copyArray(createInfo.pStages, createInfo.stageCount, entry->stages);
+
+		// sized up front, the stages point into it
+		entry->specializations.resize(entry->stages.size());
+		for (size_t i = 0; i < entry->stages.size(); ++i) {
+			const vk::SpecializationInfo *source = entry->stages[i].pSpecializationInfo;
+			if (!source) {
+				continue;
+			}
+			Specialization &specialization = entry->specializations[i];
+			specialization.info = *source;
+			specialization.info.pMapEntries = copyArray(source->pMapEntries, source->mapEntryCount, specialization.mapEntries);
+			specialization.info.pData = copyArray(static_cast<const uint8_t*>(source->pData), (uint32_t)source->dataSize, specialization.data);
+			entry->stages[i].pSpecializationInfo = &specialization.info;
+		}
+
+		if (createInfo.pVertexInputState) {
+			entry->vertexInputState = *createInfo.pVertexInputState;
+			entry->vertexInputState.pVertexBindingDescriptions = copyArray(entry->vertexInputState.pVertexBindingDescriptions, entry->vertexInputState.vertexBindingDescriptionCount, entry->vertexBindings);
+			entry->vertexInputState.pVertexAttributeDescriptions = copyArray(entry->vertexInputState.pVertexAttributeDescriptions, entry->vertexInputState.vertexAttributeDescriptionCount, entry->vertexAttributes);
+			info.pVertexInputState = &entry->vertexInputState;
+		}
+
+		if (createInfo.pInputAssemblyState) {
+			entry->inputAssemblyState = *createInfo.pInputAssemblyState;
+			info.pInputAssemblyState = &entry->inputAssemblyState;
+		}
+
+		if (createInfo.pTessellationState) {
+			entry->tessellationState = *createInfo.pTessellationState;
+			info.pTessellationState = &entry->tessellationState;
+		}
+
+		if (createInfo.pViewportState) {
+			entry->viewportState = *createInfo.pViewportState;
+			entry->viewportState.pViewports = copyArray(entry->viewportState.pViewports, entry->viewportState.viewportCount, entry->viewports);
+			entry->viewportState.pScissors = copyArray(entry->viewportState.pScissors, entry->viewportState.scissorCount, entry->scissors);
+			info.pViewportState = &entry->viewportState;
+		}
+
+		if (createInfo.pRasterizationState) {
+			entry->rasterizationState = *createInfo.pRasterizationState;
+			info.pRasterizationState = &entry->rasterizationState;
+		}
+
+		if (createInfo.pMultisampleState) {
+			entry->multisampleState = *createInfo.pMultisampleState;
+			// one mask word per 32 samples
+			uint32_t maskWords = ((uint32_t)entry->multisampleState.rasterizationSamples + 31) / 32;
+			entry->multisampleState.pSampleMask = copyArray(entry->multisampleState.pSampleMask, maskWords, entry->sampleMask);
+			info.pMultisampleState = &entry->multisampleState;
+		}
+
+		if (createInfo.pDepthStencilState) {
+			entry->depthStencilState = *createInfo.pDepthStencilState;
+			info.pDepthStencilState = &entry->depthStencilState;
+		}
+
+		if (createInfo.pColorBlendState) {
+			entry->colorBlendState = *createInfo.pColorBlendState;
+			entry->colorBlendState.pAttachments = copyArray(entry->colorBlendState.pAttachments, entry->colorBlendState.attachmentCount, entry->colorBlendAttachments);
+			info.pColorBlendState = &entry->colorBlendState;
+		}
+
+		if (createInfo.pDynamicState) {
+			entry->dynamicState = *createInfo.pDynamicState;
+			entry->dynamicState.pDynamicStates = copyArray(entry->dynamicState.pDynamicStates, entry->dynamicState.dynamicStateCount, entry->dynamicStates);
+			info.pDynamicState = &entry->dynamicState;
+		}
+
+		if (find(name)) {
+			throw std::runtime_error("Pipeline " + name + " was already added");
+		}
+		this->entryNames[name] = entry.get();
+		this->entries.push_back(std::move(entry));
+	}
+
+
+
+	PipelineBatch::~PipelineBatch() {
+		destroy();
+	}
+
+	void PipelineBatch::prepare(const vkx::Context *context, vkx::PipelineList *pipelines) {
+		this->context = context;
+		this->pipelines = pipelines;
+	}
+
+	void PipelineBatch::destroy() {
+		for (auto &entry : this->entries) {
+			if (entry->state == Entry::building) {
+				entry->worker.join();
+				entry->state = Entry::created;
+				if (entry->pipeline) {
+					this->pipelines->add(entry->name, entry->pipeline);
+				}
+			}
+		}
+	}
+
+
+
+	PipelineBatch::Entry *PipelineBatch::find(const std::string &name) {
+		auto it = this->entryNames.find(name);
+		return it != this->entryNames.end() ? it->second : nullptr;
+	}
+
+	uint32_t PipelineBatch::createdCount() const {
+		uint32_t count = 0;
+		for (auto &entry : this->entries) {
+			if (entry->state == Entry::created) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+
+
+	void PipelineBatch::create(const std::vector<Entry*> &list, uint32_t threadCount) {
+
+		if (list.empty()) {
+			return;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		threadCount = std::min(threadCount, (uint32_t)list.size());
+
+
+		// pipeline caches are internally synchronized, so every thread creates through the shared
+		// cache and picks up what was loaded from disk (no per thread caches to merge)
+		std::atomic<size_t> next(0);
+		std::mutex errorMutex;
+		std::exception_ptr error;
+
+		auto worker = [&]() {
+			size_t i;
+			while ((i = next++) < list.size()) {
+				Entry &entry = *list[i];
+				try {
+					entry.pipeline = this->context->device.createGraphicsPipeline(this->context->pipelineCache, entry.createInfo, nullptr);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+			}
+		};
+
+		// the calling thread works too
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; ++i) {
+			threads.push_back(std::thread(worker));
+		}
+		worker();
+		for (auto &thread : threads) {
+			thread.join();
+		}
+
+
+		// the created ones are kept either way, so they're still destroyed with the list
+		for (auto entry : list) {
+			if (entry->pipeline) {
+				entry->state = Entry::created;
+				this->pipelines->add(entry->name, entry->pipeline);
+			}
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
+		printf("Pipelines: %d created on %d threads (%d ms), %d of %d described\n", (int)list.size(), (int)threadCount, (int)duration, (int)createdCount(), (int)this->entries.size());
+	}
+
+
+
+	void PipelineBatch::build(uint32_t threadCount) {
+		std::vector<Entry*> list;
+		for (auto &entry : this->entries) {
+			if (entry->state == Entry::described) {
+				list.push_back(entry.get());
+			}
+		}
+		create(list, threadCount);
+	}
+
+	void PipelineBatch::prewarm(const std::vector<std::string> &names, uint32_t threadCount) {
+		std::vector<Entry*> list;
+		for (auto &name : names) {
+			Entry *entry = find(name);
+			if (!entry) {
+				printf("Error: can't prewarm unknown pipeline %s\n", name.c_str());
+				continue;
+			}
+			if (entry->state == Entry::described && std::find(list.begin(), list.end(), entry) == list.end()) {
+				list.push_back(entry);
+			}
+		}
+		create(list, threadCount);
+	}
+
+
+
+	void PipelineBatch::finish(Entry &entry) {
+		entry.worker.join();
+		entry.state = Entry::created;
+		if (entry.error) {
+			std::rethrow_exception(entry.error);
+		}
+		this->pipelines->add(entry.name, entry.pipeline);
+	}
+
+	vk::Pipeline PipelineBatch::get(const std::string &name) {
+
+		Entry *entry = find(name);
+		if (!entry) {
+			// not described here, might have been added to the list directly
+			return this->pipelines->get(name);
+		}
+
+		switch (entry->state) {
+			case Entry::described:
+				create({ entry }, 1);
+				break;
+			case Entry::building:
+				finish(*entry);
+				break;
+			case Entry::created:
+				break;
+		}
+		return entry->pipeline;
+	}
+
+	vk::Pipeline PipelineBatch::getAsync(const std::string &name, vk::Pipeline fallback) {
+
+		Entry *entry = find(name);
+		if (!entry) {
+			return this->pipelines->get(name);
+		}
+
+		if (entry->state == Entry::described) {
+			entry->state = Entry::building;
+			entry->finished = false;
+			entry->worker = std::thread([this, entry]() {
+				try {
+					entry->pipeline = this->context->device.createGraphicsPipeline(this->context->pipelineCache, entry->createInfo, nullptr);
+				} catch (...) {
+					entry->error = std::current_exception();
+				}
+				entry->finished = true;
+			});
+		}
+
+		if (entry->state == Entry::building && entry->finished) {
+			finish(*entry);
+		}
+
+		return entry->state == Entry::created ? entry->pipeline : fallback;
+	}
+
+	bool PipelineBatch::update() {
+		bool ready = false;
+		for (auto &entry : this->entries) {
+			if (entry->state == Entry::building && entry->finished) {
+				finish(*entry);
+				ready = true;
+			}
+		}
+		return ready;
+	}
+
+}
@@ -0,0 +1,188 @@
+#include "vulkanShaders.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/Include/revision.h>
+#include <SPIRV/GlslangToSpv.h>
+
+#include "vulkanTools.h"
+
+// from glslang-default-resource-limits
+namespace glslang {
+	extern const TBuiltInResource DefaultTBuiltInResource;
+}
+
+namespace vkx {
+	namespace shader {
+
+
+		static std::once_flag glslInitialized;
+		static bool glslReady = false;
+
+		void initGlsl() {
+			std::call_once(glslInitialized, []() {
+				glslang::InitializeProcess();
+				glslReady = true;
+			});
+		}
+
+		void finalizeGlsl() {
+			if (glslReady) {
+				glslang::FinalizeProcess();
+				glslReady = false;
+			}
+		}
+
+
+
+		static EShLanguage findLanguage(vk::ShaderStageFlagBits shaderType) {
+			switch (shaderType) {
+				case vk::ShaderStageFlagBits::eVertex:
+					return EShLangVertex;
+				case vk::ShaderStageFlagBits::eTessellationControl:
+					return EShLangTessControl;
+				case vk::ShaderStageFlagBits::eTessellationEvaluation:
+					return EShLangTessEvaluation;
+				case vk::ShaderStageFlagBits::eGeometry:
+					return EShLangGeometry;
+				case vk::ShaderStageFlagBits::eFragment:
+					return EShLangFragment;
+				case vk::ShaderStageFlagBits::eCompute:
+					return EShLangCompute;
+				default:
+					throw std::runtime_error("Unknown shader stage");
+			}
+		}
+
+		// the defines go after the #version line (which has to come first)
+		static std::string addDefines(const std::string& shaderSource, const Defines& defines) {
+			if (defines.empty()) {
+				return shaderSource;
+			}
+
+			std::string block;
+			for (auto &define : defines) {
+				block += "#define " + define.first + " " + define.second + "\n";
+			}
+
+			size_t version = shaderSource.find("#version");
+			if (version == std::string::npos) {
+				return block + shaderSource;
+			}
+			size_t lineEnd = shaderSource.find('\n', version);
+			if (lineEnd == std::string::npos) {
+				return shaderSource + "\n" + block;
+			}
+			// keeps the line numbers in errors right after the defines
+			return shaderSource.substr(0, lineEnd + 1) + block + "#line 2\n" + shaderSource.substr(lineEnd + 1);
+		}
+
+
+
+		SpvBuffer glslToSpv(vk::ShaderStageFlagBits shaderType, const std::string& shaderSource) {
+			return glslToSpv(shaderType, shaderSource, Defines(), "shader");
+		}
+
+		SpvBuffer glslToSpv(vk::ShaderStageFlagBits shaderType, const std::string& shaderSource, const Defines& defines, const std::string& name) {
+
+			initGlsl();
+
+			EShLanguage language = findLanguage(shaderType);
+			std::string source = addDefines(shaderSource, defines);
+			const char *strings[1] = { source.c_str() };
+
+			glslang::TShader shader(language);
+			shader.setStrings(strings, 1);
+
+			EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+			if (!shader.parse(&glslang::DefaultTBuiltInResource, 100, false, messages)) {
+				throw std::runtime_error("Failed to compile " + name + ":\n" + shader.getInfoLog());
+			}
+
+			glslang::TProgram program;
+			program.addShader(&shader);
+			if (!program.link(messages)) {
+				throw std::runtime_error("Failed to link " + name + ":\n" + program.getInfoLog());
+			}
+
+			SpvBuffer spirv;
+			glslang::GlslangToSpv(*program.getIntermediate(language), spirv);
+			return spirv;
+		}
+
+		vk::ShaderModule glslToShaderModule(const vk::Device& device, const vk::ShaderStageFlagBits shaderType, const std::string& shaderSource) {
+			SpvBuffer spirv = glslToSpv(shaderType, shaderSource);
+			vk::ShaderModuleCreateInfo moduleCreateInfo;
+			moduleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+			moduleCreateInfo.pCode = spirv.data();
+			return device.createShaderModule(moduleCreateInfo);
+		}
+
+
+
+		// fnv-1a
+		static uint64_t hashString(uint64_t hash, const std::string& string) {
+			for (unsigned char c : string) {
+				hash ^= c;
+				hash *= 0x100000001b3ull;
+			}
+			// separator, so "ab" + "c" and "a" + "bc" differ
+			hash ^= 0xFF;
+			hash *= 0x100000001b3ull;
+			return hash;
+		}
+
+		SpvBuffer compileCached(vk::ShaderStageFlagBits shaderType, const std::string& fileName, const Defines& defines, const std::string& cacheDirectory) {
+
+			std::string source = readTextFile(fileName);
+
+			// the compiler revision is part of the key, a new glslang recompiles everything
+			uint64_t hash = 0xcbf29ce484222325ull;
+			hash = hashString(hash, GLSLANG_REVISION);
+			hash = hashString(hash, std::to_string((uint32_t)shaderType));
+			hash = hashString(hash, source);
+			for (auto &define : defines) {
+				hash = hashString(hash, define.first);
+				hash = hashString(hash, define.second);
+			}
+
+			char name[64];
+			snprintf(name, sizeof(name), "spirv_%016llx.spv", (unsigned long long)hash);
+			std::string cacheFileName = cacheDirectory.empty() ? std::string(name) : cacheDirectory + "/" + name;
+
+
+			std::ifstream cached(cacheFileName, std::ios::binary | std::ios::ate);
+			if (cached.good()) {
+				size_t size = (size_t)cached.tellg();
+				// anything that isn't whole words starting with the spir-v magic is recompiled
+				if (size >= sizeof(uint32_t) * 5 && size % sizeof(uint32_t) == 0) {
+					SpvBuffer spirv(size / sizeof(uint32_t));
+					cached.seekg(0);
+					if (cached.read(reinterpret_cast<char*>(spirv.data()), size) && spirv[0] == 0x07230203) {
+						return spirv;
+					}
+				}
+			}
+			cached.close();
+
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			SpvBuffer spirv = glslToSpv(shaderType, source, defines, fileName);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
+			printf("Compiled %s (%d ms)\n", fileName.c_str(), (int)duration);
+
+			// a failed write only costs a recompile next time
+			std::ofstream file(cacheFileName, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+
+			return spirv;
+		}
+
+	}
+}
@@ -14,6 +14,8 @@ namespace vkx {
 
 		this->context = context;
 		this->meshLoader = new vkx::MeshLoader(context, assetManager);
+		// animated from the scene
+		this->meshLoader->retention = MESH_RETAIN_SCENE;
 	}
 
 
@@ -38,7 +40,7 @@ namespace vkx {
 		this->meshLoader->setAnimation(animationIndex);
 	}
 
-	// Recursive bone transformation for given animation time
+	// Bone transformations for given animation time
 	void SkinnedMesh::update(float time) {
 		this->meshLoader->update(time);
 	}
@@ -0,0 +1,199 @@
+#include "vulkanStaticBatch.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <map>
+
+namespace vkx {
+
+
+	// one source mesh placed in the world
+	struct BatchItem {
+		const MeshEntry *entry;
+		glm::mat4 transform;
+		glm::vec3 center;
+		uint32_t morton;
+	};
+
+	// meshes sharing a vertex layout and material
+	struct BatchGroup {
+		std::vector<VertexComponent> layout;
+		std::string materialName;
+		std::vector<BatchItem> items;
+		glm::vec3 boundsMin{ FLT_MAX };
+		glm::vec3 boundsMax{ -FLT_MAX };
+	};
+
+
+
+	// spread the lower 10 bits of v out to every third bit
+	static uint32_t expandBits(uint32_t v) {
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	// p in [0, 1]
+	static uint32_t mortonCode(const glm::vec3 &p) {
+		glm::vec3 q = glm::clamp(p * 1023.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+		return (expandBits((uint32_t)q.x) << 2) | (expandBits((uint32_t)q.y) << 1) | expandBits((uint32_t)q.z);
+	}
+
+	static glm::vec3 safeNormalize(const glm::vec3 &v) {
+		float length = glm::length(v);
+		return length > 0.0f ? v / length : v;
+	}
+
+	// world space bounds of a transformed box
+	static void transformBounds(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, glm::vec3 &outMin, glm::vec3 &outMax) {
+		outMin = glm::vec3(FLT_MAX);
+		outMax = glm::vec3(-FLT_MAX);
+		for (int i = 0; i < 8; ++i) {
+			glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+			glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+			outMin = glm::min(outMin, p);
+			outMax = glm::max(outMax, p);
+		}
+	}
+
+
+
+	static std::shared_ptr<MeshBuffer> buildChunk(vkx::Context *context, vkx::AssetManager *assetManager, const BatchGroup &group, const BatchItem *items, size_t itemCount, size_t vertexCount) {
+
+		std::vector<Vertex> vertices;
+		vertices.reserve(vertexCount);
+		std::vector<uint32_t> indices;
+
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+
+		for (size_t i = 0; i < itemCount; ++i) {
+			const BatchItem &item = items[i];
+
+			glm::mat3 tangentMatrix = glm::mat3(item.transform);
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(tangentMatrix));
+
+			uint32_t indexBase = (uint32_t)vertices.size();
+
+			for (auto &v : item.entry->Vertices) {
+				Vertex w = v;
+				w.m_pos = glm::vec3(item.transform * glm::vec4(v.m_pos, 1.0f));
+				w.m_normal = safeNormalize(normalMatrix * v.m_normal);
+				w.m_tangent = safeNormalize(tangentMatrix * v.m_tangent);
+				w.m_binormal = safeNormalize(tangentMatrix * v.m_binormal);
+				boundsMin = glm::min(boundsMin, w.m_pos);
+				boundsMax = glm::max(boundsMax, w.m_pos);
+				vertices.push_back(w);
+			}
+
+			for (auto index : item.entry->Indices) {
+				indices.push_back(index + indexBase);
+			}
+		}
+
+		// already in world space, nothing to scale
+		auto meshBuffer = vkx::createPooledMeshBuffer(assetManager, context, group.layout, vertices, indices, boundsMin, boundsMax, 1.0f, false, "static batch");
+		meshBuffer->dim = boundsMax - boundsMin;
+		meshBuffer->materialIndex = items[0].entry->materialIndex;
+		meshBuffer->materialName = group.materialName;
+		return meshBuffer;
+	}
+
+
+
+	bool canBatch(const Model &model) {
+		// the merged chunks are built from the loader's vertices
+		return model.buffersReady && model.meshLoader && (model.meshLoader->retention & MESH_RETAIN_VERTICES) &&
+			!model.meshBuffers.empty() && model.meshBuffers.size() == model.meshLoader->m_Entries.size();
+	}
+
+
+
+	std::shared_ptr<Model> buildStaticBatch(vkx::Context *context, vkx::AssetManager *assetManager, const std::vector<std::shared_ptr<Model>> &models) {
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		std::map<std::pair<std::vector<VertexComponent>, std::string>, BatchGroup> groups;
+		size_t meshCount = 0;
+		uint32_t binding = 0;
+
+		for (auto &model : models) {
+			if (!canBatch(*model)) {
+				continue;
+			}
+			binding = model->vertexBufferBinding;
+
+			// the mesh loader's vertices are unscaled
+			glm::mat4 transform = model->transfMatrix * glm::scale(glm::mat4(), glm::vec3(model->scale));
+
+			for (size_t i = 0; i < model->meshBuffers.size(); ++i) {
+				const MeshEntry &entry = model->meshLoader->m_Entries[i];
+				if (entry.Vertices.empty()) {
+					continue;
+				}
+
+				BatchGroup &group = groups[std::make_pair(model->meshBuffers[i]->vertexLayout, entry.materialName)];
+				group.layout = model->meshBuffers[i]->vertexLayout;
+				group.materialName = entry.materialName;
+
+				BatchItem item;
+				item.entry = &entry;
+				item.transform = transform;
+				item.morton = 0;
+
+				glm::vec3 boundsMin, boundsMax;
+				transformBounds(transform, entry.boundsMin, entry.boundsMax, boundsMin, boundsMax);
+				item.center = (boundsMin + boundsMax) * 0.5f;
+				group.boundsMin = glm::min(group.boundsMin, boundsMin);
+				group.boundsMax = glm::max(group.boundsMax, boundsMax);
+
+				group.items.push_back(item);
+				meshCount++;
+			}
+		}
+
+
+		auto batch = std::make_shared<Model>(context, assetManager);
+
+		for (auto &iterator : groups) {
+			BatchGroup &group = iterator.second;
+
+			glm::vec3 extent = glm::max(group.boundsMax - group.boundsMin, glm::vec3(1e-6f));
+			for (auto &item : group.items) {
+				item.morton = mortonCode((item.center - group.boundsMin) / extent);
+			}
+			std::sort(group.items.begin(), group.items.end(), [](const BatchItem &a, const BatchItem &b) {
+				return a.morton < b.morton;
+			});
+
+			size_t first = 0;
+			while (first < group.items.size()) {
+				// as many meshes as fit, at least one
+				size_t last = first;
+				size_t vertexCount = 0;
+				while (last < group.items.size() && (last == first || vertexCount + group.items[last].entry->Vertices.size() <= STATIC_BATCH_CHUNK_VERTICES)) {
+					vertexCount += group.items[last].entry->Vertices.size();
+					++last;
+				}
+
+				batch->meshBuffers.push_back(buildChunk(context, assetManager, group, &group.items[first], last - first, vertexCount));
+				first = last;
+			}
+		}
+
+		batch->vertexBufferBinding = binding;
+		batch->staticGeometry = true;
+		batch->buffersReady = true;
+
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
+		printf("Static batch: %d meshes -> %d chunks (%d ms)\n", (int)meshCount, (int)batch->meshBuffers.size(), (int)duration);
+
+		return batch;
+	}
+
+}
@@ -37,6 +37,8 @@ void vkx::TextOverlay::prepareResources() {
 	cmdPoolInfo.queueFamilyIndex = 0; // todo : pass from example base / swap chain
 	cmdPoolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
 
+	vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_UI, "text overlay");
+
 	// Vertex buffer
 	vk::DeviceSize bufferSize = MAX_CHAR_COUNT * sizeof(glm::vec4);
 	vertexBuffer = context.createBuffer(vk::BufferUsageFlagBits::eVertexBuffer, bufferSize);
@@ -0,0 +1,1229 @@
+#include "vulkanTextureCook.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include <gli/generate_mipmaps.hpp>
+
+#include "vulkantools.h"
+#include "vulkanParallel.h"
+
+namespace vkx {
+	namespace texture {
+
+
+		vk::Format format(const gli::texture &texture) {
+			// past astc gli has its own formats (pvrtc, atc, ...) that don't line up with Vulkan's
+			if (texture.empty() || texture.format() > gli::FORMAT_RGBA_ASTC_12X12_SRGB_BLOCK16) {
+				return vk::Format::eUndefined;
+			}
+			return static_cast<vk::Format>(texture.format());
+		}
+
+
+
+		static std::string extension(const std::string &fileName) {
+			size_t dot = fileName.rfind('.');
+			if (dot == std::string::npos) {
+				return "";
+			}
+			std::string ext = fileName.substr(dot + 1);
+			std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			return ext;
+		}
+
+		bool isCookable(const std::string &fileName) {
+			std::string ext = extension(fileName);
+			return ext == "png" || ext == "tga";
+		}
+
+
+
+		//
+		// inflate (rfc 1951), only what png needs
+		//
+
+		struct BitReader {
+			const uint8_t *data;
+			size_t size;
+			size_t pos{ 0 };
+			uint32_t bitBuffer{ 0 };
+			uint32_t bitCount{ 0 };
+
+			BitReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+			uint32_t bits(uint32_t count) {
+				while (bitCount < count) {
+					if (pos >= size) {
+						throw std::runtime_error("png: truncated image data");
+					}
+					bitBuffer |= (uint32_t)data[pos++] << bitCount;
+					bitCount += 8;
+				}
+				uint32_t value = bitBuffer & ((1u << count) - 1);
+				bitBuffer >>= count;
+				bitCount -= count;
+				return value;
+			}
+
+			// stored blocks start on a byte boundary
+			void alignToByte() {
+				bitBuffer = 0;
+				bitCount = 0;
+			}
+		};
+
+		// canonical huffman code: code counts per length and the symbols in code order
+		struct Huffman {
+			uint16_t counts[16];
+			uint16_t symbols[288];
+		};
+
+		static void buildHuffman(Huffman &huffman, const uint8_t *lengths, uint32_t count) {
+			memset(huffman.counts, 0, sizeof(huffman.counts));
+			for (uint32_t i = 0; i < count; ++i) {
+				huffman.counts[lengths[i]]++;
+			}
+			huffman.counts[0] = 0;
+
+			uint16_t offsets[16];
+			offsets[1] = 0;
+			for (uint32_t length = 1; length < 15; ++length) {
+				offsets[length + 1] = offsets[length] + huffman.counts[length];
+			}
+			for (uint32_t symbol = 0; symbol < count; ++symbol) {
+				if (lengths[symbol] != 0) {
+					huffman.symbols[offsets[lengths[symbol]]++] = (uint16_t)symbol;
+				}
+			}
+		}
+
+		static uint32_t decodeSymbol(BitReader &reader, const Huffman &huffman) {
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (uint32_t length = 1; length < 16; ++length) {
+				code |= (int)reader.bits(1);
+				int count = huffman.counts[length];
+				if (code - count < first) {
+					return huffman.symbols[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			throw std::runtime_error("png: bad huffman code");
+		}
+
+		static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		static void inflateCodes(BitReader &reader, const Huffman &lengthCodes, const Huffman &distanceCodes, std::vector<uint8_t> &out) {
+			for (;;) {
+				uint32_t symbol = decodeSymbol(reader, lengthCodes);
+				if (symbol < 256) {
+					out.push_back((uint8_t)symbol);
+				} else if (symbol == 256) {
+					return;
+				} else {
+					symbol -= 257;
+					if (symbol >= 29) {
+						throw std::runtime_error("png: bad length code");
+					}
+					uint32_t length = lengthBase[symbol] + reader.bits(lengthExtra[symbol]);
+
+					uint32_t distanceSymbol = decodeSymbol(reader, distanceCodes);
+					if (distanceSymbol >= 30) {
+						throw std::runtime_error("png: bad distance code");
+					}
+					size_t distance = distanceBase[distanceSymbol] + reader.bits(distanceExtra[distanceSymbol]);
+					if (distance > out.size()) {
+						throw std::runtime_error("png: distance too far back");
+					}
+
+					// byte by byte, the copy may overlap what it writes
+					size_t from = out.size() - distance;
+					for (uint32_t i = 0; i < length; ++i) {
+						out.push_back(out[from + i]);
+					}
+				}
+			}
+		}
+
+		static void inflateDynamic(BitReader &reader, std::vector<uint8_t> &out) {
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			uint32_t lengthCount = reader.bits(5) + 257;
+			uint32_t distanceCount = reader.bits(5) + 1;
+			uint32_t codeLengthCount = reader.bits(4) + 4;
+
+			uint8_t lengths[320];
+			memset(lengths, 0, sizeof(lengths));
+			for (uint32_t i = 0; i < codeLengthCount; ++i) {
+				lengths[order[i]] = (uint8_t)reader.bits(3);
+			}
+
+			Huffman codeLengthCodes;
+			buildHuffman(codeLengthCodes, lengths, 19);
+
+			uint32_t index = 0;
+			while (index < lengthCount + distanceCount) {
+				uint32_t symbol = decodeSymbol(reader, codeLengthCodes);
+				if (symbol < 16) {
+					lengths[index++] = (uint8_t)symbol;
+					continue;
+				}
+
+				uint8_t value = 0;
+				uint32_t repeat;
+				if (symbol == 16) {
+					if (index == 0) {
+						throw std::runtime_error("png: repeat without a previous length");
+					}
+					value = lengths[index - 1];
+					repeat = 3 + reader.bits(2);
+				} else if (symbol == 17) {
+					repeat = 3 + reader.bits(3);
+				} else {
+					repeat = 11 + reader.bits(7);
+				}
+				if (index + repeat > lengthCount + distanceCount) {
+					throw std::runtime_error("png: too many code lengths");
+				}
+				while (repeat--) {
+					lengths[index++] = value;
+				}
+			}
+
+			Huffman lengthCodes, distanceCodes;
+			buildHuffman(lengthCodes, lengths, lengthCount);
+			buildHuffman(distanceCodes, lengths + lengthCount, distanceCount);
+			inflateCodes(reader, lengthCodes, distanceCodes, out);
+		}
+
+		// the fixed codes of block type 1
+		struct FixedHuffman {
+			Huffman lengthCodes;
+			Huffman distanceCodes;
+
+			FixedHuffman() {
+				uint8_t lengths[288];
+				memset(lengths, 8, 144);
+				memset(lengths + 144, 9, 112);
+				memset(lengths + 256, 7, 24);
+				memset(lengths + 280, 8, 8);
+				buildHuffman(lengthCodes, lengths, 288);
+				memset(lengths, 5, 30);
+				buildHuffman(distanceCodes, lengths, 30);
+			}
+		};
+
+		static void inflateFixed(BitReader &reader, std::vector<uint8_t> &out) {
+			// built once, textures may be decoded on several threads
+			static const FixedHuffman fixed;
+			inflateCodes(reader, fixed.lengthCodes, fixed.distanceCodes, out);
+		}
+
+		// zlib stream (rfc 1950), the adler checksum isn't checked
+		static std::vector<uint8_t> inflateZlib(const std::vector<uint8_t> &data, size_t expectedSize) {
+			if (data.size() < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+				throw std::runtime_error("png: bad zlib header");
+			}
+
+			std::vector<uint8_t> out;
+			out.reserve(expectedSize);
+
+			BitReader reader(data.data() + 2, data.size() - 2);
+			uint32_t last = 0;
+			while (!last) {
+				last = reader.bits(1);
+				uint32_t type = reader.bits(2);
+				if (type == 0) {
+					reader.alignToByte();
+					if (reader.pos + 4 > reader.size) {
+						throw std::runtime_error("png: truncated stored block");
+					}
+					uint32_t length = reader.data[reader.pos] | (reader.data[reader.pos + 1] << 8);
+					reader.pos += 4;
+					if (reader.pos + length > reader.size) {
+						throw std::runtime_error("png: truncated stored block");
+					}
+					out.insert(out.end(), reader.data + reader.pos, reader.data + reader.pos + length);
+					reader.pos += length;
+				} else if (type == 1) {
+					inflateFixed(reader, out);
+				} else if (type == 2) {
+					inflateDynamic(reader, out);
+				} else {
+					throw std::runtime_error("png: bad block type");
+				}
+			}
+			return out;
+		}
+
+
+
+		//
+		// png
+		//
+
+		static uint32_t readBigEndian(const uint8_t *p) {
+			return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+		}
+
+		static uint8_t paeth(int a, int b, int c) {
+			int p = a + b - c;
+			int pa = abs(p - a);
+			int pb = abs(p - b);
+			int pc = abs(p - c);
+			if (pa <= pb && pa <= pc) {
+				return (uint8_t)a;
+			}
+			return (uint8_t)(pb <= pc ? b : c);
+		}
+
+		static Image decodePng(const std::vector<uint8_t> &file, const std::string &fileName) {
+
+			static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0) {
+				throw std::runtime_error(fileName + " is not a png");
+			}
+
+			uint32_t width = 0, height = 0;
+			uint32_t bitDepth = 0, colorType = 0, interlace = 0;
+			std::vector<uint8_t> palette;
+			std::vector<uint8_t> paletteAlpha;
+			// tRNS of gray / rgb images, the one color that is transparent
+			bool hasColorKey = false;
+			uint16_t colorKey[3] = { 0, 0, 0 };
+			std::vector<uint8_t> compressed;
+
+			size_t pos = 8;
+			while (pos + 12 <= file.size()) {
+				uint32_t length = readBigEndian(&file[pos]);
+				const uint8_t *type = &file[pos + 4];
+				const uint8_t *data = &file[pos + 8];
+				if (pos + 12 + (size_t)length > file.size()) {
+					throw std::runtime_error(fileName + ": truncated chunk");
+				}
+
+				if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+					width = readBigEndian(data);
+					height = readBigEndian(data + 4);
+					bitDepth = data[8];
+					colorType = data[9];
+					interlace = data[12];
+				} else if (memcmp(type, "PLTE", 4) == 0) {
+					palette.assign(data, data + length);
+				} else if (memcmp(type, "tRNS", 4) == 0) {
+					if (colorType == 3) {
+						paletteAlpha.assign(data, data + length);
+					} else if (colorType == 0 && length >= 2) {
+						hasColorKey = true;
+						colorKey[0] = (uint16_t)((data[0] << 8) | data[1]);
+					} else if (colorType == 2 && length >= 6) {
+						hasColorKey = true;
+						for (uint32_t c = 0; c < 3; ++c) {
+							colorKey[c] = (uint16_t)((data[c * 2] << 8) | data[c * 2 + 1]);
+						}
+					}
+				} else if (memcmp(type, "IDAT", 4) == 0) {
+					compressed.insert(compressed.end(), data, data + length);
+				} else if (memcmp(type, "IEND", 4) == 0) {
+					break;
+				}
+
+				pos += 12 + length;
+			}
+
+			uint32_t channels;
+			switch (colorType) {
+				case 0: channels = 1; break;
+				case 2: channels = 3; break;
+				case 3: channels = 1; break;
+				case 4: channels = 2; break;
+				case 6: channels = 4; break;
+				default: throw std::runtime_error(fileName + ": unknown png color type");
+			}
+			if (width == 0 || height == 0) {
+				throw std::runtime_error(fileName + ": png has no IHDR");
+			}
+			if (interlace != 0) {
+				throw std::runtime_error(fileName + ": interlaced pngs aren't supported");
+			}
+			if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16) {
+				throw std::runtime_error(fileName + ": bad png bit depth");
+			}
+			if (bitDepth < 8 && channels != 1) {
+				throw std::runtime_error(fileName + ": bad png bit depth");
+			}
+			if (colorType == 3 && palette.empty()) {
+				throw std::runtime_error(fileName + ": png has no palette");
+			}
+
+
+			// bytes per row without the filter byte, and the distance filters look back
+			size_t stride = ((size_t)width * channels * bitDepth + 7) / 8;
+			size_t filterStep = std::max<size_t>(1, channels * bitDepth / 8);
+
+			std::vector<uint8_t> raw = inflateZlib(compressed, (stride + 1) * height);
+			if (raw.size() < (stride + 1) * height) {
+				throw std::runtime_error(fileName + ": not enough png image data");
+			}
+
+
+			// undo the per row filters in place, dropping the filter bytes
+			std::vector<uint8_t> pixels(stride * height);
+			for (uint32_t y = 0; y < height; ++y) {
+				uint8_t filter = raw[y * (stride + 1)];
+				const uint8_t *in = &raw[y * (stride + 1) + 1];
+				uint8_t *row = &pixels[y * stride];
+				const uint8_t *previous = y > 0 ? &pixels[(y - 1) * stride] : nullptr;
+
+				for (size_t i = 0; i < stride; ++i) {
+					int a = i >= filterStep ? row[i - filterStep] : 0;
+					int b = previous ? previous[i] : 0;
+					int c = (previous && i >= filterStep) ? previous[i - filterStep] : 0;
+					switch (filter) {
+						case 0: row[i] = in[i]; break;
+						case 1: row[i] = (uint8_t)(in[i] + a); break;
+						case 2: row[i] = (uint8_t)(in[i] + b); break;
+						case 3: row[i] = (uint8_t)(in[i] + ((a + b) >> 1)); break;
+						case 4: row[i] = (uint8_t)(in[i] + paeth(a, b, c)); break;
+						default: throw std::runtime_error(fileName + ": bad png filter");
+					}
+				}
+			}
+
+
+			Image image;
+			image.width = width;
+			image.height = height;
+			image.rgba.resize((size_t)width * height * 4);
+
+			uint32_t maxValue = (1u << std::min<uint32_t>(bitDepth, 8)) - 1;
+
+			for (uint32_t y = 0; y < height; ++y) {
+				const uint8_t *row = &pixels[y * stride];
+				for (uint32_t x = 0; x < width; ++x) {
+
+					// samples at the file's bit depth (before scaling, the color key compares those)
+					uint16_t samples[4] = { 0, 0, 0, 0 };
+					for (uint32_t c = 0; c < channels; ++c) {
+						size_t index = (size_t)x * channels + c;
+						if (bitDepth == 16) {
+							samples[c] = (uint16_t)((row[index * 2] << 8) | row[index * 2 + 1]);
+						} else if (bitDepth == 8) {
+							samples[c] = row[index];
+						} else {
+							size_t bit = index * bitDepth;
+							samples[c] = (uint16_t)((row[bit / 8] >> (8 - bitDepth - bit % 8)) & maxValue);
+						}
+					}
+
+					// 8 bit values, 16 bit samples keep their high byte
+					uint8_t values[4];
+					for (uint32_t c = 0; c < channels; ++c) {
+						values[c] = bitDepth == 16 ? (uint8_t)(samples[c] >> 8) : (uint8_t)(samples[c] * 255 / maxValue);
+					}
+
+					uint8_t *out = &image.rgba[((size_t)y * width + x) * 4];
+					switch (colorType) {
+						case 0:
+							out[0] = out[1] = out[2] = values[0];
+							out[3] = (hasColorKey && samples[0] == colorKey[0]) ? 0 : 255;
+							break;
+						case 2:
+							out[0] = values[0];
+							out[1] = values[1];
+							out[2] = values[2];
+							out[3] = (hasColorKey && samples[0] == colorKey[0] && samples[1] == colorKey[1] && samples[2] == colorKey[2]) ? 0 : 255;
+							break;
+						case 3: {
+							size_t entry = samples[0];
+							if (entry * 3 + 2 >= palette.size()) {
+								throw std::runtime_error(fileName + ": png palette index out of range");
+							}
+							out[0] = palette[entry * 3];
+							out[1] = palette[entry * 3 + 1];
+							out[2] = palette[entry * 3 + 2];
+							out[3] = entry < paletteAlpha.size() ? paletteAlpha[entry] : 255;
+							break;
+						}
+						case 4:
+							out[0] = out[1] = out[2] = values[0];
+							out[3] = values[1];
+							break;
+						case 6:
+							memcpy(out, values, 4);
+							break;
+					}
+				}
+			}
+
+			return image;
+		}
+
+
+
+		//
+		// tga
+		//
+
+		static Image decodeTga(const std::vector<uint8_t> &file, const std::string &fileName) {
+
+			if (file.size() < 18) {
+				throw std::runtime_error(fileName + " is not a tga");
+			}
+
+			uint32_t idLength = file[0];
+			uint32_t colorMapType = file[1];
+			uint32_t imageType = file[2];
+			uint32_t colorMapLength = file[5] | (file[6] << 8);
+			uint32_t colorMapEntrySize = file[7];
+			uint32_t width = file[12] | (file[13] << 8);
+			uint32_t height = file[14] | (file[15] << 8);
+			uint32_t pixelDepth = file[16];
+			uint32_t descriptor = file[17];
+
+			bool rle = imageType == 10 || imageType == 11;
+			bool gray = imageType == 3 || imageType == 11;
+			if (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11) {
+				throw std::runtime_error(fileName + ": only true color and gray tgas are supported");
+			}
+			if (gray ? (pixelDepth != 8 && pixelDepth != 16) : (pixelDepth != 16 && pixelDepth != 24 && pixelDepth != 32)) {
+				throw std::runtime_error(fileName + ": bad tga pixel depth");
+			}
+			if (width == 0 || height == 0) {
+				throw std::runtime_error(fileName + ": empty tga");
+			}
+
+			uint32_t bytesPerPixel = pixelDepth / 8;
+			size_t pos = 18 + idLength + (colorMapType == 1 ? colorMapLength * ((colorMapEntrySize + 7) / 8) : 0);
+			size_t pixelCount = (size_t)width * height;
+
+
+			// expand the rle packets first, the rest works on raw pixels either way
+			std::vector<uint8_t> pixels;
+			if (rle) {
+				pixels.reserve(pixelCount * bytesPerPixel);
+				while (pixels.size() < pixelCount * bytesPerPixel) {
+					if (pos >= file.size()) {
+						throw std::runtime_error(fileName + ": truncated tga");
+					}
+					uint8_t header = file[pos++];
+					uint32_t count = (header & 0x7F) + 1;
+					if (header & 0x80) {
+						if (pos + bytesPerPixel > file.size()) {
+							throw std::runtime_error(fileName + ": truncated tga");
+						}
+						for (uint32_t i = 0; i < count; ++i) {
+							pixels.insert(pixels.end(), file.begin() + pos, file.begin() + pos + bytesPerPixel);
+						}
+						pos += bytesPerPixel;
+					} else {
+						if (pos + count * bytesPerPixel > file.size()) {
+							throw std::runtime_error(fileName + ": truncated tga");
+						}
+						pixels.insert(pixels.end(), file.begin() + pos, file.begin() + pos + count * bytesPerPixel);
+						pos += count * bytesPerPixel;
+					}
+				}
+				pixels.resize(pixelCount * bytesPerPixel);
+			} else {
+				if (pos + pixelCount * bytesPerPixel > file.size()) {
+					throw std::runtime_error(fileName + ": truncated tga");
+				}
+				pixels.assign(file.begin() + pos, file.begin() + pos + pixelCount * bytesPerPixel);
+			}
+
+
+			Image image;
+			image.width = width;
+			image.height = height;
+			image.rgba.resize(pixelCount * 4);
+
+			// rows are stored bottom up unless the top left origin bit is set
+			bool topDown = (descriptor & 0x20) != 0;
+
+			for (uint32_t y = 0; y < height; ++y) {
+				uint32_t sourceRow = topDown ? y : height - 1 - y;
+				for (uint32_t x = 0; x < width; ++x) {
+					const uint8_t *in = &pixels[((size_t)sourceRow * width + x) * bytesPerPixel];
+					uint8_t *out = &image.rgba[((size_t)y * width + x) * 4];
+
+					if (gray) {
+						out[0] = out[1] = out[2] = in[0];
+						out[3] = pixelDepth == 16 ? in[1] : 255;
+					} else if (pixelDepth == 16) {
+						// a1r5g5b5
+						uint32_t value = in[0] | (in[1] << 8);
+						out[0] = (uint8_t)(((value >> 10) & 31) * 255 / 31);
+						out[1] = (uint8_t)(((value >> 5) & 31) * 255 / 31);
+						out[2] = (uint8_t)((value & 31) * 255 / 31);
+						out[3] = (value & 0x8000) ? 255 : 0;
+					} else {
+						// bgr(a)
+						out[0] = in[2];
+						out[1] = in[1];
+						out[2] = in[0];
+						out[3] = pixelDepth == 32 ? in[3] : 255;
+					}
+				}
+			}
+
+			return image;
+		}
+
+
+
+		Image decode(const std::string &fileName) {
+			std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+			if (!file.good()) {
+				throw std::runtime_error("Couldn't open " + fileName);
+			}
+			std::vector<uint8_t> data((size_t)file.tellg());
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+			if (extension(fileName) == "tga") {
+				return decodeTga(data, fileName);
+			}
+			return decodePng(data, fileName);
+		}
+
+
+
+		//
+		// mips
+		//
+
+		// 2x2 box filter, odd edges repeat the last texel
+		// normal maps are renormalized so the shorter averaged vectors don't darken the lighting
+		static Image downsample(const Image &source, bool normalMap) {
+			Image image;
+			image.width = std::max(1u, source.width / 2);
+			image.height = std::max(1u, source.height / 2);
+			image.rgba.resize((size_t)image.width * image.height * 4);
+
+			for (uint32_t y = 0; y < image.height; ++y) {
+				uint32_t y0 = std::min(y * 2, source.height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+				for (uint32_t x = 0; x < image.width; ++x) {
+					uint32_t x0 = std::min(x * 2, source.width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+					const uint8_t *a = &source.rgba[((size_t)y0 * source.width + x0) * 4];
+					const uint8_t *b = &source.rgba[((size_t)y0 * source.width + x1) * 4];
+					const uint8_t *c = &source.rgba[((size_t)y1 * source.width + x0) * 4];
+					const uint8_t *d = &source.rgba[((size_t)y1 * source.width + x1) * 4];
+					uint8_t *out = &image.rgba[((size_t)y * image.width + x) * 4];
+
+					for (uint32_t i = 0; i < 4; ++i) {
+						out[i] = (uint8_t)((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+					}
+
+					if (normalMap) {
+						float n[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							n[i] = (a[i] + b[i] + c[i] + d[i]) / 510.0f - 1.0f;
+						}
+						float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+						if (length > 0.0f) {
+							for (uint32_t i = 0; i < 3; ++i) {
+								out[i] = (uint8_t)std::min(255.0f, std::max(0.0f, (n[i] / length * 0.5f + 0.5f) * 255.0f + 0.5f));
+							}
+						}
+					}
+				}
+			}
+
+			return image;
+		}
+
+
+
+		//
+		// block compression
+		//
+
+		static uint16_t packRgb565(const float color[3]) {
+			uint32_t r = (uint32_t)(std::min(255.0f, std::max(0.0f, color[0])) * 31.0f / 255.0f + 0.5f);
+			uint32_t g = (uint32_t)(std::min(255.0f, std::max(0.0f, color[1])) * 63.0f / 255.0f + 0.5f);
+			uint32_t b = (uint32_t)(std::min(255.0f, std::max(0.0f, color[2])) * 31.0f / 255.0f + 0.5f);
+			return (uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		static void unpackRgb565(uint16_t value, int color[3]) {
+			int r = (value >> 11) & 31;
+			int g = (value >> 5) & 63;
+			int b = value & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+
+		// bc1 color block (also the color half of bc3)
+		// endpoints are the extremes along the principal axis of the block's colors, always the 4 color mode
+		static void encodeColorBlock(const uint8_t texels[16][4], uint8_t *out) {
+
+			float mean[3] = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 0; i < 16; ++i) {
+				for (uint32_t c = 0; c < 3; ++c) {
+					mean[c] += texels[i][c] / 16.0f;
+				}
+			}
+
+			float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 0; i < 16; ++i) {
+				float r = texels[i][0] - mean[0];
+				float g = texels[i][1] - mean[1];
+				float b = texels[i][2] - mean[2];
+				covariance[0] += r * r;
+				covariance[1] += r * g;
+				covariance[2] += r * b;
+				covariance[3] += g * g;
+				covariance[4] += g * b;
+				covariance[5] += b * b;
+			}
+
+			// power iteration for the principal axis
+			float axis[3] = { 1.0f, 1.0f, 1.0f };
+			for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+				float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+				float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+				float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+				float length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+				if (length < 1e-6f) {
+					break;
+				}
+				axis[0] = x / length;
+				axis[1] = y / length;
+				axis[2] = z / length;
+			}
+			float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+			float minProjection = 0.0f;
+			float maxProjection = 0.0f;
+			for (uint32_t i = 0; i < 16; ++i) {
+				float projection = 0.0f;
+				for (uint32_t c = 0; c < 3; ++c) {
+					projection += (texels[i][c] - mean[c]) * axis[c];
+				}
+				minProjection = std::min(minProjection, projection);
+				maxProjection = std::max(maxProjection, projection);
+			}
+
+			float colorMax[3], colorMin[3];
+			for (uint32_t c = 0; c < 3; ++c) {
+				colorMax[c] = mean[c] + axis[c] * maxProjection / axisLength;
+				colorMin[c] = mean[c] + axis[c] * minProjection / axisLength;
+			}
+
+			uint16_t color0 = packRgb565(colorMax);
+			uint16_t color1 = packRgb565(colorMin);
+			// color0 > color1 selects the 4 color mode
+			if (color0 < color1) {
+				std::swap(color0, color1);
+			}
+
+			uint32_t indices = 0;
+			if (color0 != color1) {
+				int palette[4][3];
+				unpackRgb565(color0, palette[0]);
+				unpackRgb565(color1, palette[1]);
+				for (uint32_t c = 0; c < 3; ++c) {
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+
+				for (uint32_t i = 0; i < 16; ++i) {
+					uint32_t best = 0;
+					int bestDistance = INT_MAX;
+					for (uint32_t p = 0; p < 4; ++p) {
+						int distance = 0;
+						for (uint32_t c = 0; c < 3; ++c) {
+							int d = texels[i][c] - palette[p][c];
+							distance += d * d;
+						}
+						if (distance < bestDistance) {
+							bestDistance = distance;
+							best = p;
+						}
+					}
+					indices |= best << (i * 2);
+				}
+			}
+
+			out[0] = (uint8_t)(color0 & 0xFF);
+			out[1] = (uint8_t)(color0 >> 8);
+			out[2] = (uint8_t)(color1 & 0xFF);
+			out[3] = (uint8_t)(color1 >> 8);
+			out[4] = (uint8_t)(indices & 0xFF);
+			out[5] = (uint8_t)((indices >> 8) & 0xFF);
+			out[6] = (uint8_t)((indices >> 16) & 0xFF);
+			out[7] = (uint8_t)(indices >> 24);
+		}
+
+		// bc4 block of one channel (bc3 alpha, bc5 x and y), 8 value mode between the min and max
+		static void encodeChannelBlock(const uint8_t texels[16][4], uint32_t channel, uint8_t *out) {
+
+			uint8_t value0 = 0;
+			uint8_t value1 = 255;
+			for (uint32_t i = 0; i < 16; ++i) {
+				value0 = std::max(value0, texels[i][channel]);
+				value1 = std::min(value1, texels[i][channel]);
+			}
+
+			uint64_t indices = 0;
+			if (value0 != value1) {
+				int palette[8];
+				palette[0] = value0;
+				palette[1] = value1;
+				for (int p = 2; p < 8; ++p) {
+					palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7;
+				}
+
+				for (uint32_t i = 0; i < 16; ++i) {
+					uint64_t best = 0;
+					int bestDistance = INT_MAX;
+					for (uint32_t p = 0; p < 8; ++p) {
+						int distance = abs(texels[i][channel] - palette[p]);
+						if (distance < bestDistance) {
+							bestDistance = distance;
+							best = p;
+						}
+					}
+					indices |= best << (i * 3);
+				}
+			}
+
+			out[0] = value0;
+			out[1] = value1;
+			for (uint32_t i = 0; i < 6; ++i) {
+				out[2 + i] = (uint8_t)((indices >> (i * 8)) & 0xFF);
+			}
+		}
+
+		static void encodeBlock(gli::format format, const uint8_t texels[16][4], uint8_t *out) {
+			switch (format) {
+				case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8:
+					encodeColorBlock(texels, out);
+					break;
+				case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16:
+					encodeChannelBlock(texels, 3, out);
+					encodeColorBlock(texels, out + 8);
+					break;
+				case gli::FORMAT_R_ATI1N_UNORM_BLOCK8:
+					encodeChannelBlock(texels, 0, out);
+					break;
+				case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16:
+					encodeChannelBlock(texels, 0, out);
+					encodeChannelBlock(texels, 1, out + 8);
+					break;
+				default:
+					throw std::runtime_error("No encoder for this block format");
+			}
+		}
+
+
+
+		// level0Blocks: already encoded blocks of the top level in this format, copied instead of encoded again
+		static gli::texture2d encodeAs(const Image &image, gli::format format, bool normalMap, const void *level0Blocks = nullptr) {
+
+			uint32_t blockSize = (uint32_t)gli::block_size(format);
+
+			gli::texture2d texture(format, gli::extent2d(image.width, image.height));
+
+			uint32_t firstLevel = 0;
+			if (level0Blocks) {
+				memcpy(texture[0].data(), level0Blocks, texture[0].size());
+				firstLevel = 1;
+			}
+
+
+			// the whole chain up front, then every block row of every level is one work item
+			std::vector<Image> levels;
+			levels.reserve(texture.levels());
+			levels.push_back(image);
+			for (size_t level = 1; level < texture.levels(); ++level) {
+				levels.push_back(downsample(levels.back(), normalMap));
+			}
+
+			struct BlockRow {
+				uint32_t level;
+				uint32_t row;
+			};
+			std::vector<BlockRow> rows;
+			std::vector<uint8_t*> destinations;
+			for (uint32_t level = 0; level < levels.size(); ++level) {
+				uint32_t blocksY = level >= firstLevel ? (levels[level].height + 3) / 4 : 0;
+				for (uint32_t row = 0; row < blocksY; ++row) {
+					rows.push_back({ level, row });
+				}
+				destinations.push_back(static_cast<uint8_t*>(texture[level].data()));
+			}
+
+			vkx::parallelFor(rows.size(), TEXTURE_COOK_GRAIN_ROWS, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; ++i) {
+					const Image &source = levels[rows[i].level];
+					uint32_t blocksX = (source.width + 3) / 4;
+					uint8_t *out = destinations[rows[i].level] + (size_t)rows[i].row * blocksX * blockSize;
+
+					for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+						// blocks past the edge of small mips repeat the last texel
+						uint8_t texels[16][4];
+						for (uint32_t y = 0; y < 4; ++y) {
+							uint32_t sourceY = std::min(rows[i].row * 4 + y, source.height - 1);
+							for (uint32_t x = 0; x < 4; ++x) {
+								uint32_t sourceX = std::min(blockX * 4 + x, source.width - 1);
+								memcpy(texels[y * 4 + x], &source.rgba[((size_t)sourceY * source.width + sourceX) * 4], 4);
+							}
+						}
+						encodeBlock(format, texels, out + blockX * blockSize);
+					}
+				}
+			});
+
+			return texture;
+		}
+
+
+
+		gli::texture2d encode(const Image &image, Usage usage) {
+
+			bool hasAlpha = false;
+			for (size_t i = 3; i < image.rgba.size(); i += 4) {
+				if (image.rgba[i] != 255) {
+					hasAlpha = true;
+					break;
+				}
+			}
+
+			gli::format format = gli::FORMAT_RGB_DXT1_UNORM_BLOCK8;
+			if (usage == Usage::eNormal) {
+				format = gli::FORMAT_RG_ATI2N_UNORM_BLOCK16;
+			} else if (hasAlpha) {
+				format = gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+			}
+
+			return encodeAs(image, format, usage == Usage::eNormal);
+		}
+
+
+
+		//
+		// block decoding, for compressed textures that come without mips
+		//
+
+		// bc1 color block, threeColorMode: color0 <= color1 selects 3 colors + transparent black (bc1 only)
+		static void decodeColorBlock(const uint8_t *in, bool threeColorMode, uint8_t texels[16][4]) {
+			uint16_t color0 = (uint16_t)(in[0] | (in[1] << 8));
+			uint16_t color1 = (uint16_t)(in[2] | (in[3] << 8));
+
+			int palette[4][4];
+			unpackRgb565(color0, palette[0]);
+			unpackRgb565(color1, palette[1]);
+			palette[0][3] = 255;
+			palette[1][3] = 255;
+			if (color0 > color1 || !threeColorMode) {
+				for (uint32_t c = 0; c < 3; ++c) {
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+				palette[2][3] = 255;
+				palette[3][3] = 255;
+			} else {
+				for (uint32_t c = 0; c < 3; ++c) {
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+					palette[3][c] = 0;
+				}
+				palette[2][3] = 255;
+				palette[3][3] = 0;
+			}
+
+			uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+			for (uint32_t i = 0; i < 16; ++i) {
+				const int *color = palette[(indices >> (i * 2)) & 3];
+				for (uint32_t c = 0; c < 4; ++c) {
+					texels[i][c] = (uint8_t)color[c];
+				}
+			}
+		}
+
+		// bc4 block (bc3 alpha, bc5 x and y), both the 8 and the 6 value mode
+		static void decodeChannelBlock(const uint8_t *in, uint32_t channel, uint8_t texels[16][4]) {
+			int value0 = in[0];
+			int value1 = in[1];
+
+			int palette[8];
+			palette[0] = value0;
+			palette[1] = value1;
+			if (value0 > value1) {
+				for (int p = 2; p < 8; ++p) {
+					palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7;
+				}
+			} else {
+				for (int p = 2; p < 6; ++p) {
+					palette[p] = ((6 - p) * value0 + (p - 1) * value1) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 6; ++i) {
+				indices |= (uint64_t)in[2 + i] << (i * 8);
+			}
+			for (uint32_t i = 0; i < 16; ++i) {
+				texels[i][channel] = (uint8_t)palette[(indices >> (i * 3)) & 7];
+			}
+		}
+
+		// bc2 alpha, 4 bits per texel
+		static void decodeExplicitAlphaBlock(const uint8_t *in, uint8_t texels[16][4]) {
+			for (uint32_t i = 0; i < 16; ++i) {
+				texels[i][3] = (uint8_t)(((in[i / 2] >> ((i % 2) * 4)) & 15) * 17);
+			}
+		}
+
+		static bool decodableFormat(gli::format format) {
+			switch (format) {
+				case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8:
+				case gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8:
+				case gli::FORMAT_RGBA_DXT3_UNORM_BLOCK16:
+				case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16:
+				case gli::FORMAT_R_ATI1N_UNORM_BLOCK8:
+				case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		static void decodeBlock(gli::format format, const uint8_t *in, uint8_t texels[16][4]) {
+			memset(texels, 0, 16 * 4);
+			switch (format) {
+				case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8:
+					decodeColorBlock(in, true, texels);
+					// black, not transparent
+					for (uint32_t i = 0; i < 16; ++i) {
+						texels[i][3] = 255;
+					}
+					break;
+				case gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8:
+					decodeColorBlock(in, true, texels);
+					break;
+				case gli::FORMAT_RGBA_DXT3_UNORM_BLOCK16:
+					decodeColorBlock(in + 8, false, texels);
+					decodeExplicitAlphaBlock(in, texels);
+					break;
+				case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16:
+					decodeColorBlock(in + 8, false, texels);
+					decodeChannelBlock(in, 3, texels);
+					break;
+				case gli::FORMAT_R_ATI1N_UNORM_BLOCK8:
+					decodeChannelBlock(in, 0, texels);
+					for (uint32_t i = 0; i < 16; ++i) {
+						texels[i][3] = 255;
+					}
+					break;
+				case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16:
+					decodeChannelBlock(in, 0, texels);
+					decodeChannelBlock(in + 8, 1, texels);
+					// z from x and y, so the mips can be renormalized
+					for (uint32_t i = 0; i < 16; ++i) {
+						float x = texels[i][0] / 127.5f - 1.0f;
+						float y = texels[i][1] / 127.5f - 1.0f;
+						float z = sqrtf(std::max(1.0f - x * x - y * y, 0.0f));
+						texels[i][2] = (uint8_t)(z * 127.5f + 127.5f);
+						texels[i][3] = 255;
+					}
+					break;
+				default:
+					throw std::runtime_error("No decoder for this block format");
+			}
+		}
+
+		// the first level as rgba
+		static Image decodeLevel(const gli::texture2d &texture) {
+			gli::format format = texture.format();
+			uint32_t blockSize = (uint32_t)gli::block_size(format);
+
+			Image image;
+			image.width = (uint32_t)texture[0].extent().x;
+			image.height = (uint32_t)texture[0].extent().y;
+			image.rgba.resize((size_t)image.width * image.height * 4);
+
+			uint32_t blocksX = (image.width + 3) / 4;
+			uint32_t blocksY = (image.height + 3) / 4;
+			const uint8_t *in = static_cast<const uint8_t*>(texture[0].data());
+
+			vkx::parallelFor(blocksY, TEXTURE_COOK_GRAIN_ROWS, [&](size_t first, size_t last) {
+				for (size_t blockY = first; blockY < last; ++blockY) {
+					for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+						uint8_t texels[16][4];
+						decodeBlock(format, in + (blockY * blocksX + blockX) * blockSize, texels);
+
+						for (uint32_t y = 0; y < 4; ++y) {
+							uint32_t imageY = (uint32_t)blockY * 4 + y;
+							for (uint32_t x = 0; x < 4; ++x) {
+								uint32_t imageX = blockX * 4 + x;
+								if (imageX < image.width && imageY < image.height) {
+									memcpy(&image.rgba[((size_t)imageY * image.width + imageX) * 4], texels[y * 4 + x], 4);
+								}
+							}
+						}
+					}
+				}
+			});
+
+			return image;
+		}
+
+
+
+		bool canGenerateMips(vk::Format format) {
+			if (format == vk::Format::eUndefined || format > vk::Format::eAstc12x12SrgbBlock) {
+				return false;
+			}
+			if (format >= vk::Format::eD16Unorm && format <= vk::Format::eD32SfloatS8Uint) {
+				return false;
+			}
+			gli::format gliFormat = static_cast<gli::format>(format);
+			return gli::is_compressed(gliFormat) ? decodableFormat(gliFormat) : true;
+		}
+
+		gli::texture2d generateMips(const gli::texture2d &texture, Usage usage) {
+
+			gli::format format = texture.format();
+
+			if (!gli::is_compressed(format)) {
+				gli::texture2d chain(format, texture.extent());
+				memcpy(chain[0].data(), texture[0].data(), texture[0].size());
+				return gli::generate_mipmaps(chain, gli::FILTER_LINEAR);
+			}
+
+			if (!decodableFormat(format)) {
+				throw std::runtime_error("No cpu mip generation for this block format");
+			}
+
+			// the encoders cover bc1 (opaque), bc3, bc4 and bc5, bc2 and bc1 with alpha become bc3
+			gli::format chainFormat = format;
+			if (format == gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8 || format == gli::FORMAT_RGBA_DXT3_UNORM_BLOCK16) {
+				chainFormat = gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16;
+			}
+
+			bool normalMap = usage == Usage::eNormal || format == gli::FORMAT_RG_ATI2N_UNORM_BLOCK16;
+			// the top level is only decoded to downsample from, in its own format it's kept as it was
+			const void *level0Blocks = chainFormat == format ? texture[0].data() : nullptr;
+			return encodeAs(decodeLevel(texture), chainFormat, normalMap, level0Blocks);
+		}
+
+
+
+		// fnv-1a
+		static uint64_t hashString(uint64_t hash, const std::string &string) {
+			for (unsigned char c : string) {
+				hash ^= c;
+				hash *= 0x100000001b3ull;
+			}
+			hash ^= 0xFF;
+			hash *= 0x100000001b3ull;
+			return hash;
+		}
+
+		static const char *formatName(gli::format format) {
+			switch (format) {
+				case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8: return "BC1";
+				case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16: return "BC3";
+				case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16: return "BC5";
+				default: return "?";
+			}
+		}
+
+		std::string cook(const std::string &fileName, Usage usage, const std::string &cacheDirectory) {
+
+			struct stat info;
+			if (stat(fileName.c_str(), &info) != 0) {
+				throw std::runtime_error("Couldn't open " + fileName);
+			}
+
+			uint64_t hash = 0xcbf29ce484222325ull;
+			hash = hashString(hash, std::to_string(TEXTURE_COOK_VERSION));
+			hash = hashString(hash, fileName);
+			hash = hashString(hash, std::to_string((long long)info.st_size));
+			hash = hashString(hash, std::to_string((long long)info.st_mtime));
+			hash = hashString(hash, std::to_string((uint32_t)usage));
+
+			char name[64];
+			snprintf(name, sizeof(name), "texture_%016llx.ktx", (unsigned long long)hash);
+			std::string cacheFileName = cacheDirectory.empty() ? std::string(name) : cacheDirectory + "/" + name;
+
+			if (std::ifstream(cacheFileName, std::ios::binary).good()) {
+				return cacheFileName;
+			}
+
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+
+			Image image = decode(fileName);
+			gli::texture2d texture = encode(image, usage);
+
+			// written next to the cache file first, a half written ktx is never picked up
+			std::string tempFileName = cacheFileName + ".tmp";
+			if (!gli::save_ktx(texture, tempFileName)) {
+				throw std::runtime_error("Couldn't write " + tempFileName);
+			}
+			std::remove(cacheFileName.c_str());
+			if (std::rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+				std::remove(tempFileName.c_str());
+				throw std::runtime_error("Couldn't write " + cacheFileName);
+			}
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
+			printf("Cooked %s: %dx%d %s, %d mips (%d ms)\n", fileName.c_str(), (int)image.width, (int)image.height, formatName(texture.format()), (int)texture.levels(), (int)duration);
+
+			return cacheFileName;
+		}
+
+
+
+		gli::texture2d load2D(const std::string &fileName, Usage usage, const std::string &cacheDirectory) {
+
+			if (!isCookable(fileName)) {
+				return gli::texture2d(gli::load(fileName));
+			}
+
+			if (!std::ifstream(fileName, std::ios::binary).good()) {
+				std::string fileNameKTX = fileName.substr(0, fileName.rfind('.')) + ".ktx";
+				printf("Info: %s not found, loading %s\n", fileName.c_str(), fileNameKTX.c_str());
+				return gli::texture2d(gli::load(fileNameKTX));
+			}
+
+			std::string cooked = cook(fileName, usage, cacheDirectory);
+			gli::texture2d texture(gli::load(cooked));
+			if (texture.empty()) {
+				// unreadable cache file, cook it again
+				std::remove(cooked.c_str());
+				texture = gli::texture2d(gli::load(cook(fileName, usage, cacheDirectory)));
+			}
+			return texture;
+		}
+
+	}
+}
@@ -1,5 +1,10 @@
 #include "vulkanTextureLoader.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include "vulkanParallel.h"
+
 //vkx::TextureLoader::TextureLoader(const Context &context) {
 //	this->context = &context;
 //
@@ -62,9 +67,91 @@ vkx::TextureLoader::~TextureLoader() {
 	context.device.freeCommandBuffers(context.getCommandPool(), cmdBuffer);
 }
 
-// Load a 2D texture
+vk::Sampler vkx::createSampler2D(const Context &context, uint32_t mipLevels) {
+	vk::SamplerCreateInfo sampler;
+	sampler.magFilter = vk::Filter::eLinear;
+	sampler.minFilter = vk::Filter::eLinear;
+	sampler.mipmapMode = vk::SamplerMipmapMode::eLinear;
+	// the view has the mip levels, so textures with any mip count share the sampler
+	sampler.maxLod = mipLevels > 1 ? VK_LOD_CLAMP_NONE : 0.0f;
+	// Enable anisotropic filtering
+	sampler.maxAnisotropy = 8;
+	sampler.anisotropyEnable = VK_TRUE;
+	sampler.borderColor = vk::BorderColor::eFloatOpaqueWhite;
+	return context.getSampler(sampler);
+}
 
-vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::Format format, bool forceLinear, vk::ImageUsageFlags imageUsageFlags) {
+vk::ImageView vkx::createView2D(const Context &context, vk::Image image, vk::Format format, uint32_t mipLevels) {
+	vk::ImageViewCreateInfo view;
+	view.viewType = vk::ImageViewType::e2D;
+	view.format = format;
+	view.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1 };
+	view.image = image;
+	return context.device.createImageView(view);
+}
+
+// levels down to 1x1
+static uint32_t mipCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+// the device can make the mips with linear blits (not true for block compressed formats)
+static bool canBlitMips(const vkx::Context &context, vk::Format format) {
+	vk::FormatFeatureFlags needed = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	return (context.physicalDevice.getFormatProperties(format).optimalTilingFeatures & needed) == needed;
+}
+
+// fills levels 1..mipLevels-1 from level 0, every level starts in transfer dst and ends up shader read only
+// (the image needs transfer src usage)
+static void blitMips(vk::CommandBuffer cmdBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels, vk::PipelineStageFlags dstStageMask) {
+	for (uint32_t i = 1; i < mipLevels; ++i) {
+		// the level above is written, read it
+		vkx::setImageLayout(
+			cmdBuffer,
+			image,
+			vk::ImageAspectFlagBits::eColor,
+			vk::ImageLayout::eTransferDstOptimal,
+			vk::ImageLayout::eTransferSrcOptimal,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i - 1, 1, 0, 1),
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eTransfer);
+
+		vk::ImageBlit blit;
+		blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1, 0, 1);
+		blit.srcOffsets[1] = vk::Offset3D((int32_t)std::max(width >> (i - 1), 1u), (int32_t)std::max(height >> (i - 1), 1u), 1);
+		blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1);
+		blit.dstOffsets[1] = vk::Offset3D((int32_t)std::max(width >> i, 1u), (int32_t)std::max(height >> i, 1u), 1);
+		cmdBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+	}
+
+	// all but the last level were blit sources
+	if (mipLevels > 1) {
+		vkx::setImageLayout(
+			cmdBuffer,
+			image,
+			vk::ImageAspectFlagBits::eColor,
+			vk::ImageLayout::eTransferSrcOptimal,
+			vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels - 1, 0, 1),
+			vk::PipelineStageFlagBits::eTransfer,
+			dstStageMask);
+	}
+	vkx::setImageLayout(
+		cmdBuffer,
+		image,
+		vk::ImageAspectFlagBits::eColor,
+		vk::ImageLayout::eTransferDstOptimal,
+		vk::ImageLayout::eShaderReadOnlyOptimal,
+		vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, mipLevels - 1, 1, 0, 1),
+		vk::PipelineStageFlagBits::eTransfer,
+		dstStageMask);
+}
+
+gli::texture2d vkx::TextureLoader::loadFile2D(const std::string & filename, texture::Usage usage) {
 	#if defined(__ANDROID__)
 	assert(assetManager != nullptr);
 
@@ -82,27 +169,72 @@ vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::F
 	gli::texture2d tex2D(gli::load((const char*)textureData, size));
 
 	free(textureData);
+
+	return tex2D;
 	#else
+	return texture::load2D(filename, usage, context.textureCacheDirectory);
+	#endif
+}
+
+// Load a 2D texture
+
+vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, texture::Usage usage, bool forceLinear, vk::ImageUsageFlags imageUsageFlags) {
+	gli::texture2d tex2D = loadFile2D(filename, usage);
+	if (tex2D.empty()) {
+		throw std::runtime_error("Couldn't load texture " + filename);
+	}
 
-	std::string ext = filename.substr(filename.length()-3, 3);
-	std::string filenameKTX = filename;
-	if (ext == "png") {
-		filenameKTX = filename.substr(0, filename.length() - 3);
-		filenameKTX = filenameKTX + "ktx";
+	vk::Format format = texture::format(tex2D);
+	if (format == vk::Format::eUndefined) {
+		throw std::runtime_error(filename + " has no Vulkan format");
 	}
 
-	gli::texture2d tex2D(gli::load(filenameKTX.c_str()));
+	vkx::memory::Scope memoryScope(filename.c_str());
+	return createTexture2D(tex2D, format, usage, forceLinear, imageUsageFlags);
+}
 
-	#endif
-	assert(!tex2D.empty());
+vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::Format format, bool forceLinear, vk::ImageUsageFlags imageUsageFlags) {
+	gli::texture2d tex2D = loadFile2D(filename, texture::Usage::eColor);
+	if (tex2D.empty()) {
+		throw std::runtime_error("Couldn't load texture " + filename);
+	}
+
+	// the header knows better
+	vk::Format fileFormat = texture::format(tex2D);
+	if (fileFormat != vk::Format::eUndefined && fileFormat != format) {
+		printf("Warning: %s is %s, not %s\n", filename.c_str(), vk::to_string(fileFormat).c_str(), vk::to_string(format).c_str());
+		format = fileFormat;
+	}
+
+	vkx::memory::Scope memoryScope(filename.c_str());
+	return createTexture2D(tex2D, format, texture::Usage::eColor, forceLinear, imageUsageFlags);
+}
 
+vkx::Texture vkx::TextureLoader::createTexture2D(const gli::texture2d & source, vk::Format format, texture::Usage usage, bool forceLinear, vk::ImageUsageFlags imageUsageFlags) {
 	Texture texture;
 	texture.device = this->context.device;
 
+	gli::texture2d tex2D = source;
+
 	texture.extent.width = (uint32_t)tex2D[0].extent().x;
 	texture.extent.height = (uint32_t)tex2D[0].extent().y;
 	texture.mipLevels = tex2D.levels();
 
+	// a single level file: blit the mips where the format allows it, else make them on the cpu
+	// (the cpu path may change the format, BC2 comes back as BC3)
+	bool blitMipLevels = false;
+	uint32_t fullMipLevels = mipCount(texture.extent.width, texture.extent.height);
+	if (generateMissingMips && !forceLinear && texture.mipLevels == 1 && fullMipLevels > 1) {
+		if (canBlitMips(context, format)) {
+			blitMipLevels = true;
+			texture.mipLevels = fullMipLevels;
+		} else if (texture::canGenerateMips(format)) {
+			tex2D = texture::generateMips(tex2D, usage);
+			format = texture::format(tex2D);
+			texture.mipLevels = tex2D.levels();
+		}
+	}
+
 	// Get device properites for the requested texture format
 	vk::FormatProperties formatProperties;
 	formatProperties = context.physicalDevice.getFormatProperties(format);
@@ -141,7 +273,7 @@ vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::F
 		bufferCopyRegion.imageSubresource.layerCount = 1;
 		bufferCopyRegion.imageExtent.depth = 1;
 
-		for (uint32_t i = 0; i < texture.mipLevels; i++) {
+		for (uint32_t i = 0; i < tex2D.levels(); i++) {
 			bufferCopyRegion.imageExtent.width = tex2D[i].extent().x;
 			bufferCopyRegion.imageExtent.height = tex2D[i].extent().y;
 			bufferCopyRegion.imageSubresource.mipLevel = i;
@@ -152,6 +284,9 @@ vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::F
 
 		// Create optimal tiled target image
 		imageCreateInfo.usage = vk::ImageUsageFlagBits::eTransferDst | imageUsageFlags;
+		if (blitMipLevels) {
+			imageCreateInfo.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
 		imageCreateInfo.mipLevels = texture.mipLevels;
 
 		texture = context.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
@@ -173,14 +308,18 @@ vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::F
 
 		// Copy mip levels from staging buffer
 		cmdBuffer.copyBufferToImage(staging.buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, bufferCopyRegions);
-		// Change texture image layout to shader read after all mip levels have been copied
-		setImageLayout(
-			cmdBuffer,
-			texture.image,
-			vk::ImageAspectFlagBits::eColor,
-			vk::ImageLayout::eTransferDstOptimal,
-			texture.imageLayout,
-			subresourceRange);
+		if (blitMipLevels) {
+			blitMips(cmdBuffer, texture.image, imageCreateInfo.extent.width, imageCreateInfo.extent.height, texture.mipLevels, vk::PipelineStageFlagBits::eAllCommands);
+		} else {
+			// Change texture image layout to shader read after all mip levels have been copied
+			setImageLayout(
+				cmdBuffer,
+				texture.image,
+				vk::ImageAspectFlagBits::eColor,
+				vk::ImageLayout::eTransferDstOptimal,
+				texture.imageLayout,
+				subresourceRange);
+		}
 
 		// Submit command buffer containing copy and image layout commands
 		cmdBuffer.end();
@@ -249,35 +388,15 @@ vkx::Texture vkx::TextureLoader::loadTexture(const std::string & filename, vk::F
 	}
 
 	// Create sampler
-	{
-		vk::SamplerCreateInfo sampler;
-		sampler.magFilter = vk::Filter::eLinear;
-		sampler.minFilter = vk::Filter::eLinear;
-		sampler.mipmapMode = vk::SamplerMipmapMode::eLinear;
-		// Max level-of-detail should match mip level count
-		sampler.maxLod = (useStaging) ? (float)texture.mipLevels : 0.0f;
-		// Enable anisotropic filtering
-		sampler.maxAnisotropy = 8;
-		sampler.anisotropyEnable = VK_TRUE;
-		sampler.borderColor = vk::BorderColor::eFloatOpaqueWhite;
-		texture.sampler = context.device.createSampler(sampler);
-	}
+	// Linear tiling usually won't support mip maps
+	// Only use the mip chain if optimal tiling is used
+	texture.sampler = createSampler2D(context, (useStaging) ? texture.mipLevels : 1);
 
 	// Create image view
 	// Textures are not directly accessed by the shaders and
 	// are abstracted by image views containing additional
 	// information and sub resource ranges
-	{
-		vk::ImageViewCreateInfo view;
-		view.viewType = vk::ImageViewType::e2D;
-		view.format = format;
-		view.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
-		// Linear tiling usually won't support mip maps
-		// Only set mip map count if optimal tiling is used
-		view.subresourceRange.levelCount = (useStaging) ? texture.mipLevels : 1;
-		view.image = texture.image;
-		texture.view = context.device.createImageView(view);
-	}
+	texture.view = createView2D(context, texture.image, format, (useStaging) ? texture.mipLevels : 1);
 
 
 	texture.descriptor.imageLayout = texture.imageLayout;
@@ -404,7 +523,7 @@ vkx::Texture vkx::TextureLoader::loadCubemap(const std::string & filename, vk::F
 	sampler.maxAnisotropy = 8.0f;
 	sampler.maxLod = texture.mipLevels;
 	sampler.borderColor = vk::BorderColor::eFloatOpaqueWhite;
-	texture.sampler = context.device.createSampler(sampler);
+	texture.sampler = context.getSampler(sampler);
 
 	// Create image view
 	vk::ImageViewCreateInfo view;
@@ -579,7 +698,7 @@ vkx::Texture vkx::TextureLoader::loadTextureArray(const std::string & filename,
 	sampler.minLod = 0.0f;
 	sampler.maxLod = 0.0f;
 	sampler.borderColor = vk::BorderColor::eFloatOpaqueWhite;
-	texture.sampler = context.device.createSampler(sampler);
+	texture.sampler = context.getSampler(sampler);
 
 	// Create image view
 	vk::ImageViewCreateInfo view;
@@ -668,8 +787,9 @@ uint32_t getMemoryType(vk::PhysicalDeviceMemoryProperties memoryProperties, uint
 * @param texture Pointer to the texture object to load the image into
 * @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 * @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+* @param (Optional) generateMips Build the full mip chain from the buffer (blitted, or on the cpu for block formats)
 */
-void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize, vk::Format format, uint32_t width, uint32_t height, vkx::Texture *texture, vk::Filter filter, vk::ImageUsageFlags imageUsageFlags) {
+void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize, vk::Format format, uint32_t width, uint32_t height, vkx::Texture *texture, vk::Filter filter, vk::ImageUsageFlags imageUsageFlags, bool generateMips) {
 
 	
 
@@ -683,6 +803,26 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	texture->extent.setHeight(height);
 	texture->mipLevels = 1;
 
+	// one level from the buffer, unless mips were asked for
+	std::vector<vk::BufferImageCopy> bufferCopyRegions(1);
+	bool blitMipLevels = false;
+	gli::texture2d generated;
+	if (generateMips && mipCount(width, height) > 1) {
+		if (canBlitMips(context, format)) {
+			blitMipLevels = true;
+			texture->mipLevels = mipCount(width, height);
+		} else if (texture::canGenerateMips(format)) {
+			gli::texture2d level0((gli::format)format, gli::extent2d(width, height), 1);
+			memcpy(level0.data(), buffer, (size_t)std::min(bufferSize, (vk::DeviceSize)level0.size()));
+			generated = texture::generateMips(level0, texture::Usage::eColor);
+			format = texture::format(generated);
+			texture->mipLevels = (uint32_t)generated.levels();
+			buffer = generated.data();
+			bufferSize = generated.size();
+			bufferCopyRegions.resize(texture->mipLevels);
+		}
+	}
+
 	vk::MemoryAllocateInfo memAllocInfo;/* = vkTools::initializers::memoryAllocateInfo();*/
 	vk::MemoryRequirements memReqs;
 
@@ -716,7 +856,7 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 
 
 	//VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	stagingMemory = context.device.allocateMemory(memAllocInfo, nullptr);
+	stagingMemory = vkx::memory::allocateMemory(context.device, memAllocInfo, vkx::MEMORY_CATEGORY_STAGING);
 	//VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer, stagingMemory, 0));
 	context.device.bindBufferMemory(stagingBuffer, stagingMemory, 0);
 	
@@ -729,15 +869,21 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	memcpy(data, buffer, bufferSize);
 	//vkUnmapMemory(vulkanDevice->logicalDevice, stagingMemory);
 
-	vk::BufferImageCopy bufferCopyRegion;
-	bufferCopyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-	bufferCopyRegion.imageSubresource.mipLevel = 0;
-	bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-	bufferCopyRegion.imageSubresource.layerCount = 1;
-	bufferCopyRegion.imageExtent.width = width;
-	bufferCopyRegion.imageExtent.height = height;
-	bufferCopyRegion.imageExtent.depth = 1;
-	bufferCopyRegion.bufferOffset = 0;
+	vk::DeviceSize offset = 0;
+	for (uint32_t i = 0; i < bufferCopyRegions.size(); i++) {
+		vk::BufferImageCopy &bufferCopyRegion = bufferCopyRegions[i];
+		bufferCopyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+		bufferCopyRegion.imageSubresource.mipLevel = i;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = std::max(width >> i, 1u);
+		bufferCopyRegion.imageExtent.height = std::max(height >> i, 1u);
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = offset;
+		if (generated.levels() > i) {
+			offset += generated[i].size();
+		}
+	}
 
 	// Create optimal tiled target image
 	vk::ImageCreateInfo imageCreateInfo;
@@ -756,8 +902,13 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	if (!(imageCreateInfo.usage & vk::ImageUsageFlagBits::eTransferDst)) {
 		imageCreateInfo.usage |= vk::ImageUsageFlagBits::eTransferDst;
 	}
+	// and the blits read from it
+	if (blitMipLevels) {
+		imageCreateInfo.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+	}
 	//VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
 	texture->image = context.device.createImage(imageCreateInfo, nullptr);
+	texture->format = format;
 
 	//vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture->image, &memReqs);
 	memReqs = context.device.getImageMemoryRequirements(texture->image);
@@ -768,7 +919,7 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	memAllocInfo.memoryTypeIndex = getMemoryType(context.deviceMemoryProperties, memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
 
 	//VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-	texture->memory = context.device.allocateMemory(memAllocInfo, nullptr);
+	texture->memory = vkx::memory::allocateMemory(context.device, memAllocInfo, vkx::MEMORY_CATEGORY_TEXTURE);
 	//VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture->image, texture->deviceMemory, 0));
 	context.device.bindImageMemory(texture->image, texture->memory, 0);
 
@@ -798,17 +949,21 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	//	&bufferCopyRegion
 	//);
 
-	cmdBuffer.copyBufferToImage(stagingBuffer, texture->image, vk::ImageLayout::eTransferDstOptimal, 1, &bufferCopyRegion);
+	cmdBuffer.copyBufferToImage(stagingBuffer, texture->image, vk::ImageLayout::eTransferDstOptimal, bufferCopyRegions);
 
 	// Change texture image layout to shader read after all mip levels have been copied
 	texture->imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-	vkx::setImageLayout(
-		cmdBuffer,
-		texture->image,
-		vk::ImageAspectFlagBits::eColor,
-		vk::ImageLayout::eTransferDstOptimal,
-		texture->imageLayout,
-		subresourceRange);
+	if (blitMipLevels) {
+		blitMips(cmdBuffer, texture->image, width, height, texture->mipLevels, vk::PipelineStageFlagBits::eAllCommands);
+	} else {
+		vkx::setImageLayout(
+			cmdBuffer,
+			texture->image,
+			vk::ImageAspectFlagBits::eColor,
+			vk::ImageLayout::eTransferDstOptimal,
+			texture->imageLayout,
+			subresourceRange);
+	}
 
 	// Submit command buffer containing copy and image layout commands
 	//VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
@@ -835,7 +990,7 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 
 	// Clean up staging resources
 	//vkFreeMemory(vulkanDevice->logicalDevice, stagingMemory, nullptr);
-	context.device.freeMemory(stagingMemory, nullptr);
+	vkx::memory::freeMemory(context.device, stagingMemory);
 	//vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer, nullptr);
 	context.device.destroyBuffer(stagingBuffer, nullptr);
 
@@ -850,9 +1005,9 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	sampler.mipLodBias = 0.0f;
 	sampler.compareOp = vk::CompareOp::eNever;
 	sampler.minLod = 0.0f;
-	sampler.maxLod = 0.0f;
+	sampler.maxLod = texture->mipLevels > 1 ? VK_LOD_CLAMP_NONE : 0.0f;
 	//VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &sampler, nullptr, &texture->sampler));
-	texture->sampler = context.device.createSampler(sampler, nullptr);
+	texture->sampler = context.getSampler(sampler);
 
 	// Create image view
 	vk::ImageViewCreateInfo view;
@@ -862,7 +1017,7 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	view.format = format;
 	view.components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
 	view.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
-	view.subresourceRange.levelCount = 1;
+	view.subresourceRange.levelCount = texture->mipLevels;
 	view.image = texture->image;
 	//VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &texture->view));
 	texture->view = context.device.createImageView(view, nullptr);
@@ -874,3 +1029,238 @@ void vkx::TextureLoader::createTexture(void* buffer, vk::DeviceSize bufferSize,
 	texture->descriptor.sampler = texture->sampler;
 }
 
+
+
+
+vkx::TextureBatch::TextureBatch(const Context &context, TextureLoader &loader)
+	: context(context), loader(loader)
+{
+}
+
+vkx::TextureBatch::~TextureBatch() {
+	wait();
+}
+
+std::shared_ptr<vkx::Texture> vkx::TextureBatch::add(const std::string & filename, texture::Usage usage) {
+	if (submitted) {
+		throw std::runtime_error("TextureBatch: add after submit");
+	}
+
+	// the same file twice is one upload (and one cook)
+	for (auto &request : requests) {
+		if (request.filename == filename && request.usage == usage) {
+			return request.texture;
+		}
+	}
+
+	Request request;
+	request.filename = filename;
+	request.usage = usage;
+	request.texture = std::make_shared<Texture>();
+	requests.push_back(request);
+	return request.texture;
+}
+
+vk::DeviceSize vkx::TextureBatch::stagedSize(const Request &request) {
+	vk::DeviceSize size = 0;
+	for (size_t i = request.firstLevel; i < request.data.levels(); i++) {
+		size += request.data[i].size();
+	}
+	return size;
+}
+
+void vkx::TextureBatch::submit() {
+	if (submitted) {
+		throw std::runtime_error("TextureBatch: submitted twice");
+	}
+	submitted = true;
+
+	if (requests.empty()) {
+		finished = true;
+		return;
+	}
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+
+	// decode / cook on all threads, the rest has to stay on this one (command pool)
+	vkx::parallelFor(requests.size(), 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			Request &request = requests[i];
+			request.data = loader.loadFile2D(request.filename, request.usage);
+
+			// single level block formats get their mips here, the rest are blitted below
+			// (all of them with maxSize, the levels that are left out have to exist in the file data)
+			if (loader.generateMissingMips && request.data.levels() == 1 && mipCount((uint32_t)request.data.extent().x, (uint32_t)request.data.extent().y) > 1) {
+				vk::Format format = texture::format(request.data);
+				if ((maxSize || !canBlitMips(context, format)) && texture::canGenerateMips(format)) {
+					request.data = texture::generateMips(request.data, request.usage);
+				}
+			}
+		}
+	});
+
+	// every texture at an offset that suits any block size
+	vk::DeviceSize stagingSize = 0;
+	for (auto &request : requests) {
+		if (request.data.empty()) {
+			throw std::runtime_error("Couldn't load texture " + request.filename);
+		}
+		request.format = texture::format(request.data);
+		if (request.format == vk::Format::eUndefined) {
+			throw std::runtime_error(request.filename + " has no Vulkan format");
+		}
+
+		// the smallest levels only, down from the first that fits maxSize
+		request.firstLevel = 0;
+		while (maxSize && request.firstLevel + 1 < request.data.levels() &&
+			((uint32_t)request.data[request.firstLevel].extent().x > maxSize || (uint32_t)request.data[request.firstLevel].extent().y > maxSize)) {
+			request.firstLevel++;
+		}
+
+		request.offset = (stagingSize + 15) & ~(vk::DeviceSize)15;
+		stagingSize = request.offset + stagedSize(request);
+	}
+
+	staging = context.createBuffer(vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingSize);
+	staging.map();
+	for (auto &request : requests) {
+		staging.copy(stagedSize(request), request.data[request.firstLevel].data(), (size_t)request.offset);
+	}
+	staging.unmap();
+
+
+	vk::CommandBufferAllocateInfo cmdBufInfo;
+	cmdBufInfo.commandPool = context.getCommandPool();
+	cmdBufInfo.level = vk::CommandBufferLevel::ePrimary;
+	cmdBufInfo.commandBufferCount = 1;
+	cmdBuffer = context.device.allocateCommandBuffers(cmdBufInfo)[0];
+
+	cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+	for (auto &request : requests) {
+		const gli::texture2d &tex2D = request.data;
+		Texture &texture = *request.texture;
+
+		uint32_t mipLevels = (uint32_t)tex2D.levels() - request.firstLevel;
+		uint32_t width = (uint32_t)tex2D[request.firstLevel].extent().x;
+		uint32_t height = (uint32_t)tex2D[request.firstLevel].extent().y;
+
+		bool blitMipLevels = loader.generateMissingMips && mipLevels == 1 && mipCount(width, height) > 1 && canBlitMips(context, request.format);
+		if (blitMipLevels) {
+			mipLevels = mipCount(width, height);
+		}
+
+		vk::ImageCreateInfo imageCreateInfo;
+		imageCreateInfo.imageType = vk::ImageType::e2D;
+		imageCreateInfo.format = request.format;
+		imageCreateInfo.extent = vk::Extent3D(width, height, 1);
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		if (blitMipLevels || maxSize) {
+			imageCreateInfo.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
+		imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+		{
+			vkx::memory::Scope memoryScope(request.filename.c_str());
+			texture = context.createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		}
+		texture.mipLevels = mipLevels;
+		texture.firstLevel = request.firstLevel;
+
+		std::vector<vk::BufferImageCopy> bufferCopyRegions;
+		vk::DeviceSize offset = request.offset;
+		for (uint32_t i = request.firstLevel; i < tex2D.levels(); i++) {
+			vk::BufferImageCopy bufferCopyRegion;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.imageSubresource = { vk::ImageAspectFlagBits::eColor, i - request.firstLevel, 0, 1 };
+			bufferCopyRegion.imageExtent = vk::Extent3D((uint32_t)tex2D[i].extent().x, (uint32_t)tex2D[i].extent().y, 1);
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			offset += tex2D[i].size();
+		}
+
+		vk::ImageSubresourceRange subresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1);
+
+		setImageLayout(
+			cmdBuffer,
+			texture.image,
+			vk::ImageAspectFlagBits::eColor,
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eTransferDstOptimal,
+			subresourceRange,
+			vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eTransfer);
+
+		cmdBuffer.copyBufferToImage(staging.buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, bufferCopyRegions);
+
+		// all commands, later submits sample these without waiting on the fence
+		if (blitMipLevels) {
+			blitMips(cmdBuffer, texture.image, width, height, mipLevels, vk::PipelineStageFlagBits::eAllCommands);
+		} else {
+			setImageLayout(
+				cmdBuffer,
+				texture.image,
+				vk::ImageAspectFlagBits::eColor,
+				vk::ImageLayout::eTransferDstOptimal,
+				texture.imageLayout,
+				subresourceRange,
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eAllCommands);
+		}
+
+		texture.sampler = createSampler2D(context, mipLevels);
+		texture.view = createView2D(context, texture.image, request.format, mipLevels);
+
+		texture.descriptor.imageLayout = texture.imageLayout;
+		texture.descriptor.imageView = texture.view;
+		texture.descriptor.sampler = texture.sampler;
+
+		// the staging buffer has it now
+		request.data = gli::texture2d();
+	}
+
+	cmdBuffer.end();
+
+	fence = context.device.createFence(vk::FenceCreateInfo());
+
+	vk::SubmitInfo submitInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+	context.queue.submit(submitInfo, fence);
+
+
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(tEnd - tStart).count();
+	printf("Texture batch: %d textures, %d KB staged (%d ms)\n", (int)requests.size(), (int)(stagingSize / 1024), (int)duration);
+}
+
+void vkx::TextureBatch::release() {
+	context.device.destroyFence(fence);
+	fence = vk::Fence();
+	context.device.freeCommandBuffers(context.getCommandPool(), cmdBuffer);
+	cmdBuffer = vk::CommandBuffer();
+	staging.destroy();
+	finished = true;
+}
+
+bool vkx::TextureBatch::ready() {
+	// nothing submitted (or submit() threw)
+	if (finished || !fence) {
+		return finished;
+	}
+	if (context.device.getFenceStatus(fence) != vk::Result::eSuccess) {
+		return false;
+	}
+	release();
+	return true;
+}
+
+void vkx::TextureBatch::wait() {
+	if (finished || !fence) {
+		return;
+	}
+	context.device.waitForFences(fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
+	release();
+}
@@ -0,0 +1,534 @@
+#include "vulkanTextureStreamer.h"
+#include "vulkanArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace vkx {
+
+
+	void TextureStreamer::prepare(const Context *context, TextureLoader *loader, AssetManager *assetManager, MaterialTable *materialTable) {
+		this->context = context;
+		this->loader = loader;
+		this->assetManager = assetManager;
+		this->materialTable = materialTable;
+		this->limitBytes = currentLimit();
+	}
+
+
+
+	void TextureStreamer::add(const std::string &fileName, texture::Usage usage, const Texture &texture) {
+
+		// materials share textures
+		if (this->entryByImage.find(texture.image) != this->entryByImage.end()) {
+			return;
+		}
+
+		Entry entry;
+		entry.fileName = fileName;
+		entry.usage = usage;
+		entry.width = std::max(texture.extent.width << texture.firstLevel, 1u);
+		entry.height = std::max(texture.extent.height << texture.firstLevel, 1u);
+		entry.mipLevels = texture.firstLevel + texture.mipLevels;
+		entry.minLevel = texture.firstLevel;
+		entry.texture = texture;
+		entry.wantedLevel = texture.firstLevel;
+		entry.targetLevel = texture.firstLevel;
+
+		this->residentBytes += levelsSize(entry, texture.firstLevel);
+		this->entryByImage[texture.image] = this->entries.size();
+		this->entries.push_back(std::move(entry));
+	}
+
+
+
+	vk::DeviceSize TextureStreamer::levelsSize(const Entry &entry, uint32_t firstLevel) const {
+
+		gli::format format = (gli::format)entry.texture.format;
+		gli::ivec3 blockExtent = gli::block_extent(format);
+		vk::DeviceSize blockSize = gli::block_size(format);
+
+		vk::DeviceSize size = 0;
+		for (uint32_t level = firstLevel; level < entry.mipLevels; ++level) {
+			vk::DeviceSize width = std::max(entry.width >> level, 1u);
+			vk::DeviceSize height = std::max(entry.height >> level, 1u);
+			size += ((width + blockExtent.x - 1) / blockExtent.x) * ((height + blockExtent.y - 1) / blockExtent.y) * blockSize;
+		}
+		return size;
+	}
+
+
+
+	vk::DeviceSize TextureStreamer::currentLimit() const {
+
+		if (this->budget) {
+			return this->budget;
+		}
+
+		vk::DeviceSize heapBudget, heapUsage;
+		if (this->context->getMemoryBudget(heapBudget, heapUsage)) {
+			// the usage includes the streamed textures
+			vk::DeviceSize allowed = (vk::DeviceSize)(heapBudget * (1.0 - TEXTURE_STREAM_BUDGET_RESERVE));
+			vk::DeviceSize others = heapUsage > this->residentBytes ? heapUsage - this->residentBytes : 0;
+			return allowed > others ? allowed - others : 0;
+		}
+
+		return (vk::DeviceSize)(heapBudget * TEXTURE_STREAM_HEAP_FRACTION);
+	}
+
+
+
+	void TextureStreamer::beginFrame() {
+		this->frame++;
+	}
+
+
+
+	void TextureStreamer::request(const Texture &texture, float pixels) {
+
+		if (pixels <= 0.0f) {
+			return;
+		}
+
+		auto it = this->entryByImage.find(texture.image);
+		if (it == this->entryByImage.end()) {
+			return;
+		}
+		Entry &entry = this->entries[it->second];
+
+		// one texel per pixel
+		float level = log2f((float)std::max(entry.width, entry.height) / pixels) + this->lodBias;
+		uint32_t wanted = level <= 0.0f ? 0 : std::min((uint32_t)level, entry.minLevel);
+
+		if (entry.lastRequested != this->frame) {
+			entry.lastRequested = this->frame;
+			entry.wantedLevel = wanted;
+		} else {
+			entry.wantedLevel = std::min(entry.wantedLevel, wanted);
+		}
+	}
+
+	void TextureStreamer::request(const Material &material, float pixels) {
+		if (material.diffuse) {
+			request(*material.diffuse, pixels);
+		}
+		if (material.specular) {
+			request(*material.specular, pixels);
+		}
+		if (material.bump) {
+			request(*material.bump, pixels);
+		}
+	}
+
+
+
+	void TextureStreamer::chooseLevels() {
+
+		this->limitBytes = currentLimit();
+
+		vk::DeviceSize total = 0;
+		ArenaVector<size_t> order = frameVector<size_t>();
+		order.reserve(this->entries.size());
+
+		for (size_t i = 0; i < this->entries.size(); ++i) {
+			Entry &entry = this->entries[i];
+			bool requested = this->frame - entry.lastRequested <= TEXTURE_STREAM_IDLE_FRAMES;
+			// idle textures keep what they have as long as it fits
+			entry.targetLevel = (requested && !entry.failed) ? entry.wantedLevel : entry.texture.firstLevel;
+			total += levelsSize(entry, entry.targetLevel);
+			order.push_back(i);
+		}
+
+		if (total <= this->limitBytes) {
+			return;
+		}
+
+		// least recently requested first, of those the most detailed
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			const Entry &entryA = this->entries[a];
+			const Entry &entryB = this->entries[b];
+			if (entryA.lastRequested != entryB.lastRequested) {
+				return entryA.lastRequested < entryB.lastRequested;
+			}
+			return entryA.targetLevel < entryB.targetLevel;
+		});
+
+		for (size_t i : order) {
+			Entry &entry = this->entries[i];
+			while (total > this->limitBytes && entry.targetLevel < entry.minLevel) {
+				total -= levelsSize(entry, entry.targetLevel) - levelsSize(entry, entry.targetLevel + 1);
+				entry.targetLevel++;
+			}
+			if (total <= this->limitBytes) {
+				break;
+			}
+		}
+	}
+
+
+
+	void TextureStreamer::startLoads() {
+
+		uint32_t loads = 0;
+		ArenaVector<size_t> wanted = frameVector<size_t>();
+		for (size_t i = 0; i < this->entries.size(); ++i) {
+			const Entry &entry = this->entries[i];
+			if (entry.loading) {
+				loads++;
+			} else if (!entry.uploading && !entry.failed && entry.targetLevel < entry.texture.firstLevel) {
+				wanted.push_back(i);
+			}
+		}
+
+		// the ones missing the most mips first
+		std::sort(wanted.begin(), wanted.end(), [this](size_t a, size_t b) {
+			const Entry &entryA = this->entries[a];
+			const Entry &entryB = this->entries[b];
+			return entryA.texture.firstLevel - entryA.targetLevel > entryB.texture.firstLevel - entryB.targetLevel;
+		});
+
+		for (size_t i : wanted) {
+			if (loads >= TEXTURE_STREAM_MAX_LOADS) {
+				break;
+			}
+			Entry &entry = this->entries[i];
+
+			TextureLoader *loader = this->loader;
+			std::string fileName = entry.fileName;
+			texture::Usage usage = entry.usage;
+			bool generateMips = loader->generateMissingMips && entry.mipLevels > 1;
+
+			entry.load = std::async(std::launch::async, [loader, fileName, usage, generateMips]() {
+				gli::texture2d tex2D = loader->loadFile2D(fileName, usage);
+				// made the same way when the texture was added (TextureBatch::maxSize)
+				if (generateMips && tex2D.levels() == 1 && texture::canGenerateMips(texture::format(tex2D))) {
+					tex2D = texture::generateMips(tex2D, usage);
+				}
+				return tex2D;
+			});
+			entry.loading = true;
+			loads++;
+		}
+	}
+
+
+
+	void TextureStreamer::recordUploads() {
+
+		// files that finished loading
+		std::vector<std::pair<size_t, gli::texture2d>> loaded;
+		for (size_t i = 0; i < this->entries.size(); ++i) {
+			Entry &entry = this->entries[i];
+			if (!entry.loading || entry.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				continue;
+			}
+			entry.loading = false;
+
+			gli::texture2d tex2D;
+			try {
+				tex2D = entry.load.get();
+			} catch (const std::exception &error) {
+				printf("Warning: couldn't stream %s: %s\n", entry.fileName.c_str(), error.what());
+				entry.failed = true;
+				continue;
+			}
+
+			if (tex2D.empty() || texture::format(tex2D) != entry.texture.format || tex2D.levels() != entry.mipLevels) {
+				printf("Warning: %s changed since it was loaded, not streaming it\n", entry.fileName.c_str());
+				entry.failed = true;
+				continue;
+			}
+			// add() could only guess odd sizes from the small mips
+			this->residentBytes -= levelsSize(entry, entry.texture.firstLevel);
+			entry.width = (uint32_t)tex2D[0].extent().x;
+			entry.height = (uint32_t)tex2D[0].extent().y;
+			this->residentBytes += levelsSize(entry, entry.texture.firstLevel);
+
+			// the budget may have changed while it was loading
+			if (entry.targetLevel < entry.texture.firstLevel) {
+				loaded.push_back(std::make_pair(i, tex2D));
+			}
+		}
+
+		// textures giving up mips
+		ArenaVector<size_t> dropped = frameVector<size_t>();
+		for (size_t i = 0; i < this->entries.size(); ++i) {
+			const Entry &entry = this->entries[i];
+			if (!entry.loading && !entry.uploading && entry.targetLevel > entry.texture.firstLevel) {
+				dropped.push_back(i);
+			}
+		}
+
+		if (loaded.empty() && dropped.empty()) {
+			return;
+		}
+
+
+		// the new levels of every loaded file in one staging buffer
+		std::vector<vk::DeviceSize> offsets;
+		vk::DeviceSize stagingSize = 0;
+		for (auto &load : loaded) {
+			offsets.push_back((stagingSize + 15) & ~(vk::DeviceSize)15);
+			stagingSize = offsets.back() + levelsSize(this->entries[load.first], this->entries[load.first].targetLevel);
+		}
+
+		if (stagingSize) {
+			this->staging = this->context->createBuffer(vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingSize);
+			this->staging.map();
+			for (size_t i = 0; i < loaded.size(); ++i) {
+				const gli::texture2d &tex2D = loaded[i].second;
+				vk::DeviceSize offset = offsets[i];
+				for (size_t level = this->entries[loaded[i].first].targetLevel; level < tex2D.levels(); ++level) {
+					this->staging.copy(tex2D[level].size(), tex2D[level].data(), (size_t)offset);
+					offset += tex2D[level].size();
+				}
+			}
+			this->staging.unmap();
+		}
+
+
+		vk::CommandBufferAllocateInfo cmdBufInfo;
+		cmdBufInfo.commandPool = this->context->getCommandPool();
+		cmdBufInfo.level = vk::CommandBufferLevel::ePrimary;
+		cmdBufInfo.commandBufferCount = 1;
+		this->cmdBuffer = this->context->device.allocateCommandBuffers(cmdBufInfo)[0];
+
+		this->cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+		// an image for the levels [firstLevel, mipLevels) of the entry, ready to be written
+		auto createTexture = [this](const Entry &entry, uint32_t firstLevel, uint32_t width, uint32_t height) {
+			vk::ImageCreateInfo imageCreateInfo;
+			imageCreateInfo.imageType = vk::ImageType::e2D;
+			imageCreateInfo.format = entry.texture.format;
+			imageCreateInfo.extent = vk::Extent3D(width, height, 1);
+			imageCreateInfo.mipLevels = entry.mipLevels - firstLevel;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+			imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+			Texture texture;
+			{
+				vkx::memory::Scope memoryScope(entry.fileName.c_str());
+				texture = this->context->createImage(imageCreateInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			}
+			texture.mipLevels = imageCreateInfo.mipLevels;
+			texture.firstLevel = firstLevel;
+
+			setImageLayout(
+				this->cmdBuffer,
+				texture.image,
+				vk::ImageAspectFlagBits::eColor,
+				vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eTransferDstOptimal,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, texture.mipLevels, 0, 1),
+				vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eTransfer);
+			return texture;
+		};
+
+		for (size_t i = 0; i < loaded.size(); ++i) {
+			Entry &entry = this->entries[loaded[i].first];
+			const gli::texture2d &tex2D = loaded[i].second;
+			uint32_t firstLevel = entry.targetLevel;
+
+			Texture texture = createTexture(entry, firstLevel, (uint32_t)tex2D[firstLevel].extent().x, (uint32_t)tex2D[firstLevel].extent().y);
+
+			std::vector<vk::BufferImageCopy> bufferCopyRegions;
+			vk::DeviceSize offset = offsets[i];
+			for (uint32_t level = firstLevel; level < tex2D.levels(); ++level) {
+				vk::BufferImageCopy bufferCopyRegion;
+				bufferCopyRegion.bufferOffset = offset;
+				bufferCopyRegion.imageSubresource = { vk::ImageAspectFlagBits::eColor, level - firstLevel, 0, 1 };
+				bufferCopyRegion.imageExtent = vk::Extent3D((uint32_t)tex2D[level].extent().x, (uint32_t)tex2D[level].extent().y, 1);
+				bufferCopyRegions.push_back(bufferCopyRegion);
+				offset += tex2D[level].size();
+			}
+			this->cmdBuffer.copyBufferToImage(this->staging.buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, bufferCopyRegions);
+
+			Upload upload;
+			upload.entry = loaded[i].first;
+			upload.texture = texture;
+			this->uploads.push_back(upload);
+		}
+
+		for (size_t i : dropped) {
+			Entry &entry = this->entries[i];
+			const Texture &old = entry.texture;
+			uint32_t skip = entry.targetLevel - old.firstLevel;
+			uint32_t width = std::max(old.extent.width >> skip, 1u);
+			uint32_t height = std::max(old.extent.height >> skip, 1u);
+
+			Texture texture = createTexture(entry, entry.targetLevel, width, height);
+
+			// the levels that stay are copied from the resident image
+			vk::ImageSubresourceRange keptRange(vk::ImageAspectFlagBits::eColor, skip, texture.mipLevels, 0, 1);
+			setImageLayout(
+				this->cmdBuffer,
+				old.image,
+				vk::ImageAspectFlagBits::eColor,
+				old.imageLayout,
+				vk::ImageLayout::eTransferSrcOptimal,
+				keptRange,
+				vk::PipelineStageFlagBits::eAllCommands,
+				vk::PipelineStageFlagBits::eTransfer);
+
+			std::vector<vk::ImageCopy> imageCopyRegions;
+			for (uint32_t level = 0; level < texture.mipLevels; ++level) {
+				vk::ImageCopy imageCopyRegion;
+				imageCopyRegion.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, skip + level, 0, 1);
+				imageCopyRegion.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+				imageCopyRegion.extent = vk::Extent3D(std::max(width >> level, 1u), std::max(height >> level, 1u), 1);
+				imageCopyRegions.push_back(imageCopyRegion);
+			}
+			this->cmdBuffer.copyImage(old.image, vk::ImageLayout::eTransferSrcOptimal, texture.image, vk::ImageLayout::eTransferDstOptimal, imageCopyRegions);
+
+			// frames submitted before the swap still sample it
+			setImageLayout(
+				this->cmdBuffer,
+				old.image,
+				vk::ImageAspectFlagBits::eColor,
+				vk::ImageLayout::eTransferSrcOptimal,
+				old.imageLayout,
+				keptRange,
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eAllCommands);
+
+			Upload upload;
+			upload.entry = i;
+			upload.texture = texture;
+			this->uploads.push_back(upload);
+		}
+
+		for (auto &upload : this->uploads) {
+			Texture &texture = upload.texture;
+
+			setImageLayout(
+				this->cmdBuffer,
+				texture.image,
+				vk::ImageAspectFlagBits::eColor,
+				vk::ImageLayout::eTransferDstOptimal,
+				texture.imageLayout,
+				vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, texture.mipLevels, 0, 1),
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eAllCommands);
+
+			texture.sampler = createSampler2D(*this->context, texture.mipLevels);
+			texture.view = createView2D(*this->context, texture.image, texture.format, texture.mipLevels);
+			texture.descriptor.imageLayout = texture.imageLayout;
+			texture.descriptor.imageView = texture.view;
+			texture.descriptor.sampler = texture.sampler;
+
+			this->entries[upload.entry].uploading = true;
+		}
+
+		this->cmdBuffer.end();
+
+		this->fence = this->context->device.createFence(vk::FenceCreateInfo());
+
+		vk::SubmitInfo submitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &this->cmdBuffer;
+		this->context->queue.submit(submitInfo, this->fence);
+	}
+
+
+
+	bool TextureStreamer::finishUploads() {
+
+		if (!this->fence || this->context->device.getFenceStatus(this->fence) != vk::Result::eSuccess) {
+			return false;
+		}
+
+		// frames in flight and the recorded command buffers use the old descriptors
+		this->context->device.waitIdle();
+
+		for (auto &upload : this->uploads) {
+			Entry &entry = this->entries[upload.entry];
+			Texture old = entry.texture;
+
+			this->assetManager->replaceTexture(this->context->device, old, upload.texture);
+			if (this->materialTable) {
+				this->materialTable->replaceTexture(old.view, upload.texture.descriptor);
+			}
+
+			if (upload.texture.firstLevel < old.firstLevel) {
+				this->streamedIn++;
+			} else {
+				this->evicted++;
+			}
+			this->residentBytes = this->residentBytes - levelsSize(entry, old.firstLevel) + levelsSize(entry, upload.texture.firstLevel);
+
+			this->entryByImage.erase(old.image);
+			this->entryByImage[upload.texture.image] = upload.entry;
+			entry.texture = upload.texture;
+			entry.uploading = false;
+
+			old.destroy();
+		}
+		this->uploads.clear();
+
+		this->context->device.destroyFence(this->fence);
+		this->fence = vk::Fence();
+		this->context->device.freeCommandBuffers(this->context->getCommandPool(), this->cmdBuffer);
+		this->cmdBuffer = vk::CommandBuffer();
+		if (this->staging.buffer) {
+			this->staging.destroy();
+		}
+
+		return true;
+	}
+
+
+
+	bool TextureStreamer::update() {
+
+		if (!this->context) {
+			return false;
+		}
+
+		bool swapped = finishUploads();
+
+		// one submit at a time
+		if (!this->fence) {
+			chooseLevels();
+			startLoads();
+			recordUploads();
+		}
+
+		return swapped;
+	}
+
+
+
+	void TextureStreamer::destroy() {
+
+		for (auto &entry : this->entries) {
+			if (entry.loading) {
+				entry.load.wait();
+				entry.loading = false;
+			}
+		}
+
+		if (this->fence) {
+			this->context->device.waitForFences(this->fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
+			for (auto &upload : this->uploads) {
+				upload.texture.destroy();
+			}
+			this->uploads.clear();
+
+			this->context->device.destroyFence(this->fence);
+			this->fence = vk::Fence();
+			this->context->device.freeCommandBuffers(this->context->getCommandPool(), this->cmdBuffer);
+			this->cmdBuffer = vk::CommandBuffer();
+			if (this->staging.buffer) {
+				this->staging.destroy();
+			}
+		}
+
+		this->entries.clear();
+		this->entryByImage.clear();
+		this->residentBytes = 0;
+	}
+
+}
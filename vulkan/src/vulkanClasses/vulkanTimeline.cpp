@@ -0,0 +1,73 @@
+#include "vulkanTimeline.h"
+
+#include <stdio.h>
+
+namespace vkx {
+
+
+	StartupTimeline::StartupTimeline() {
+		this->tStart = std::chrono::high_resolution_clock::now();
+		this->tLastMark = this->tStart;
+	}
+
+
+
+	StartupTimeline::Stage &StartupTimeline::stage(const std::string &name) {
+		for (auto &stage : this->stages) {
+			if (stage.name == name) {
+				return stage;
+			}
+		}
+		this->stages.push_back({ name, 0.0 });
+		return this->stages.back();
+	}
+
+
+
+	void StartupTimeline::add(const std::string &name, double ms) {
+		if (this->finished) {
+			return;
+		}
+		stage(name).ms += ms;
+		this->excludedMS += ms;
+	}
+
+	void StartupTimeline::mark(const std::string &name) {
+		if (this->finished) {
+			return;
+		}
+		auto tNow = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(tNow - this->tLastMark).count() - this->excludedMS;
+		stage(name).ms += ms > 0.0 ? ms : 0.0;
+		this->excludedMS = 0.0;
+		this->tLastMark = tNow;
+	}
+
+
+
+	void StartupTimeline::print(bool warm) {
+		if (this->finished) {
+			return;
+		}
+		this->finished = true;
+
+		double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - this->tStart).count();
+
+		printf("Startup (%s pipeline cache):\n", warm ? "warm" : "cold");
+		for (auto &stage : this->stages) {
+			printf("  %-18s %8.1f ms\n", stage.name.c_str(), stage.ms);
+		}
+		printf("  %-18s %8.1f ms\n", "total", total);
+	}
+
+
+
+	StartupTimeline::Scope::Scope(StartupTimeline &timeline, const std::string &name) : timeline(timeline), name(name) {
+		this->tStart = std::chrono::high_resolution_clock::now();
+	}
+
+	StartupTimeline::Scope::~Scope() {
+		this->timeline.add(this->name, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - this->tStart).count());
+	}
+
+}
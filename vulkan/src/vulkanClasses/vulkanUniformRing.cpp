@@ -0,0 +1,99 @@
+#include "vulkanUniformRing.h"
+
+#include <algorithm>
+
+namespace vkx {
+
+
+	vk::DeviceSize UniformRing::aligned(vk::DeviceSize size) const {
+		return (size + this->alignment - 1) / this->alignment * this->alignment;
+	}
+
+
+
+	void UniformRing::prepare(const vkx::Context *context, vk::DeviceSize frameSize, uint32_t frameCount) {
+
+		this->alignment = std::max<vk::DeviceSize>(context->deviceProperties.limits.minUniformBufferOffsetAlignment, 1);
+		this->frameSize = aligned(frameSize);
+		this->frameCount = frameCount;
+		this->frameIndex = 0;
+		this->offset = 0;
+
+		vkx::memory::Scope memoryScope(vkx::MEMORY_CATEGORY_UNIFORM, "uniform ring");
+		this->buffer = context->createBuffer(vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, size());
+		this->buffer.map();
+	}
+
+
+
+	void UniformRing::beginFrame() {
+		this->frameIndex = (this->frameIndex + 1) % this->frameCount;
+		this->usedBytes = this->offset;
+		this->offset = 0;
+	}
+
+	uint32_t UniformRing::push(const void *data, vk::DeviceSize size) {
+
+		if (this->offset + size > this->frameSize) {
+			throw std::runtime_error("Uniform ring: more than " + std::to_string(this->frameSize) + " bytes pushed in a frame");
+		}
+
+		vk::DeviceSize dynamicOffset = this->frameIndex * this->frameSize + this->offset;
+		this->buffer.copy((size_t)size, data, (size_t)dynamicOffset);
+
+		this->offset = aligned(this->offset + size);
+		this->peakBytes = std::max(this->peakBytes, this->offset);
+
+		return (uint32_t)dynamicOffset;
+	}
+
+	vk::DescriptorBufferInfo UniformRing::descriptor(vk::DeviceSize range) const {
+		return vk::DescriptorBufferInfo(this->buffer.buffer, 0, range);
+	}
+
+	void UniformRing::destroy() {
+		this->buffer.destroy();
+	}
+
+
+
+	vk::DeviceSize DirtyUpload::write(const vkx::CreateBufferResult &buffer, const void *data, size_t size, size_t blockSize) {
+
+		const uint8_t *bytes = (const uint8_t*)data;
+
+		if (this->shadow.size() != size) {
+			this->shadow.assign(bytes, bytes + size);
+			buffer.copy(size, data);
+			this->writtenBytes += size;
+			return size;
+		}
+
+		// neighbouring changed blocks go out in one copy
+		vk::DeviceSize written = 0;
+		size_t runStart = SIZE_MAX;
+		size_t offset = 0;
+		for (;;) {
+			// the last pass has nothing left to compare and only ends an open run
+			size_t length = std::min(blockSize, size - offset);
+			bool changed = length && memcmp(this->shadow.data() + offset, bytes + offset, length) != 0;
+
+			if (changed && runStart == SIZE_MAX) {
+				runStart = offset;
+			} else if (!changed && runStart != SIZE_MAX) {
+				memcpy(this->shadow.data() + runStart, bytes + runStart, offset - runStart);
+				buffer.copy(offset - runStart, bytes + runStart, runStart);
+				written += offset - runStart;
+				runStart = SIZE_MAX;
+			}
+
+			if (offset == size) {
+				break;
+			}
+			offset += length;
+		}
+
+		this->writtenBytes += written;
+		return written;
+	}
+
+}
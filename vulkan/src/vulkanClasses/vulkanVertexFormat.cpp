@@ -0,0 +1,152 @@
+#include "vulkanVertexFormat.h"
+#include "vulkanParallel.h"
+
+// vertices per parallel chunk
+#define VERTEX_WRITE_GRAIN_SIZE 16384
+
+namespace vkx {
+
+
+	VertexWriteParams vertexWriteParams(float scale, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+		VertexWriteParams params;
+		params.scale = scale;
+		glm::vec3 scaledMin = glm::min(boundsMin, boundsMax) * scale;
+		glm::vec3 scaledMax = glm::max(boundsMin, boundsMax) * scale;
+		// scale can be negative
+		glm::vec3 lo = glm::min(scaledMin, scaledMax);
+		glm::vec3 hi = glm::max(scaledMin, scaledMax);
+		params.center = (lo + hi) * 0.5f;
+		// avoid dividing by zero for flat meshes
+		params.extent = glm::max((hi - lo) * 0.5f, glm::vec3(1e-6f));
+		params.invExtent = glm::vec3(1.0f) / params.extent;
+		return params;
+	}
+
+
+
+	bool hasPositionStream(const std::vector<VertexComponent> &layout) {
+		return !layout.empty() && layout[0] == VERTEX_COMPONENT_POSITION_SNORM16;
+	}
+
+
+
+	template <typename Format>
+	static bool tryWriteVertices(const std::vector<VertexComponent> &layout, const Vertex *vertices, size_t count, const VertexWriteParams &params, uint8_t *dst) {
+		if (!Format::matches(layout)) {
+			return false;
+		}
+		Format::write(vertices, count, params, dst);
+		return true;
+	}
+
+
+
+	template <typename Component>
+	static uint8_t *writeComponent(uint8_t *dst, const Vertex &v, const VertexWriteParams &params) {
+		Component::write(dst, v, params);
+		return dst + Component::size;
+	}
+
+	static void writeVertexRange(const std::vector<VertexComponent> &layout, const Vertex *vertices, size_t count, const VertexWriteParams &params, uint8_t *dst) {
+
+		if (tryWriteVertices<DefaultVertexFormat>(layout, vertices, count, params, dst)) {
+			return;
+		}
+		if (tryWriteVertices<MeshVertexFormat>(layout, vertices, count, params, dst)) {
+			return;
+		}
+		if (tryWriteVertices<DeferredVertexFormat>(layout, vertices, count, params, dst)) {
+			return;
+		}
+		if (tryWriteVertices<PackedAttributeFormat>(layout, vertices, count, params, dst)) {
+			return;
+		}
+		if (tryWriteVertices<PackedVertexFormat>(layout, vertices, count, params, dst)) {
+			return;
+		}
+
+
+		// generic path for layouts without a pre-instantiated format
+		for (size_t i = 0; i < count; ++i) {
+			const Vertex &v = vertices[i];
+
+			for (auto &layoutDetail : layout) {
+				switch (layoutDetail) {
+					case VERTEX_COMPONENT_POSITION:
+						dst = writeComponent<vertex::Position>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_NORMAL:
+						dst = writeComponent<vertex::Normal>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_COLOR:
+						dst = writeComponent<vertex::Color>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_UV:
+						dst = writeComponent<vertex::UV>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_TANGENT:
+						dst = writeComponent<vertex::Tangent>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_BITANGENT:
+						dst = writeComponent<vertex::Bitangent>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_DUMMY_FLOAT:
+						dst = writeComponent<vertex::PadFloat>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_DUMMY_VEC4:
+						dst = writeComponent<vertex::Pad4>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_POSITION_SNORM16:
+						dst = writeComponent<vertex::PositionSnorm16>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_NORMAL_OCT:
+						dst = writeComponent<vertex::NormalOct>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_TANGENT_OCT:
+						dst = writeComponent<vertex::TangentOct>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_UV_HALF:
+						dst = writeComponent<vertex::UVHalf>(dst, v, params);
+						break;
+					case VERTEX_COMPONENT_COLOR_UNORM8:
+						dst = writeComponent<vertex::ColorUnorm8>(dst, v, params);
+						break;
+				}
+			}
+		}
+	}
+
+
+
+	void writeVertices(const std::vector<VertexComponent> &layout, const std::vector<Vertex> &vertices, const VertexWriteParams &params, void *dst) {
+
+		uint8_t *bytes = static_cast<uint8_t*>(dst);
+
+		if (hasPositionStream(layout)) {
+			// position stream first, then everything else interleaved
+			std::vector<VertexComponent> attributeLayout(layout.begin() + 1, layout.end());
+			uint32_t attributeStride = vkx::vertexSize(attributeLayout);
+			uint8_t *attributes = bytes + vertices.size() * PackedPositionFormat::size;
+
+			vkx::parallelFor(vertices.size(), VERTEX_WRITE_GRAIN_SIZE, [&](size_t begin, size_t end) {
+				PackedPositionFormat::write(vertices.data() + begin, end - begin, params, bytes + begin * PackedPositionFormat::size);
+				writeVertexRange(attributeLayout, vertices.data() + begin, end - begin, params, attributes + begin * attributeStride);
+			});
+			return;
+		}
+
+		uint32_t stride = vkx::vertexSize(layout);
+
+		vkx::parallelFor(vertices.size(), VERTEX_WRITE_GRAIN_SIZE, [&](size_t begin, size_t end) {
+			writeVertexRange(layout, vertices.data() + begin, end - begin, params, bytes + begin * stride);
+		});
+	}
+
+	void writeVertices(const std::vector<VertexComponent> &layout, const std::vector<Vertex> &vertices, const VertexWriteParams &params, std::vector<uint8_t> &vertexBuffer) {
+		vertexBuffer.resize(vertices.size() * vkx::vertexSize(layout));
+		if (!vertices.empty()) {
+			writeVertices(layout, vertices, params, vertexBuffer.data());
+		}
+	}
+
+}